@@ -164,6 +164,69 @@ int AT_RF_Handler(int8_t tx_power, uint16_t scan_interval, uint16_t scan_window)
   */
 int AT_SAVE_Handler(void);
 
+/**
+  * @brief Report key-value store usage and page wear
+  */
+int AT_KVS_Handler(void);
+
+/**
+  * @brief Set store-and-forward mode for events the host misses
+  * @param mode 0 = off, 1 = store after timeout_s without AT commands, 2 = always store
+  */
+int AT_EVLOG_Handler(uint8_t mode, uint16_t timeout_s);
+
+/**
+  * @brief Report event log mode, usage and counters
+  */
+int AT_EVLOGS_Handler(void);
+
+/**
+  * @brief Replay stored events in sequence order
+  * @param from_seq First sequence number (0 = after the last replayed one)
+  */
+int AT_REPLAY_Handler(uint32_t from_seq);
+
+/**
+  * @brief Benchmark the CRC-32 implementations
+  * @param len Bytes of Flash to checksum (1 - CRC_BENCH_MAX)
+  */
+int AT_CRCB_Handler(uint16_t len);
+
+/**
+  * @brief Report debug log filters, ring usage and drop counters
+  */
+int AT_LOG_Handler(void);
+
+/**
+  * @brief Report CPU load and per task / ISR cycle counts
+  */
+int AT_PROF_Handler(void);
+
+/**
+  * @brief Clear the profiler counters and start a new window
+  */
+int AT_PROFCLR_Handler(void);
+
+/**
+  * @brief Report asynchronous HCI command queue depth and latencies
+  */
+int AT_HCIQ_Handler(void);
+
+/**
+  * @brief Clear the HCI command queue counters
+  */
+int AT_HCIQCLR_Handler(void);
+
+/**
+  * @brief Report HCI event queue, event pool and CPU2 memory block usage
+  */
+int AT_HCIEVT_Handler(void);
+
+/**
+  * @brief Clear the HCI event queue counters
+  */
+int AT_HCIEVTCLR_Handler(void);
+
 /* ============ Mode Commands ============ */
 
 /**
@@ -174,9 +237,104 @@ int AT_CMDMODE_Handler(void);
 /**
   * @brief Enter data mode (transparent UART<->GATT)
   * @param dev_idx Device index
-  * @param char_handle Characteristic handle
+  * @param char_handle Characteristic handle written with UART data
+  * @param rx_handle Characteristic forwarded to UART (0 = char_handle)
+  * @param tx_mode 0 = write without response, 1 = write with response
+  */
+int AT_DATAMODE_Handler(uint8_t dev_idx, uint16_t char_handle, uint16_t rx_handle,
+                        uint8_t tx_mode);
+
+/**
+  * @brief Report data mode throughput statistics
+  */
+int AT_DATASTAT_Handler(void);
+
+/**
+  * @brief Set and report the data mode flush policy
+  * @param set 0 = report only
+  * @param max_bytes Send once this many bytes are buffered (0 = ATT_MTU-3)
+  * @param latency_ms Max time a byte waits for coalescing
+  * @param idle_ms Send after this UART silence (0 = off)
+  * @param nagle 1 = send at once when the link has been quiet for latency_ms
+  */
+int AT_DATAFLUSH_Handler(uint8_t set, uint16_t max_bytes, uint16_t latency_ms,
+                         uint16_t idle_ms, uint8_t nagle);
+
+/**
+  * @brief Bind a mux link to its data characteristics
+  * @param link Device index
+  * @param tx_handle Characteristic written with host frames (0 = unbind)
+  * @param rx_handle Characteristic framed back to host (0 = tx_handle)
+  * @param tx_mode 0 = write without response, 1 = write with response
+  */
+int AT_MUX_Handler(uint8_t link, uint16_t tx_handle, uint16_t rx_handle, uint8_t tx_mode);
+
+/**
+  * @brief Enter mux mode (COBS-framed multi-link data mode)
+  */
+int AT_MUXMODE_Handler(void);
+
+/**
+  * @brief Report mux links and statistics
+  */
+int AT_MUXS_Handler(void);
+
+/**
+  * @brief Open an L2CAP CoC channel
+  * @param dev_idx Device index
+  * @param spsm Peer SPSM (1-0xFF)
+  * @param mtu Largest SDU accepted (0 = default)
+  */
+int AT_COC_Handler(uint8_t dev_idx, uint16_t spsm, uint16_t mtu);
+
+/**
+  * @brief Close an L2CAP CoC channel
+  */
+int AT_COCDISC_Handler(uint8_t ch);
+
+/**
+  * @brief Enter data mode over an L2CAP CoC channel
+  */
+int AT_COCMODE_Handler(uint8_t ch);
+
+/**
+  * @brief Report L2CAP CoC channels and statistics
+  */
+int AT_COCS_Handler(void);
+
+/**
+  * @brief Start a link throughput benchmark
+  * @param dev_idx Device index
+  * @param dir 1 = TX, 2 = RX, 3 = both
+  * @param seconds Test length
+  * @param mode 0 = write without response, 1 = write with response, 2 = CoC
+  * @param target Characteristic handle, or CoC channel in mode 2
+  */
+int AT_TPUT_Handler(uint8_t dev_idx, uint8_t dir, uint16_t seconds, uint8_t mode,
+                    uint16_t target);
+
+/**
+  * @brief Report the running or last benchmark
+  */
+int AT_TPUTS_Handler(void);
+
+/**
+  * @brief Abort the running benchmark
+  */
+int AT_TPUTSTOP_Handler(void);
+
+/**
+  * @brief Enable or disable UART-side compression on a link
+  * @param dev_idx Device index (data mode target or mux link)
+  * @param up 1 = host sends compressed data to the peer
+  * @param down 1 = peer data is compressed toward the host
   */
-int AT_DATAMODE_Handler(uint8_t dev_idx, uint16_t char_handle);
+int AT_COMP_Handler(uint8_t dev_idx, uint8_t up, uint8_t down);
+
+/**
+  * @brief Report compression ratio and cycle cost per stream
+  */
+int AT_COMPS_Handler(void);
 
 /* ============ Connection Status Commands ============ */
 
@@ -209,4 +367,149 @@ int AT_WAKE_Handler(void);
   */
 int AT_DIAG_Handler(uint8_t dev_idx);
 
+/* ============ GATT Flow Commands ============ */
+
+/**
+  * @brief Start GATT procedure flow on device
+  * @param dev_idx Device index
+  * @param class_name Device class (GENERIC, HRS, BAS, HTS, P2P)
+  */
+int AT_FLOW_Handler(uint8_t dev_idx, const char *class_name);
+
+/**
+  * @brief Abort GATT procedure flow on device
+  * @param dev_idx Device index
+  */
+int AT_FLOWSTOP_Handler(uint8_t dev_idx);
+
+/**
+  * @brief List device classes and running flows
+  */
+int AT_FLOWS_Handler(void);
+
+/* ============ Profile Decoder Commands ============ */
+
+/**
+  * @brief Bind a profile decoder to a characteristic value
+  * @param dev_idx Device index
+  * @param value_handle Characteristic value handle
+  * @param name Decoder name (HRM, BATT, TEMP, CSC, RSC, NONE)
+  */
+int AT_DECODE_Handler(uint8_t dev_idx, uint16_t value_handle, const char *name);
+
+/**
+  * @brief List decoder bindings
+  */
+int AT_DECODES_Handler(void);
+
+/* ============ Group Commands ============ */
+
+/**
+  * @brief Define a device group
+  * @param gid Group ID
+  * @param spec "ALL", "1;2;5", "NAME:<prefix>", "RSSI:<min_dbm>" or "NONE"
+  */
+int AT_GROUP_Handler(uint8_t gid, const char *spec);
+
+/**
+  * @brief List device groups
+  */
+int AT_GROUPS_Handler(void);
+
+/**
+  * @brief Run a GATT operation on all connected members of a group
+  * @param gid Group ID
+  * @param op_type BLE_GattQueueOpType_t (read, write, subscribe)
+  * @param by_uuid 1 if target is a 16-bit char UUID
+  * @param target Handle or UUID
+  * @param arg Subscribe mode (0=off, 1=notify, 2=indicate)
+  * @param data Hex data for write
+  */
+int AT_GOP_Handler(uint8_t gid, uint8_t op_type, uint8_t by_uuid, uint16_t target,
+                   uint8_t arg, const char *data);
+
+/* ============ Poll Commands ============ */
+
+/**
+  * @brief Add, update or remove (period 0) a periodic read
+  * @param dev_idx Device index
+  * @param by_uuid 1 if target is a 16-bit char UUID
+  * @param target Handle or UUID
+  * @param period_ms Poll period in ms
+  */
+int AT_POLL_Handler(uint8_t dev_idx, uint8_t by_uuid, uint16_t target, uint32_t period_ms);
+
+/**
+  * @brief List poll entries with statistics
+  */
+int AT_POLLS_Handler(void);
+
+/**
+  * @brief Remove all poll entries
+  */
+int AT_POLLCLR_Handler(void);
+
+/* ============ Rule Commands ============ */
+
+/**
+  * @brief Add or replace the filter/trigger rule of a characteristic
+  * @param dev_idx Device index
+  * @param handle Value handle
+  * @param spec "<off>:<field>,<cond>:<value>[,<interval_ms>[,<dst_idx>,<dst_handle>,<hex>]]"
+  */
+int AT_RULE_Handler(uint8_t dev_idx, uint16_t handle, const char *spec);
+
+/**
+  * @brief Delete the rule of a characteristic
+  */
+int AT_RULEDEL_Handler(uint8_t dev_idx, uint16_t handle);
+
+/**
+  * @brief List rules with statistics
+  */
+int AT_RULES_Handler(void);
+
+/* ============ Aggregation Commands ============ */
+
+/**
+  * @brief Add or replace windowed aggregation of a characteristic
+  * @param dev_idx Device index
+  * @param handle Value handle
+  * @param samples Window size in samples (0 = time only)
+  * @param window_ms Window length in ms (0 = count only)
+  * @param layout "<off>:<field>[;<off>:<field>...][/<stride>]"
+  */
+int AT_AGG_Handler(uint8_t dev_idx, uint16_t handle, uint16_t samples, uint16_t window_ms,
+                   const char *layout);
+
+/**
+  * @brief Delete aggregation of a characteristic
+  */
+int AT_AGGDEL_Handler(uint8_t dev_idx, uint16_t handle);
+
+/**
+  * @brief List aggregation streams
+  */
+int AT_AGGS_Handler(void);
+
+/* ============ Anomaly Commands ============ */
+
+/**
+  * @brief Add or replace anomaly scoring of a characteristic
+  * @param dev_idx Device index
+  * @param handle Value handle
+  * @param spec "<off>:<field>[/<stride>],<in_shift>,<threshold>"
+  */
+int AT_ANOM_Handler(uint8_t dev_idx, uint16_t handle, const char *spec);
+
+/**
+  * @brief Delete anomaly scoring of a characteristic
+  */
+int AT_ANOMDEL_Handler(uint8_t dev_idx, uint16_t handle);
+
+/**
+  * @brief List anomaly streams with scores and cycle cost
+  */
+int AT_ANOMS_Handler(void);
+
 #endif /* AT_COMMAND_H */
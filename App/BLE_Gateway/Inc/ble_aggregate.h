@@ -0,0 +1,68 @@
+/**
+  ******************************************************************************
+  * @file    ble_aggregate.h
+  * @brief   Windowed statistics over numeric characteristic streams (CMSIS-DSP)
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#ifndef BLE_AGGREGATE_H
+#define BLE_AGGREGATE_H
+
+#include <stdint.h>
+
+#define BLE_AGG_MAX_STREAMS     4
+#define BLE_AGG_MAX_CHANNELS    3       /* Fields per sample (e.g. X/Y/Z) */
+#define BLE_AGG_MAX_SAMPLES     128     /* Window buffer per channel */
+
+/**
+  * @brief Aggregation stream definition
+  */
+typedef struct {
+    uint8_t dev_idx;
+    uint8_t channels;                           /* Number of fields per sample */
+    uint8_t stride;                             /* Bytes per sample, 0 = one sample per value */
+    uint8_t field[BLE_AGG_MAX_CHANNELS];        /* BLE_RuleField_t */
+    uint8_t offset[BLE_AGG_MAX_CHANNELS];       /* Byte offset within sample */
+    uint16_t handle;
+    uint16_t window_samples;                    /* Close after N samples (0 = off) */
+    uint16_t window_ms;                         /* Close after T ms (0 = off) */
+} BLE_AggDef_t;
+
+/**
+  * @brief Initialize aggregation streams
+  */
+void BLE_Agg_Init(void);
+
+/**
+  * @brief Add or replace the aggregation of a (device, handle) pair
+  * @return 0 if success, -1 if invalid or table full
+  */
+int BLE_Agg_Set(const BLE_AggDef_t *def);
+
+/**
+  * @brief Delete an aggregation stream
+  * @return 0 if success, -1 if not found
+  */
+int BLE_Agg_Delete(uint8_t dev_idx, uint16_t handle);
+
+/**
+  * @brief Parse field layout "<off>:<field>[;<off>:<field>...][/<stride>]"
+  * @return 0 if success, -1 if invalid
+  */
+int BLE_Agg_ParseLayout(const char *layout, BLE_AggDef_t *def);
+
+/**
+  * @brief Feed a value to its aggregation stream
+  * @return 1 if consumed by an aggregation stream, 0 otherwise
+  * @note  Emits one +AGG record per channel when the window closes
+  */
+uint8_t BLE_Agg_Process(uint16_t conn_handle, uint16_t handle,
+                        const uint8_t *data, uint16_t len);
+
+/**
+  * @brief Report aggregation streams via AT response
+  */
+void BLE_Agg_Report(void);
+
+#endif /* BLE_AGGREGATE_H */
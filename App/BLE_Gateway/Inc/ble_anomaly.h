@@ -0,0 +1,60 @@
+/**
+  ******************************************************************************
+  * @file    ble_anomaly.h
+  * @brief   Optional int8 anomaly scoring stage on notification streams
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#ifndef BLE_ANOMALY_H
+#define BLE_ANOMALY_H
+
+#include <stdint.h>
+
+#define BLE_ANOM_MAX_STREAMS    2
+#define BLE_ANOM_WINDOW         32      /* Samples per inference (model in_dim) */
+
+/**
+  * @brief Anomaly stream definition
+  */
+typedef struct {
+    uint8_t dev_idx;
+    uint8_t field;                  /* BLE_RuleField_t */
+    uint8_t offset;
+    uint8_t stride;                 /* Bytes per sample, 0 = one sample per value */
+    uint8_t in_shift;               /* Raw value >> in_shift -> q7 input */
+    uint8_t threshold;              /* Score (0-255) above which windows are forwarded */
+    uint16_t handle;
+} BLE_AnomalyDef_t;
+
+/**
+  * @brief Initialize anomaly stage and cycle counter
+  */
+void BLE_Anomaly_Init(void);
+
+/**
+  * @brief Add or replace the anomaly stream of a (device, handle) pair
+  * @return 0 if success, -1 if invalid or table full
+  */
+int BLE_Anomaly_Set(const BLE_AnomalyDef_t *def);
+
+/**
+  * @brief Delete an anomaly stream
+  * @return 0 if success, -1 if not found
+  */
+int BLE_Anomaly_Delete(uint8_t dev_idx, uint16_t handle);
+
+/**
+  * @brief Feed a value to its anomaly stream, scoring each full window
+  * @return 1 if consumed by an anomaly stream, 0 otherwise
+  * @note  Emits +ANOM and +ANOMWIN when the score exceeds the threshold
+  */
+uint8_t BLE_Anomaly_Process(uint16_t conn_handle, uint16_t handle,
+                            const uint8_t *data, uint16_t len);
+
+/**
+  * @brief Report streams, scores and inference cycle cost via AT response
+  */
+void BLE_Anomaly_Report(void);
+
+#endif /* BLE_ANOMALY_H */
@@ -0,0 +1,42 @@
+/**
+  ******************************************************************************
+  * @file    ble_anomaly_model.h
+  * @brief   int8 anomaly model descriptor (CMSIS-NN fully-connected autoencoder)
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#ifndef BLE_ANOMALY_MODEL_H
+#define BLE_ANOMALY_MODEL_H
+
+#include <stdint.h>
+#include "arm_nnfunctions.h"
+
+#define BLE_ANOM_DEFAULT_INPUT      32
+#define BLE_ANOM_DEFAULT_HIDDEN     8
+
+/**
+  * @brief Two-layer autoencoder: in_dim -> hidden_dim -> in_dim
+  * @note  Weights are row-major q7 (arm_fully_connected_q7 layout), kept in flash
+  */
+typedef struct {
+    const char *name;
+    uint16_t in_dim;                /* Window length in samples */
+    uint16_t hidden_dim;
+    const q7_t *w1;                 /* hidden_dim x in_dim */
+    const q7_t *b1;                 /* hidden_dim */
+    const q7_t *w2;                 /* in_dim x hidden_dim */
+    const q7_t *b2;                 /* in_dim */
+    uint8_t w1_out_shift;
+    uint8_t w1_bias_shift;
+    uint8_t w2_out_shift;
+    uint8_t w2_bias_shift;
+    uint8_t relu;                   /* 1: ReLU after encoder */
+} BLE_AnomalyModel_t;
+
+/**
+  * @brief Default compiled-in model
+  */
+extern const BLE_AnomalyModel_t ble_anomaly_default_model;
+
+#endif /* BLE_ANOMALY_MODEL_H */
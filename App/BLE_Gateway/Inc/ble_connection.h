@@ -14,6 +14,8 @@
 
 #define BLE_MAC_LEN         6
 #define MAX_BLE_CONNECTIONS 8
+#define BLE_SCAN_QUEUE_LEN  16      /* Reports waiting for the background task */
+#define BLE_SCAN_NAME_MAX   31
 
 typedef enum {
     CONN_STATE_IDLE,
@@ -39,6 +41,13 @@ int BLE_Connection_StartScan(uint16_t duration_ms);
   */
 int BLE_Connection_StopScan(void);
 
+/**
+  * @brief Restart an active scan at reduced (throttled = 1) or full duty cycle
+  * @note  Non-blocking: the commands go through the HCI command queue
+  * @return 0 if queued, -1 if no scan is active or a restart is pending
+  */
+int BLE_Connection_ThrottleScan(uint8_t throttled);
+
 /**
   * @brief Create connection to device
   * @param mac MAC address (6 bytes)
@@ -70,6 +79,9 @@ uint8_t BLE_Connection_IsConnected(uint16_t conn_handle);
 
 /**
   * @brief Callback when scan discovers device
+  * @note  Only queues the report (repeats from a queued device are merged);
+  *        it is processed by a background priority task. Reports are dropped
+  *        when the queue is full.
   * @param mac MAC address
   * @param rssi RSSI value
   * @param name Device name (if available)
@@ -77,6 +89,16 @@ uint8_t BLE_Connection_IsConnected(uint16_t conn_handle);
   */
 void BLE_Connection_OnScanReport(const uint8_t *mac, int8_t rssi, const char *name, uint8_t addr_type);
 
+/**
+  * @brief Report the scan report queue (depth, dropped reports) via AT response
+  */
+void BLE_Connection_ReportScanQueue(void);
+
+/**
+  * @brief Clear the dropped scan report counter
+  */
+void BLE_Connection_ResetScanQueue(void);
+
 /**
   * @brief Callback when connection established
   * @param mac MAC address
@@ -15,6 +15,7 @@
 #define MAX_BLE_DEVICES     32  /* Maximum devices in scan list */
 #define BLE_MAC_LEN         6
 #define BLE_DEVICE_NAME_MAX_LEN 32
+#define BLE_ATT_DEFAULT_MTU     23  /* ATT_MTU before any exchange */
 
 typedef struct {
     uint8_t   mac_addr[BLE_MAC_LEN];    // MAC address
@@ -25,6 +26,8 @@ typedef struct {
     uint8_t addr_type;                  // Address type
     char name[BLE_DEVICE_NAME_MAX_LEN];
     uint8_t reported_in_scan;
+    uint16_t att_mtu;                   // Negotiated ATT MTU
+    uint16_t conn_interval;             // Connection interval (1.25 ms units, 0 = unknown)
 } BLE_Device_t;
 
 typedef struct {
@@ -103,6 +106,16 @@ void BLE_DeviceManager_UpdateAddrType(int dev_idx, uint8_t addr_type);
   */
 void BLE_DeviceManager_UpdateName(int dev_idx, const char *name);
 
+/**
+  * @brief Update negotiated ATT MTU of a connected device
+  */
+void BLE_DeviceManager_UpdateMTU(int dev_idx, uint16_t mtu);
+
+/**
+  * @brief Update connection interval of a connected device (1.25 ms units)
+  */
+void BLE_DeviceManager_UpdateConnInterval(int dev_idx, uint16_t interval);
+
 /**
 * @brief Reset reported_in_scan flags for all devices
 */
@@ -115,4 +115,73 @@ void BLE_EventHandler_OnServiceDiscovered(uint16_t conn_handle, const uint8_t *d
 void BLE_EventHandler_OnCharacteristicDiscovered(uint16_t conn_handle, const uint8_t *data,
                                                    uint16_t data_len, uint8_t pair_len);
 
+/**
+  * @brief Dispatch ATT MTU exchange response
+  */
+void BLE_EventHandler_OnMtuExchanged(uint16_t conn_handle, uint16_t server_mtu);
+
+/**
+  * @brief Dispatch connection parameters (connection complete or update complete)
+  * @param interval Connection interval in 1.25 ms units
+  */
+void BLE_EventHandler_OnConnParams(uint16_t conn_handle, uint16_t interval);
+
+/**
+  * @brief Dispatch GATT TX pool available (write without response credits)
+  */
+void BLE_EventHandler_OnTxPoolAvailable(uint16_t conn_handle, uint16_t available);
+
+/**
+  * @brief Dispatch L2CAP CoC connection request from the peer
+  */
+void BLE_EventHandler_OnCocConnectRequest(uint16_t conn_handle, uint16_t spsm);
+
+/**
+  * @brief Dispatch L2CAP CoC connection response
+  */
+void BLE_EventHandler_OnCocConnectConfirm(uint16_t conn_handle, uint16_t mtu, uint16_t mps,
+                                          uint16_t credits, uint16_t result,
+                                          uint8_t num_channels, const uint8_t *index_list);
+
+/**
+  * @brief Dispatch L2CAP CoC channel closed
+  */
+void BLE_EventHandler_OnCocDisconnect(uint8_t channel_index);
+
+/**
+  * @brief Dispatch L2CAP CoC credits granted by the peer
+  */
+void BLE_EventHandler_OnCocFlowControl(uint8_t channel_index, uint16_t credits);
+
+/**
+  * @brief Dispatch L2CAP CoC K-frame received
+  */
+void BLE_EventHandler_OnCocRxData(uint8_t channel_index, const uint8_t *data, uint16_t len);
+
+/**
+  * @brief Dispatch L2CAP CoC TX buffers available
+  */
+void BLE_EventHandler_OnCocTxPoolAvailable(void);
+
+/**
+  * @brief Dispatch primary service found by UUID (Find By Type Value response)
+  * @param data Handle pairs: [found_handle(2), group_end(2)] * num_pairs
+  */
+void BLE_EventHandler_OnServiceFoundByUUID(uint16_t conn_handle, const uint8_t *data,
+                                            uint8_t num_pairs);
+
+/**
+  * @brief Dispatch characteristic found by UUID
+  * @param value Declaration value: [properties(1), value_handle(2), UUID(2 or 16)]
+  */
+void BLE_EventHandler_OnCharFoundByUUID(uint16_t conn_handle, uint16_t decl_handle,
+                                         const uint8_t *value, uint8_t value_len);
+
+/**
+  * @brief Dispatch descriptor discovery (Find Information response)
+  * @param format 1 = 16-bit UUIDs, 2 = 128-bit UUIDs
+  */
+void BLE_EventHandler_OnDescriptorDiscovered(uint16_t conn_handle, uint8_t format,
+                                              const uint8_t *data, uint8_t data_len);
+
 #endif /* BLE_EVENT_HANDLER_H */
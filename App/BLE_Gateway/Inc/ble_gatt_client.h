@@ -42,6 +42,14 @@ int BLE_GATT_DiscoverCharacteristics(uint16_t conn_handle, uint16_t start_handle
   */
 int BLE_GATT_ReadCharacteristic(uint16_t conn_handle, uint16_t char_handle);
 
+/**
+  * @brief Get and release handle of the outstanding read on a connection
+  * @param conn_handle Connection handle
+  * @return Characteristic handle, 0 if none
+  * @note ATT Read Response does not carry the handle; it is tracked here
+  */
+uint16_t BLE_GATT_TakePendingReadHandle(uint16_t conn_handle);
+
 /**
   * @brief Write characteristic value
   * @param conn_handle Connection handle
@@ -64,6 +72,14 @@ int BLE_GATT_WriteCharacteristic(uint16_t conn_handle, uint16_t char_handle,
 int BLE_GATT_WriteCharacteristicNoResp(uint16_t conn_handle, uint16_t char_handle,
                                        const uint8_t *data, uint16_t len);
 
+/**
+  * @brief Write without response, reporting TX pool exhaustion
+  * @param len Data length (at most ATT_MTU - 3)
+  * @return 0 if queued, 1 if TX pool full (retry on ACI_GATT_TX_POOL_AVAILABLE), -1 if error
+  */
+int BLE_GATT_TryWriteNoResp(uint16_t conn_handle, uint16_t char_handle,
+                            const uint8_t *data, uint16_t len);
+
 /**
   * @brief Enable notification on characteristic
   * @param conn_handle Connection handle
@@ -0,0 +1,103 @@
+/**
+  ******************************************************************************
+  * @file    ble_gatt_flow.h
+  * @brief   GATT Procedure Flow engine - cooperative per-link GATT sequences
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#ifndef BLE_GATT_FLOW_H
+#define BLE_GATT_FLOW_H
+
+#include <stdint.h>
+
+#define BLE_FLOW_MAX_ACTIVE     8       /* One flow per link (MAX_BLE_CONNECTIONS) */
+#define BLE_FLOW_STEP_TIMEOUT_MS 5000U  /* Per-step timeout */
+
+/* Flow error codes (reported in +FLOW_ERROR, ATT/HCI codes pass through) */
+#define FLOW_ERR_TIMEOUT        0xF0
+#define FLOW_ERR_NOT_FOUND      0xF1
+#define FLOW_ERR_DISCONNECTED   0xF2
+#define FLOW_ERR_CMD_FAILED     0xF3
+
+/**
+  * @brief Flow step opcodes
+  */
+typedef enum {
+    FLOW_OP_END = 0,        /* Terminates a step list */
+    FLOW_OP_CONNECT,        /* Connect if not connected (serialized across links) */
+    FLOW_OP_MTU,            /* ATT MTU exchange */
+    FLOW_OP_DLE,            /* LE Data Length Extension */
+    FLOW_OP_FIND_SERVICE,   /* Discover primary service by 16-bit UUID */
+    FLOW_OP_FIND_CHAR,      /* Discover characteristic by 16-bit UUID in service */
+    FLOW_OP_SUBSCRIBE,      /* Find CCCD of current char and enable (arg: 1=notify, 2=indicate) */
+    FLOW_OP_READ,           /* Read current char value */
+} BLE_FlowOp_t;
+
+/**
+  * @brief One step of a declarative flow
+  */
+typedef struct {
+    uint8_t  op;            /* BLE_FlowOp_t */
+    uint8_t  arg;           /* Op-specific argument */
+    uint16_t uuid;          /* 16-bit UUID for FIND_SERVICE / FIND_CHAR */
+} BLE_FlowStep_t;
+
+/**
+  * @brief Device class: named step list
+  */
+typedef struct {
+    const char *name;
+    const BLE_FlowStep_t *steps;
+} BLE_FlowClass_t;
+
+/**
+  * @brief Initialize flow engine and register sequencer task
+  */
+void BLE_Flow_Init(void);
+
+/**
+  * @brief Start a flow on a device
+  * @param dev_idx Device index
+  * @param class_name Device class name (e.g. "HRS")
+  * @return 0 if started, -1 if error
+  */
+int BLE_Flow_Start(uint8_t dev_idx, const char *class_name);
+
+/**
+  * @brief Abort a running flow
+  * @return 0 if stopped, -1 if no flow on device
+  */
+int BLE_Flow_Stop(uint8_t dev_idx);
+
+/**
+  * @brief Check if a flow is running on device
+  */
+uint8_t BLE_Flow_IsActive(uint8_t dev_idx);
+
+/**
+  * @brief Get device class by index (for listing)
+  * @return Class pointer, NULL past the end
+  */
+const BLE_FlowClass_t* BLE_Flow_GetClass(uint8_t class_idx);
+
+/**
+  * @brief Report running flows via AT response (+FLOW:<idx>,<class>,<step>)
+  */
+void BLE_Flow_ReportStatus(void);
+
+/* ============ Event Hooks (called from BLE event context) ============ */
+
+void BLE_Flow_OnConnected(int dev_idx, uint16_t conn_handle, uint8_t status);
+void BLE_Flow_OnDisconnected(uint16_t conn_handle);
+void BLE_Flow_OnServiceFound(uint16_t conn_handle, uint16_t start_handle, uint16_t end_handle);
+void BLE_Flow_OnCharFound(uint16_t conn_handle, uint8_t properties, uint16_t value_handle);
+void BLE_Flow_OnDescriptorFound(uint16_t conn_handle, uint16_t handle, uint16_t uuid);
+
+/**
+  * @brief Offer GATT procedure complete to the flow engine
+  * @return 1 if consumed by a running flow, 0 otherwise
+  */
+uint8_t BLE_Flow_OnProcComplete(uint16_t conn_handle, uint8_t error_code);
+
+#endif /* BLE_GATT_FLOW_H */
@@ -0,0 +1,90 @@
+/**
+  ******************************************************************************
+  * @file    ble_gatt_queue.h
+  * @brief   Per-link GATT operation queues - one ATT procedure in flight per link
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#ifndef BLE_GATT_QUEUE_H
+#define BLE_GATT_QUEUE_H
+
+#include <stdint.h>
+
+#define BLE_GATTQ_DEPTH         4       /* Pending ops per link */
+
+/* Queue error codes (ATT/HCI codes pass through) */
+#define GATTQ_ERR_NOT_FOUND     0xF1
+#define GATTQ_ERR_DISCONNECTED  0xF2
+#define GATTQ_ERR_CMD_FAILED    0xF3
+
+/**
+  * @brief Queued operation types
+  */
+typedef enum {
+    GATTQ_OP_READ = 0,
+    GATTQ_OP_WRITE,             /* Write with response */
+    GATTQ_OP_SUBSCRIBE,         /* Write CCCD (arg: 0=off, 1=notify, 2=indicate) */
+} BLE_GattQueueOpType_t;
+
+/**
+  * @brief Completion callback
+  * @param conn_handle Connection handle
+  * @param handle Resolved value handle (CCCD for SUBSCRIBE), 0 if unresolved
+  * @param status 0 = success, ATT/HCI or GATTQ_ERR_* otherwise
+  * @param tag Caller tag
+  */
+typedef void (*BLE_GattQueueCb_t)(uint16_t conn_handle, uint16_t handle, uint8_t status, uint8_t tag);
+
+/**
+  * @brief Queued operation
+  * @note  data must stay valid until the completion callback
+  */
+typedef struct {
+    uint8_t type;               /* BLE_GattQueueOpType_t */
+    uint8_t arg;                /* Op-specific argument */
+    uint8_t by_uuid;            /* 1: target is a 16-bit char UUID to resolve */
+    uint8_t tag;
+    uint16_t target;            /* Handle or UUID */
+    uint16_t len;
+    const uint8_t *data;
+    BLE_GattQueueCb_t cb;
+} BLE_GattQueueOp_t;
+
+/**
+  * @brief Initialize queues and register sequencer task
+  */
+void BLE_GattQueue_Init(void);
+
+/**
+  * @brief Queue an operation on a link
+  * @return 0 if queued, -1 if queue full or no free link slot
+  */
+int BLE_GattQueue_Push(uint16_t conn_handle, const BLE_GattQueueOp_t *op);
+
+/**
+  * @brief Number of ops queued or in flight on a link
+  */
+uint8_t BLE_GattQueue_Pending(uint16_t conn_handle);
+
+/**
+  * @brief Op whose read/write/CCCD write is in flight on a link
+  * @param handle Resolved value handle (may be NULL)
+  * @return The op, NULL if none (also during UUID/CCCD discovery)
+  * @note  Lets a read response be matched to the op that issued it
+  */
+const BLE_GattQueueOp_t* BLE_GattQueue_InFlight(uint16_t conn_handle, uint16_t *handle);
+
+/* ============ Event Hooks (called from BLE event context) ============ */
+
+void BLE_GattQueue_OnCharFound(uint16_t conn_handle, uint16_t value_handle);
+void BLE_GattQueue_OnDescriptorFound(uint16_t conn_handle, uint16_t handle, uint16_t uuid);
+void BLE_GattQueue_OnDisconnected(uint16_t conn_handle);
+
+/**
+  * @brief Offer GATT procedure complete to the queues
+  * @return 1 if consumed by an in-flight op, 0 otherwise
+  */
+uint8_t BLE_GattQueue_OnProcComplete(uint16_t conn_handle, uint8_t error_code);
+
+#endif /* BLE_GATT_QUEUE_H */
@@ -0,0 +1,81 @@
+/**
+  ******************************************************************************
+  * @file    ble_group.h
+  * @brief   Device groups and group GATT operations across links
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#ifndef BLE_GROUP_H
+#define BLE_GROUP_H
+
+#include <stdint.h>
+#include "ble_gatt_queue.h"
+
+#define BLE_GROUP_MAX               8
+#define BLE_GROUP_NAME_PREFIX_LEN   12
+#define BLE_GROUP_MAX_DATA          64
+
+/**
+  * @brief Group membership rule
+  */
+typedef enum {
+    GROUP_TYPE_NONE = 0,
+    GROUP_TYPE_LIST,            /* Explicit device index list */
+    GROUP_TYPE_ALL,             /* All connected devices */
+    GROUP_TYPE_NAME,            /* Name prefix filter */
+    GROUP_TYPE_RSSI,            /* Minimum RSSI filter */
+} BLE_GroupType_t;
+
+typedef struct {
+    uint8_t type;                               /* BLE_GroupType_t */
+    int8_t rssi_min;
+    uint32_t members;                           /* Bit per device index (LIST) */
+    char name_prefix[BLE_GROUP_NAME_PREFIX_LEN];
+} BLE_Group_t;
+
+/**
+  * @brief Initialize groups
+  */
+void BLE_Group_Init(void);
+
+/**
+  * @brief Define a group
+  * @param gid Group ID (0..BLE_GROUP_MAX-1)
+  * @param spec "ALL", "1;2;5", "NAME:<prefix>", "RSSI:<min_dbm>" or "NONE"
+  * @return 0 if success, -1 if invalid
+  */
+int BLE_Group_Define(uint8_t gid, const char *spec);
+
+/**
+  * @brief Resolve group to connected member devices
+  * @return Bit mask of device indices
+  */
+uint32_t BLE_Group_Resolve(uint8_t gid);
+
+/**
+  * @brief Check if a group operation is running
+  */
+uint8_t BLE_Group_IsBusy(void);
+
+/**
+  * @brief Run one GATT operation on every connected member in parallel
+  * @param gid Group ID
+  * @param type Operation type
+  * @param by_uuid 1 if target is a 16-bit characteristic UUID
+  * @param target Handle or UUID
+  * @param arg Op argument (SUBSCRIBE: 0=off, 1=notify, 2=indicate)
+  * @param data Write data (copied)
+  * @param len Write data length
+  * @return Number of links the op was queued on, -1 if error
+  * @note  Per-link failures are reported as +GFAIL, completion as +GDONE
+  */
+int BLE_Group_Run(uint8_t gid, BLE_GattQueueOpType_t type, uint8_t by_uuid,
+                  uint16_t target, uint8_t arg, const uint8_t *data, uint16_t len);
+
+/**
+  * @brief Report group definitions via AT response
+  */
+void BLE_Group_Report(void);
+
+#endif /* BLE_GROUP_H */
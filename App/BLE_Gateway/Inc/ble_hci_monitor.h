@@ -0,0 +1,53 @@
+/**
+  ******************************************************************************
+  * @file    ble_hci_monitor.h
+  * @brief   HCI event queue and event pool telemetry, scan throttling
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#ifndef BLE_HCI_MONITOR_H
+#define BLE_HCI_MONITOR_H
+
+#include <stdint.h>
+
+/*
+ * hci_tl.c reports every asynchronous event as it is queued (IPCC RX
+ * interrupt), taken for processing and returned to the memory manager.
+ * From that the monitor keeps the queue depth, the bytes of the event pool
+ * (EvtPool, app_entry.c) held by the M4 and the time events wait queued.
+ * Only BLE events are seen: system (SHCI) events take buffers from the same
+ * pool but go through their own queue and are not counted.
+ *
+ * When the M4 falls behind and the held bytes reach BLE_HCIMON_THROTTLE_PCT
+ * of the pool, an active scan is restarted at a lower duty cycle so CPU2
+ * produces fewer advertising reports. Full duty comes back once usage stayed
+ * below BLE_HCIMON_RESUME_PCT for BLE_HCIMON_RESUME_MS.
+ */
+#define BLE_HCIMON_TS_DEPTH         64      /* Queued events timed */
+#define BLE_HCIMON_THROTTLE_PCT     50
+#define BLE_HCIMON_RESUME_PCT       20
+#define BLE_HCIMON_RESUME_MS        2000
+
+/**
+  * @brief Clear counters
+  */
+void BLE_HciMon_Init(void);
+
+/**
+  * @brief Scan (re)started or stopped: throttling starts over
+  */
+void BLE_HciMon_OnScan(uint8_t active);
+
+/**
+  * @brief Report queue, pool and CPU2 memory block usage via AT response
+  * @note  Reads CPU2 stats with a blocking ACI call
+  */
+void BLE_HciMon_Report(void);
+
+/**
+  * @brief Clear counters and maxima
+  */
+void BLE_HciMon_Reset(void);
+
+#endif /* BLE_HCI_MONITOR_H */
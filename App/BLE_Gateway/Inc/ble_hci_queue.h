@@ -0,0 +1,69 @@
+/**
+  ******************************************************************************
+  * @file    ble_hci_queue.h
+  * @brief   Asynchronous ACI/HCI command queue - commands complete by callback
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#ifndef BLE_HCI_QUEUE_H
+#define BLE_HCI_QUEUE_H
+
+#include <stdint.h>
+
+/*
+ * The ACI wrappers (aci_xxx()) send through hci_send_req(), which waits for
+ * the CPU2 response in UTIL_SEQ_WaitEvt() with every HCI task paused. A
+ * command queued here is sent with hci_send_cmd_async() instead: the caller
+ * returns at once and the response is reported to its callback. Commands are
+ * sent one at a time, in order, back to back as the responses come in. A
+ * blocking ACI call still works: it waits for the queued command in flight.
+ */
+#define BLE_HCIQ_DEPTH          8       /* Commands waiting, in flight excluded */
+#define BLE_HCIQ_PARAM_MAX      32      /* Longest parameter block */
+
+#define BLE_HCIQ_OPCODE(ogf, ocf)   ((uint16_t)(((ogf) << 10) | ((ocf) & 0x3FFU)))
+
+/* Status when the response carried no return parameters */
+#define HCIQ_ERR_NO_STATUS      0xFF
+
+/**
+  * @brief Completion callback
+  * @param opcode Command opcode
+  * @param status First return parameter (HCI status), HCIQ_ERR_NO_STATUS if none
+  * @param rparam Return parameters, valid during the call only
+  * @param rlen Return parameter length
+  * @param tag Caller tag
+  */
+typedef void (*BLE_HciQueueCb_t)(uint16_t opcode, uint8_t status,
+                                 const uint8_t *rparam, uint8_t rlen, uint32_t tag);
+
+/**
+  * @brief Initialize the queue and register its sequencer task
+  */
+void BLE_HciQueue_Init(void);
+
+/**
+  * @brief Queue a command (parameters are copied)
+  * @param cb Completion callback, may be 0
+  * @return 0 if queued, -1 if the queue is full or the parameters too long
+  */
+int BLE_HciQueue_Send(uint16_t opcode, const void *param, uint8_t plen,
+                      BLE_HciQueueCb_t cb, uint32_t tag);
+
+/**
+  * @brief Number of commands queued or in flight
+  */
+uint8_t BLE_HciQueue_Pending(void);
+
+/**
+  * @brief Report depth, counters and latencies via AT response
+  */
+void BLE_HciQueue_Report(void);
+
+/**
+  * @brief Clear counters and maxima
+  */
+void BLE_HciQueue_Reset(void);
+
+#endif /* BLE_HCI_QUEUE_H */
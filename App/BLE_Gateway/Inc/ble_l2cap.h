@@ -0,0 +1,120 @@
+/**
+  ******************************************************************************
+  * @file    ble_l2cap.h
+  * @brief   LE credit-based L2CAP connection-oriented channels (CoC)
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#ifndef BLE_L2CAP_H
+#define BLE_L2CAP_H
+
+#include <stdint.h>
+
+#define BLE_L2CAP_MAX_CHANNELS  4
+#define BLE_L2CAP_SDU_MAX       512     /* Our MTU, and largest SDU we send */
+#define BLE_L2CAP_MPS           247     /* One LL PDU at 251-byte data length */
+#define BLE_L2CAP_RX_CREDITS    8       /* RX_CREDITS * MPS fits the UART TX ring */
+#define BLE_L2CAP_FRAME_MAX     248     /* aci_l2cap_coc_tx_data MPS limit */
+
+/**
+  * @brief Initialize channel table
+  */
+void BLE_L2cap_Init(void);
+
+/**
+  * @brief Open an LE credit-based channel to a connected device
+  * @param dev_idx Device index
+  * @param spsm Peer's Simplified Protocol/Service Multiplexer (1-0xFF)
+  * @param mtu Largest SDU we accept (0 = BLE_L2CAP_SDU_MAX)
+  * @return Channel number if request sent, -1 if error
+  * @note Result is reported asynchronously as +COC:<ch>,OPEN or +COC:<ch>,FAIL
+  */
+int BLE_L2cap_Connect(uint8_t dev_idx, uint16_t spsm, uint16_t mtu);
+
+/**
+  * @brief Close a channel
+  * @return 0 if request sent, -1 if error
+  */
+int BLE_L2cap_Disconnect(uint8_t ch);
+
+/**
+  * @brief Check if a channel is open
+  */
+uint8_t BLE_L2cap_IsOpen(uint8_t ch);
+
+/**
+  * @brief Get the connection handle of a channel
+  * @return Connection handle, 0xFFFF if not open
+  */
+uint16_t BLE_L2cap_GetConnHandle(uint8_t ch);
+
+/**
+  * @brief Largest SDU that may be sent on a channel (min of peer MTU and SDU_MAX)
+  */
+uint16_t BLE_L2cap_GetSduMax(uint8_t ch);
+
+/**
+  * @brief Queue one SDU; it is segmented into K-frames as TX credits allow
+  * @return 0 if queued, 1 if the previous SDU is still being sent, -1 if error
+  * @note  Module_Mode_OnTxPoolAvailable and BLE_Tput_OnTxPoolAvailable are called
+  *        when the channel can take the next SDU
+  */
+int BLE_L2cap_Send(uint8_t ch, const uint8_t *data, uint16_t len);
+
+/**
+  * @brief Route a channel's RX SDUs to the UART as raw bytes (data mode)
+  * @param ch Channel number, 0xFF = unbind (RX goes back to +COCDATA lines)
+  * @note  While bound, RX credits are only returned as UART TX ring space frees up
+  */
+void BLE_L2cap_BindUart(uint8_t ch);
+
+/**
+  * @brief Return RX credits withheld for a bound channel
+  * @return 1 if credits are still withheld (call again later), 0 otherwise
+  */
+uint8_t BLE_L2cap_Service(void);
+
+/**
+  * @brief Report channels and throughput statistics via AT response
+  */
+void BLE_L2cap_Report(void);
+
+/**
+  * @brief Peer requested a channel (ACI_L2CAP_COC_CONNECT)
+  */
+void BLE_L2cap_OnConnectRequest(uint16_t conn_handle, uint16_t spsm);
+
+/**
+  * @brief Channel connect response (ACI_L2CAP_COC_CONNECT_CONFIRM)
+  */
+void BLE_L2cap_OnConnectConfirm(uint16_t conn_handle, uint16_t mtu, uint16_t mps,
+                                uint16_t credits, uint16_t result, uint8_t index);
+
+/**
+  * @brief Channel closed (ACI_L2CAP_COC_DISCONNECT)
+  */
+void BLE_L2cap_OnDisconnect(uint8_t index);
+
+/**
+  * @brief Peer granted TX credits (ACI_L2CAP_COC_FLOW_CONTROL)
+  */
+void BLE_L2cap_OnFlowControl(uint8_t index, uint16_t credits);
+
+/**
+  * @brief K-frame received (ACI_L2CAP_COC_RX_DATA)
+  * @note  The first K-frame of an SDU starts with the 2-byte SDU length
+  */
+void BLE_L2cap_OnRxData(uint8_t index, const uint8_t *data, uint16_t len);
+
+/**
+  * @brief CoC TX buffers available again (ACI_L2CAP_COC_TX_POOL_AVAILABLE)
+  */
+void BLE_L2cap_OnTxPoolAvailable(void);
+
+/**
+  * @brief Link dropped: release its channels
+  */
+void BLE_L2cap_OnLinkDown(uint16_t conn_handle);
+
+#endif /* BLE_L2CAP_H */
@@ -0,0 +1,51 @@
+/**
+  ******************************************************************************
+  * @file    ble_poll.h
+  * @brief   Periodic read scheduler for sensors without notifications
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#ifndef BLE_POLL_H
+#define BLE_POLL_H
+
+#include <stdint.h>
+
+#define BLE_POLL_MAX_ENTRIES    16
+#define BLE_POLL_TICK_MS        50U     /* Scheduler resolution */
+#define BLE_POLL_MIN_PERIOD_MS  100U
+#define BLE_POLL_MAX_PER_TICK   2U      /* Reads issued per tick (burst limit) */
+
+/**
+  * @brief Initialize poll scheduler, timer and sequencer task
+  */
+void BLE_Poll_Init(void);
+
+/**
+  * @brief Add or update a poll entry
+  * @param dev_idx Device index
+  * @param by_uuid 1 if target is a 16-bit char UUID
+  * @param target Handle or UUID
+  * @param period_ms Poll period (0 removes the entry)
+  * @return Entry ID, -1 if error
+  */
+int BLE_Poll_Set(uint8_t dev_idx, uint8_t by_uuid, uint16_t target, uint32_t period_ms);
+
+/**
+  * @brief Remove all poll entries
+  */
+void BLE_Poll_Clear(void);
+
+/**
+  * @brief Report poll entries and statistics via AT response
+  */
+void BLE_Poll_Report(void);
+
+/**
+  * @brief Offer a read response to the poll scheduler
+  * @return 1 if it answered a poll read (consumed), 0 otherwise
+  */
+uint8_t BLE_Poll_OnReadResponse(uint16_t conn_handle, uint16_t handle,
+                                const uint8_t *data, uint16_t len);
+
+#endif /* BLE_POLL_H */
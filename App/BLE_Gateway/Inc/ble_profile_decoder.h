@@ -0,0 +1,85 @@
+/**
+  ******************************************************************************
+  * @file    ble_profile_decoder.h
+  * @brief   Client-side decoders for standard SIG GATT characteristics
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#ifndef BLE_PROFILE_DECODER_H
+#define BLE_PROFILE_DECODER_H
+
+#include <stdint.h>
+
+#define BLE_DECODER_MAX_BINDINGS    16
+
+/**
+  * @brief Decoder types
+  */
+typedef enum {
+    DECODER_NONE = 0,
+    DECODER_HRM,            /* Heart Rate Measurement (0x2A37) */
+    DECODER_BATTERY,        /* Battery Level (0x2A19) */
+    DECODER_TEMP,           /* Temperature Measurement (0x2A1C), IEEE-11073 FLOAT */
+    DECODER_CSC,            /* CSC Measurement (0x2A5B) */
+    DECODER_RSC,            /* RSC Measurement (0x2A53) */
+    DECODER_COUNT
+} BLE_DecoderType_t;
+
+/**
+  * @brief Initialize decoder bindings
+  */
+void BLE_Decoder_Init(void);
+
+/**
+  * @brief Bind a decoder to a characteristic value handle
+  * @param conn_handle Connection handle
+  * @param value_handle Characteristic value handle
+  * @param type Decoder type (DECODER_NONE removes the binding)
+  * @return 0 if success, -1 if table full
+  */
+int BLE_Decoder_Bind(uint16_t conn_handle, uint16_t value_handle, BLE_DecoderType_t type);
+
+/**
+  * @brief Remove all bindings of a connection
+  */
+void BLE_Decoder_UnbindConn(uint16_t conn_handle);
+
+/**
+  * @brief Decode value and emit typed record if a decoder is bound
+  * @return 0 if record emitted, -1 if no binding or malformed value
+  */
+int BLE_Decoder_Process(uint16_t conn_handle, uint16_t value_handle,
+                        const uint8_t *data, uint16_t len);
+
+/**
+  * @brief Map a 16-bit characteristic UUID to its decoder
+  * @return Decoder type, DECODER_NONE if unknown
+  */
+BLE_DecoderType_t BLE_Decoder_FromUUID(uint16_t uuid);
+
+/**
+  * @brief Parse decoder name (HRM, BATT, TEMP, CSC, RSC, NONE)
+  * @return Decoder type, DECODER_COUNT if invalid
+  */
+BLE_DecoderType_t BLE_Decoder_FromName(const char *name);
+
+/**
+  * @brief Get decoder name
+  */
+const char* BLE_Decoder_GetName(BLE_DecoderType_t type);
+
+/**
+  * @brief Report bindings via AT response (+DECODE:<conn>,<handle>,<name>)
+  */
+void BLE_Decoder_ReportBindings(void);
+
+/**
+  * @brief Decode IEEE-11073 32-bit FLOAT to hundredths
+  * @param raw Little-endian 32-bit FLOAT
+  * @param out_centi Value * 100
+  * @return 0 if success, -1 for NaN/NRes/INF/reserved
+  */
+int BLE_Decoder_Float11073ToCenti(uint32_t raw, int32_t *out_centi);
+
+#endif /* BLE_PROFILE_DECODER_H */
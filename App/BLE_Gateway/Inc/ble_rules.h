@@ -0,0 +1,114 @@
+/**
+  ******************************************************************************
+  * @file    ble_rules.h
+  * @brief   Per-characteristic filter and trigger rules on the notification path
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#ifndef BLE_RULES_H
+#define BLE_RULES_H
+
+#include <stdint.h>
+
+#define BLE_RULES_MAX           16
+#define BLE_RULES_HASH_SIZE     32      /* Power of 2, > BLE_RULES_MAX */
+#define BLE_RULES_MAX_DATA      8       /* Trigger write payload */
+
+/**
+  * @brief Field extracted from the value (little-endian)
+  */
+typedef enum {
+    RULE_FIELD_U8 = 0,
+    RULE_FIELD_S8,
+    RULE_FIELD_U16,
+    RULE_FIELD_S16,
+    RULE_FIELD_U32,
+    RULE_FIELD_S32,
+    RULE_FIELD_HR,              /* Heart rate (0x2A37 flags select u8/u16), offset ignored */
+    RULE_FIELD_FLT,             /* IEEE-11073 FLOAT, in hundredths */
+    RULE_FIELD_COUNT
+} BLE_RuleField_t;
+
+/**
+  * @brief Condition
+  */
+typedef enum {
+    RULE_COND_ANY = 0,          /* Every value (rate limit only) */
+    RULE_COND_GT,               /* Crosses threshold upwards */
+    RULE_COND_LT,               /* Crosses threshold downwards */
+    RULE_COND_CROSS,            /* Crosses threshold either way */
+    RULE_COND_DELTA,            /* Differs from last forwarded by more than threshold */
+    RULE_COND_COUNT
+} BLE_RuleCond_t;
+
+/**
+  * @brief Rule definition
+  */
+typedef struct {
+    uint8_t dev_idx;
+    uint8_t field;              /* BLE_RuleField_t */
+    uint8_t offset;             /* Byte offset of field */
+    uint8_t cond;               /* BLE_RuleCond_t */
+    uint16_t handle;            /* Value handle */
+    uint16_t interval_ms;       /* Minimum interval between matches (0 = none) */
+    int32_t threshold;
+    uint8_t dst_idx;            /* Trigger write target device (0xFF = none) */
+    uint8_t dst_len;
+    uint16_t dst_handle;
+    uint8_t dst_data[BLE_RULES_MAX_DATA];
+} BLE_RuleDef_t;
+
+/**
+  * @brief Initialize rule table
+  */
+void BLE_Rules_Init(void);
+
+/**
+  * @brief Add or replace the rule of a (device, handle) pair
+  * @return 0 if success, -1 if invalid or table full
+  */
+int BLE_Rules_Set(const BLE_RuleDef_t *def);
+
+/**
+  * @brief Delete the rule of a (device, handle) pair
+  * @return 0 if success, -1 if not found
+  */
+int BLE_Rules_Delete(uint8_t dev_idx, uint16_t handle);
+
+/**
+  * @brief Evaluate the rule of a value, running its trigger on match
+  * @return 1 if the value should be forwarded, 0 if filtered out
+  * @note  Values without a rule are always forwarded. Constant time.
+  */
+uint8_t BLE_Rules_Evaluate(uint16_t conn_handle, uint16_t handle,
+                           const uint8_t *data, uint16_t len);
+
+/**
+  * @brief Report rules and statistics via AT response
+  */
+void BLE_Rules_Report(void);
+
+/**
+  * @brief Extract a typed field from a characteristic value
+  * @param field BLE_RuleField_t
+  * @param offset Byte offset (ignored for HR)
+  * @param out Field value (FLT in hundredths)
+  * @return 0 if success, -1 if value too short or invalid
+  */
+int BLE_Rules_ExtractField(uint8_t field, uint8_t offset, const uint8_t *data, uint16_t len,
+                           int32_t *out);
+
+/**
+  * @brief Parse field name (U8, S8, U16, S16, U32, S32, HR, FLT)
+  * @return Field type, RULE_FIELD_COUNT if invalid
+  */
+BLE_RuleField_t BLE_Rules_FieldFromName(const char *name, uint8_t len);
+
+/**
+  * @brief Parse condition name (ANY, GT, LT, CROSS, DELTA)
+  * @return Condition, RULE_COND_COUNT if invalid
+  */
+BLE_RuleCond_t BLE_Rules_CondFromName(const char *name, uint8_t len);
+
+#endif /* BLE_RULES_H */
@@ -0,0 +1,96 @@
+/**
+  ******************************************************************************
+  * @file    ble_tput.h
+  * @brief   Built-in link throughput benchmark (no UART in the data path)
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#ifndef BLE_TPUT_H
+#define BLE_TPUT_H
+
+#include <stdint.h>
+
+#define BLE_TPUT_MAX_SECONDS    3600
+#define BLE_TPUT_HIST_BINS      256     /* 1 ms bins, last bin collects >= 255 ms */
+#define BLE_TPUT_MAX_PACKET     512     /* Largest generated packet (CoC SDU) */
+
+/**
+  * @brief Test direction
+  */
+typedef enum {
+    TPUT_DIR_TX = 1,            /* Gateway generates a pattern stream */
+    TPUT_DIR_RX = 2,            /* Gateway sinks notifications/indications or CoC SDUs */
+    TPUT_DIR_BOTH = 3,
+    TPUT_DIR_INVALID = 0
+} BLE_TputDir_t;
+
+/**
+  * @brief Initialize benchmark task and timer
+  */
+void BLE_Tput_Init(void);
+
+/**
+  * @brief Start a benchmark on one link
+  * @param dev_idx Device index
+  * @param dir BLE_TputDir_t
+  * @param seconds Test length (1 - BLE_TPUT_MAX_SECONDS)
+  * @param mode Data_TxMode_t: write without response, write with response, or CoC
+  * @param target Characteristic written (GATT modes) or CoC channel; ignored for RX only
+  * @return 0 if started, -1 if invalid, busy or not connected
+  * @note  Results are reported as +TPUT lines when the test ends
+  */
+int BLE_Tput_Start(uint8_t dev_idx, BLE_TputDir_t dir, uint16_t seconds, uint8_t mode,
+                   uint16_t target);
+
+/**
+  * @brief Abort the running benchmark and report what was measured
+  * @return 0 if a test was running, -1 otherwise
+  */
+int BLE_Tput_Stop(void);
+
+/**
+  * @brief Check if a benchmark is running
+  */
+uint8_t BLE_Tput_IsActive(void);
+
+/**
+  * @brief Report results of the running or last benchmark via AT response
+  */
+void BLE_Tput_Report(void);
+
+/**
+  * @brief Parse direction name (TX, RX, BOTH; any case)
+  * @return Direction, TPUT_DIR_INVALID if unknown
+  */
+BLE_TputDir_t BLE_Tput_DirFromName(const char *name, uint8_t len);
+
+/**
+  * @brief Sink a notification/indication on the benchmarked link
+  * @return 1 if consumed by the benchmark, 0 otherwise
+  */
+uint8_t BLE_Tput_OnNotification(uint16_t conn_handle, const uint8_t *data, uint16_t len);
+
+/**
+  * @brief Sink a CoC K-frame on the benchmarked channel
+  * @return 1 if consumed by the benchmark, 0 otherwise
+  */
+uint8_t BLE_Tput_OnCocRx(uint8_t ch, uint16_t len);
+
+/**
+  * @brief GATT procedure complete (write with response)
+  * @return 1 if consumed by the benchmark, 0 otherwise
+  */
+uint8_t BLE_Tput_OnProcComplete(uint16_t conn_handle, uint8_t error_code);
+
+/**
+  * @brief TX pool credits available again, or CoC channel ready for the next SDU
+  */
+void BLE_Tput_OnTxPoolAvailable(uint16_t conn_handle);
+
+/**
+  * @brief Link dropped: end a benchmark running on it
+  */
+void BLE_Tput_OnDisconnected(uint16_t conn_handle);
+
+#endif /* BLE_TPUT_H */
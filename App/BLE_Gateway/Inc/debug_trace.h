@@ -12,33 +12,140 @@
 #include <stdint.h>
 #include <stdio.h>
 
+/*
+ * Logging is deferred: a DEBUG_xxx call only copies its format pointer and
+ * arguments into a binary ring (strings are copied, truncated to
+ * DEBUG_STR_MAX). A low priority sequencer task formats the records and
+ * sends them over USB CDC when the endpoint is free, so a call never blocks
+ * and never runs printf. Records that do not fit are dropped and counted.
+ *
+ * Filtering is at compile time: calls above DEBUG_LEVEL, or from a module
+ * not in DEBUG_MODULES, compile to nothing (arguments are not evaluated).
+ * A source file selects its module by defining DEBUG_MODULE before
+ * including this header.
+ *
+ * With DEBUG_TOKENIZED, format strings go to the .trace_fmt section, which
+ * stays in the ELF but is not loaded, and records are sent as binary frames
+ * (format address, arguments, time delta) for tools/trace_decode.py:
+ *   0xA5 <len> <token> <level> <dt_ms> [<suppressed>] <args>
+ * Numbers are LEB128 varints, strings a length byte and the characters.
+ */
+#define DEBUG_LEVEL_NONE        0
+#define DEBUG_LEVEL_ERROR       1
+#define DEBUG_LEVEL_WARN        2
+#define DEBUG_LEVEL_INFO        3
+#define DEBUG_LEVEL_DEBUG       4
+
+#ifndef DEBUG_LEVEL
+#define DEBUG_LEVEL             DEBUG_LEVEL_DEBUG
+#endif
+
+#define DEBUG_MOD_APP           (1U << 0)
+#define DEBUG_MOD_AT            (1U << 1)
+#define DEBUG_MOD_BLE           (1U << 2)       /* Link layer: scan, connect, L2CAP */
+#define DEBUG_MOD_GATT          (1U << 3)       /* Discovery, queues, polling */
+#define DEBUG_MOD_DATA          (1U << 4)       /* Data mode, mux, rules, analytics */
+#define DEBUG_MOD_STORE         (1U << 5)       /* Flash, key-value, config, event log */
+#define DEBUG_MOD_SYS           (1U << 6)       /* System, power, init */
+
+#ifndef DEBUG_MODULES
+#define DEBUG_MODULES           0xFFFFU
+#endif
+
+#ifndef DEBUG_MODULE
+#define DEBUG_MODULE            DEBUG_MOD_APP
+#endif
+
+#ifndef DEBUG_TOKENIZED
+#define DEBUG_TOKENIZED         0
+#endif
+
+#define DEBUG_RING_SIZE         2048    /* Pending records, bytes */
+#define DEBUG_MAX_ARGS          12
+#define DEBUG_STR_MAX           32      /* Longest %s copied, without terminator */
+#define DEBUG_LINE_MAX          160
+#define DEBUG_RATE_BURST        16      /* Records per call site per window */
+#define DEBUG_RATE_WINDOW_MS    1000
+#define DEBUG_TOKEN_SYNC        0xA5
+#define DEBUG_TOKEN_SUPPRESSED  0x08    /* Level byte flag */
+
 /**
-  * @brief Debug print (uses printf -> USB CDC)
+  * @brief Per call site state (one static instance per DEBUG_xxx use)
   */
-#define DEBUG_PRINT(fmt, ...) do { \
-    printf("[DEBUG] "); \
-    printf(fmt, ##__VA_ARGS__); \
-    printf("\r\n"); \
-} while(0)
+typedef struct {
+    const char *fmt;            /* Token address if DEBUG_TOKENIZED */
+    uint8_t level;
+    uint8_t nargs;
+    uint8_t count;              /* Records in the current window */
+    uint16_t strmask;           /* Bit n: argument n is a string */
+    uint16_t suppressed;        /* Rate limited since the last record */
+    uint32_t window_start;
+} Debug_Site_t;
 
-#define DEBUG_INFO(fmt, ...) do { \
-    printf("[INFO] "); \
-    printf(fmt, ##__VA_ARGS__); \
-    printf("\r\n"); \
-} while(0)
+#if DEBUG_TOKENIZED
+#define DEBUG_FMT_SECTION       __attribute__((section(".trace_fmt")))
+#else
+#define DEBUG_FMT_SECTION
+#endif
 
-#define DEBUG_ERROR(fmt, ...) do { \
-    printf("[ERROR] "); \
-    printf(fmt, ##__VA_ARGS__); \
-    printf("\r\n"); \
-} while(0)
+/* Argument count and string mask, known at compile time: a record is
+   captured without reading the format */
+#define DEBUG_NARGS(...) \
+    DEBUG_NARGS_(0, ##__VA_ARGS__, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define DEBUG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, N, ...) N
+
+#define DEBUG_IS_STR(x) _Generic((x), char*: 1U, const char*: 1U, \
+    unsigned char*: 1U, const unsigned char*: 1U, default: 0U)
+#define DEBUG_STRMASK(...) \
+    DEBUG_STRMASK_(0, ##__VA_ARGS__, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0)
+#define DEBUG_STRMASK_(_0, a, b, c, d, e, f, g, h, i, j, k, l, ...) (uint16_t)( \
+    DEBUG_IS_STR(a) | (DEBUG_IS_STR(b) << 1) | (DEBUG_IS_STR(c) << 2) | \
+    (DEBUG_IS_STR(d) << 3) | (DEBUG_IS_STR(e) << 4) | (DEBUG_IS_STR(f) << 5) | \
+    (DEBUG_IS_STR(g) << 6) | (DEBUG_IS_STR(h) << 7) | (DEBUG_IS_STR(i) << 8) | \
+    (DEBUG_IS_STR(j) << 9) | (DEBUG_IS_STR(k) << 10) | (DEBUG_IS_STR(l) << 11))
 
-#define DEBUG_WARN(fmt, ...) do { \
-    printf("[WARN] "); \
-    printf(fmt, ##__VA_ARGS__); \
-    printf("\r\n"); \
+#define DEBUG_ENABLED(level) \
+    ((level) <= DEBUG_LEVEL && ((DEBUG_MODULE) & (DEBUG_MODULES)) != 0U)
+
+#define DEBUG_LOG(level, fmt, ...) do { \
+    if (DEBUG_ENABLED(level)) { \
+        _Static_assert(DEBUG_NARGS(__VA_ARGS__) <= DEBUG_MAX_ARGS, "too many log arguments"); \
+        static const char debug_fmt_[] DEBUG_FMT_SECTION = fmt; \
+        static Debug_Site_t debug_site_ = { debug_fmt_, level, DEBUG_NARGS(__VA_ARGS__), 0, \
+                                            DEBUG_STRMASK(__VA_ARGS__), 0, 0 }; \
+        DEBUG_Log(&debug_site_, ##__VA_ARGS__); \
+    } \
 } while(0)
 
+/**
+  * @brief Debug print (deferred to USB CDC)
+  */
+#define DEBUG_PRINT(fmt, ...)   DEBUG_LOG(DEBUG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#define DEBUG_INFO(fmt, ...)    DEBUG_LOG(DEBUG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define DEBUG_ERROR(fmt, ...)   DEBUG_LOG(DEBUG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#define DEBUG_WARN(fmt, ...)    DEBUG_LOG(DEBUG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+
+/**
+  * @brief Register the output task; records logged before are kept
+  */
+void DEBUG_Init(void);
+
+/**
+  * @brief Queue a record (use the DEBUG_xxx macros)
+  * @note  Safe from interrupt context
+  */
+void DEBUG_Log(Debug_Site_t *site, ...);
+
+/**
+  * @brief USB CDC IN transfer complete (interrupt context)
+  */
+void DEBUG_OnTxComplete(void);
+
+/**
+  * @brief Report filter settings, ring usage and drop counters via AT response
+  */
+void DEBUG_Report(void);
+
 /**
   * @brief Print MAC address
   */
@@ -0,0 +1,94 @@
+/**
+  ******************************************************************************
+  * @file    module_compress.h
+  * @brief   Streaming LZ compression of UART data mode traffic, per link and direction
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#ifndef MODULE_COMPRESS_H
+#define MODULE_COMPRESS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * Byte-aligned LZSS stream (both directions use the same format):
+ *   [flags][token x 8][flags][token x 8]...
+ * flags bit i (LSB first) describes token i:
+ *   1 = literal   [byte]
+ *   0 = reference [offset 11:4][offset 3:0 | length - COMPRESS_MIN_MATCH]
+ * offset is the distance back into the last COMPRESS_WINDOW bytes of output.
+ * offset 0 is a sync marker: the rest of the group is empty, the next byte
+ * is a flags byte. The encoder ends every block with one, so each notification
+ * can be decoded as soon as it arrives while the window carries over.
+ */
+#define COMPRESS_WINDOW         512     /* Power of 2: history shared by encoder and decoder */
+#define COMPRESS_MIN_MATCH      3
+#define COMPRESS_MAX_MATCH      18      /* 4-bit length field */
+#define COMPRESS_MAX_STREAMS    2       /* Per direction, ~2 KB per encoder, ~0.5 KB per decoder */
+#define COMPRESS_BLOCK_MAX      128     /* Largest input per encode: output fits one mux frame */
+
+/* Largest encoder output for a block of len bytes (all literals + flags + sync) */
+#define COMPRESS_BOUND(len)     ((len) + (len) / 8U + 4U)
+
+typedef enum {
+    COMPRESS_UP = 0,            /* Host -> peer: host compresses, gateway decodes */
+    COMPRESS_DOWN = 1           /* Peer -> host: gateway compresses, host decodes */
+} Compress_Dir_t;
+
+/**
+  * @brief Initialize stream pool and cycle counter
+  */
+void Module_Compress_Init(void);
+
+/**
+  * @brief Enable or disable compression on a link
+  * @param link Device index (data mode target or mux link)
+  * @param up Decode host -> peer traffic
+  * @param down Encode peer -> host traffic
+  * @return 0 if success, -1 if invalid or no free stream
+  * @note  Takes effect at the next data or mux mode entry, where both ends start
+  *        with an empty window
+  */
+int Module_Compress_Set(uint8_t link, uint8_t up, uint8_t down);
+
+/**
+  * @brief Check if a link direction is compressed
+  */
+uint8_t Module_Compress_IsEnabled(uint8_t link, Compress_Dir_t dir);
+
+/**
+  * @brief Clear windows and statistics of all streams (new session)
+  */
+void Module_Compress_Reset(void);
+
+/**
+  * @brief Compress one block and end it with a sync marker
+  * @param len Input length (1 - COMPRESS_BLOCK_MAX)
+  * @param out Output buffer of at least COMPRESS_BOUND(len) bytes
+  * @return Output length, 0 if the link is not compressed
+  */
+uint16_t Module_Compress_Encode(uint8_t link, const uint8_t *in, uint16_t len, uint8_t *out);
+
+/**
+  * @brief Decompress a fragment of the host stream
+  * @param out_max Room in out; output beyond it is dropped but still enters the window
+  * @return Bytes produced (may exceed out_max), 0 if the link is not compressed
+  */
+uint16_t Module_Compress_Decode(uint8_t link, const uint8_t *in, uint16_t len,
+                                uint8_t *out, uint16_t out_max);
+
+/**
+  * @brief Report ratio and cycle cost per stream via AT response
+  */
+void Module_Compress_Report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MODULE_COMPRESS_H */
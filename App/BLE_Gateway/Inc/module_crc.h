@@ -0,0 +1,65 @@
+/**
+  ******************************************************************************
+  * @file    module_crc.h
+  * @brief   CRC-32 service on the CRC peripheral, with a table-driven fallback
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#ifndef MODULE_CRC_H
+#define MODULE_CRC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * CRC-32 (IEEE 802.3, reflected, as zlib): the value is identical whichever
+ * implementation runs, so records written by one build verify on another.
+ * On target the CRC peripheral is fed a word per write, by DMA for blocks of
+ * at least CRC_DMA_THRESHOLD bytes. Host builds (no CRC peripheral) use a
+ * 256-entry table. Not reentrant: call from task context only.
+ */
+#ifndef CRC_USE_HARDWARE
+#if defined(__arm__)
+#define CRC_USE_HARDWARE        1
+#else
+#define CRC_USE_HARDWARE        0
+#endif
+#endif
+
+#define CRC32_INIT              0xFFFFFFFFU
+#define CRC_DMA_THRESHOLD       256     /* Below this, CPU writes beat DMA setup */
+#define CRC_BENCH_MAX           4096
+
+/**
+  * @brief Enable the CRC unit and DMA channel
+  */
+void Module_Crc_Init(void);
+
+/**
+  * @brief CRC-32 of a buffer
+  */
+uint32_t Module_Crc32(const void *data, uint32_t len);
+
+/**
+  * @brief Continue a CRC-32 over several buffers
+  * @param crc CRC32_INIT for the first buffer, then the previous result
+  * @return Running value; the CRC-32 is its complement (~crc)
+  */
+uint32_t Module_Crc32_Update(uint32_t crc, const void *data, uint32_t len);
+
+/**
+  * @brief Time each implementation over len bytes of Flash and report via AT response
+  * @param len 1 - CRC_BENCH_MAX
+  * @return 0 if all implementations agree, -1 if invalid or mismatch
+  */
+int Module_Crc_Benchmark(uint16_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MODULE_CRC_H */
@@ -0,0 +1,110 @@
+/**
+  ******************************************************************************
+  * @file    module_evlog.h
+  * @brief   Flash-backed store-and-forward log of events the host missed
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#ifndef MODULE_EVLOG_H
+#define MODULE_EVLOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * While the host is away, +NOTIFICATION and +SCAN events are appended as
+ * compact binary records to a ring of EVLOG_PAGE_COUNT pages in the EVLOG
+ * region (see stm32wb55xx_flash_cm4.ld), instead of being printed. Lines
+ * that rules, aggregation, anomaly scoring and decoders print for a
+ * notification are stored as text records, one per line. When the
+ * ring is full the oldest page is erased. Every record has a sequence
+ * number that keeps increasing across reboots, so a host can drop events it
+ * already has after AT+REPLAY.
+ */
+#define EVLOG_FLASH_BASE        0x08074000U     /* EVLOG region origin */
+#define EVLOG_PAGE_COUNT        8
+#define EVLOG_MAX_PAYLOAD       192
+#define EVLOG_DEFAULT_TIMEOUT_S 30
+#define EVLOG_REPLAY_BURST      8               /* Records per replay task run */
+
+typedef enum {
+    EVLOG_OFF = 0,              /* Events are always printed */
+    EVLOG_AUTO = 1,             /* Stored once no AT command came for timeout_s */
+    EVLOG_HOLD = 2              /* Always stored (host announced an outage) */
+} EvLog_Mode_t;
+
+/**
+  * @brief Load settings and locate the ring head and tail
+  * @note  Call after Module_KV_Init
+  */
+void Module_EvLog_Init(void);
+
+/**
+  * @brief Set the store-and-forward mode (saved in the key-value store)
+  * @param timeout_s Host silence before storing in EVLOG_AUTO (1 - 3600)
+  * @return 0 if success, -1 if invalid
+  */
+int Module_EvLog_Config(EvLog_Mode_t mode, uint16_t timeout_s);
+
+/**
+  * @brief An AT command arrived: the host is draining the UART
+  */
+void Module_EvLog_OnHostActivity(void);
+
+/**
+  * @brief Check if events are being stored instead of printed
+  */
+uint8_t Module_EvLog_IsStoring(void);
+
+/**
+  * @brief Store a notification if the host is away
+  * @return 1 if stored (do not print), 0 otherwise
+  */
+uint8_t Module_EvLog_Notification(uint16_t conn_handle, uint16_t handle,
+                                  const uint8_t *data, uint16_t len);
+
+/**
+  * @brief Start capturing response lines for the notification being consumed
+  * @note  Lines are only captured if the host is away
+  */
+void Module_EvLog_BeginCapture(void);
+
+/**
+  * @brief Stop capturing, storing an unterminated last line
+  */
+void Module_EvLog_EndCapture(void);
+
+/**
+  * @brief Store response text while a capture is running
+  * @return 1 if captured (do not print), 0 otherwise
+  */
+uint8_t Module_EvLog_Capture(const char *text, uint16_t len);
+
+/**
+  * @brief Store a scan report if the host is away
+  * @param mac Address, LSB first
+  * @return 1 if stored (do not print), 0 otherwise
+  */
+uint8_t Module_EvLog_Scan(const uint8_t *mac, int8_t rssi, const char *name);
+
+/**
+  * @brief Start replaying stored events to the host
+  * @param from_seq First sequence number (0 = the first one not yet replayed)
+  * @return Number of events to replay (may be 0), -1 if a replay is running
+  */
+int Module_EvLog_Replay(uint32_t from_seq);
+
+/**
+  * @brief Report mode, ring usage and counters via AT response
+  */
+void Module_EvLog_Report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MODULE_EVLOG_H */
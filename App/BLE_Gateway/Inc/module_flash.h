@@ -0,0 +1,102 @@
+/**
+  ******************************************************************************
+  * @file    module_flash.h
+  * @brief   Background Flash writer coordinated with CPU2 radio activity
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#ifndef MODULE_FLASH_H
+#define MODULE_FLASH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * Erase and program requests are queued and run by a sequencer task one
+ * slice at a time: one page erase or one 64-bit word per slice. Each slice
+ * first takes HSEM CFG_HW_BLOCK_FLASH_REQ_BY_CPU2_SEMID, which CPU2 holds
+ * around its radio events, so Flash stalls never land on a connection
+ * event. Erases are bracketed by SHCI_C2_FLASH_EraseActivity.
+ */
+#define FLASH_WRITER_MAX_JOBS       32
+#define FLASH_WRITER_POOL_SIZE      4096    /* Bytes of queued program data */
+#define FLASH_WRITER_RETRY_MS       1       /* Back-off while CPU2 holds the semaphore */
+
+/**
+  * @brief Job completion callback (sequencer task context)
+  * @param addr Job start address
+  * @param status 0 if success, -1 if the Flash operation failed
+  */
+typedef void (*Module_Flash_Cb_t)(uint32_t addr, int status);
+
+/**
+  * @brief Deferred flush completion (see Module_Flash_FlushThen)
+  */
+typedef void (*Module_Flash_DoneCb_t)(void);
+
+/**
+  * @brief Initialize queue, task and retry timer
+  */
+void Module_Flash_Init(void);
+
+/**
+  * @brief CPU2 wireless firmware is running: switch it to semaphore 7 control
+  * @note  Before this, CPU2 has no radio activity and slices run unguarded
+  */
+void Module_Flash_OnCpu2Ready(void);
+
+/**
+  * @brief Queue a page erase
+  * @param addr Page start address
+  * @param cb Completion callback (may be NULL)
+  * @return 0 if queued, -1 if the queue is full
+  */
+int Module_Flash_Erase(uint32_t addr, Module_Flash_Cb_t cb);
+
+/**
+  * @brief Queue data to program (copied; a short tail is padded with 0xFF)
+  * @param addr 8-byte aligned address in erased Flash
+  * @param cb Completion callback (may be NULL)
+  * @return 0 if queued, -1 if the queue or data pool is full
+  * @note  Jobs run in order: a later job never lands before an earlier one
+  */
+int Module_Flash_Program(uint32_t addr, const void *data, uint16_t len, Module_Flash_Cb_t cb);
+
+/**
+  * @brief Read Flash as it will be once all queued jobs have run
+  */
+void Module_Flash_Read(uint32_t addr, void *buffer, uint16_t len);
+
+/**
+  * @brief Run all queued jobs now, waiting for radio-idle windows
+  * @return 0 if the queue is empty, -1 if called from a task run while the
+  *         writer waits for a CPU2 response (nothing done)
+  * @note  For boot, reset and a full queue; normal writes stay in the background
+  */
+int Module_Flash_Flush(void);
+
+/**
+  * @brief Run all queued jobs, then call done
+  * @note  Inside the writer's CPU2 wait, both are deferred to the writer task
+  */
+void Module_Flash_FlushThen(Module_Flash_DoneCb_t done);
+
+/**
+  * @brief Check if no job is queued
+  */
+uint8_t Module_Flash_IsIdle(void);
+
+/**
+  * @brief Report queue and slice statistics via AT response
+  */
+void Module_Flash_Report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MODULE_FLASH_H */
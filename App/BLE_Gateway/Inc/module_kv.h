@@ -0,0 +1,79 @@
+/**
+  ******************************************************************************
+  * @file    module_kv.h
+  * @brief   Log-structured key-value store in reserved Flash pages
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#ifndef MODULE_KV_H
+#define MODULE_KV_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * Records are appended to a log that rotates through KV_PAGE_COUNT pages of
+ * the NVM region (see stm32wb55xx_flash_cm4.ld). One page is always kept
+ * erased: when the log reaches it, the live records of the oldest page are
+ * copied over and the oldest page is erased (page swap). Every record
+ * carries a CRC32 and becomes visible only when its header, programmed
+ * last, is written, so power loss never leaves a half-written value.
+ */
+#define KV_FLASH_BASE           0x0807C000U     /* NVM region origin */
+#define KV_PAGE_COUNT           4
+#define KV_MAX_VALUE            1024            /* Largest value in bytes */
+#define KV_MAX_KEYS             192             /* Live keys (RAM index holds 256) */
+
+/* Key namespaces: high byte = kind, low byte = slot */
+#define KV_KEY_CONFIG           0x0001U         /* Module_Config_t */
+#define KV_KEY_EVLOG            0x0002U         /* Event log mode and replay cursor */
+#define KV_NS_BOND              0x0100U         /* Bonding records */
+#define KV_NS_GATT_CACHE        0x0200U         /* Discovered attribute tables */
+#define KV_NS_NAME              0x0300U         /* Device name cache */
+#define KV_NS_SCRIPT            0x0400U         /* Boot script lines */
+#define KV_KEY(ns, slot)        ((uint16_t)((ns) | ((slot) & 0xFFU)))
+
+/**
+  * @brief Recover from an interrupted page swap and build the RAM index
+  * @note  Call before any module that reads persisted data
+  */
+void Module_KV_Init(void);
+
+/**
+  * @brief Read a value
+  * @param key Key (not 0xFFFF)
+  * @param buffer Output buffer, may be NULL to query the length
+  * @param max_len Buffer size; longer values are truncated
+  * @return Value length, -1 if not found
+  */
+int Module_KV_Get(uint16_t key, void *buffer, uint16_t max_len);
+
+/**
+  * @brief Write a value (replaces any previous value of the key)
+  * @param len 1 - KV_MAX_VALUE
+  * @return 0 if queued, -1 if invalid, store full or Flash error
+  * @note  Flash is programmed in the background (module_flash.c), in order;
+  *        reads see the new value at once
+  */
+int Module_KV_Set(uint16_t key, const void *data, uint16_t len);
+
+/**
+  * @brief Delete a key
+  * @return 0 if deleted or absent, -1 if Flash error
+  */
+int Module_KV_Delete(uint16_t key);
+
+/**
+  * @brief Report usage and wear via AT response
+  */
+void Module_KV_Report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MODULE_KV_H */
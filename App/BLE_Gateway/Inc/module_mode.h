@@ -18,9 +18,30 @@ extern "C" {
 /* Operation modes */
 typedef enum {
     MODE_COMMAND = 0,    /* AT command mode - parse AT commands */
-    MODE_DATA = 1        /* Data mode - transparent UART to BLE GATT */
+    MODE_DATA = 1,       /* Data mode - transparent UART to BLE GATT */
+    MODE_MUX = 2         /* Mux mode - COBS frames routed to several links */
 } Operation_Mode_t;
 
+/* Data mode write type */
+typedef enum {
+    DATA_TX_NORESP = 0,  /* Write Command, paced by TX pool credits */
+    DATA_TX_ACKED = 1,   /* Write Request, one packet in flight */
+    DATA_TX_COC = 2      /* L2CAP CoC SDUs, paced by channel credits (see ble_l2cap.h) */
+} Data_TxMode_t;
+
+/* Data mode flush policy: when a packet smaller than ATT_MTU-3 may be sent */
+typedef struct {
+    uint16_t max_bytes;     /* Send once this many bytes are buffered (0 = ATT_MTU-3) */
+    uint16_t latency_ms;    /* Max time a byte waits for coalescing (>= 1) */
+    uint16_t idle_ms;       /* Send after this UART silence (0 = off) */
+    uint8_t nagle;          /* 1 = send at once when no packet went out within latency_ms */
+} Data_FlushPolicy_t;
+
+#define DATA_FLUSH_DEFAULT_MAX_BYTES   0
+#define DATA_FLUSH_DEFAULT_LATENCY_MS  20
+#define DATA_FLUSH_DEFAULT_IDLE_MS     10
+#define DATA_FLUSH_DEFAULT_NAGLE       0
+
 /* Escape sequence configuration */
 #define ESCAPE_SEQ_CHAR       '+'
 #define ESCAPE_SEQ_LENGTH     3
@@ -37,13 +58,29 @@ void Module_Mode_Init(void);
   */
 int Module_Mode_EnterCommand(void);
 
+/**
+  * @brief Enter mux mode (framed UART<->several GATT links, see module_mux.h)
+  * @return 0 if success, -1 if not in command mode or no link bound
+  */
+int Module_Mode_EnterMux(void);
+
 /**
   * @brief Enter data mode (transparent UART<->GATT)
   * @param dev_idx Device index
-  * @param char_handle Characteristic handle for data transfer
+  * @param char_handle Characteristic written with UART data
+  * @param rx_handle Characteristic whose notifications/indications go to UART (0 = char_handle)
+  * @param tx_mode Write type for UART data
   * @return 0 if success, -1 if error
   */
-int Module_Mode_EnterData(uint8_t dev_idx, uint16_t char_handle);
+int Module_Mode_EnterData(uint8_t dev_idx, uint16_t char_handle, uint16_t rx_handle,
+                          Data_TxMode_t tx_mode);
+
+/**
+  * @brief Enter data mode over an open L2CAP CoC channel (transparent UART<->SDUs)
+  * @param ch Channel number from BLE_L2cap_Connect
+  * @return 0 if success, -1 if the channel is not open
+  */
+int Module_Mode_EnterCoc(uint8_t ch);
 
 /**
   * @brief Get current mode
@@ -52,11 +89,63 @@ int Module_Mode_EnterData(uint8_t dev_idx, uint16_t char_handle);
 Operation_Mode_t Module_Mode_GetCurrent(void);
 
 /**
-  * @brief Process incoming UART byte in data mode
+  * @brief Queue a UART byte received in data mode (ISR context)
+  * @param byte Data byte received
+  * @note Only appends to the RX ring and schedules the data mode task
+  */
+void Module_Mode_ReceiveByteISR(uint8_t byte);
+
+/**
+  * @brief Process incoming UART byte in data mode (task context)
   * @param byte Data byte received
+  * @param after_guard 1 if the byte arrived after the escape guard time of
+  *        silence (timed at arrival by Module_Mode_ReceiveByteISR)
   * @note This handles escape sequence detection and data buffering
   */
-void Module_Mode_ProcessDataByte(uint8_t byte);
+void Module_Mode_ProcessDataByte(uint8_t byte, uint8_t after_guard);
+
+/**
+  * @brief Offer a GATT procedure completion to the data mode writer
+  * @return 1 if it completed a data mode write (consumed), 0 otherwise
+  */
+uint8_t Module_Mode_OnProcComplete(uint16_t conn_handle, uint8_t error_code);
+
+/**
+  * @brief TX pool credits available again (ACI_GATT_TX_POOL_AVAILABLE),
+  *        or a CoC channel ready for the next SDU
+  */
+void Module_Mode_OnTxPoolAvailable(uint16_t conn_handle);
+
+/**
+  * @brief Link established (mux links track their connection handle)
+  */
+void Module_Mode_OnConnected(uint8_t dev_idx, uint16_t conn_handle);
+
+/**
+  * @brief Link dropped: release a write or credit wait on it
+  */
+void Module_Mode_OnDisconnected(uint16_t conn_handle);
+
+/**
+  * @brief Get data mode packet size (target ATT_MTU - 3, or CoC SDU size)
+  */
+uint16_t Module_Mode_GetChunkSize(void);
+
+/**
+  * @brief Set data mode flush policy
+  * @return 0 if success, -1 if invalid
+  */
+int Module_Mode_SetFlushPolicy(const Data_FlushPolicy_t *policy);
+
+/**
+  * @brief Get data mode flush policy
+  */
+const Data_FlushPolicy_t* Module_Mode_GetFlushPolicy(void);
+
+/**
+  * @brief Report data mode throughput of the current or last session via AT response
+  */
+void Module_Mode_ReportStats(void);
 
 /**
   * @brief Process incoming GATT notification in data mode
@@ -64,16 +153,33 @@ void Module_Mode_ProcessDataByte(uint8_t byte);
   * @param handle Characteristic handle
   * @param data Data bytes
   * @param len Data length
-  * @note Forward GATT data to UART in data mode
+  * @return 1 if forwarded as raw UART bytes, 0 if not the data mode RX characteristic
+  */
+uint8_t Module_Mode_ProcessGATTData(uint16_t conn_handle, uint16_t handle, 
+                                    const uint8_t *data, uint16_t len);
+
+/**
+  * @brief Free space on the non-blocking UART TX path
+  */
+uint16_t Module_Mode_UartTxFree(void);
+
+/**
+  * @brief Queue bytes on the non-blocking UART TX path (LPUART DMA)
+  * @return Number of bytes queued (less than len if the ring is full)
+  * @note  Task context only
+  */
+uint16_t Module_Mode_UartWrite(const uint8_t *data, uint16_t len);
+
+/**
+  * @brief Run the data mode task again once a UART TX transfer frees space
   */
-void Module_Mode_ProcessGATTData(uint16_t conn_handle, uint16_t handle, 
-                                 const uint8_t *data, uint16_t len);
+void Module_Mode_UartTxNotify(void);
 
 /**
-  * @brief Check if escape sequence detected
-  * @return 1 if escape detected, 0 otherwise
+  * @brief Check if the non-blocking UART TX path still has bytes to send
+  * @return 1 if pending, 0 if idle
   */
-uint8_t Module_Mode_IsEscapeDetected(void);
+uint8_t Module_Mode_UartTxPending(void);
 
 /**
   * @brief Get data mode target device index
@@ -88,8 +194,9 @@ uint8_t Module_Mode_GetTargetDevice(void);
 uint16_t Module_Mode_GetTargetHandle(void);
 
 /**
-  * @brief Flush data mode TX buffer
-  * @return Number of bytes flushed
+  * @brief Write buffered data mode bytes in ATT_MTU-3 packets
+  * @return Number of bytes written, -1 if error
+  * @note  Stops early when TX pool credits run out or an acked write is in flight
   */
 int Module_Mode_FlushTxBuffer(void);
 
@@ -0,0 +1,114 @@
+/**
+  ******************************************************************************
+  * @file    module_mux.h
+  * @brief   Multiplexed data mode - COBS-framed UART streams to several links
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#ifndef MODULE_MUX_H
+#define MODULE_MUX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "module_mode.h"
+
+/*
+ * Frame (before COBS encoding, 0x00 delimited on the wire):
+ *   [link][len][payload x len][crc32 x 4]
+ * crc32 is the CRC-32 of link, len and payload, little-endian; frames that
+ * fail it are dropped.
+ * link is the device index. Link MUX_LINK_CTRL carries control frames:
+ *   host -> gateway  [0xFF][1][MUX_CTRL_EXIT]         leave mux mode
+ *   gateway -> host  [0xFF][2][link][MUX_STATE_x]     per-link flow control
+ */
+#define MUX_MAX_LINKS           8
+#define MUX_LINK_CTRL           0xFFU
+#define MUX_MAX_PAYLOAD         153     /* CFG_BLE_MAX_ATT_MTU - 3 */
+#define MUX_LINK_BUFFER_SIZE    512     /* Per-link UART -> GATT buffer */
+
+#define MUX_CTRL_EXIT           0x00U
+
+typedef enum {
+    MUX_STATE_XOFF = 0,     /* Link buffer above high water: pause this link */
+    MUX_STATE_XON = 1,      /* Link buffer drained: resume */
+    MUX_STATE_DOWN = 2      /* Link disconnected */
+} Mux_LinkState_t;
+
+/**
+  * @brief Initialize link table
+  */
+void Module_Mux_Init(void);
+
+/**
+  * @brief Bind a link to its data characteristics
+  * @param link Device index
+  * @param tx_handle Characteristic written with host frames (0 = unbind)
+  * @param rx_handle Characteristic framed back to host (0 = tx_handle)
+  * @return 0 if success, -1 if invalid
+  */
+int Module_Mux_Bind(uint8_t link, uint16_t tx_handle, uint16_t rx_handle, Data_TxMode_t tx_mode);
+
+/**
+  * @brief Start a mux session (reset buffers and statistics)
+  * @return 0 if success, -1 if no link is bound
+  */
+int Module_Mux_Start(void);
+
+/**
+  * @brief Stop the mux session, discarding unsent data
+  */
+void Module_Mux_Stop(void);
+
+/**
+  * @brief Feed one UART byte to the frame decoder (data mode task)
+  * @return 1 if the host requested exit, 0 otherwise
+  */
+uint8_t Module_Mux_RxByte(uint8_t byte);
+
+/**
+  * @brief Write buffered link data, as far as credits allow
+  */
+void Module_Mux_Service(void);
+
+/**
+  * @brief Frame a notification/indication from a bound RX characteristic to UART
+  * @return 1 if consumed, 0 if not a mux RX characteristic
+  */
+uint8_t Module_Mux_OnNotification(uint16_t conn_handle, uint16_t handle,
+                                  const uint8_t *data, uint16_t len);
+
+/**
+  * @brief GATT procedure complete (acked links)
+  * @return 1 if consumed by a mux write, 0 otherwise
+  */
+uint8_t Module_Mux_OnProcComplete(uint16_t conn_handle, uint8_t error_code);
+
+/**
+  * @brief TX pool credits available again
+  */
+void Module_Mux_OnTxPoolAvailable(uint16_t conn_handle);
+
+/**
+  * @brief Device connected: track its connection handle
+  */
+void Module_Mux_OnConnected(uint8_t link, uint16_t conn_handle);
+
+/**
+  * @brief Link dropped: discard its buffer and tell the host
+  */
+void Module_Mux_OnDisconnected(uint16_t conn_handle);
+
+/**
+  * @brief Report links and statistics via AT response
+  */
+void Module_Mux_Report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MODULE_MUX_H */
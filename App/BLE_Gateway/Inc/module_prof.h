@@ -0,0 +1,89 @@
+/**
+  ******************************************************************************
+  * @file    module_prof.h
+  * @brief   Sequencer task and ISR profiler on the DWT cycle counter
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#ifndef MODULE_PROF_H
+#define MODULE_PROF_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "app_conf.h"
+
+/*
+ * UTIL_SEQ_Run() and UTIL_SEQ_SetTask() call the hooks below (see
+ * utilities_conf.h), and the profiled ISRs use PROF_ISR_ENTER/EXIT. Times
+ * are self times: a task does not include the profiled ISRs that preempted
+ * it, nor tasks run by a nested UTIL_SEQ_WaitEvt(). Latency is from the
+ * first UTIL_SEQ_SetTask() of a pending task to its start; it is also
+ * binned per priority class (the highest the task was set with), in
+ * power-of-two cycle buckets, for the class percentiles.
+ * CFG_PROF_ENABLE = 0 (app_conf.h) removes all hooks.
+ */
+#define PROF_TASK_NBR           32      /* UTIL_SEQ_CONF_TASK_NBR */
+#define PROF_DEPTH              4       /* Nested UTIL_SEQ_WaitEvt() levels */
+#define PROF_LAT_BUCKETS        28      /* Bucket n: latency < 2^n cycles */
+
+typedef enum {
+    PROF_ISR_LPUART1 = 0,
+    PROF_ISR_IPCC_RX,
+    PROF_ISR_IPCC_TX,
+    PROF_ISR_RTC_WKUP,
+    PROF_ISR_NBR
+} Prof_Isr_t;
+
+typedef struct {
+    uint32_t start;
+    uint32_t nested;
+} Prof_IsrCtx_t;
+
+#if (CFG_PROF_ENABLE == 1)
+#define PROF_ISR_ENTER(ctx)         Prof_IsrCtx_t ctx; Module_Prof_IsrEnter(&ctx)
+#define PROF_ISR_EXIT(isr, ctx)     Module_Prof_IsrExit(isr, &ctx)
+#else
+#define PROF_ISR_ENTER(ctx)
+#define PROF_ISR_EXIT(isr, ctx)
+#endif
+
+/**
+  * @brief Start the DWT cycle counter and open the first window
+  * @note  Call first: every module that times work reads CYCCNT
+  */
+void Module_Prof_Init(void);
+
+/**
+  * @brief Sequencer hooks (critical section held for TaskSet)
+  */
+void Module_Prof_TaskSet(uint32_t task_bm, uint32_t prio);
+void Module_Prof_TaskStart(uint32_t task_idx);
+void Module_Prof_TaskEnd(uint32_t task_idx);
+void Module_Prof_Idle(void);
+
+/**
+  * @brief ISR hooks (use PROF_ISR_ENTER/EXIT)
+  */
+void Module_Prof_IsrEnter(Prof_IsrCtx_t *ctx);
+void Module_Prof_IsrExit(Prof_Isr_t isr, const Prof_IsrCtx_t *ctx);
+
+/**
+  * @brief Clear all counters and start a new window
+  */
+void Module_Prof_Reset(void);
+
+/**
+  * @brief Report CPU load, then tasks, priority classes and ISRs that ran,
+  *        via AT response
+  */
+void Module_Prof_Report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MODULE_PROF_H */
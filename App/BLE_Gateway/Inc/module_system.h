@@ -61,7 +61,8 @@ int Module_System_GetBDAddr(uint8_t *addr_type, uint8_t addr[6]);
 
 /**
   * @brief Software reset - reset MCU via NVIC
-  * @note This function does not return
+  * @note Does not return, unless called while the Flash writer waits for
+  *       CPU2: the reset then follows from the writer task
   */
 void Module_System_SoftwareReset(void);
 
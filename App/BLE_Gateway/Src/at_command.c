@@ -6,19 +6,40 @@
   ******************************************************************************
   */
 
+#define DEBUG_MODULE DEBUG_MOD_AT
+
 #include "at_command.h"
 #include "ble_device_manager.h"
 #include "ble_connection.h"
 #include "ble_gatt_client.h"
+#include "ble_gatt_flow.h"
+#include "ble_profile_decoder.h"
+#include "ble_group.h"
+#include "ble_poll.h"
+#include "ble_rules.h"
+#include "ble_aggregate.h"
+#include "ble_anomaly.h"
 #include "debug_trace.h"
 #include "module_system.h"
 #include "module_config.h"
+#include "module_kv.h"
+#include "module_flash.h"
+#include "module_crc.h"
+#include "module_evlog.h"
 #include "module_power.h"
+#include "module_prof.h"
 #include "module_mode.h"
+#include "module_mux.h"
+#include "module_compress.h"
+#include "ble_l2cap.h"
+#include "ble_tput.h"
+#include "ble_hci_queue.h"
+#include "ble_hci_monitor.h"
 #include "main.h"
 #include "app_conf.h"
 #include "stm32_seq.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
 
@@ -109,6 +130,29 @@ static uint16_t ParseUInt16_Hex(const char *str)
     return (uint16_t)val;
 }
 
+/**
+ * @brief Parse unsigned decimal string to uint32_t
+ * @return Parsed value, or 0 if invalid
+ */
+static uint32_t ParseUInt32(const char *str)
+{
+    uint64_t val = 0;
+    
+    if (str == NULL || *str == '\0') {
+        return 0;
+    }
+    
+    while (*str >= '0' && *str <= '9') {
+        val = val * 10U + (uint64_t)(*str - '0');
+        if (val > 0xFFFFFFFFUL) {
+            return 0;  /* Overflow */
+        }
+        str++;
+    }
+    
+    return (uint32_t)val;
+}
+
 /**
  * @brief Parse unsigned decimal string to uint8_t
  * @return Parsed value, or 0xFF if invalid
@@ -251,6 +295,27 @@ static int ParseMACString(const char *mac_str, uint8_t *mac_bytes)
     return 0;
 }
 
+/**
+ * @brief Parse GATT target: "U2A37" = 16-bit char UUID, otherwise hex handle
+ * @return 0 if valid, -1 if invalid
+ */
+static int ParseGattTarget(const char *str, uint8_t *by_uuid, uint16_t *target)
+{
+    if (str == NULL || by_uuid == NULL || target == NULL) {
+        return -1;
+    }
+    
+    if (str[0] == 'U' || str[0] == 'u') {
+        *by_uuid = 1;
+        *target = ParseUInt16_Hex(&str[1]);
+    } else {
+        *by_uuid = 0;
+        *target = ParseUInt16_Hex(str);
+    }
+    
+    return (*target > 0) ? 0 : -1;
+}
+
 /*============================================================================
  * Event Callbacks
  *============================================================================*/
@@ -277,7 +342,7 @@ static void AT_GATT_ProcCompleteCallback(uint16_t conn_handle, uint8_t error_cod
     gatt_proc_pending = 1;
     
     /* Schedule task to send response */
-    UTIL_SEQ_SetTask(1U << CFG_TASK_AT_CMD_PROC_ID, CFG_SCH_PRIO_0);
+    UTIL_SEQ_SetTask(1U << CFG_TASK_AT_CMD_PROC_ID, CFG_SCH_PRIO_RT);
 }
 
 /*============================================================================
@@ -306,18 +371,9 @@ void AT_Command_Init(void)
  *============================================================================*/
 void AT_Command_ReceiveByte(uint8_t byte)
 {
-    /* Check for Data Mode first */
-    if (Module_Mode_GetCurrent() == MODE_DATA) {
-        Module_Mode_ProcessDataByte(byte);
-        
-        /* Check if escape sequence detected (switched back to command mode) */
-        if (Module_Mode_IsEscapeDetected()) {
-             Module_Mode_EnterCommand();
-             /* Clear any partial command buffer */
-             at_line_idx = 0;
-             at_cmd_ready = 0;
-             at_garbage_count = 0;
-        }
+    /* Data/mux mode: ring append only, processed in the data mode task */
+    if (Module_Mode_GetCurrent() != MODE_COMMAND) {
+        Module_Mode_ReceiveByteISR(byte);
         return;
     }
 
@@ -343,7 +399,7 @@ void AT_Command_ReceiveByte(uint8_t byte)
             at_cmd_ready = 1;
             at_garbage_count = 0;
             at_rx_tick = 0;
-            UTIL_SEQ_SetTask(1U << CFG_TASK_AT_CMD_PROC_ID, CFG_SCH_PRIO_0);
+            UTIL_SEQ_SetTask(1U << CFG_TASK_AT_CMD_PROC_ID, CFG_SCH_PRIO_RT);
         } else {
             at_line_idx = 0;
         }
@@ -418,6 +474,17 @@ void AT_Response_Send(const char *fmt, ...)
         len = AT_CMD_MAX_LEN;
     }
     
+    /* Host away: a record printed for a notification is kept for AT+REPLAY */
+    if (Module_EvLog_Capture(response_buf, len)) {
+        return;
+    }
+    
+    /* Keep ordering behind data mode bytes still queued for DMA */
+    if (Module_Mode_UartTxPending()) {
+        Module_Mode_UartWrite((const uint8_t *)response_buf, len);
+        return;
+    }
+    
     /* Send via UART - blocking */
     HAL_UART_Transmit(&hlpuart1, (uint8_t *)response_buf, len, 100);
 }
@@ -459,6 +526,9 @@ void AT_Command_Process(const char *cmd_line)
     /* Debug log */
     DEBUG_PRINT("AT RX: %s", cmd);
     
+    /* Any command shows the host is reading the UART again */
+    Module_EvLog_OnHostActivity();
+    
     /* Parse commands */
     if (strcmp(cmd, "AT") == 0) {
         AT_Response_Send("OK\r\n");
@@ -584,14 +654,24 @@ void AT_Command_Process(const char *cmd_line)
         }
     }
     else if (strncmp(cmd, "AT+DATAMODE=", 12) == 0) {
-        /* Parse: AT+DATAMODE=<idx>,<handle> */
+        /* Parse: AT+DATAMODE=<idx>,<handle>[,<mode>[,<rx_handle>]] */
         const char *p = &cmd[12];
         uint8_t idx = ParseUInt8(p);
         p = SkipToComma(p);
         if (p != NULL && idx != 0xFFU) {
             uint16_t handle = ParseUInt16_Hex(p);
-            if (handle > 0) {
-                AT_DATAMODE_Handler(idx, handle);
+            uint16_t rx_handle = 0;
+            uint8_t mode = DATA_TX_NORESP;
+            p = SkipToComma(p);
+            if (p != NULL) {
+                mode = ParseUInt8(p);
+                p = SkipToComma(p);
+                if (p != NULL) {
+                    rx_handle = ParseUInt16_Hex(p);
+                }
+            }
+            if (handle > 0 && mode <= DATA_TX_ACKED) {
+                AT_DATAMODE_Handler(idx, handle, rx_handle, mode);
             } else {
                 AT_Response_Send("ERROR\r\n");
             }
@@ -664,10 +744,186 @@ void AT_Command_Process(const char *cmd_line)
     else if (strcmp(cmd, "AT+SAVE") == 0) {
         AT_SAVE_Handler();
     }
+    else if (strcmp(cmd, "AT+KVS") == 0) {
+        AT_KVS_Handler();
+    }
+    else if (strncmp(cmd, "AT+EVLOG=", 9) == 0) {
+        /* Parse: AT+EVLOG=<mode>[,<timeout_s>] */
+        const char *p = &cmd[9];
+        uint8_t mode = ParseUInt8(p);
+        uint16_t timeout_s = EVLOG_DEFAULT_TIMEOUT_S;
+        p = SkipToComma(p);
+        if (p != NULL) {
+            timeout_s = ParseUInt16(p);
+        }
+        AT_EVLOG_Handler(mode, timeout_s);
+    }
+    else if (strcmp(cmd, "AT+EVLOG") == 0) {
+        AT_EVLOGS_Handler();
+    }
+    else if (strncmp(cmd, "AT+REPLAY", 9) == 0) {
+        /* Parse: AT+REPLAY[=<from_seq>] */
+        uint32_t from_seq = 0;
+        if (cmd[9] == '=') {
+            from_seq = ParseUInt32(&cmd[10]);
+        }
+        AT_REPLAY_Handler(from_seq);
+    }
+    else if (strncmp(cmd, "AT+CRCB", 7) == 0) {
+        /* Parse: AT+CRCB[=<len>] */
+        uint16_t len = 1024U;
+        if (cmd[7] == '=') {
+            len = ParseUInt16(&cmd[8]);
+        }
+        AT_CRCB_Handler(len);
+    }
+    else if (strcmp(cmd, "AT+LOG") == 0) {
+        AT_LOG_Handler();
+    }
+    else if (strcmp(cmd, "AT+PROF") == 0) {
+        AT_PROF_Handler();
+    }
+    else if (strcmp(cmd, "AT+PROFCLR") == 0) {
+        AT_PROFCLR_Handler();
+    }
+    else if (strcmp(cmd, "AT+HCIQ") == 0) {
+        AT_HCIQ_Handler();
+    }
+    else if (strcmp(cmd, "AT+HCIQCLR") == 0) {
+        AT_HCIQCLR_Handler();
+    }
+    else if (strcmp(cmd, "AT+HCIEVT") == 0) {
+        AT_HCIEVT_Handler();
+    }
+    else if (strcmp(cmd, "AT+HCIEVTCLR") == 0) {
+        AT_HCIEVTCLR_Handler();
+    }
     /* ============ Mode Commands ============ */
     else if (strcmp(cmd, "AT+CMDMODE") == 0) {
         AT_CMDMODE_Handler();
     }
+    else if (strcmp(cmd, "AT+DATASTAT") == 0) {
+        AT_DATASTAT_Handler();
+    }
+    else if (strcmp(cmd, "AT+DATAFLUSH") == 0) {
+        AT_DATAFLUSH_Handler(0, 0, 0, 0, 0);
+    }
+    else if (strncmp(cmd, "AT+DATAFLUSH=", 13) == 0) {
+        /* Parse: AT+DATAFLUSH=<max_bytes>,<latency_ms>,<idle_ms>,<nagle> */
+        const char *p = &cmd[13];
+        const char *q1 = SkipToComma(p);
+        const char *q2 = (q1 != NULL) ? SkipToComma(q1) : NULL;
+        const char *q3 = (q2 != NULL) ? SkipToComma(q2) : NULL;
+        if (q3 != NULL) {
+            AT_DATAFLUSH_Handler(1, ParseUInt16(p), ParseUInt16(q1), ParseUInt16(q2),
+                                 ParseUInt8(q3));
+        } else {
+            AT_Response_Send("ERROR\r\n");
+        }
+    }
+    else if (strncmp(cmd, "AT+MUX=", 7) == 0) {
+        /* Parse: AT+MUX=<idx>,<tx_handle>[,<rx_handle>[,<mode>]] */
+        const char *p = &cmd[7];
+        uint8_t idx = ParseUInt8(p);
+        p = SkipToComma(p);
+        if (p != NULL && idx != 0xFFU) {
+            uint16_t tx_handle = ParseUInt16_Hex(p);
+            uint16_t rx_handle = 0;
+            uint8_t mode = DATA_TX_NORESP;
+            p = SkipToComma(p);
+            if (p != NULL) {
+                rx_handle = ParseUInt16_Hex(p);
+                p = SkipToComma(p);
+                if (p != NULL) {
+                    mode = ParseUInt8(p);
+                }
+            }
+            AT_MUX_Handler(idx, tx_handle, rx_handle, mode);
+        } else {
+            AT_Response_Send("ERROR\r\n");
+        }
+    }
+    else if (strcmp(cmd, "AT+MUXMODE") == 0) {
+        AT_MUXMODE_Handler();
+    }
+    else if (strcmp(cmd, "AT+MUXS") == 0) {
+        AT_MUXS_Handler();
+    }
+    else if (strncmp(cmd, "AT+COC=", 7) == 0) {
+        /* Parse: AT+COC=<idx>,<spsm>[,<mtu>] */
+        const char *p = &cmd[7];
+        uint8_t idx = ParseUInt8(p);
+        p = SkipToComma(p);
+        if (p != NULL && idx != 0xFFU) {
+            uint16_t spsm = ParseUInt16_Hex(p);
+            uint16_t mtu = 0;
+            p = SkipToComma(p);
+            if (p != NULL) {
+                mtu = ParseUInt16(p);
+            }
+            AT_COC_Handler(idx, spsm, mtu);
+        } else {
+            AT_Response_Send("ERROR\r\n");
+        }
+    }
+    else if (strncmp(cmd, "AT+COCDISC=", 11) == 0) {
+        AT_COCDISC_Handler(ParseUInt8(&cmd[11]));
+    }
+    else if (strncmp(cmd, "AT+COCMODE=", 11) == 0) {
+        AT_COCMODE_Handler(ParseUInt8(&cmd[11]));
+    }
+    else if (strcmp(cmd, "AT+COCS") == 0) {
+        AT_COCS_Handler();
+    }
+    else if (strncmp(cmd, "AT+TPUT=", 8) == 0) {
+        /* Parse: AT+TPUT=<idx>,<TX|RX|BOTH>,<seconds>[,<mode>[,<target>]] */
+        const char *p = &cmd[8];
+        const char *dir_p, *q;
+        uint8_t idx = ParseUInt8(p);
+        uint8_t dir = TPUT_DIR_INVALID;
+        uint16_t seconds = 0, target = 0;
+        uint8_t mode = DATA_TX_NORESP;
+        dir_p = SkipToComma(p);
+        q = SkipToComma(dir_p);
+        if (q != NULL) {
+            dir = (uint8_t)BLE_Tput_DirFromName(dir_p, (uint8_t)(q - dir_p - 1));
+            seconds = ParseUInt16(q);
+            q = SkipToComma(q);
+            if (q != NULL) {
+                mode = ParseUInt8(q);
+                q = SkipToComma(q);
+                if (q != NULL) {
+                    target = ParseUInt16_Hex(q);
+                }
+            }
+        }
+        if (idx != 0xFFU && dir != TPUT_DIR_INVALID) {
+            AT_TPUT_Handler(idx, dir, seconds, mode, target);
+        } else {
+            AT_Response_Send("ERROR\r\n");
+        }
+    }
+    else if (strcmp(cmd, "AT+TPUT") == 0) {
+        AT_TPUTS_Handler();
+    }
+    else if (strcmp(cmd, "AT+TPUTSTOP") == 0) {
+        AT_TPUTSTOP_Handler();
+    }
+    else if (strncmp(cmd, "AT+COMP=", 8) == 0) {
+        /* Parse: AT+COMP=<idx>,<up>,<down> */
+        const char *p = &cmd[8];
+        uint8_t idx = ParseUInt8(p);
+        const char *q = SkipToComma(p);
+        const char *r = SkipToComma(q);
+        if (r != NULL && idx != 0xFFU) {
+            AT_COMP_Handler(idx, ParseUInt8(q), ParseUInt8(r));
+        } else {
+            AT_Response_Send("ERROR\r\n");
+        }
+    }
+    else if (strcmp(cmd, "AT+COMPS") == 0) {
+        AT_COMPS_Handler();
+    }
     else if (strncmp(cmd, "AT+DATAMODE=", 12) == 0) {
         /* Parse: AT+DATAMODE=<dev_idx>,<char_handle> */
         const char *p = &cmd[12];
@@ -676,7 +932,7 @@ void AT_Command_Process(const char *cmd_line)
         if (p != NULL && idx != 0xFFU) {
             uint16_t handle = ParseUInt16(p);
             if (handle > 0) {
-                AT_DATAMODE_Handler(idx, handle);
+                AT_DATAMODE_Handler(idx, handle, 0, DATA_TX_NORESP);
             } else {
                 AT_Response_Send("ERROR\r\n");
             }
@@ -725,6 +981,228 @@ void AT_Command_Process(const char *cmd_line)
             AT_Response_Send("ERROR\r\n");
         }
     }
+    /* ============ GATT Flow Commands ============ */
+    else if (strncmp(cmd, "AT+FLOW=", 8) == 0) {
+        /* Parse: AT+FLOW=<idx>,<class> */
+        const char *p = &cmd[8];
+        uint8_t idx = ParseUInt8(p);
+        p = SkipToComma(p);
+        if (p != NULL && idx != 0xFFU && *p != '\0') {
+            AT_FLOW_Handler(idx, p);
+        } else {
+            AT_Response_Send("ERROR\r\n");
+        }
+    }
+    else if (strncmp(cmd, "AT+FLOWSTOP=", 12) == 0) {
+        uint8_t idx = ParseUInt8(&cmd[12]);
+        if (idx != 0xFFU) {
+            AT_FLOWSTOP_Handler(idx);
+        } else {
+            AT_Response_Send("ERROR\r\n");
+        }
+    }
+    else if (strcmp(cmd, "AT+FLOWS") == 0) {
+        AT_FLOWS_Handler();
+    }
+    /* ============ Profile Decoder Commands ============ */
+    else if (strncmp(cmd, "AT+DECODE=", 10) == 0) {
+        /* Parse: AT+DECODE=<idx>,<handle>,<decoder> */
+        const char *p = &cmd[10];
+        uint8_t idx = ParseUInt8(p);
+        p = SkipToComma(p);
+        if (p != NULL && idx != 0xFFU) {
+            uint16_t handle = ParseUInt16_Hex(p);
+            p = SkipToComma(p);
+            if (p != NULL && handle > 0) {
+                AT_DECODE_Handler(idx, handle, p);
+            } else {
+                AT_Response_Send("ERROR\r\n");
+            }
+        } else {
+            AT_Response_Send("ERROR\r\n");
+        }
+    }
+    else if (strcmp(cmd, "AT+DECODE") == 0) {
+        AT_DECODES_Handler();
+    }
+    /* ============ Group Commands ============ */
+    else if (strncmp(cmd, "AT+GROUP=", 9) == 0) {
+        /* Parse: AT+GROUP=<gid>,<spec> */
+        const char *p = &cmd[9];
+        uint8_t gid = ParseUInt8(p);
+        p = SkipToComma(p);
+        if (p != NULL && gid != 0xFFU) {
+            AT_GROUP_Handler(gid, p);
+        } else {
+            AT_Response_Send("ERROR\r\n");
+        }
+    }
+    else if (strcmp(cmd, "AT+GROUPS") == 0) {
+        AT_GROUPS_Handler();
+    }
+    else if (strncmp(cmd, "AT+GREAD=", 9) == 0) {
+        /* Parse: AT+GREAD=<gid>,<handle|Uuuid> */
+        const char *p = &cmd[9];
+        uint8_t gid = ParseUInt8(p);
+        uint8_t by_uuid;
+        uint16_t target;
+        p = SkipToComma(p);
+        if (p != NULL && gid != 0xFFU && ParseGattTarget(p, &by_uuid, &target) == 0) {
+            AT_GOP_Handler(gid, GATTQ_OP_READ, by_uuid, target, 0, NULL);
+        } else {
+            AT_Response_Send("ERROR\r\n");
+        }
+    }
+    else if (strncmp(cmd, "AT+GWRITE=", 10) == 0) {
+        /* Parse: AT+GWRITE=<gid>,<handle|Uuuid>,<hex_data> */
+        const char *p = &cmd[10];
+        uint8_t gid = ParseUInt8(p);
+        uint8_t by_uuid;
+        uint16_t target;
+        p = SkipToComma(p);
+        if (p != NULL && gid != 0xFFU && ParseGattTarget(p, &by_uuid, &target) == 0 &&
+            (p = SkipToComma(p)) != NULL) {
+            AT_GOP_Handler(gid, GATTQ_OP_WRITE, by_uuid, target, 0, p);
+        } else {
+            AT_Response_Send("ERROR\r\n");
+        }
+    }
+    else if (strncmp(cmd, "AT+GSUB=", 8) == 0) {
+        /* Parse: AT+GSUB=<gid>,<cccd|Uuuid>,<0|1|2> */
+        const char *p = &cmd[8];
+        uint8_t gid = ParseUInt8(p);
+        uint8_t by_uuid;
+        uint16_t target;
+        uint8_t mode = 0xFF;
+        p = SkipToComma(p);
+        if (p != NULL && gid != 0xFFU && ParseGattTarget(p, &by_uuid, &target) == 0 &&
+            (p = SkipToComma(p)) != NULL) {
+            mode = ParseUInt8(p);
+        }
+        if (mode <= 2U) {
+            AT_GOP_Handler(gid, GATTQ_OP_SUBSCRIBE, by_uuid, target, mode, NULL);
+        } else {
+            AT_Response_Send("ERROR\r\n");
+        }
+    }
+    /* ============ Poll Commands ============ */
+    else if (strncmp(cmd, "AT+POLL=", 8) == 0) {
+        /* Parse: AT+POLL=<idx>,<handle|Uuuid>,<period_ms> */
+        const char *p = &cmd[8];
+        uint8_t dev_idx = ParseUInt8(p);
+        uint8_t by_uuid;
+        uint16_t target;
+        p = SkipToComma(p);
+        if (p != NULL && dev_idx != 0xFFU && ParseGattTarget(p, &by_uuid, &target) == 0 &&
+            (p = SkipToComma(p)) != NULL && *p >= '0' && *p <= '9') {
+            AT_POLL_Handler(dev_idx, by_uuid, target, ParseUInt32(p));
+        } else {
+            AT_Response_Send("ERROR\r\n");
+        }
+    }
+    else if (strcmp(cmd, "AT+POLLS") == 0) {
+        AT_POLLS_Handler();
+    }
+    else if (strcmp(cmd, "AT+POLLCLR") == 0) {
+        AT_POLLCLR_Handler();
+    }
+    /* ============ Rule Commands ============ */
+    else if (strncmp(cmd, "AT+RULE=", 8) == 0) {
+        /* Parse: AT+RULE=<idx>,<handle>,<off>:<field>,<cond>:<value>[,<ms>[,<dst>,<dst_handle>,<hex>]] */
+        const char *p = &cmd[8];
+        uint8_t dev_idx = ParseUInt8(p);
+        uint16_t handle = 0;
+        p = SkipToComma(p);
+        if (p != NULL) {
+            handle = ParseUInt16_Hex(p);
+            p = SkipToComma(p);
+        }
+        if (p != NULL && dev_idx != 0xFFU && handle != 0) {
+            AT_RULE_Handler(dev_idx, handle, p);
+        } else {
+            AT_Response_Send("ERROR\r\n");
+        }
+    }
+    else if (strncmp(cmd, "AT+RULEDEL=", 11) == 0) {
+        /* Parse: AT+RULEDEL=<idx>,<handle> */
+        const char *p = &cmd[11];
+        uint8_t dev_idx = ParseUInt8(p);
+        p = SkipToComma(p);
+        if (p != NULL && dev_idx != 0xFFU) {
+            AT_RULEDEL_Handler(dev_idx, ParseUInt16_Hex(p));
+        } else {
+            AT_Response_Send("ERROR\r\n");
+        }
+    }
+    else if (strcmp(cmd, "AT+RULES") == 0) {
+        AT_RULES_Handler();
+    }
+    /* ============ Aggregation Commands ============ */
+    else if (strncmp(cmd, "AT+AGG=", 7) == 0) {
+        /* Parse: AT+AGG=<idx>,<handle>,<samples>,<ms>,<layout> */
+        const char *p = &cmd[7];
+        uint8_t dev_idx = ParseUInt8(p);
+        uint16_t handle = 0, samples = 0, ms = 0;
+        if ((p = SkipToComma(p)) != NULL) {
+            handle = ParseUInt16_Hex(p);
+        }
+        if (p != NULL && (p = SkipToComma(p)) != NULL) {
+            samples = ParseUInt16(p);
+        }
+        if (p != NULL && (p = SkipToComma(p)) != NULL) {
+            ms = ParseUInt16(p);
+            p = SkipToComma(p);
+        }
+        if (p != NULL && dev_idx != 0xFFU && handle != 0) {
+            AT_AGG_Handler(dev_idx, handle, samples, ms, p);
+        } else {
+            AT_Response_Send("ERROR\r\n");
+        }
+    }
+    else if (strncmp(cmd, "AT+AGGDEL=", 10) == 0) {
+        /* Parse: AT+AGGDEL=<idx>,<handle> */
+        const char *p = &cmd[10];
+        uint8_t dev_idx = ParseUInt8(p);
+        p = SkipToComma(p);
+        if (p != NULL && dev_idx != 0xFFU) {
+            AT_AGGDEL_Handler(dev_idx, ParseUInt16_Hex(p));
+        } else {
+            AT_Response_Send("ERROR\r\n");
+        }
+    }
+    else if (strcmp(cmd, "AT+AGGS") == 0) {
+        AT_AGGS_Handler();
+    }
+    /* ============ Anomaly Commands ============ */
+    else if (strncmp(cmd, "AT+ANOM=", 8) == 0) {
+        /* Parse: AT+ANOM=<idx>,<handle>,<off>:<field>[/<stride>],<in_shift>,<threshold> */
+        const char *p = &cmd[8];
+        uint8_t dev_idx = ParseUInt8(p);
+        uint16_t handle = 0;
+        if ((p = SkipToComma(p)) != NULL) {
+            handle = ParseUInt16_Hex(p);
+            p = SkipToComma(p);
+        }
+        if (p != NULL && dev_idx != 0xFFU && handle != 0) {
+            AT_ANOM_Handler(dev_idx, handle, p);
+        } else {
+            AT_Response_Send("ERROR\r\n");
+        }
+    }
+    else if (strncmp(cmd, "AT+ANOMDEL=", 11) == 0) {
+        /* Parse: AT+ANOMDEL=<idx>,<handle> */
+        const char *p = &cmd[11];
+        uint8_t dev_idx = ParseUInt8(p);
+        p = SkipToComma(p);
+        if (p != NULL && dev_idx != 0xFFU) {
+            AT_ANOMDEL_Handler(dev_idx, ParseUInt16_Hex(p));
+        } else {
+            AT_Response_Send("ERROR\r\n");
+        }
+    }
+    else if (strcmp(cmd, "AT+ANOMS") == 0) {
+        AT_ANOMS_Handler();
+    }
     else {
         /* Unknown AT command - log but don't spam ERROR */
         DEBUG_WARN("Unknown AT cmd: %s", cmd);
@@ -1005,7 +1483,7 @@ int AT_RESET_Handler(void)
     HAL_Delay(100);
     Module_System_SoftwareReset();
     
-    /* Never returns */
+    /* Returns only if the reset waits for the Flash writer */
     return 0;
 }
 
@@ -1031,7 +1509,7 @@ int AT_FACTORY_Handler(void)
     HAL_Delay(100);
     Module_System_FactoryReset();
     
-    /* Never returns */
+    /* Returns only if the reset waits for the Flash writer */
     return 0;
 }
 
@@ -1149,44 +1627,355 @@ int AT_SAVE_Handler(void)
     }
 }
 
-// ==================== Mode Handlers ====================
+int AT_KVS_Handler(void)
+{
+    DEBUG_INFO("AT+KVS");
+    
+    Module_KV_Report();
+    Module_Flash_Report();
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
 
-int AT_CMDMODE_Handler(void)
+int AT_EVLOG_Handler(uint8_t mode, uint16_t timeout_s)
 {
-    DEBUG_INFO("AT+CMDMODE");
+    DEBUG_INFO("AT+EVLOG=%d,%d", mode, timeout_s);
     
-    if (Module_Mode_EnterCommand() == 0) {
-        AT_Response_Send("OK\r\n");
-        return 0;
-    } else {
+    if (Module_EvLog_Config((EvLog_Mode_t)mode, timeout_s) != 0) {
         AT_Response_Send("ERROR\r\n");
         return -1;
     }
+    
+    AT_Response_Send("OK\r\n");
+    return 0;
 }
 
-int AT_DATAMODE_Handler(uint8_t dev_idx, uint16_t char_handle)
+int AT_EVLOGS_Handler(void)
 {
-    DEBUG_INFO("AT+DATAMODE: dev=%d, handle=0x%04X", dev_idx, char_handle);
+    DEBUG_INFO("AT+EVLOG");
     
-    if (Module_Mode_EnterData(dev_idx, char_handle) == 0) {
-        AT_Response_Send("OK\r\n");
-        return 0;
-    } else {
-        AT_Response_Send("+ERROR:NOT_CONNECTED\r\n");
+    Module_EvLog_Report();
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_REPLAY_Handler(uint32_t from_seq)
+{
+    int count;
+    
+    DEBUG_INFO("AT+REPLAY=%lu", from_seq);
+    
+    count = Module_EvLog_Replay(from_seq);
+    if (count < 0) {
+        AT_Response_Send("ERROR\r\n");
         return -1;
     }
+    
+    /* Events follow as +EVT lines, then +REPLAYEND */
+    AT_Response_Send("+REPLAY:%d\r\n", count);
+    AT_Response_Send("OK\r\n");
+    return 0;
 }
 
-// ==================== Status Handlers ====================
-
-int AT_STATUS_Handler(uint8_t dev_idx)
+int AT_CRCB_Handler(uint16_t len)
 {
-    uint8_t i, count;
-    BLE_Device_t *dev;
-    
-    DEBUG_INFO("AT+STATUS: idx=%d", dev_idx);
+    DEBUG_INFO("AT+CRCB=%d", len);
     
-    if (dev_idx == 0xFF) {
+    if (Module_Crc_Benchmark(len) != 0) {
+        AT_Response_Send("ERROR\r\n");
+        return -1;
+    }
+    
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_LOG_Handler(void)
+{
+    DEBUG_INFO("AT+LOG");
+    
+    DEBUG_Report();
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_PROF_Handler(void)
+{
+    DEBUG_INFO("AT+PROF");
+    
+    Module_Prof_Report();
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_PROFCLR_Handler(void)
+{
+    DEBUG_INFO("AT+PROFCLR");
+    
+    Module_Prof_Reset();
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_HCIQ_Handler(void)
+{
+    DEBUG_INFO("AT+HCIQ");
+    
+    BLE_HciQueue_Report();
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_HCIQCLR_Handler(void)
+{
+    DEBUG_INFO("AT+HCIQCLR");
+    
+    BLE_HciQueue_Reset();
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_HCIEVT_Handler(void)
+{
+    DEBUG_INFO("AT+HCIEVT");
+    
+    BLE_HciMon_Report();
+    BLE_Connection_ReportScanQueue();
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_HCIEVTCLR_Handler(void)
+{
+    DEBUG_INFO("AT+HCIEVTCLR");
+    
+    BLE_HciMon_Reset();
+    BLE_Connection_ResetScanQueue();
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+// ==================== Mode Handlers ====================
+
+int AT_CMDMODE_Handler(void)
+{
+    DEBUG_INFO("AT+CMDMODE");
+    
+    if (Module_Mode_EnterCommand() == 0) {
+        AT_Response_Send("OK\r\n");
+        return 0;
+    } else {
+        AT_Response_Send("ERROR\r\n");
+        return -1;
+    }
+}
+
+int AT_DATAMODE_Handler(uint8_t dev_idx, uint16_t char_handle, uint16_t rx_handle,
+                        uint8_t tx_mode)
+{
+    DEBUG_INFO("AT+DATAMODE: dev=%d, handle=0x%04X, rx=0x%04X, mode=%d",
+               dev_idx, char_handle, rx_handle, tx_mode);
+    
+    if (Module_Mode_EnterData(dev_idx, char_handle, rx_handle, (Data_TxMode_t)tx_mode) == 0) {
+        AT_Response_Send("OK\r\n");
+        return 0;
+    } else {
+        AT_Response_Send("+ERROR:NOT_CONNECTED\r\n");
+        return -1;
+    }
+}
+
+int AT_DATASTAT_Handler(void)
+{
+    DEBUG_INFO("AT+DATASTAT");
+    
+    Module_Mode_ReportStats();
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_DATAFLUSH_Handler(uint8_t set, uint16_t max_bytes, uint16_t latency_ms,
+                         uint16_t idle_ms, uint8_t nagle)
+{
+    Data_FlushPolicy_t policy;
+    const Data_FlushPolicy_t *cur;
+    
+    DEBUG_INFO("AT+DATAFLUSH");
+    
+    if (set) {
+        policy.max_bytes = max_bytes;
+        policy.latency_ms = latency_ms;
+        policy.idle_ms = idle_ms;
+        policy.nagle = nagle;
+        if (Module_Mode_SetFlushPolicy(&policy) != 0) {
+            AT_Response_Send("ERROR\r\n");
+            return -1;
+        }
+    }
+    
+    cur = Module_Mode_GetFlushPolicy();
+    AT_Response_Send("+DATAFLUSH:%u,%u,%u,%u\r\n", cur->max_bytes, cur->latency_ms,
+                     cur->idle_ms, cur->nagle);
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_MUX_Handler(uint8_t link, uint16_t tx_handle, uint16_t rx_handle, uint8_t tx_mode)
+{
+    DEBUG_INFO("AT+MUX: link=%d, tx=0x%04X, rx=0x%04X, mode=%d", link, tx_handle, rx_handle, tx_mode);
+    
+    if (Module_Mux_Bind(link, tx_handle, rx_handle, (Data_TxMode_t)tx_mode) == 0) {
+        AT_Response_Send("OK\r\n");
+        return 0;
+    } else {
+        AT_Response_Send("ERROR\r\n");
+        return -1;
+    }
+}
+
+int AT_MUXMODE_Handler(void)
+{
+    DEBUG_INFO("AT+MUXMODE");
+    
+    if (Module_Mode_EnterMux() == 0) {
+        AT_Response_Send("OK\r\n");
+        return 0;
+    } else {
+        AT_Response_Send("ERROR\r\n");
+        return -1;
+    }
+}
+
+int AT_MUXS_Handler(void)
+{
+    DEBUG_INFO("AT+MUXS");
+    
+    Module_Mux_Report();
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_COC_Handler(uint8_t dev_idx, uint16_t spsm, uint16_t mtu)
+{
+    int ch;
+    
+    DEBUG_INFO("AT+COC: dev=%d, spsm=0x%02X, mtu=%d", dev_idx, spsm, mtu);
+    
+    ch = BLE_L2cap_Connect(dev_idx, spsm, mtu);
+    if (ch < 0) {
+        AT_Response_Send("ERROR\r\n");
+        return -1;
+    }
+    
+    AT_Response_Send("+COC:%d\r\n", ch);
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_COCDISC_Handler(uint8_t ch)
+{
+    DEBUG_INFO("AT+COCDISC: ch=%d", ch);
+    
+    if (BLE_L2cap_Disconnect(ch) == 0) {
+        AT_Response_Send("OK\r\n");
+        return 0;
+    } else {
+        AT_Response_Send("+ERROR:NOT_FOUND\r\n");
+        return -1;
+    }
+}
+
+int AT_COCMODE_Handler(uint8_t ch)
+{
+    DEBUG_INFO("AT+COCMODE: ch=%d", ch);
+    
+    if (Module_Mode_EnterCoc(ch) == 0) {
+        AT_Response_Send("OK\r\n");
+        return 0;
+    } else {
+        AT_Response_Send("+ERROR:NOT_FOUND\r\n");
+        return -1;
+    }
+}
+
+int AT_COCS_Handler(void)
+{
+    DEBUG_INFO("AT+COCS");
+    
+    BLE_L2cap_Report();
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_TPUT_Handler(uint8_t dev_idx, uint8_t dir, uint16_t seconds, uint8_t mode,
+                    uint16_t target)
+{
+    DEBUG_INFO("AT+TPUT: dev=%d, dir=%d, %us, mode=%d, target=0x%04X", dev_idx, dir,
+               seconds, mode, target);
+    
+    if (BLE_Tput_Start(dev_idx, (BLE_TputDir_t)dir, seconds, mode, target) == 0) {
+        AT_Response_Send("OK\r\n");
+        return 0;
+    } else {
+        AT_Response_Send("ERROR\r\n");
+        return -1;
+    }
+}
+
+int AT_TPUTS_Handler(void)
+{
+    DEBUG_INFO("AT+TPUT");
+    
+    BLE_Tput_Report();
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_TPUTSTOP_Handler(void)
+{
+    DEBUG_INFO("AT+TPUTSTOP");
+    
+    if (BLE_Tput_Stop() == 0) {
+        AT_Response_Send("OK\r\n");
+        return 0;
+    } else {
+        AT_Response_Send("ERROR\r\n");
+        return -1;
+    }
+}
+
+int AT_COMP_Handler(uint8_t dev_idx, uint8_t up, uint8_t down)
+{
+    DEBUG_INFO("AT+COMP: dev=%d, up=%d, down=%d", dev_idx, up, down);
+    
+    if (Module_Compress_Set(dev_idx, up, down) == 0) {
+        AT_Response_Send("OK\r\n");
+        return 0;
+    } else {
+        AT_Response_Send("ERROR\r\n");
+        return -1;
+    }
+}
+
+int AT_COMPS_Handler(void)
+{
+    DEBUG_INFO("AT+COMPS");
+    
+    Module_Compress_Report();
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+// ==================== Status Handlers ====================
+
+int AT_STATUS_Handler(uint8_t dev_idx)
+{
+    uint8_t i, count;
+    BLE_Device_t *dev;
+    
+    DEBUG_INFO("AT+STATUS: idx=%d", dev_idx);
+    
+    if (dev_idx == 0xFF) {
         /* Report all devices */
         count = BLE_DeviceManager_GetCount();
         AT_Response_Send("+STATUS:%d devices\r\n", (int)count);
@@ -1286,3 +2075,439 @@ int AT_DIAG_Handler(uint8_t dev_idx)
     AT_Response_Send("OK\r\n");
     return 0;
 }
+
+// ==================== GATT Flow Handlers ====================
+
+int AT_FLOW_Handler(uint8_t dev_idx, const char *class_name)
+{
+    DEBUG_INFO("AT+FLOW: dev=%d, class=%s", dev_idx, class_name);
+    
+    if (BLE_DeviceManager_GetDevice(dev_idx) == NULL) {
+        AT_Response_Send("+ERROR:NOT_FOUND\r\n");
+        return -1;
+    }
+    
+    if (BLE_Flow_IsActive(dev_idx)) {
+        AT_Response_Send("+ERROR:BUSY\r\n");
+        return -1;
+    }
+    
+    if (BLE_Flow_Start(dev_idx, class_name) != 0) {
+        AT_Response_Send("ERROR\r\n");
+        return -1;
+    }
+    
+    /* OK sent immediately, +FLOW_DONE / +FLOW_ERROR will follow */
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_FLOWSTOP_Handler(uint8_t dev_idx)
+{
+    DEBUG_INFO("AT+FLOWSTOP: dev=%d", dev_idx);
+    
+    if (BLE_Flow_Stop(dev_idx) != 0) {
+        AT_Response_Send("ERROR\r\n");
+        return -1;
+    }
+    
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_FLOWS_Handler(void)
+{
+    const BLE_FlowClass_t *cls;
+    uint8_t i;
+    
+    DEBUG_INFO("AT+FLOWS");
+    
+    for (i = 0; (cls = BLE_Flow_GetClass(i)) != NULL; i++) {
+        AT_Response_Send("+FLOWCLASS:%s\r\n", cls->name);
+    }
+    BLE_Flow_ReportStatus();
+    
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+// ==================== Profile Decoder Handlers ====================
+
+int AT_DECODE_Handler(uint8_t dev_idx, uint16_t value_handle, const char *name)
+{
+    BLE_Device_t *dev;
+    BLE_DecoderType_t type;
+    
+    dev = BLE_DeviceManager_GetDevice(dev_idx);
+    if (dev == NULL || !dev->is_connected) {
+        AT_Response_Send("+ERROR:NOT_CONNECTED\r\n");
+        return -1;
+    }
+    
+    type = BLE_Decoder_FromName(name);
+    if (type == DECODER_COUNT) {
+        AT_Response_Send("ERROR\r\n");
+        return -1;
+    }
+    
+    DEBUG_INFO("AT+DECODE: dev=%d, handle=0x%04X, decoder=%s", dev_idx, value_handle, name);
+    
+    if (BLE_Decoder_Bind(dev->conn_handle, value_handle, type) != 0) {
+        AT_Response_Send("ERROR\r\n");
+        return -1;
+    }
+    
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_DECODES_Handler(void)
+{
+    DEBUG_INFO("AT+DECODE");
+    
+    BLE_Decoder_ReportBindings();
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+// ==================== Group Handlers ====================
+
+int AT_GROUP_Handler(uint8_t gid, const char *spec)
+{
+    DEBUG_INFO("AT+GROUP: gid=%d, spec=%s", gid, spec);
+    
+    if (BLE_Group_Define(gid, spec) != 0) {
+        AT_Response_Send("ERROR\r\n");
+        return -1;
+    }
+    
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_GROUPS_Handler(void)
+{
+    DEBUG_INFO("AT+GROUPS");
+    
+    BLE_Group_Report();
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_GOP_Handler(uint8_t gid, uint8_t op_type, uint8_t by_uuid, uint16_t target,
+                   uint8_t arg, const char *data)
+{
+    uint8_t write_buf[BLE_GROUP_MAX_DATA];
+    int data_len = 0;
+    int queued;
+    
+    DEBUG_INFO("AT+G op %d: gid=%d, target=%s0x%04X", op_type, gid, by_uuid ? "U" : "", target);
+    
+    if (BLE_Group_IsBusy()) {
+        AT_Response_Send("+ERROR:BUSY\r\n");
+        return -1;
+    }
+    
+    if (op_type == GATTQ_OP_WRITE) {
+        if (data == NULL || data[0] == '\0') {
+            AT_Response_Send("+ERROR:NO_DATA\r\n");
+            return -1;
+        }
+        data_len = ParseHexString(data, write_buf, BLE_GROUP_MAX_DATA);
+        if (data_len <= 0) {
+            AT_Response_Send("+ERROR:INVALID_HEX\r\n");
+            return -1;
+        }
+    }
+    
+    if (BLE_Group_Resolve(gid) == 0) {
+        AT_Response_Send("+ERROR:NOT_CONNECTED\r\n");
+        return -1;
+    }
+    
+    queued = BLE_Group_Run(gid, (BLE_GattQueueOpType_t)op_type, by_uuid, target, arg,
+                           write_buf, (uint16_t)data_len);
+    if (queued < 0) {
+        AT_Response_Send("ERROR\r\n");
+        return -1;
+    }
+    
+    /* OK sent immediately, +GDONE follows once every link completed */
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+// ==================== Poll Handlers ====================
+
+int AT_POLL_Handler(uint8_t dev_idx, uint8_t by_uuid, uint16_t target, uint32_t period_ms)
+{
+    int id;
+    
+    DEBUG_INFO("AT+POLL: idx=%d, target=%s0x%04X, period=%lu", dev_idx,
+               by_uuid ? "U" : "", target, period_ms);
+    
+    if (BLE_DeviceManager_GetDevice(dev_idx) == NULL) {
+        AT_Response_Send("+ERROR:NOT_FOUND\r\n");
+        return -1;
+    }
+    
+    id = BLE_Poll_Set(dev_idx, by_uuid, target, period_ms);
+    if (id < 0) {
+        AT_Response_Send("ERROR\r\n");
+        return -1;
+    }
+    
+    AT_Response_Send("+POLLID:%d\r\n", id);
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_POLLS_Handler(void)
+{
+    DEBUG_INFO("AT+POLLS");
+    
+    BLE_Poll_Report();
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_POLLCLR_Handler(void)
+{
+    DEBUG_INFO("AT+POLLCLR");
+    
+    BLE_Poll_Clear();
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+// ==================== Rule Handlers ====================
+
+int AT_RULE_Handler(uint8_t dev_idx, uint16_t handle, const char *spec)
+{
+    BLE_RuleDef_t def;
+    const char *sep;
+    const char *p = spec;
+    char *end;
+    int data_len;
+    
+    DEBUG_INFO("AT+RULE: idx=%d, handle=0x%04X, spec=%s", dev_idx, handle, spec);
+    
+    if (BLE_DeviceManager_GetDevice(dev_idx) == NULL) {
+        AT_Response_Send("+ERROR:NOT_FOUND\r\n");
+        return -1;
+    }
+    
+    memset(&def, 0, sizeof(def));
+    def.dev_idx = dev_idx;
+    def.handle = handle;
+    def.dst_idx = 0xFF;
+    
+    /* <offset>:<field> */
+    def.offset = (uint8_t)strtoul(p, &end, 10);
+    if (end == p || *end != ':') {
+        AT_Response_Send("ERROR\r\n");
+        return -1;
+    }
+    p = end + 1;
+    sep = strchr(p, ',');
+    if (sep == NULL) {
+        AT_Response_Send("ERROR\r\n");
+        return -1;
+    }
+    def.field = (uint8_t)BLE_Rules_FieldFromName(p, (uint8_t)(sep - p));
+    
+    /* <cond>[:<value>] */
+    p = sep + 1;
+    sep = p;
+    while (*sep != '\0' && *sep != ':' && *sep != ',') {
+        sep++;
+    }
+    def.cond = (uint8_t)BLE_Rules_CondFromName(p, (uint8_t)(sep - p));
+    if (*sep == ':') {
+        def.threshold = (int32_t)strtol(sep + 1, NULL, 10);
+    }
+    
+    /* [,<interval_ms>[,<dst_idx>,<dst_handle>,<hex>]] */
+    p = SkipToComma(sep);
+    if (p != NULL) {
+        def.interval_ms = ParseUInt16(p);
+        p = SkipToComma(p);
+    }
+    if (p != NULL) {
+        def.dst_idx = ParseUInt8(p);
+        p = SkipToComma(p);
+        if (p == NULL || BLE_DeviceManager_GetDevice(def.dst_idx) == NULL) {
+            AT_Response_Send("ERROR\r\n");
+            return -1;
+        }
+        def.dst_handle = ParseUInt16_Hex(p);
+        p = SkipToComma(p);
+        data_len = (p != NULL) ? ParseHexString(p, def.dst_data, BLE_RULES_MAX_DATA) : -1;
+        if (data_len <= 0) {
+            AT_Response_Send("+ERROR:INVALID_HEX\r\n");
+            return -1;
+        }
+        def.dst_len = (uint8_t)data_len;
+    }
+    
+    if (BLE_Rules_Set(&def) != 0) {
+        AT_Response_Send("ERROR\r\n");
+        return -1;
+    }
+    
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_RULEDEL_Handler(uint8_t dev_idx, uint16_t handle)
+{
+    DEBUG_INFO("AT+RULEDEL: idx=%d, handle=0x%04X", dev_idx, handle);
+    
+    if (BLE_Rules_Delete(dev_idx, handle) != 0) {
+        AT_Response_Send("+ERROR:NOT_FOUND\r\n");
+        return -1;
+    }
+    
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_RULES_Handler(void)
+{
+    DEBUG_INFO("AT+RULES");
+    
+    BLE_Rules_Report();
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+// ==================== Aggregation Handlers ====================
+
+int AT_AGG_Handler(uint8_t dev_idx, uint16_t handle, uint16_t samples, uint16_t window_ms,
+                   const char *layout)
+{
+    BLE_AggDef_t def;
+    
+    DEBUG_INFO("AT+AGG: idx=%d, handle=0x%04X, N=%d, T=%d, layout=%s", dev_idx, handle,
+               samples, window_ms, layout);
+    
+    if (BLE_DeviceManager_GetDevice(dev_idx) == NULL) {
+        AT_Response_Send("+ERROR:NOT_FOUND\r\n");
+        return -1;
+    }
+    
+    memset(&def, 0, sizeof(def));
+    def.dev_idx = dev_idx;
+    def.handle = handle;
+    def.window_samples = samples;
+    def.window_ms = window_ms;
+    
+    if (BLE_Agg_ParseLayout(layout, &def) != 0 || BLE_Agg_Set(&def) != 0) {
+        AT_Response_Send("ERROR\r\n");
+        return -1;
+    }
+    
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_AGGDEL_Handler(uint8_t dev_idx, uint16_t handle)
+{
+    DEBUG_INFO("AT+AGGDEL: idx=%d, handle=0x%04X", dev_idx, handle);
+    
+    if (BLE_Agg_Delete(dev_idx, handle) != 0) {
+        AT_Response_Send("+ERROR:NOT_FOUND\r\n");
+        return -1;
+    }
+    
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_AGGS_Handler(void)
+{
+    DEBUG_INFO("AT+AGGS");
+    
+    BLE_Agg_Report();
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+// ==================== Anomaly Handlers ====================
+
+int AT_ANOM_Handler(uint8_t dev_idx, uint16_t handle, const char *spec)
+{
+    BLE_AnomalyDef_t def;
+    const char *p = spec;
+    const char *name;
+    char *end;
+    
+    DEBUG_INFO("AT+ANOM: idx=%d, handle=0x%04X, spec=%s", dev_idx, handle, spec);
+    
+    if (BLE_DeviceManager_GetDevice(dev_idx) == NULL) {
+        AT_Response_Send("+ERROR:NOT_FOUND\r\n");
+        return -1;
+    }
+    
+    memset(&def, 0, sizeof(def));
+    def.dev_idx = dev_idx;
+    def.handle = handle;
+    
+    /* <offset>:<field>[/<stride>] */
+    def.offset = (uint8_t)strtoul(p, &end, 10);
+    if (end == p || *end != ':') {
+        AT_Response_Send("ERROR\r\n");
+        return -1;
+    }
+    name = end + 1;
+    p = name;
+    while (*p != '\0' && *p != '/' && *p != ',') {
+        p++;
+    }
+    def.field = (uint8_t)BLE_Rules_FieldFromName(name, (uint8_t)(p - name));
+    if (*p == '/') {
+        def.stride = (uint8_t)strtoul(p + 1, NULL, 10);
+    }
+    
+    /* <in_shift>,<threshold> */
+    p = SkipToComma(p);
+    if (p != NULL) {
+        def.in_shift = ParseUInt8(p);
+        p = SkipToComma(p);
+    }
+    if (p == NULL) {
+        AT_Response_Send("ERROR\r\n");
+        return -1;
+    }
+    def.threshold = ParseUInt8(p);
+    
+    if (BLE_Anomaly_Set(&def) != 0) {
+        AT_Response_Send("ERROR\r\n");
+        return -1;
+    }
+    
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_ANOMDEL_Handler(uint8_t dev_idx, uint16_t handle)
+{
+    DEBUG_INFO("AT+ANOMDEL: idx=%d, handle=0x%04X", dev_idx, handle);
+    
+    if (BLE_Anomaly_Delete(dev_idx, handle) != 0) {
+        AT_Response_Send("+ERROR:NOT_FOUND\r\n");
+        return -1;
+    }
+    
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
+
+int AT_ANOMS_Handler(void)
+{
+    DEBUG_INFO("AT+ANOMS");
+    
+    BLE_Anomaly_Report();
+    AT_Response_Send("OK\r\n");
+    return 0;
+}
@@ -0,0 +1,298 @@
+/**
+  ******************************************************************************
+  * @file    ble_aggregate.c
+  * @brief   Windowed statistics implementation
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#define DEBUG_MODULE DEBUG_MOD_DATA
+
+#include "ble_aggregate.h"
+#include "ble_rules.h"
+#include "ble_device_manager.h"
+#include "at_command.h"
+#include "debug_trace.h"
+#include "main.h"
+#include "arm_math.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*============================================================================
+ * State
+ *============================================================================*/
+typedef struct {
+    BLE_AggDef_t def;
+    uint8_t active;
+    uint16_t count;                 /* Samples in current window */
+    uint32_t window_start;
+    uint32_t windows;
+    uint32_t samples;
+    uint32_t malformed;
+} AggStream_t;
+
+static AggStream_t streams[BLE_AGG_MAX_STREAMS];
+static float32_t agg_buf[BLE_AGG_MAX_STREAMS][BLE_AGG_MAX_CHANNELS][BLE_AGG_MAX_SAMPLES];
+
+/*============================================================================
+ * Static Helper Functions
+ *============================================================================*/
+
+static int Agg_Find(uint8_t dev_idx, uint16_t handle)
+{
+    uint8_t i;
+
+    for (i = 0; i < BLE_AGG_MAX_STREAMS; i++) {
+        if (streams[i].active && streams[i].def.dev_idx == dev_idx &&
+            streams[i].def.handle == handle) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Format float as fixed-point "x.yy" (no printf float support)
+ */
+static int Agg_FormatCenti(char *buf, size_t size, float32_t v)
+{
+    float32_t scaled = v * 100.0f;
+    int32_t centi;
+
+    if (scaled > 2147483000.0f) {
+        scaled = 2147483000.0f;
+    } else if (scaled < -2147483000.0f) {
+        scaled = -2147483000.0f;
+    }
+    centi = (int32_t)((scaled >= 0.0f) ? (scaled + 0.5f) : (scaled - 0.5f));
+
+    return snprintf(buf, size, "%s%ld.%02ld", (centi < 0) ? "-" : "",
+                    labs((long)centi) / 100L, labs((long)centi) % 100L);
+}
+
+/**
+ * @brief Reduce the window of each channel and emit one record per channel
+ */
+static void Agg_Emit(uint8_t s)
+{
+    AggStream_t *st = &streams[s];
+    char line[AT_CMD_MAX_LEN];
+    float32_t vmin, vmax, mean, rms, var;
+    uint32_t idx;
+    uint8_t ch;
+    int n;
+
+    if (st->count == 0) {
+        return;
+    }
+
+    for (ch = 0; ch < st->def.channels; ch++) {
+        const float32_t *buf = agg_buf[s][ch];
+
+        arm_min_f32(buf, st->count, &vmin, &idx);
+        arm_max_f32(buf, st->count, &vmax, &idx);
+        arm_mean_f32(buf, st->count, &mean);
+        arm_rms_f32(buf, st->count, &rms);
+        arm_var_f32(buf, st->count, &var);
+
+        n = snprintf(line, sizeof(line), "+AGG:%d,0x%04X,%d,%d,", st->def.dev_idx,
+                     st->def.handle, ch, st->count);
+        n += Agg_FormatCenti(&line[n], sizeof(line) - (size_t)n, vmin);
+        line[n++] = ',';
+        n += Agg_FormatCenti(&line[n], sizeof(line) - (size_t)n, vmax);
+        line[n++] = ',';
+        n += Agg_FormatCenti(&line[n], sizeof(line) - (size_t)n, mean);
+        line[n++] = ',';
+        n += Agg_FormatCenti(&line[n], sizeof(line) - (size_t)n, rms);
+        line[n++] = ',';
+        Agg_FormatCenti(&line[n], sizeof(line) - (size_t)n, var);
+        AT_Response_Send("%s\r\n", line);
+    }
+
+    st->windows++;
+    st->count = 0;
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+void BLE_Agg_Init(void)
+{
+    memset(streams, 0, sizeof(streams));
+    DEBUG_INFO("Aggregation initialized");
+}
+
+int BLE_Agg_Set(const BLE_AggDef_t *def)
+{
+    int slot;
+    uint8_t i;
+
+    if (def == NULL || def->handle == 0 || def->channels == 0 ||
+        def->channels > BLE_AGG_MAX_CHANNELS || def->window_samples > BLE_AGG_MAX_SAMPLES ||
+        (def->window_samples == 0 && def->window_ms == 0)) {
+        return -1;
+    }
+
+    for (i = 0; i < def->channels; i++) {
+        if (def->field[i] >= RULE_FIELD_COUNT) {
+            return -1;
+        }
+    }
+
+    slot = Agg_Find(def->dev_idx, def->handle);
+    if (slot < 0) {
+        for (i = 0; i < BLE_AGG_MAX_STREAMS; i++) {
+            if (!streams[i].active) {
+                slot = i;
+                break;
+            }
+        }
+    }
+    if (slot < 0) {
+        return -1;
+    }
+
+    memset(&streams[slot], 0, sizeof(streams[slot]));
+    streams[slot].def = *def;
+    streams[slot].active = 1;
+
+    DEBUG_INFO("Agg %d: dev=%d handle=0x%04X ch=%d N=%d T=%d", slot, def->dev_idx,
+               def->handle, def->channels, def->window_samples, def->window_ms);
+    return 0;
+}
+
+int BLE_Agg_Delete(uint8_t dev_idx, uint16_t handle)
+{
+    int slot = Agg_Find(dev_idx, handle);
+
+    if (slot < 0) {
+        return -1;
+    }
+
+    streams[slot].active = 0;
+    return 0;
+}
+
+int BLE_Agg_ParseLayout(const char *layout, BLE_AggDef_t *def)
+{
+    const char *p = layout;
+    const char *name;
+    char *end;
+    unsigned long val;
+
+    def->channels = 0;
+    def->stride = 0;
+
+    while (*p != '\0' && *p != '/') {
+        if (def->channels >= BLE_AGG_MAX_CHANNELS) {
+            return -1;
+        }
+
+        val = strtoul(p, &end, 10);
+        if (end == p || *end != ':' || val > 0xFFUL) {
+            return -1;
+        }
+        name = end + 1;
+        p = name;
+        while (*p != '\0' && *p != ';' && *p != '/') {
+            p++;
+        }
+
+        def->offset[def->channels] = (uint8_t)val;
+        def->field[def->channels] = (uint8_t)BLE_Rules_FieldFromName(name, (uint8_t)(p - name));
+        if (def->field[def->channels] >= RULE_FIELD_COUNT) {
+            return -1;
+        }
+        def->channels++;
+
+        if (*p == ';') {
+            p++;
+        }
+    }
+
+    if (*p == '/') {
+        val = strtoul(p + 1, &end, 10);
+        if (end == p + 1 || *end != '\0' || val == 0 || val > 0xFFUL) {
+            return -1;
+        }
+        def->stride = (uint8_t)val;
+    }
+
+    return (def->channels > 0) ? 0 : -1;
+}
+
+uint8_t BLE_Agg_Process(uint16_t conn_handle, uint16_t handle,
+                        const uint8_t *data, uint16_t len)
+{
+    AggStream_t *st;
+    uint16_t pos, step;
+    uint32_t now;
+    int32_t v;
+    int dev_idx, s;
+    uint8_t ch;
+
+    dev_idx = BLE_DeviceManager_FindConnHandle(conn_handle);
+    if (dev_idx < 0) {
+        return 0;
+    }
+
+    s = Agg_Find((uint8_t)dev_idx, handle);
+    if (s < 0) {
+        return 0;
+    }
+    st = &streams[s];
+
+    /* Packed values carry several samples, one per stride */
+    step = (st->def.stride > 0) ? st->def.stride : len;
+    if (step == 0) {
+        st->malformed++;
+        return 1;
+    }
+
+    now = HAL_GetTick();
+    for (pos = 0; (uint32_t)pos + step <= len; pos = (uint16_t)(pos + step)) {
+        if (st->count == 0) {
+            st->window_start = now;
+        }
+
+        for (ch = 0; ch < st->def.channels; ch++) {
+            if (BLE_Rules_ExtractField(st->def.field[ch], st->def.offset[ch],
+                                       &data[pos], step, &v) != 0) {
+                st->malformed++;
+                return 1;
+            }
+            agg_buf[s][ch][st->count] = (float32_t)v;
+        }
+        st->count++;
+        st->samples++;
+
+        if ((st->def.window_samples > 0 && st->count >= st->def.window_samples) ||
+            st->count >= BLE_AGG_MAX_SAMPLES) {
+            Agg_Emit((uint8_t)s);
+        }
+    }
+
+    /* Time windows close on the first value after T */
+    if (st->def.window_ms > 0 && st->count > 0 &&
+        (now - st->window_start) >= st->def.window_ms) {
+        Agg_Emit((uint8_t)s);
+    }
+
+    return 1;
+}
+
+void BLE_Agg_Report(void)
+{
+    uint8_t i;
+    const AggStream_t *st;
+
+    for (i = 0; i < BLE_AGG_MAX_STREAMS; i++) {
+        st = &streams[i];
+        if (st->active) {
+            AT_Response_Send("+AGGS:%d,0x%04X,%d,%d,%d,%lu,%lu,%lu\r\n", st->def.dev_idx,
+                             st->def.handle, st->def.channels, st->def.window_samples,
+                             st->def.window_ms, st->windows, st->samples, st->malformed);
+        }
+    }
+}
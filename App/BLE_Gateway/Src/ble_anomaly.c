@@ -0,0 +1,262 @@
+/**
+  ******************************************************************************
+  * @file    ble_anomaly.c
+  * @brief   int8 anomaly scoring stage implementation (CMSIS-NN)
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#define DEBUG_MODULE DEBUG_MOD_DATA
+
+#include "ble_anomaly.h"
+#include "ble_anomaly_model.h"
+#include "ble_rules.h"
+#include "ble_device_manager.h"
+#include "at_command.h"
+#include "debug_trace.h"
+#include "main.h"
+#include <string.h>
+
+/*============================================================================
+ * State
+ *============================================================================*/
+typedef struct {
+    BLE_AnomalyDef_t def;
+    uint8_t active;
+    uint8_t has_prev;               /* Previous window valid */
+    uint8_t last_score;
+    uint16_t count;
+    int16_t cur[BLE_ANOM_WINDOW];   /* Raw samples, current window */
+    int16_t prev[BLE_ANOM_WINDOW];  /* Raw samples, previous window (context) */
+    uint32_t windows;
+    uint32_t events;
+    uint32_t cycles_last;
+    uint32_t cycles_max;
+    uint32_t cycles_total;
+} AnomStream_t;
+
+static AnomStream_t anom_streams[BLE_ANOM_MAX_STREAMS];
+static const BLE_AnomalyModel_t *anom_model = &ble_anomaly_default_model;
+
+/* Inference scratch (shared: inference never runs concurrently) */
+static q7_t anom_in[BLE_ANOM_WINDOW];
+static q7_t anom_hidden[BLE_ANOM_WINDOW];
+static q7_t anom_out[BLE_ANOM_WINDOW];
+static q15_t anom_vec_buf[BLE_ANOM_WINDOW];
+
+/*============================================================================
+ * Static Helper Functions
+ *============================================================================*/
+
+static int Anom_Find(uint8_t dev_idx, uint16_t handle)
+{
+    uint8_t i;
+
+    for (i = 0; i < BLE_ANOM_MAX_STREAMS; i++) {
+        if (anom_streams[i].active && anom_streams[i].def.dev_idx == dev_idx &&
+            anom_streams[i].def.handle == handle) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int16_t Anom_Sat16(int32_t v)
+{
+    if (v > 32767) {
+        return 32767;
+    }
+    if (v < -32768) {
+        return -32768;
+    }
+    return (int16_t)v;
+}
+
+/**
+ * @brief Run the autoencoder over the current window
+ * @return Mean absolute reconstruction error (0-255)
+ */
+static uint8_t Anom_Infer(AnomStream_t *st)
+{
+    const BLE_AnomalyModel_t *m = anom_model;
+    uint32_t sum = 0;
+    int32_t v;
+    uint16_t i;
+
+    for (i = 0; i < m->in_dim; i++) {
+        v = (int32_t)st->cur[i] >> st->def.in_shift;
+        anom_in[i] = (q7_t)((v > 127) ? 127 : ((v < -128) ? -128 : v));
+    }
+
+    arm_fully_connected_q7(anom_in, m->w1, m->in_dim, m->hidden_dim, m->w1_bias_shift,
+                           m->w1_out_shift, m->b1, anom_hidden, anom_vec_buf);
+    if (m->relu) {
+        arm_relu_q7(anom_hidden, m->hidden_dim);
+    }
+    arm_fully_connected_q7(anom_hidden, m->w2, m->hidden_dim, m->in_dim, m->w2_bias_shift,
+                           m->w2_out_shift, m->b2, anom_out, anom_vec_buf);
+
+    for (i = 0; i < m->in_dim; i++) {
+        v = (int32_t)anom_in[i] - (int32_t)anom_out[i];
+        sum += (uint32_t)((v < 0) ? -v : v);
+    }
+
+    return (uint8_t)(sum / m->in_dim);
+}
+
+static void Anom_SendWindow(const int16_t *win)
+{
+    uint16_t i;
+
+    for (i = 0; i < BLE_ANOM_WINDOW; i++) {
+        AT_Response_Send("%04X", (uint16_t)win[i]);
+    }
+}
+
+/**
+ * @brief Score a full window and forward it if anomalous
+ */
+static void Anom_Window(AnomStream_t *st)
+{
+    uint32_t t0, cycles;
+
+    t0 = DWT->CYCCNT;
+    st->last_score = Anom_Infer(st);
+    cycles = DWT->CYCCNT - t0;
+
+    st->windows++;
+    st->cycles_last = cycles;
+    st->cycles_total += cycles;
+    if (cycles > st->cycles_max) {
+        st->cycles_max = cycles;
+    }
+
+    if (st->last_score > st->def.threshold) {
+        st->events++;
+        AT_Response_Send("+ANOM:%d,0x%04X,%d,%lu\r\n", st->def.dev_idx, st->def.handle,
+                         st->last_score, cycles);
+
+        /* Raw context: previous window (if any) then the anomalous one */
+        AT_Response_Send("+ANOMWIN:%d,0x%04X,%d,", st->def.dev_idx, st->def.handle,
+                         st->has_prev ? (2 * BLE_ANOM_WINDOW) : BLE_ANOM_WINDOW);
+        if (st->has_prev) {
+            Anom_SendWindow(st->prev);
+        }
+        Anom_SendWindow(st->cur);
+        AT_Response_Send("\r\n");
+    }
+
+    memcpy(st->prev, st->cur, sizeof(st->prev));
+    st->has_prev = 1;
+    st->count = 0;
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+void BLE_Anomaly_Init(void)
+{
+    memset(anom_streams, 0, sizeof(anom_streams));
+
+    DEBUG_INFO("Anomaly stage initialized: model %s", anom_model->name);
+}
+
+int BLE_Anomaly_Set(const BLE_AnomalyDef_t *def)
+{
+    int slot;
+    uint8_t i;
+
+    if (def == NULL || def->handle == 0 || def->field >= RULE_FIELD_COUNT ||
+        def->in_shift > 24 || anom_model->in_dim != BLE_ANOM_WINDOW ||
+        anom_model->hidden_dim > BLE_ANOM_WINDOW) {
+        return -1;
+    }
+
+    slot = Anom_Find(def->dev_idx, def->handle);
+    if (slot < 0) {
+        for (i = 0; i < BLE_ANOM_MAX_STREAMS; i++) {
+            if (!anom_streams[i].active) {
+                slot = i;
+                break;
+            }
+        }
+    }
+    if (slot < 0) {
+        return -1;
+    }
+
+    memset(&anom_streams[slot], 0, sizeof(anom_streams[slot]));
+    anom_streams[slot].def = *def;
+    anom_streams[slot].active = 1;
+
+    DEBUG_INFO("Anom %d: dev=%d handle=0x%04X thr=%d", slot, def->dev_idx, def->handle,
+               def->threshold);
+    return 0;
+}
+
+int BLE_Anomaly_Delete(uint8_t dev_idx, uint16_t handle)
+{
+    int slot = Anom_Find(dev_idx, handle);
+
+    if (slot < 0) {
+        return -1;
+    }
+
+    anom_streams[slot].active = 0;
+    return 0;
+}
+
+uint8_t BLE_Anomaly_Process(uint16_t conn_handle, uint16_t handle,
+                            const uint8_t *data, uint16_t len)
+{
+    AnomStream_t *st;
+    uint16_t pos, step;
+    int32_t v;
+    int dev_idx, s;
+
+    dev_idx = BLE_DeviceManager_FindConnHandle(conn_handle);
+    if (dev_idx < 0) {
+        return 0;
+    }
+
+    s = Anom_Find((uint8_t)dev_idx, handle);
+    if (s < 0) {
+        return 0;
+    }
+    st = &anom_streams[s];
+
+    step = (st->def.stride > 0) ? st->def.stride : len;
+    if (step == 0) {
+        return 1;
+    }
+
+    for (pos = 0; (uint32_t)pos + step <= len; pos = (uint16_t)(pos + step)) {
+        if (BLE_Rules_ExtractField(st->def.field, st->def.offset, &data[pos], step, &v) != 0) {
+            return 1;
+        }
+        st->cur[st->count++] = Anom_Sat16(v);
+
+        if (st->count >= BLE_ANOM_WINDOW) {
+            Anom_Window(st);
+        }
+    }
+
+    return 1;
+}
+
+void BLE_Anomaly_Report(void)
+{
+    uint8_t i;
+    const AnomStream_t *st;
+
+    for (i = 0; i < BLE_ANOM_MAX_STREAMS; i++) {
+        st = &anom_streams[i];
+        if (st->active) {
+            AT_Response_Send("+ANOMS:%d,0x%04X,%d,%lu,%lu,%d,%lu,%lu,%lu\r\n",
+                             st->def.dev_idx, st->def.handle, st->def.threshold,
+                             st->windows, st->events, st->last_score, st->cycles_last,
+                             st->cycles_max,
+                             (st->windows > 0) ? (st->cycles_total / st->windows) : 0UL);
+        }
+    }
+}
@@ -0,0 +1,92 @@
+/**
+  ******************************************************************************
+  * @file    ble_anomaly_model.c
+  * @brief   Default compiled-in int8 anomaly model (window autoencoder)
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#include "ble_anomaly_model.h"
+
+/*============================================================================
+ * Default Model
+ *
+ * 32 -> 8 -> 32 linear autoencoder. The encoder averages blocks of 4
+ * samples (0.25 = 32 >> 7), the decoder holds each average over its block
+ * (~1.0 = 127 >> 7). Reconstruction error is the energy the 8-point
+ * envelope cannot explain, i.e. high-frequency content such as bearing
+ * chatter or impacts. Replace with trained weights of the same layout.
+ *============================================================================*/
+
+static const q7_t default_w1[BLE_ANOM_DEFAULT_HIDDEN * BLE_ANOM_DEFAULT_INPUT] = {
+     32,  32,  32,  32,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,  32,  32,  32,  32,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,  32,  32,  32,  32,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  32,  32,  32,  32,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+     32,  32,  32,  32,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,  32,  32,  32,  32,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,  32,  32,  32,  32,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  32,  32,  32,  32,
+};
+
+static const q7_t default_b1[BLE_ANOM_DEFAULT_HIDDEN] = { 0 };
+
+static const q7_t default_w2[BLE_ANOM_DEFAULT_INPUT * BLE_ANOM_DEFAULT_HIDDEN] = {
+    127,   0,   0,   0,   0,   0,   0,   0,
+    127,   0,   0,   0,   0,   0,   0,   0,
+    127,   0,   0,   0,   0,   0,   0,   0,
+    127,   0,   0,   0,   0,   0,   0,   0,
+      0, 127,   0,   0,   0,   0,   0,   0,
+      0, 127,   0,   0,   0,   0,   0,   0,
+      0, 127,   0,   0,   0,   0,   0,   0,
+      0, 127,   0,   0,   0,   0,   0,   0,
+      0,   0, 127,   0,   0,   0,   0,   0,
+      0,   0, 127,   0,   0,   0,   0,   0,
+      0,   0, 127,   0,   0,   0,   0,   0,
+      0,   0, 127,   0,   0,   0,   0,   0,
+      0,   0,   0, 127,   0,   0,   0,   0,
+      0,   0,   0, 127,   0,   0,   0,   0,
+      0,   0,   0, 127,   0,   0,   0,   0,
+      0,   0,   0, 127,   0,   0,   0,   0,
+      0,   0,   0,   0, 127,   0,   0,   0,
+      0,   0,   0,   0, 127,   0,   0,   0,
+      0,   0,   0,   0, 127,   0,   0,   0,
+      0,   0,   0,   0, 127,   0,   0,   0,
+      0,   0,   0,   0,   0, 127,   0,   0,
+      0,   0,   0,   0,   0, 127,   0,   0,
+      0,   0,   0,   0,   0, 127,   0,   0,
+      0,   0,   0,   0,   0, 127,   0,   0,
+      0,   0,   0,   0,   0,   0, 127,   0,
+      0,   0,   0,   0,   0,   0, 127,   0,
+      0,   0,   0,   0,   0,   0, 127,   0,
+      0,   0,   0,   0,   0,   0, 127,   0,
+      0,   0,   0,   0,   0,   0,   0, 127,
+      0,   0,   0,   0,   0,   0,   0, 127,
+      0,   0,   0,   0,   0,   0,   0, 127,
+      0,   0,   0,   0,   0,   0,   0, 127,
+};
+
+static const q7_t default_b2[BLE_ANOM_DEFAULT_INPUT] = { 0 };
+
+const BLE_AnomalyModel_t ble_anomaly_default_model = {
+    .name = "ENV32",
+    .in_dim = BLE_ANOM_DEFAULT_INPUT,
+    .hidden_dim = BLE_ANOM_DEFAULT_HIDDEN,
+    .w1 = default_w1,
+    .b1 = default_b1,
+    .w2 = default_w2,
+    .b2 = default_b2,
+    .w1_out_shift = 7,
+    .w1_bias_shift = 0,
+    .w2_out_shift = 7,
+    .w2_bias_shift = 0,
+    .relu = 0,
+};
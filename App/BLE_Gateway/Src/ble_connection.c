@@ -6,25 +6,125 @@
   ******************************************************************************
   */
 
+#define DEBUG_MODULE DEBUG_MOD_BLE
+
 #include "ble_connection.h"
 #include "ble_device_manager.h"
 #include "debug_trace.h"
 #include "at_command.h"
+#include "ble_gatt_flow.h"
+#include "ble_gatt_queue.h"
+#include "ble_profile_decoder.h"
+#include "module_mode.h"
+#include "module_evlog.h"
+#include "ble_l2cap.h"
+#include "ble_tput.h"
 #include "ble_gap_aci.h"
 #include "ble_hci_le.h"
+#include "ble_hci_queue.h"
+#include "ble_hci_monitor.h"
+#include "app_conf.h"
+#include "stm32_seq.h"
 #include <string.h>
 
 extern void AT_Response_Send(const char *fmt, ...);
 
+#define SCAN_INTERVAL_THROTTLED 0x0040  /* 40ms: 25% duty with the 10ms window */
+
 typedef struct {
     uint16_t conn_handle;
     BLE_ConnectionState_t state;
     uint8_t mac_addr[BLE_MAC_LEN];
 } ConnectionInfo_t;
 
+typedef struct {
+    uint8_t mac[BLE_MAC_LEN];
+    int8_t rssi;
+    uint8_t addr_type;
+    char name[BLE_SCAN_NAME_MAX + 1];
+} ScanReport_t;
+
 static ConnectionInfo_t connections[MAX_BLE_CONNECTIONS];
 static uint8_t connection_count = 0;
 
+/* Scan reports from the HCI event task, processed at background priority */
+static ScanReport_t scan_queue[BLE_SCAN_QUEUE_LEN];
+static uint8_t scan_head = 0;
+static uint8_t scan_count = 0;
+static uint32_t scan_dropped = 0;
+
+/* Duty cycle change in progress: stop queued, start follows unless the
+   scan was stopped, restarted or a connection started meanwhile */
+static uint8_t scan_restart_pending = 0;
+static uint8_t scan_restart_throttled = 0;
+
+static void Connection_ProcessScanReport(const ScanReport_t *rep)
+{
+    int idx;
+    BLE_Device_t *dev;
+    
+    idx = BLE_DeviceManager_AddDevice(rep->mac, rep->rssi);
+    
+    if (idx >= 0) {
+        dev = BLE_DeviceManager_GetDevice(idx);
+        if (dev == NULL) {
+            return;
+        }
+        /*Update Address Type*/
+        BLE_DeviceManager_UpdateAddrType(idx, rep->addr_type);
+        
+        if (rep->name[0] != '\0') {
+            /* Update name if available */
+            BLE_DeviceManager_UpdateName(idx, rep->name);
+        }
+        
+        /* Send AT response for newly discovered device */
+        if (!dev->reported_in_scan) {
+            dev->reported_in_scan = 1;
+            /* Host away: keep it for AT+REPLAY */
+            if (Module_EvLog_Scan(rep->mac, rep->rssi,
+                                  (rep->name[0] != '\0') ? rep->name : NULL)) {
+                return;
+            }
+            AT_Response_Send("+SCAN:%02X:%02X:%02X:%02X:%02X:%02X,%d,%s\r\n",
+                rep->mac[5], rep->mac[4], rep->mac[3], rep->mac[2], rep->mac[1], rep->mac[0],
+                (int)rep->rssi,
+                (rep->name[0] != '\0') ? rep->name : "Unknown");
+        }
+    }
+}
+
+void BLE_Connection_ReportScanQueue(void)
+{
+    AT_Response_Send("+SCANQ:%u,%u,%lu\r\n", scan_count, BLE_SCAN_QUEUE_LEN, scan_dropped);
+}
+
+void BLE_Connection_ResetScanQueue(void)
+{
+    scan_dropped = 0;
+}
+
+/* Sequencer task: one report per run, so higher priority work interleaves */
+static void Connection_ScanTask(void)
+{
+    ScanReport_t rep;
+    
+    if (scan_count == 0) {
+        return;
+    }
+    
+    /* Copy out first: the report may be merged into while it is processed */
+    rep = scan_queue[scan_head];
+    scan_head = (uint8_t)((scan_head + 1U) % BLE_SCAN_QUEUE_LEN);
+    scan_count--;
+    
+    Connection_ProcessScanReport(&rep);
+    
+    if (scan_count > 0) {
+        UTIL_SEQ_SetTask(1U << CFG_TASK_SCAN_REPORT_ID, CFG_SCH_PRIO_BG);
+    }
+}
+
 void BLE_Connection_Init(void)
 {
     uint8_t i;
@@ -34,6 +134,10 @@ void BLE_Connection_Init(void)
         connections[i].state = CONN_STATE_IDLE;
     }
     connection_count = 0;
+    scan_head = 0;
+    scan_count = 0;
+    scan_dropped = 0;
+    UTIL_SEQ_RegTask(1U << CFG_TASK_SCAN_REPORT_ID, UTIL_SEQ_RFU, Connection_ScanTask);
     DEBUG_INFO("Connection Manager initialized");
 }
 
@@ -44,6 +148,7 @@ int BLE_Connection_StartScan(uint16_t duration_ms)
     DEBUG_INFO("Starting BLE scan: %dms", duration_ms);
 
     BLE_DeviceManager_ResetScanFlags();
+    scan_restart_pending = 0;
     
     /* Use ACI_GAP_START_GENERAL_DISCOVERY_PROC for active scanning
      * Scan interval: 0x0010 = 10ms
@@ -64,6 +169,7 @@ int BLE_Connection_StartScan(uint16_t duration_ms)
     }
     
     BLE_DeviceManager_SetScanActive(1);
+    BLE_HciMon_OnScan(1);
     DEBUG_INFO("Scan started successfully");
     return 0;
 }
@@ -73,6 +179,7 @@ int BLE_Connection_StopScan(void)
     tBleStatus ret;
     
     DEBUG_INFO("Stopping BLE scan");
+    scan_restart_pending = 0;
     
     /* Terminate general discovery procedure (0x02 = GAP_GENERAL_DISCOVERY_PROC) */
     ret = aci_gap_terminate_gap_proc(0x02);
@@ -83,13 +190,115 @@ int BLE_Connection_StopScan(void)
     }
     
     BLE_DeviceManager_SetScanActive(0);
+    BLE_HciMon_OnScan(0);
     DEBUG_INFO("Scan stopped successfully");
     return 0;
 }
 
+/* The duty cycle restart failed: the scan is over, tell the host */
+static void Connection_ScanLost(uint8_t status)
+{
+    DEBUG_ERROR("Failed to restart scan: 0x%02X", status);
+    BLE_DeviceManager_SetScanActive(0);
+    BLE_HciMon_OnScan(0);
+    AT_Response_Send("+SCANSTOP:0x%02X\r\n", status);
+}
+
+static void Connection_OnScanRestarted(uint16_t opcode, uint8_t status,
+                                       const uint8_t *rparam, uint8_t rlen, uint32_t tag)
+{
+    (void)opcode; (void)rparam; (void)rlen; (void)tag;
+    
+    if (status != BLE_STATUS_SUCCESS) {
+        Connection_ScanLost(status);
+    }
+}
+
+static void Connection_OnScanPaused(uint16_t opcode, uint8_t status,
+                                    const uint8_t *rparam, uint8_t rlen, uint32_t tag)
+{
+    aci_gap_start_general_discovery_proc_cp0 cp;
+    
+    (void)opcode; (void)status; (void)rparam; (void)rlen; (void)tag;
+    
+    if (!scan_restart_pending || !BLE_DeviceManager_IsScanActive()) {
+        return;
+    }
+    scan_restart_pending = 0;
+    
+    /* Same parameters as BLE_Connection_StartScan(), longer interval if
+     * throttled. Reporting flags are kept: devices are not reported again.
+     */
+    cp.LE_Scan_Interval = scan_restart_throttled ? SCAN_INTERVAL_THROTTLED : 0x0010;
+    cp.LE_Scan_Window = 0x0010;
+    cp.Own_Address_Type = 0x00;
+    cp.Filter_Duplicates = 0x00;
+    
+    if (BLE_HciQueue_Send(BLE_HCIQ_OPCODE(0x3F, 0x097), &cp, sizeof(cp),
+                          Connection_OnScanRestarted, 0) != 0) {
+        Connection_ScanLost(0xFFU);
+    }
+}
+
+int BLE_Connection_ThrottleScan(uint8_t throttled)
+{
+    aci_gap_terminate_gap_proc_cp0 stop;
+    
+    if (!BLE_DeviceManager_IsScanActive() || scan_restart_pending) {
+        return -1;
+    }
+    
+    /* Restart the discovery procedure through the HCI queue: never blocks
+     * the HCI event task that detects the overload
+     */
+    stop.Procedure_Code = 0x02;         /* GAP_GENERAL_DISCOVERY_PROC */
+    if (BLE_HciQueue_Send(BLE_HCIQ_OPCODE(0x3F, 0x09D), &stop, sizeof(stop),
+                          Connection_OnScanPaused, 0) != 0) {
+        return -1;
+    }
+    scan_restart_pending = 1;
+    scan_restart_throttled = throttled;
+    DEBUG_INFO("Scan duty cycle: %s", throttled ? "throttled" : "full");
+    return 0;
+}
+
+/* Terminate general discovery before connecting (queued, see below) */
+static void Connection_OnScanStopped(uint16_t opcode, uint8_t status,
+                                     const uint8_t *rparam, uint8_t rlen, uint32_t tag)
+{
+    (void)opcode; (void)rparam; (void)rlen; (void)tag;
+    
+    /* An error means no procedure was running anymore */
+    BLE_DeviceManager_SetScanActive(0);
+    BLE_HciMon_OnScan(0);
+    DEBUG_INFO("Scan stopped before connect: 0x%02X", status);
+}
+
+/* ACI_GAP_CREATE_CONNECTION command status; tag = device index */
+static void Connection_OnCreateStatus(uint16_t opcode, uint8_t status,
+                                      const uint8_t *rparam, uint8_t rlen, uint32_t tag)
+{
+    static const uint8_t no_mac[BLE_MAC_LEN] = {0};
+    BLE_Device_t *dev;
+    
+    (void)opcode; (void)rparam; (void)rlen;
+    
+    if (status == BLE_STATUS_SUCCESS) {
+        DEBUG_INFO("Connection initiated");
+        return;
+    }
+    
+    DEBUG_ERROR("Failed to create connection: 0x%02X", status);
+    
+    /* Same path as a failed connection complete: +CONN_ERROR, flow released */
+    dev = BLE_DeviceManager_GetDevice((int)tag);
+    BLE_Connection_OnConnected((dev != NULL) ? dev->mac_addr : no_mac, 0xFFFF, status);
+}
+
 int BLE_Connection_CreateConnection(const uint8_t *mac)
 {
-    tBleStatus ret;
+    aci_gap_terminate_gap_proc_cp0 stop;
+    aci_gap_create_connection_cp0 cp;
     BLE_Device_t *dev;
     int dev_idx;
     
@@ -112,33 +321,41 @@ int BLE_Connection_CreateConnection(const uint8_t *mac)
         return -1;
     }
     
-    /* Stop scan first */
-    BLE_Connection_StopScan();
+    /* Both commands go through the asynchronous HCI queue, in order: the
+     * connect (a slow ACI call) no longer holds the sequencer in
+     * hci_send_req(). A failed command status is reported as +CONN_ERROR.
+     */
+    scan_restart_pending = 0;
+    if (BLE_DeviceManager_IsScanActive()) {
+        stop.Procedure_Code = 0x02;     /* GAP_GENERAL_DISCOVERY_PROC */
+        if (BLE_HciQueue_Send(BLE_HCIQ_OPCODE(0x3F, 0x09D), &stop, sizeof(stop),
+                              Connection_OnScanStopped, 0) != 0) {
+            return -1;
+        }
+    }
     
-    /* Create connection using ACI_GAP_CREATE_CONNECTION
+    /* ACI_GAP_CREATE_CONNECTION
      * Peer address type: 0x00 = Public (most common)
      */
-    ret = aci_gap_create_connection(
-        0x0010,         /* LE_Scan_Interval: 10ms (0x0010 * 0.625ms) */
-        0x0010,         /* LE_Scan_Window: 10ms */
-        dev->addr_type, /* Peer_Address_Type: Public */
-        mac,            /* Peer_Address */
-        0x00,           /* Own_Address_Type: Public */
-        0x0018,         /* Conn_Interval_Min: 30ms (24 * 1.25ms) */
-        0x0028,         /* Conn_Interval_Max: 50ms (40 * 1.25ms) */
-        0x0000,         /* Conn_Latency: 0 */
-        0x00C8,         /* Supervision_Timeout: 2000ms (200 * 10ms) */
-        0x0000,         /* Minimum_CE_Length: 0 */
-        0x0000          /* Maximum_CE_Length: 0 */
-    );
-    
-    if (ret != BLE_STATUS_SUCCESS) {
-        DEBUG_ERROR("Failed to create connection: 0x%02X", ret);
+    cp.LE_Scan_Interval = 0x0010;       /* 10ms (0x0010 * 0.625ms) */
+    cp.LE_Scan_Window = 0x0010;         /* 10ms */
+    cp.Peer_Address_Type = dev->addr_type;
+    memcpy(cp.Peer_Address, mac, BLE_MAC_LEN);
+    cp.Own_Address_Type = 0x00;         /* Public */
+    cp.Conn_Interval_Min = 0x0018;      /* 30ms (24 * 1.25ms) */
+    cp.Conn_Interval_Max = 0x0028;      /* 50ms (40 * 1.25ms) */
+    cp.Conn_Latency = 0x0000;
+    cp.Supervision_Timeout = 0x00C8;    /* 2000ms (200 * 10ms) */
+    cp.Minimum_CE_Length = 0x0000;
+    cp.Maximum_CE_Length = 0x0000;
+    
+    if (BLE_HciQueue_Send(BLE_HCIQ_OPCODE(0x3F, 0x09C), &cp, sizeof(cp),
+                          Connection_OnCreateStatus, (uint32_t)dev_idx) != 0) {
+        DEBUG_ERROR("HCI queue full, connection not created");
         return -1;
     }
     
     AT_Response_Send("+CONNECTING\r\n");
-    DEBUG_INFO("Connection initiated");
     return 0;
 }
 
@@ -202,37 +419,42 @@ uint8_t BLE_Connection_IsConnected(uint16_t conn_handle)
 void BLE_Connection_OnScanReport(const uint8_t *mac, int8_t rssi, 
                                   const char *name, uint8_t addr_type)
 {
-    int idx;
-    BLE_Device_t *dev;
+    ScanReport_t *rep = NULL;
+    uint8_t i;
     
     if (mac == NULL) {
         return;
     }
     
-    idx = BLE_DeviceManager_AddDevice(mac, rssi);
+    /* A device advertising again while queued: keep the latest values */
+    for (i = 0; i < scan_count; i++) {
+        rep = &scan_queue[(scan_head + i) % BLE_SCAN_QUEUE_LEN];
+        if (memcmp(rep->mac, mac, BLE_MAC_LEN) == 0) {
+            break;
+        }
+        rep = NULL;
+    }
     
-    if (idx >= 0) {
-        dev = BLE_DeviceManager_GetDevice(idx);
-        if (dev == NULL) {
+    if (rep == NULL) {
+        if (scan_count >= BLE_SCAN_QUEUE_LEN) {
+            scan_dropped++;
+            DEBUG_WARN("Scan queue full, %lu reports dropped", scan_dropped);
             return;
         }
-        /*Update Address Type*/
-        BLE_DeviceManager_UpdateAddrType(idx, addr_type);
-        
-        if (name != NULL && name[0] != '\0') {
-            /* Update name if available */
-            BLE_DeviceManager_UpdateName(idx, name);
-        }
-        
-        /* Send AT response for newly discovered device */
-        if (!dev->reported_in_scan) {
-            dev->reported_in_scan = 1;
-            AT_Response_Send("+SCAN:%02X:%02X:%02X:%02X:%02X:%02X,%d,%s\r\n",
-                mac[5], mac[4], mac[3], mac[2], mac[1], mac[0],
-                (int)rssi,
-                (name != NULL && name[0] != '\0') ? name : "Unknown");
-        }
+        rep = &scan_queue[(scan_head + scan_count) % BLE_SCAN_QUEUE_LEN];
+        scan_count++;
+        memcpy(rep->mac, mac, BLE_MAC_LEN);
+        rep->name[0] = '\0';
+    }
+    
+    rep->rssi = rssi;
+    rep->addr_type = addr_type;
+    if (name != NULL && name[0] != '\0') {
+        strncpy(rep->name, name, BLE_SCAN_NAME_MAX);
+        rep->name[BLE_SCAN_NAME_MAX] = '\0';
     }
+    
+    UTIL_SEQ_SetTask(1U << CFG_TASK_SCAN_REPORT_ID, CFG_SCH_PRIO_BG);
 }
 
 
@@ -243,13 +465,15 @@ void BLE_Connection_OnConnected(const uint8_t *mac, uint16_t conn_handle, uint8_
     
     DEBUG_INFO("Conn complete: hdl=0x%04X status=0x%02X", conn_handle, status);
     
+    dev_idx = BLE_DeviceManager_FindDevice(mac);
+    
     if (status != 0) {
         DEBUG_ERROR("Conn failed: 0x%02X", status);
         AT_Response_Send("+CONN_ERROR:%02X\r\n", status);
+        BLE_Flow_OnConnected(dev_idx, conn_handle, status);
         return;
     }
     
-    dev_idx = BLE_DeviceManager_FindDevice(mac);
     if (dev_idx >= 0) {
         BLE_DeviceManager_UpdateConnection(dev_idx, conn_handle, 1);
         
@@ -265,6 +489,8 @@ void BLE_Connection_OnConnected(const uint8_t *mac, uint16_t conn_handle, uint8_
         }
         
         AT_Response_Send("+CONNECTED:%d,0x%04X\r\n", dev_idx, conn_handle);
+        Module_Mode_OnConnected((uint8_t)dev_idx, conn_handle);
+        BLE_Flow_OnConnected(dev_idx, conn_handle, status);
     }
 }
 
@@ -293,4 +519,10 @@ void BLE_Connection_OnDisconnected(uint16_t conn_handle, uint8_t reason)
     }
     
     AT_Response_Send("+DISCONNECTED:0x%04X\r\n", conn_handle);
+    BLE_Flow_OnDisconnected(conn_handle);
+    BLE_GattQueue_OnDisconnected(conn_handle);
+    BLE_Decoder_UnbindConn(conn_handle);
+    BLE_L2cap_OnLinkDown(conn_handle);
+    BLE_Tput_OnDisconnected(conn_handle);
+    Module_Mode_OnDisconnected(conn_handle);
 }
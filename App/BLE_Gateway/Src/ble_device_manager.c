@@ -6,6 +6,8 @@
   ******************************************************************************
   */
 
+#define DEBUG_MODULE DEBUG_MOD_BLE
+
 #include "ble_device_manager.h"
 #include "debug_trace.h"
 
@@ -26,6 +28,7 @@ void BLE_DeviceManager_Init(void)
         device_manager.devices[i].device_index = i;
         device_manager.devices[i].addr_type = 0x00;
         device_manager.devices[i].name[0] = '\0';
+        device_manager.devices[i].att_mtu = BLE_ATT_DEFAULT_MTU;
     }
     
     DEBUG_INFO("Device Manager initialized");
@@ -58,6 +61,7 @@ int BLE_DeviceManager_AddDevice(const uint8_t *mac, int8_t rssi)
         device_manager.devices[idx].conn_handle = 0xFFFF;
         device_manager.devices[idx].name[0] = '\0';
         device_manager.devices[idx].reported_in_scan = 0;
+        device_manager.devices[idx].att_mtu = BLE_ATT_DEFAULT_MTU;
         device_manager.device_count++;
         list_full_warned = 0;  /* Reset warning flag */
         
@@ -111,6 +115,8 @@ void BLE_DeviceManager_UpdateConnection(int dev_idx, uint16_t conn_handle, uint8
     
     device_manager.devices[dev_idx].conn_handle = connected ? conn_handle : 0xFFFF;
     device_manager.devices[dev_idx].is_connected = connected;
+    device_manager.devices[dev_idx].att_mtu = BLE_ATT_DEFAULT_MTU;
+    device_manager.devices[dev_idx].conn_interval = 0;
     
     DEBUG_INFO("Dev[%d] conn: handle=0x%04X state=%d", dev_idx, conn_handle, connected);
 }
@@ -190,6 +196,30 @@ void BLE_DeviceManager_UpdateName(int dev_idx, const char *name)
     DEBUG_INFO("Dev[%d] name updated: %s", dev_idx, name);
 }
 
+void BLE_DeviceManager_UpdateMTU(int dev_idx, uint16_t mtu)
+{
+    if (dev_idx < 0 || dev_idx >= (int)device_manager.device_count) {
+        return;
+    }
+    
+    if (mtu < BLE_ATT_DEFAULT_MTU) {
+        mtu = BLE_ATT_DEFAULT_MTU;
+    }
+    
+    device_manager.devices[dev_idx].att_mtu = mtu;
+    DEBUG_INFO("Dev[%d] ATT MTU updated: %d", dev_idx, mtu);
+}
+
+void BLE_DeviceManager_UpdateConnInterval(int dev_idx, uint16_t interval)
+{
+    if (dev_idx < 0 || dev_idx >= (int)device_manager.device_count) {
+        return;
+    }
+    
+    device_manager.devices[dev_idx].conn_interval = interval;
+    DEBUG_INFO("Dev[%d] conn interval: %d x 1.25 ms", dev_idx, interval);
+}
+
 void BLE_DeviceManager_ResetScanFlags(void)
 {
     uint8_t i;
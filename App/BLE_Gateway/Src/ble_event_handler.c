@@ -6,8 +6,17 @@
   ******************************************************************************
   */
 
+#define DEBUG_MODULE DEBUG_MOD_BLE
+
 #include "ble_event_handler.h"
+#include "ble_device_manager.h"
+#include "ble_gatt_flow.h"
+#include "ble_gatt_queue.h"
+#include "module_mode.h"
+#include "ble_l2cap.h"
+#include "ble_tput.h"
 #include "debug_trace.h"
+#include "app_conf.h"
 
 // Event callbacks
 static BLE_ScanReportCallback_t scan_cb = NULL;
@@ -120,6 +129,27 @@ void BLE_EventHandler_OnWriteResponse(uint16_t conn_handle, uint8_t status)
 void BLE_EventHandler_OnGattProcComplete(uint16_t conn_handle, uint8_t error_code)
 {
     DEBUG_PRINT("Event: GATT Proc Complete - conn=0x%04X, error=0x%02X", conn_handle, error_code);
+    
+    /* Procedures issued by a running flow are not AT command completions */
+    if (BLE_Flow_OnProcComplete(conn_handle, error_code)) {
+        return;
+    }
+    
+    /* Same for procedures issued from the per-link GATT queues */
+    if (BLE_GattQueue_OnProcComplete(conn_handle, error_code)) {
+        return;
+    }
+    
+    /* And for data mode writes (completion paces the next write) */
+    if (Module_Mode_OnProcComplete(conn_handle, error_code)) {
+        return;
+    }
+    
+    /* And for benchmark writes */
+    if (BLE_Tput_OnProcComplete(conn_handle, error_code)) {
+        return;
+    }
+    
     if (proc_complete_cb) {
         proc_complete_cb(conn_handle, error_code);
     }
@@ -208,3 +238,131 @@ void BLE_EventHandler_OnCharacteristicDiscovered(uint16_t conn_handle, const uin
         }
     }
 }
+
+void BLE_EventHandler_OnMtuExchanged(uint16_t conn_handle, uint16_t server_mtu)
+{
+    uint16_t mtu = server_mtu;
+    int dev_idx;
+    
+    DEBUG_PRINT("Event: MTU Exchanged - conn=0x%04X, server_mtu=%d", conn_handle, server_mtu);
+    
+    /* Effective ATT_MTU is the smaller of both sides */
+    if (mtu > CFG_BLE_MAX_ATT_MTU) {
+        mtu = CFG_BLE_MAX_ATT_MTU;
+    }
+    
+    dev_idx = BLE_DeviceManager_FindConnHandle(conn_handle);
+    if (dev_idx >= 0) {
+        BLE_DeviceManager_UpdateMTU(dev_idx, mtu);
+    }
+}
+
+void BLE_EventHandler_OnConnParams(uint16_t conn_handle, uint16_t interval)
+{
+    int dev_idx = BLE_DeviceManager_FindConnHandle(conn_handle);
+    
+    if (dev_idx >= 0) {
+        BLE_DeviceManager_UpdateConnInterval(dev_idx, interval);
+    }
+}
+
+void BLE_EventHandler_OnTxPoolAvailable(uint16_t conn_handle, uint16_t available)
+{
+    (void)available;
+    
+    Module_Mode_OnTxPoolAvailable(conn_handle);
+    BLE_Tput_OnTxPoolAvailable(conn_handle);
+}
+
+void BLE_EventHandler_OnCocConnectRequest(uint16_t conn_handle, uint16_t spsm)
+{
+    BLE_L2cap_OnConnectRequest(conn_handle, spsm);
+}
+
+void BLE_EventHandler_OnCocConnectConfirm(uint16_t conn_handle, uint16_t mtu, uint16_t mps,
+                                          uint16_t credits, uint16_t result,
+                                          uint8_t num_channels, const uint8_t *index_list)
+{
+    DEBUG_PRINT("Event: CoC Confirm - conn=0x%04X, result=0x%04X, channels=%d",
+                conn_handle, result, num_channels);
+    
+    /* One LE credit-based channel per request (Channel_Number 0). A
+       refusal keeps the peer's result; a success without a channel is
+       reported as 0xFFFF */
+    BLE_L2cap_OnConnectConfirm(conn_handle, mtu, mps, credits,
+                               (result == 0 && num_channels == 0) ? 0xFFFFU : result,
+                               (num_channels > 0) ? index_list[0] : 0xFFU);
+}
+
+void BLE_EventHandler_OnCocDisconnect(uint8_t channel_index)
+{
+    BLE_L2cap_OnDisconnect(channel_index);
+}
+
+void BLE_EventHandler_OnCocFlowControl(uint8_t channel_index, uint16_t credits)
+{
+    BLE_L2cap_OnFlowControl(channel_index, credits);
+}
+
+void BLE_EventHandler_OnCocRxData(uint8_t channel_index, const uint8_t *data, uint16_t len)
+{
+    BLE_L2cap_OnRxData(channel_index, data, len);
+}
+
+void BLE_EventHandler_OnCocTxPoolAvailable(void)
+{
+    BLE_L2cap_OnTxPoolAvailable();
+}
+
+void BLE_EventHandler_OnServiceFoundByUUID(uint16_t conn_handle, const uint8_t *data,
+                                            uint8_t num_pairs)
+{
+    uint8_t i;
+    uint16_t start_handle, end_handle;
+    
+    DEBUG_PRINT("Event: Service By UUID - conn=0x%04X, pairs=%d", conn_handle, num_pairs);
+    
+    for (i = 0; i < num_pairs; i++) {
+        start_handle = (uint16_t)(data[i * 4] | (data[i * 4 + 1] << 8));
+        end_handle = (uint16_t)(data[i * 4 + 2] | (data[i * 4 + 3] << 8));
+        BLE_Flow_OnServiceFound(conn_handle, start_handle, end_handle);
+    }
+}
+
+void BLE_EventHandler_OnCharFoundByUUID(uint16_t conn_handle, uint16_t decl_handle,
+                                         const uint8_t *value, uint8_t value_len)
+{
+    uint16_t value_handle;
+    
+    DEBUG_PRINT("Event: Char By UUID - conn=0x%04X, decl=0x%04X", conn_handle, decl_handle);
+    
+    /* Declaration value: [properties(1), value_handle(2), UUID] */
+    if (value_len < 3) {
+        return;
+    }
+    
+    value_handle = (uint16_t)(value[1] | (value[2] << 8));
+    BLE_Flow_OnCharFound(conn_handle, value[0], value_handle);
+    BLE_GattQueue_OnCharFound(conn_handle, value_handle);
+}
+
+void BLE_EventHandler_OnDescriptorDiscovered(uint16_t conn_handle, uint8_t format,
+                                              const uint8_t *data, uint8_t data_len)
+{
+    uint8_t i;
+    uint16_t handle, uuid;
+    
+    DEBUG_PRINT("Event: Descriptors - conn=0x%04X, format=%d, len=%d", conn_handle, format, data_len);
+    
+    /* Only 16-bit UUID pairs carry CCCD / declarations */
+    if (format != 1) {
+        return;
+    }
+    
+    for (i = 0; (uint16_t)(i + 4) <= data_len; i += 4) {
+        handle = (uint16_t)(data[i] | (data[i + 1] << 8));
+        uuid = (uint16_t)(data[i + 2] | (data[i + 3] << 8));
+        BLE_Flow_OnDescriptorFound(conn_handle, handle, uuid);
+        BLE_GattQueue_OnDescriptorFound(conn_handle, handle, uuid);
+    }
+}
@@ -6,15 +6,69 @@
   ******************************************************************************
   */
 
+#define DEBUG_MODULE DEBUG_MOD_GATT
+
 #include "ble_gatt_client.h"
 #include "debug_trace.h"
 #include "ble_gatt_aci.h"
+#include "ble_connection.h"
+
+/* Outstanding read per link (ATT allows one request at a time per link) */
+typedef struct {
+    uint16_t conn_handle;
+    uint16_t char_handle;
+} PendingRead_t;
+
+static PendingRead_t pending_reads[MAX_BLE_CONNECTIONS];
+
+static void GATT_SetPendingRead(uint16_t conn_handle, uint16_t char_handle)
+{
+    uint8_t i;
+    int free_idx = -1;
+    
+    for (i = 0; i < MAX_BLE_CONNECTIONS; i++) {
+        if (pending_reads[i].conn_handle == conn_handle) {
+            pending_reads[i].char_handle = char_handle;
+            return;
+        }
+        if (free_idx < 0 && pending_reads[i].char_handle == 0) {
+            free_idx = i;
+        }
+    }
+    
+    if (free_idx >= 0) {
+        pending_reads[free_idx].conn_handle = conn_handle;
+        pending_reads[free_idx].char_handle = char_handle;
+    }
+}
 
 void BLE_GATT_Init(void)
 {
+    uint8_t i;
+    
+    for (i = 0; i < MAX_BLE_CONNECTIONS; i++) {
+        pending_reads[i].conn_handle = 0xFFFF;
+        pending_reads[i].char_handle = 0;
+    }
+    
     DEBUG_INFO("GATT Client initialized");
 }
 
+uint16_t BLE_GATT_TakePendingReadHandle(uint16_t conn_handle)
+{
+    uint8_t i;
+    
+    for (i = 0; i < MAX_BLE_CONNECTIONS; i++) {
+        if (pending_reads[i].conn_handle == conn_handle) {
+            uint16_t char_handle = pending_reads[i].char_handle;
+            pending_reads[i].conn_handle = 0xFFFF;
+            pending_reads[i].char_handle = 0;
+            return char_handle;
+        }
+    }
+    return 0;
+}
+
 int BLE_GATT_DiscoverAllServices(uint16_t conn_handle)
 {
     tBleStatus ret;
@@ -70,6 +124,7 @@ int BLE_GATT_ReadCharacteristic(uint16_t conn_handle, uint16_t char_handle)
         return -1;
     }
     
+    GATT_SetPendingRead(conn_handle, char_handle);
     return 0;
 }
 
@@ -123,6 +178,23 @@ int BLE_GATT_WriteCharacteristicNoResp(uint16_t conn_handle, uint16_t char_handl
     return 0;
 }
 
+int BLE_GATT_TryWriteNoResp(uint16_t conn_handle, uint16_t char_handle,
+                            const uint8_t *data, uint16_t len)
+{
+    tBleStatus ret;
+    
+    /* Streaming path: no trace per packet */
+    ret = aci_gatt_write_without_resp(conn_handle, char_handle, len, (uint8_t *)data);
+    
+    if (ret == BLE_STATUS_SUCCESS) {
+        return 0;
+    }
+    if (ret == BLE_STATUS_INSUFFICIENT_RESOURCES) {
+        return 1;
+    }
+    return -1;
+}
+
 int BLE_GATT_EnableNotification(uint16_t conn_handle, uint16_t desc_handle)
 {
     tBleStatus ret;
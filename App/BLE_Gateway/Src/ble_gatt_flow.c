@@ -0,0 +1,682 @@
+/**
+  ******************************************************************************
+  * @file    ble_gatt_flow.c
+  * @brief   GATT Procedure Flow engine implementation
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#define DEBUG_MODULE DEBUG_MOD_GATT
+
+#include "ble_gatt_flow.h"
+#include "ble_device_manager.h"
+#include "ble_connection.h"
+#include "ble_gatt_client.h"
+#include "ble_profile_decoder.h"
+#include "at_command.h"
+#include "debug_trace.h"
+#include "ble_gatt_aci.h"
+#include "ble_hci_le.h"
+#include "main.h"
+#include "hw_if.h"
+#include "app_conf.h"
+#include "stm32_seq.h"
+#include <string.h>
+
+/*============================================================================
+ * Constants
+ *============================================================================*/
+#define FLOW_TICK_MS            100U
+#define FLOW_TICK_TS            ((FLOW_TICK_MS * 1000U) / CFG_TS_TICK_VAL)
+
+#define FLOW_DLE_TX_OCTETS      251U
+#define FLOW_DLE_TX_TIME        2120U
+
+#define FLOW_UUID_CHAR_DECL     0x2803
+#define FLOW_UUID_CCCD          0x2902
+
+/*============================================================================
+ * Built-in Device Classes
+ *============================================================================*/
+static const BLE_FlowStep_t flow_generic[] = {
+    { FLOW_OP_CONNECT, 0, 0 },
+    { FLOW_OP_MTU,     0, 0 },
+    { FLOW_OP_DLE,     0, 0 },
+    { FLOW_OP_END,     0, 0 },
+};
+
+/* Heart Rate: subscribe to Heart Rate Measurement */
+static const BLE_FlowStep_t flow_hrs[] = {
+    { FLOW_OP_CONNECT,      0, 0 },
+    { FLOW_OP_MTU,          0, 0 },
+    { FLOW_OP_DLE,          0, 0 },
+    { FLOW_OP_FIND_SERVICE, 0, 0x180D },
+    { FLOW_OP_FIND_CHAR,    0, 0x2A37 },
+    { FLOW_OP_SUBSCRIBE,    1, 0 },
+    { FLOW_OP_END,          0, 0 },
+};
+
+/* Battery: read Battery Level, then subscribe */
+static const BLE_FlowStep_t flow_bas[] = {
+    { FLOW_OP_CONNECT,      0, 0 },
+    { FLOW_OP_MTU,          0, 0 },
+    { FLOW_OP_FIND_SERVICE, 0, 0x180F },
+    { FLOW_OP_FIND_CHAR,    0, 0x2A19 },
+    { FLOW_OP_READ,         0, 0 },
+    { FLOW_OP_SUBSCRIBE,    1, 0 },
+    { FLOW_OP_END,          0, 0 },
+};
+
+/* Health Thermometer: Temperature Measurement is indicate-only */
+static const BLE_FlowStep_t flow_hts[] = {
+    { FLOW_OP_CONNECT,      0, 0 },
+    { FLOW_OP_MTU,          0, 0 },
+    { FLOW_OP_FIND_SERVICE, 0, 0x1809 },
+    { FLOW_OP_FIND_CHAR,    0, 0x2A1C },
+    { FLOW_OP_SUBSCRIBE,    2, 0 },
+    { FLOW_OP_END,          0, 0 },
+};
+
+/* ST P2P Server: subscribe to notify char */
+static const BLE_FlowStep_t flow_p2p[] = {
+    { FLOW_OP_CONNECT,      0, 0 },
+    { FLOW_OP_MTU,          0, 0 },
+    { FLOW_OP_DLE,          0, 0 },
+    { FLOW_OP_FIND_SERVICE, 0, 0xFE40 },
+    { FLOW_OP_FIND_CHAR,    0, 0xFE42 },
+    { FLOW_OP_SUBSCRIBE,    1, 0 },
+    { FLOW_OP_END,          0, 0 },
+};
+
+static const BLE_FlowClass_t flow_classes[] = {
+    { "GENERIC", flow_generic },
+    { "HRS",     flow_hrs },
+    { "BAS",     flow_bas },
+    { "HTS",     flow_hts },
+    { "P2P",     flow_p2p },
+    { NULL,      NULL },
+};
+
+/*============================================================================
+ * Flow Context
+ *============================================================================*/
+typedef enum {
+    FLOW_ST_IDLE = 0,
+    FLOW_ST_ISSUE,          /* Current step ready to be issued */
+    FLOW_ST_WAIT,           /* Waiting for step completion event */
+} FlowState_t;
+
+typedef struct {
+    uint8_t active;
+    uint8_t dev_idx;
+    uint8_t class_idx;
+    uint8_t step;
+    uint8_t state;
+    uint8_t phase;                  /* Sub-step phase (SUBSCRIBE) */
+    volatile uint8_t done;          /* Completion event received */
+    volatile uint8_t result;        /* Completion status */
+    uint16_t conn_handle;
+    uint16_t svc_start;
+    uint16_t svc_end;
+    uint16_t char_value;
+    uint16_t cccd;
+    uint8_t char_props;
+    uint8_t desc_stop;              /* Next char decl reached during desc scan */
+    uint32_t step_tick;
+} FlowCtx_t;
+
+static FlowCtx_t flows[BLE_FLOW_MAX_ACTIVE];
+static int8_t connect_owner = -1;   /* Flow slot owning the pending connect */
+static uint8_t flow_timer_id;
+static uint8_t flow_timer_running = 0;
+
+static void Flow_Task(void);
+
+/*============================================================================
+ * Static Helper Functions
+ *============================================================================*/
+
+static void Flow_TimerCallback(void)
+{
+    /* Timer server ISR context: defer to task */
+    UTIL_SEQ_SetTask(1U << CFG_TASK_GATT_FLOW_ID, CFG_SCH_PRIO_CTRL);
+}
+
+static FlowCtx_t* Flow_FindByDevice(uint8_t dev_idx)
+{
+    uint8_t i;
+
+    for (i = 0; i < BLE_FLOW_MAX_ACTIVE; i++) {
+        if (flows[i].active && flows[i].dev_idx == dev_idx) {
+            return &flows[i];
+        }
+    }
+    return NULL;
+}
+
+static FlowCtx_t* Flow_FindByConn(uint16_t conn_handle)
+{
+    uint8_t i;
+
+    for (i = 0; i < BLE_FLOW_MAX_ACTIVE; i++) {
+        if (flows[i].active && flows[i].conn_handle == conn_handle) {
+            return &flows[i];
+        }
+    }
+    return NULL;
+}
+
+static const BLE_FlowStep_t* Flow_CurrentStep(const FlowCtx_t *ctx)
+{
+    return &flow_classes[ctx->class_idx].steps[ctx->step];
+}
+
+static void Flow_Free(FlowCtx_t *ctx)
+{
+    if (connect_owner == (int8_t)(ctx - flows)) {
+        connect_owner = -1;
+    }
+    ctx->active = 0;
+    ctx->state = FLOW_ST_IDLE;
+}
+
+static void Flow_Fail(FlowCtx_t *ctx, uint8_t error)
+{
+    DEBUG_ERROR("Flow dev[%d] step %d failed: 0x%02X", ctx->dev_idx, ctx->step, error);
+    AT_Response_Send("+FLOW_ERROR:%d,%d,0x%02X\r\n", ctx->dev_idx, ctx->step, error);
+    Flow_Free(ctx);
+}
+
+static void Flow_Advance(FlowCtx_t *ctx)
+{
+    ctx->step++;
+    ctx->phase = 0;
+    ctx->state = FLOW_ST_ISSUE;
+    ctx->step_tick = HAL_GetTick();
+
+    /* Yield to other tasks between steps */
+    UTIL_SEQ_SetTask(1U << CFG_TASK_GATT_FLOW_ID, CFG_SCH_PRIO_CTRL);
+}
+
+static void Flow_Wait(FlowCtx_t *ctx)
+{
+    ctx->done = 0;
+    ctx->result = 0;
+    ctx->state = FLOW_ST_WAIT;
+    ctx->step_tick = HAL_GetTick();
+}
+
+/**
+ * @brief Issue current step (non-blocking)
+ */
+static void Flow_IssueStep(FlowCtx_t *ctx)
+{
+    const BLE_FlowStep_t *s = Flow_CurrentStep(ctx);
+    BLE_Device_t *dev = BLE_DeviceManager_GetDevice(ctx->dev_idx);
+    UUID_t uuid;
+    tBleStatus ret;
+
+    if (dev == NULL) {
+        Flow_Fail(ctx, FLOW_ERR_NOT_FOUND);
+        return;
+    }
+
+    if (s->op == FLOW_OP_END) {
+        AT_Response_Send("+FLOW_DONE:%d,%s\r\n", ctx->dev_idx,
+                         flow_classes[ctx->class_idx].name);
+        Flow_Free(ctx);
+        return;
+    }
+
+    if (s->op == FLOW_OP_CONNECT) {
+        if (dev->is_connected) {
+            ctx->conn_handle = dev->conn_handle;
+            Flow_Advance(ctx);
+            return;
+        }
+
+        /* Only one connection can be created at a time: wait for slot */
+        if (connect_owner >= 0) {
+            ctx->step_tick = HAL_GetTick();
+            return;
+        }
+
+        if (BLE_Connection_CreateConnection(dev->mac_addr) != 0) {
+            Flow_Fail(ctx, FLOW_ERR_CMD_FAILED);
+            return;
+        }
+        connect_owner = (int8_t)(ctx - flows);
+        Flow_Wait(ctx);
+        return;
+    }
+
+    /* All remaining steps need a live link */
+    if (!dev->is_connected) {
+        Flow_Fail(ctx, FLOW_ERR_DISCONNECTED);
+        return;
+    }
+    ctx->conn_handle = dev->conn_handle;
+
+    switch (s->op) {
+        case FLOW_OP_MTU:
+            ret = aci_gatt_exchange_config(ctx->conn_handle);
+            if (ret != BLE_STATUS_SUCCESS) {
+                /* Already exchanged or not allowed: not fatal */
+                DEBUG_WARN("Flow dev[%d] MTU exchange skipped: 0x%02X", ctx->dev_idx, ret);
+                Flow_Advance(ctx);
+                return;
+            }
+            Flow_Wait(ctx);
+            break;
+
+        case FLOW_OP_DLE:
+            /* Completion is a controller event; no need to wait for it */
+            ret = hci_le_set_data_length(ctx->conn_handle, FLOW_DLE_TX_OCTETS, FLOW_DLE_TX_TIME);
+            if (ret != BLE_STATUS_SUCCESS) {
+                DEBUG_WARN("Flow dev[%d] DLE skipped: 0x%02X", ctx->dev_idx, ret);
+            }
+            Flow_Advance(ctx);
+            break;
+
+        case FLOW_OP_FIND_SERVICE:
+            ctx->svc_start = 0;
+            ctx->svc_end = 0;
+            uuid.UUID_16 = s->uuid;
+            ret = aci_gatt_disc_primary_service_by_uuid(ctx->conn_handle, UUID_TYPE_16, &uuid);
+            if (ret != BLE_STATUS_SUCCESS) {
+                Flow_Fail(ctx, FLOW_ERR_CMD_FAILED);
+                return;
+            }
+            Flow_Wait(ctx);
+            break;
+
+        case FLOW_OP_FIND_CHAR:
+            if (ctx->svc_start == 0) {
+                Flow_Fail(ctx, FLOW_ERR_NOT_FOUND);
+                return;
+            }
+            ctx->char_value = 0;
+            ctx->char_props = 0;
+            uuid.UUID_16 = s->uuid;
+            ret = aci_gatt_disc_char_by_uuid(ctx->conn_handle, ctx->svc_start, ctx->svc_end,
+                                             UUID_TYPE_16, &uuid);
+            if (ret != BLE_STATUS_SUCCESS) {
+                Flow_Fail(ctx, FLOW_ERR_CMD_FAILED);
+                return;
+            }
+            Flow_Wait(ctx);
+            break;
+
+        case FLOW_OP_SUBSCRIBE:
+            if (ctx->char_value == 0) {
+                Flow_Fail(ctx, FLOW_ERR_NOT_FOUND);
+                return;
+            }
+            if (ctx->phase == 0) {
+                /* Phase 0: locate CCCD between value handle and next char decl */
+                ctx->cccd = 0;
+                ctx->desc_stop = 0;
+                ret = aci_gatt_disc_all_char_desc(ctx->conn_handle, ctx->char_value, ctx->svc_end);
+            } else {
+                /* Phase 1: write CCCD */
+                if (s->arg == 2) {
+                    ret = (BLE_GATT_EnableIndication(ctx->conn_handle, ctx->cccd) == 0) ?
+                          BLE_STATUS_SUCCESS : BLE_STATUS_FAILED;
+                } else {
+                    ret = (BLE_GATT_EnableNotification(ctx->conn_handle, ctx->cccd) == 0) ?
+                          BLE_STATUS_SUCCESS : BLE_STATUS_FAILED;
+                }
+            }
+            if (ret != BLE_STATUS_SUCCESS) {
+                Flow_Fail(ctx, FLOW_ERR_CMD_FAILED);
+                return;
+            }
+            Flow_Wait(ctx);
+            break;
+
+        case FLOW_OP_READ:
+            if (ctx->char_value == 0) {
+                Flow_Fail(ctx, FLOW_ERR_NOT_FOUND);
+                return;
+            }
+            /* Value is reported as +READ by the normal read response path */
+            if (BLE_GATT_ReadCharacteristic(ctx->conn_handle, ctx->char_value) != 0) {
+                Flow_Fail(ctx, FLOW_ERR_CMD_FAILED);
+                return;
+            }
+            Flow_Wait(ctx);
+            break;
+
+        default:
+            Flow_Fail(ctx, FLOW_ERR_CMD_FAILED);
+            break;
+    }
+}
+
+/**
+ * @brief Handle completion of the step being waited on
+ */
+static void Flow_CompleteStep(FlowCtx_t *ctx, uint8_t result)
+{
+    const BLE_FlowStep_t *s = Flow_CurrentStep(ctx);
+
+    switch (s->op) {
+        case FLOW_OP_CONNECT:
+            if (result != 0) {
+                Flow_Fail(ctx, result);
+                return;
+            }
+            break;
+
+        case FLOW_OP_MTU:
+            /* Peer may reject MTU exchange; keep default MTU */
+            if (result == FLOW_ERR_DISCONNECTED) {
+                Flow_Fail(ctx, result);
+                return;
+            }
+            break;
+
+        case FLOW_OP_FIND_SERVICE:
+            if (result != 0) {
+                Flow_Fail(ctx, result);
+                return;
+            }
+            if (ctx->svc_start == 0) {
+                Flow_Fail(ctx, FLOW_ERR_NOT_FOUND);
+                return;
+            }
+            break;
+
+        case FLOW_OP_FIND_CHAR:
+            if (result != 0) {
+                Flow_Fail(ctx, result);
+                return;
+            }
+            if (ctx->char_value == 0) {
+                Flow_Fail(ctx, FLOW_ERR_NOT_FOUND);
+                return;
+            }
+            AT_Response_Send("+FLOW_CHAR:%d,0x%04X,0x%04X,0x%02X\r\n",
+                             ctx->dev_idx, s->uuid, ctx->char_value, ctx->char_props);
+            
+            /* Known SIG characteristic: report typed records from now on */
+            if (BLE_Decoder_FromUUID(s->uuid) != DECODER_NONE) {
+                BLE_Decoder_Bind(ctx->conn_handle, ctx->char_value, BLE_Decoder_FromUUID(s->uuid));
+            }
+            break;
+
+        case FLOW_OP_SUBSCRIBE:
+            if (result != 0) {
+                Flow_Fail(ctx, result);
+                return;
+            }
+            if (ctx->phase == 0) {
+                if (ctx->cccd == 0) {
+                    Flow_Fail(ctx, FLOW_ERR_NOT_FOUND);
+                    return;
+                }
+                ctx->phase = 1;
+                ctx->state = FLOW_ST_ISSUE;
+                UTIL_SEQ_SetTask(1U << CFG_TASK_GATT_FLOW_ID, CFG_SCH_PRIO_CTRL);
+                return;
+            }
+            AT_Response_Send("+FLOW_SUB:%d,0x%04X,0x%04X\r\n",
+                             ctx->dev_idx, ctx->char_value, ctx->cccd);
+            break;
+
+        default:
+            if (result != 0) {
+                Flow_Fail(ctx, result);
+                return;
+            }
+            break;
+    }
+
+    Flow_Advance(ctx);
+}
+
+/*============================================================================
+ * Sequencer Task
+ *============================================================================*/
+static void Flow_Task(void)
+{
+    uint8_t i;
+    uint8_t any_active = 0;
+    FlowCtx_t *ctx;
+
+    for (i = 0; i < BLE_FLOW_MAX_ACTIVE; i++) {
+        ctx = &flows[i];
+        if (!ctx->active) {
+            continue;
+        }
+
+        if (ctx->state == FLOW_ST_WAIT) {
+            if (ctx->done) {
+                ctx->done = 0;
+                Flow_CompleteStep(ctx, ctx->result);
+            } else if ((HAL_GetTick() - ctx->step_tick) > BLE_FLOW_STEP_TIMEOUT_MS) {
+                Flow_Fail(ctx, FLOW_ERR_TIMEOUT);
+            }
+        } else if (ctx->state == FLOW_ST_ISSUE) {
+            Flow_IssueStep(ctx);
+        }
+
+        if (ctx->active) {
+            any_active = 1;
+        }
+    }
+
+    if (!any_active && flow_timer_running) {
+        HW_TS_Stop(flow_timer_id);
+        flow_timer_running = 0;
+    }
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+void BLE_Flow_Init(void)
+{
+    memset(flows, 0, sizeof(flows));
+    connect_owner = -1;
+    flow_timer_running = 0;
+
+    UTIL_SEQ_RegTask(1U << CFG_TASK_GATT_FLOW_ID, UTIL_SEQ_RFU, Flow_Task);
+    HW_TS_Create(CFG_TIM_PROC_ID_ISR, &flow_timer_id, hw_ts_Repeated, Flow_TimerCallback);
+
+    DEBUG_INFO("GATT Flow engine initialized");
+}
+
+int BLE_Flow_Start(uint8_t dev_idx, const char *class_name)
+{
+    uint8_t i, c;
+    FlowCtx_t *ctx = NULL;
+
+    if (class_name == NULL || BLE_DeviceManager_GetDevice(dev_idx) == NULL) {
+        return -1;
+    }
+
+    for (c = 0; flow_classes[c].name != NULL; c++) {
+        if (strcmp(flow_classes[c].name, class_name) == 0) {
+            break;
+        }
+    }
+    if (flow_classes[c].name == NULL) {
+        DEBUG_ERROR("Unknown flow class: %s", class_name);
+        return -1;
+    }
+
+    if (Flow_FindByDevice(dev_idx) != NULL) {
+        DEBUG_ERROR("Flow already running on dev[%d]", dev_idx);
+        return -1;
+    }
+
+    for (i = 0; i < BLE_FLOW_MAX_ACTIVE; i++) {
+        if (!flows[i].active) {
+            ctx = &flows[i];
+            break;
+        }
+    }
+    if (ctx == NULL) {
+        return -1;
+    }
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->active = 1;
+    ctx->dev_idx = dev_idx;
+    ctx->class_idx = c;
+    ctx->conn_handle = 0xFFFF;
+    ctx->state = FLOW_ST_ISSUE;
+    ctx->step_tick = HAL_GetTick();
+
+    if (!flow_timer_running) {
+        HW_TS_Start(flow_timer_id, FLOW_TICK_TS);
+        flow_timer_running = 1;
+    }
+
+    DEBUG_INFO("Flow %s started on dev[%d]", class_name, dev_idx);
+    UTIL_SEQ_SetTask(1U << CFG_TASK_GATT_FLOW_ID, CFG_SCH_PRIO_CTRL);
+    return 0;
+}
+
+int BLE_Flow_Stop(uint8_t dev_idx)
+{
+    FlowCtx_t *ctx = Flow_FindByDevice(dev_idx);
+
+    if (ctx == NULL) {
+        return -1;
+    }
+
+    DEBUG_INFO("Flow stopped on dev[%d] at step %d", dev_idx, ctx->step);
+    Flow_Free(ctx);
+    return 0;
+}
+
+uint8_t BLE_Flow_IsActive(uint8_t dev_idx)
+{
+    return (Flow_FindByDevice(dev_idx) != NULL) ? 1U : 0U;
+}
+
+const BLE_FlowClass_t* BLE_Flow_GetClass(uint8_t class_idx)
+{
+    uint8_t c;
+
+    for (c = 0; flow_classes[c].name != NULL; c++) {
+        if (c == class_idx) {
+            return &flow_classes[c];
+        }
+    }
+    return NULL;
+}
+
+void BLE_Flow_ReportStatus(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < BLE_FLOW_MAX_ACTIVE; i++) {
+        if (flows[i].active) {
+            AT_Response_Send("+FLOW:%d,%s,%d\r\n", flows[i].dev_idx,
+                             flow_classes[flows[i].class_idx].name, flows[i].step);
+        }
+    }
+}
+
+/*============================================================================
+ * Event Hooks
+ *============================================================================*/
+void BLE_Flow_OnConnected(int dev_idx, uint16_t conn_handle, uint8_t status)
+{
+    FlowCtx_t *ctx;
+
+    if (connect_owner < 0) {
+        return;
+    }
+
+    ctx = &flows[connect_owner];
+    if (!ctx->active || ctx->state != FLOW_ST_WAIT ||
+        Flow_CurrentStep(ctx)->op != FLOW_OP_CONNECT) {
+        return;
+    }
+
+    /* Failed connect carries no reliable peer address: release slot anyway */
+    if (status == 0 && dev_idx != (int)ctx->dev_idx) {
+        return;
+    }
+
+    connect_owner = -1;
+    ctx->conn_handle = conn_handle;
+    ctx->result = status;
+    ctx->done = 1;
+    UTIL_SEQ_SetTask(1U << CFG_TASK_GATT_FLOW_ID, CFG_SCH_PRIO_CTRL);
+}
+
+void BLE_Flow_OnDisconnected(uint16_t conn_handle)
+{
+    FlowCtx_t *ctx = Flow_FindByConn(conn_handle);
+
+    if (ctx == NULL) {
+        return;
+    }
+
+    ctx->conn_handle = 0xFFFF;
+    if (ctx->state == FLOW_ST_WAIT) {
+        ctx->result = FLOW_ERR_DISCONNECTED;
+        ctx->done = 1;
+    }
+    UTIL_SEQ_SetTask(1U << CFG_TASK_GATT_FLOW_ID, CFG_SCH_PRIO_CTRL);
+}
+
+void BLE_Flow_OnServiceFound(uint16_t conn_handle, uint16_t start_handle, uint16_t end_handle)
+{
+    FlowCtx_t *ctx = Flow_FindByConn(conn_handle);
+
+    if (ctx == NULL || ctx->state != FLOW_ST_WAIT || ctx->svc_start != 0) {
+        return;
+    }
+
+    ctx->svc_start = start_handle;
+    ctx->svc_end = end_handle;
+}
+
+void BLE_Flow_OnCharFound(uint16_t conn_handle, uint8_t properties, uint16_t value_handle)
+{
+    FlowCtx_t *ctx = Flow_FindByConn(conn_handle);
+
+    if (ctx == NULL || ctx->state != FLOW_ST_WAIT || ctx->char_value != 0) {
+        return;
+    }
+
+    ctx->char_props = properties;
+    ctx->char_value = value_handle;
+}
+
+void BLE_Flow_OnDescriptorFound(uint16_t conn_handle, uint16_t handle, uint16_t uuid)
+{
+    FlowCtx_t *ctx = Flow_FindByConn(conn_handle);
+
+    if (ctx == NULL || ctx->state != FLOW_ST_WAIT || ctx->desc_stop) {
+        return;
+    }
+
+    if (uuid == FLOW_UUID_CHAR_DECL) {
+        /* Next characteristic reached: no CCCD on ours beyond this point */
+        ctx->desc_stop = 1;
+    } else if (uuid == FLOW_UUID_CCCD && ctx->cccd == 0) {
+        ctx->cccd = handle;
+    }
+}
+
+uint8_t BLE_Flow_OnProcComplete(uint16_t conn_handle, uint8_t error_code)
+{
+    FlowCtx_t *ctx = Flow_FindByConn(conn_handle);
+
+    if (ctx == NULL || ctx->state != FLOW_ST_WAIT ||
+        Flow_CurrentStep(ctx)->op == FLOW_OP_CONNECT) {
+        return 0;
+    }
+
+    ctx->result = error_code;
+    ctx->done = 1;
+    UTIL_SEQ_SetTask(1U << CFG_TASK_GATT_FLOW_ID, CFG_SCH_PRIO_CTRL);
+    return 1;
+}
@@ -0,0 +1,369 @@
+/**
+  ******************************************************************************
+  * @file    ble_gatt_queue.c
+  * @brief   Per-link GATT operation queues implementation
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#define DEBUG_MODULE DEBUG_MOD_GATT
+
+#include "ble_gatt_queue.h"
+#include "ble_gatt_client.h"
+#include "ble_gatt_flow.h"
+#include "ble_device_manager.h"
+#include "ble_connection.h"
+#include "debug_trace.h"
+#include "ble_gatt_aci.h"
+#include "app_conf.h"
+#include "stm32_seq.h"
+#include <string.h>
+
+/*============================================================================
+ * Constants
+ *============================================================================*/
+#define GATTQ_CCCD_SEARCH_SPAN  4U      /* Descriptors scanned after value handle */
+#define GATTQ_UUID_CHAR_DECL    0x2803
+#define GATTQ_UUID_CCCD         0x2902
+
+typedef enum {
+    GATTQ_PH_RESOLVE = 0,       /* Char UUID -> value handle */
+    GATTQ_PH_FIND_CCCD,         /* Value handle -> CCCD handle */
+    GATTQ_PH_EXEC,              /* Read / write / CCCD write */
+} GattQueuePhase_t;
+
+typedef struct {
+    uint16_t conn_handle;               /* 0xFFFF = slot free */
+    uint8_t head;
+    uint8_t count;
+    uint8_t in_flight;
+    uint8_t phase;
+    uint8_t desc_stop;
+    volatile uint8_t closed;            /* Link dropped: flush */
+    volatile uint8_t done;
+    volatile uint8_t result;
+    uint16_t handle;                    /* Resolved value handle */
+    uint16_t cccd;
+    BLE_GattQueueOp_t ops[BLE_GATTQ_DEPTH];
+} LinkQueue_t;
+
+static LinkQueue_t queues[MAX_BLE_CONNECTIONS];
+
+/*============================================================================
+ * Static Helper Functions
+ *============================================================================*/
+
+static void GattQueue_Schedule(void)
+{
+    UTIL_SEQ_SetTask(1U << CFG_TASK_GATT_QUEUE_ID, CFG_SCH_PRIO_CTRL);
+}
+
+static LinkQueue_t* GattQueue_Find(uint16_t conn_handle)
+{
+    uint8_t i;
+
+    for (i = 0; i < MAX_BLE_CONNECTIONS; i++) {
+        if (queues[i].conn_handle == conn_handle) {
+            return &queues[i];
+        }
+    }
+    return NULL;
+}
+
+static void GattQueue_StartHead(LinkQueue_t *q)
+{
+    const BLE_GattQueueOp_t *op = &q->ops[q->head];
+
+    q->in_flight = 0;
+    q->handle = op->by_uuid ? 0 : op->target;
+    q->cccd = 0;
+
+    if (op->by_uuid) {
+        q->phase = GATTQ_PH_RESOLVE;
+    } else {
+        /* Handle-addressed SUBSCRIBE targets the CCCD directly */
+        q->phase = GATTQ_PH_EXEC;
+        if (op->type == GATTQ_OP_SUBSCRIBE) {
+            q->cccd = op->target;
+        }
+    }
+}
+
+/**
+ * @brief Complete head op, report, and move to next
+ */
+static void GattQueue_Finish(LinkQueue_t *q, uint8_t status)
+{
+    BLE_GattQueueOp_t op = q->ops[q->head];
+    uint16_t conn_handle = q->conn_handle;
+    uint16_t handle = (op.type == GATTQ_OP_SUBSCRIBE) ? q->cccd : q->handle;
+
+    q->head = (uint8_t)((q->head + 1U) % BLE_GATTQ_DEPTH);
+    q->count--;
+    q->in_flight = 0;
+
+    if (q->count > 0) {
+        GattQueue_StartHead(q);
+        GattQueue_Schedule();
+    }
+
+    if (op.cb) {
+        op.cb(conn_handle, handle, status, op.tag);
+    }
+}
+
+/**
+ * @brief Issue current phase of head op (non-blocking)
+ */
+static void GattQueue_Issue(LinkQueue_t *q)
+{
+    const BLE_GattQueueOp_t *op = &q->ops[q->head];
+    tBleStatus ret = BLE_STATUS_SUCCESS;
+    int rc = 0;
+    UUID_t uuid;
+
+    switch (q->phase) {
+        case GATTQ_PH_RESOLVE:
+            uuid.UUID_16 = op->target;
+            ret = aci_gatt_disc_char_by_uuid(q->conn_handle, 0x0001, 0xFFFF, UUID_TYPE_16, &uuid);
+            break;
+
+        case GATTQ_PH_FIND_CCCD:
+            q->desc_stop = 0;
+            ret = aci_gatt_disc_all_char_desc(q->conn_handle, q->handle,
+                                              (uint16_t)(q->handle + GATTQ_CCCD_SEARCH_SPAN));
+            break;
+
+        default:
+            if (op->type == GATTQ_OP_READ) {
+                rc = BLE_GATT_ReadCharacteristic(q->conn_handle, q->handle);
+            } else if (op->type == GATTQ_OP_WRITE) {
+                rc = BLE_GATT_WriteCharacteristic(q->conn_handle, q->handle, op->data, op->len);
+            } else if (op->arg == 2) {
+                rc = BLE_GATT_EnableIndication(q->conn_handle, q->cccd);
+            } else if (op->arg == 1) {
+                rc = BLE_GATT_EnableNotification(q->conn_handle, q->cccd);
+            } else {
+                rc = BLE_GATT_DisableNotification(q->conn_handle, q->cccd);
+            }
+            break;
+    }
+
+    if (ret != BLE_STATUS_SUCCESS || rc != 0) {
+        GattQueue_Finish(q, GATTQ_ERR_CMD_FAILED);
+        return;
+    }
+
+    q->done = 0;
+    q->result = 0;
+    q->in_flight = 1;
+}
+
+/**
+ * @brief Handle completion of the in-flight phase
+ */
+static void GattQueue_Complete(LinkQueue_t *q, uint8_t result)
+{
+    const BLE_GattQueueOp_t *op = &q->ops[q->head];
+
+    q->in_flight = 0;
+
+    if (result != 0) {
+        GattQueue_Finish(q, result);
+        return;
+    }
+
+    switch (q->phase) {
+        case GATTQ_PH_RESOLVE:
+            if (q->handle == 0) {
+                GattQueue_Finish(q, GATTQ_ERR_NOT_FOUND);
+                return;
+            }
+            q->phase = (op->type == GATTQ_OP_SUBSCRIBE) ? GATTQ_PH_FIND_CCCD : GATTQ_PH_EXEC;
+            break;
+
+        case GATTQ_PH_FIND_CCCD:
+            if (q->cccd == 0) {
+                GattQueue_Finish(q, GATTQ_ERR_NOT_FOUND);
+                return;
+            }
+            q->phase = GATTQ_PH_EXEC;
+            break;
+
+        default:
+            GattQueue_Finish(q, 0);
+            return;
+    }
+
+    GattQueue_Schedule();
+}
+
+/*============================================================================
+ * Sequencer Task
+ *============================================================================*/
+static void GattQueue_Task(void)
+{
+    uint8_t i;
+    LinkQueue_t *q;
+
+    for (i = 0; i < MAX_BLE_CONNECTIONS; i++) {
+        q = &queues[i];
+        if (q->conn_handle == 0xFFFF) {
+            continue;
+        }
+
+        if (q->closed) {
+            while (q->count > 0) {
+                GattQueue_Finish(q, GATTQ_ERR_DISCONNECTED);
+            }
+            q->closed = 0;
+            q->conn_handle = 0xFFFF;
+            continue;
+        }
+
+        if (q->count == 0) {
+            /* Release slot for other links */
+            q->conn_handle = 0xFFFF;
+            continue;
+        }
+
+        if (q->in_flight) {
+            if (q->done) {
+                q->done = 0;
+                GattQueue_Complete(q, q->result);
+            }
+            continue;
+        }
+
+        /* A running flow owns the link's ATT bearer */
+        if (BLE_Flow_IsActive((uint8_t)BLE_DeviceManager_FindConnHandle(q->conn_handle))) {
+            continue;
+        }
+
+        GattQueue_Issue(q);
+    }
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+void BLE_GattQueue_Init(void)
+{
+    uint8_t i;
+
+    memset(queues, 0, sizeof(queues));
+    for (i = 0; i < MAX_BLE_CONNECTIONS; i++) {
+        queues[i].conn_handle = 0xFFFF;
+    }
+
+    UTIL_SEQ_RegTask(1U << CFG_TASK_GATT_QUEUE_ID, UTIL_SEQ_RFU, GattQueue_Task);
+
+    DEBUG_INFO("GATT queues initialized");
+}
+
+int BLE_GattQueue_Push(uint16_t conn_handle, const BLE_GattQueueOp_t *op)
+{
+    LinkQueue_t *q;
+    uint8_t i;
+
+    if (op == NULL || conn_handle == 0xFFFF) {
+        return -1;
+    }
+
+    q = GattQueue_Find(conn_handle);
+    if (q == NULL) {
+        for (i = 0; i < MAX_BLE_CONNECTIONS; i++) {
+            if (queues[i].conn_handle == 0xFFFF) {
+                q = &queues[i];
+                memset(q, 0, sizeof(*q));
+                q->conn_handle = conn_handle;
+                break;
+            }
+        }
+    }
+
+    if (q == NULL || q->count >= BLE_GATTQ_DEPTH || q->closed) {
+        DEBUG_WARN("GATT queue full: conn=0x%04X", conn_handle);
+        return -1;
+    }
+
+    q->ops[(q->head + q->count) % BLE_GATTQ_DEPTH] = *op;
+    q->count++;
+    if (q->count == 1U) {
+        GattQueue_StartHead(q);
+    }
+
+    GattQueue_Schedule();
+    return 0;
+}
+
+uint8_t BLE_GattQueue_Pending(uint16_t conn_handle)
+{
+    LinkQueue_t *q = GattQueue_Find(conn_handle);
+
+    return (q != NULL) ? q->count : 0U;
+}
+
+const BLE_GattQueueOp_t* BLE_GattQueue_InFlight(uint16_t conn_handle, uint16_t *handle)
+{
+    LinkQueue_t *q = GattQueue_Find(conn_handle);
+
+    if (q == NULL || q->count == 0 || !q->in_flight || q->phase != GATTQ_PH_EXEC) {
+        return NULL;
+    }
+    if (handle != NULL) {
+        *handle = q->handle;
+    }
+    return &q->ops[q->head];
+}
+
+/*============================================================================
+ * Event Hooks
+ *============================================================================*/
+void BLE_GattQueue_OnCharFound(uint16_t conn_handle, uint16_t value_handle)
+{
+    LinkQueue_t *q = GattQueue_Find(conn_handle);
+
+    if (q != NULL && q->in_flight && q->phase == GATTQ_PH_RESOLVE && q->handle == 0) {
+        q->handle = value_handle;
+    }
+}
+
+void BLE_GattQueue_OnDescriptorFound(uint16_t conn_handle, uint16_t handle, uint16_t uuid)
+{
+    LinkQueue_t *q = GattQueue_Find(conn_handle);
+
+    if (q == NULL || !q->in_flight || q->phase != GATTQ_PH_FIND_CCCD || q->desc_stop) {
+        return;
+    }
+
+    if (uuid == GATTQ_UUID_CHAR_DECL) {
+        q->desc_stop = 1;
+    } else if (uuid == GATTQ_UUID_CCCD && q->cccd == 0) {
+        q->cccd = handle;
+    }
+}
+
+void BLE_GattQueue_OnDisconnected(uint16_t conn_handle)
+{
+    LinkQueue_t *q = GattQueue_Find(conn_handle);
+
+    if (q != NULL) {
+        q->closed = 1;
+        GattQueue_Schedule();
+    }
+}
+
+uint8_t BLE_GattQueue_OnProcComplete(uint16_t conn_handle, uint8_t error_code)
+{
+    LinkQueue_t *q = GattQueue_Find(conn_handle);
+
+    if (q == NULL || !q->in_flight) {
+        return 0;
+    }
+
+    q->result = error_code;
+    q->done = 1;
+    GattQueue_Schedule();
+    return 1;
+}
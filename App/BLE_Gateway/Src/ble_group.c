@@ -0,0 +1,271 @@
+/**
+  ******************************************************************************
+  * @file    ble_group.c
+  * @brief   Device groups and group GATT operations implementation
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#define DEBUG_MODULE DEBUG_MOD_GATT
+
+#include "ble_group.h"
+#include "ble_device_manager.h"
+#include "at_command.h"
+#include "debug_trace.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*============================================================================
+ * State
+ *============================================================================*/
+typedef struct {
+    uint8_t busy;
+    uint8_t tag;                        /* Incremented per group op */
+    uint8_t type;
+    uint8_t total;
+    uint8_t completed;
+    uint8_t ok;
+    uint8_t data[BLE_GROUP_MAX_DATA];
+} GroupOp_t;
+
+static BLE_Group_t groups[BLE_GROUP_MAX];
+static GroupOp_t group_op;
+
+static const char * const group_op_names[] = { "GREAD", "GWRITE", "GSUB" };
+
+/*============================================================================
+ * Static Helper Functions
+ *============================================================================*/
+
+static uint8_t Group_Matches(const BLE_Group_t *g, uint8_t idx, const BLE_Device_t *dev)
+{
+    switch (g->type) {
+        case GROUP_TYPE_LIST:
+            return (g->members & (1UL << idx)) ? 1U : 0U;
+        case GROUP_TYPE_ALL:
+            return 1U;
+        case GROUP_TYPE_NAME:
+            return (strncmp(dev->name, g->name_prefix, strlen(g->name_prefix)) == 0) ? 1U : 0U;
+        case GROUP_TYPE_RSSI:
+            return (dev->rssi >= g->rssi_min) ? 1U : 0U;
+        default:
+            return 0U;
+    }
+}
+
+/**
+ * @brief Per-link completion from the GATT queues (task context)
+ */
+static void Group_OnOpComplete(uint16_t conn_handle, uint16_t handle, uint8_t status, uint8_t tag)
+{
+    (void)handle;
+
+    if (!group_op.busy || tag != group_op.tag) {
+        return;
+    }
+
+    group_op.completed++;
+    if (status == 0) {
+        group_op.ok++;
+    } else {
+        AT_Response_Send("+GFAIL:%d,0x%02X\r\n",
+                         BLE_DeviceManager_FindConnHandle(conn_handle), status);
+    }
+
+    if (group_op.completed >= group_op.total) {
+        AT_Response_Send("+GDONE:%s,%d,%d\r\n", group_op_names[group_op.type],
+                         group_op.ok, group_op.total);
+        group_op.busy = 0;
+    }
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+void BLE_Group_Init(void)
+{
+    memset(groups, 0, sizeof(groups));
+    memset(&group_op, 0, sizeof(group_op));
+    DEBUG_INFO("Groups initialized");
+}
+
+int BLE_Group_Define(uint8_t gid, const char *spec)
+{
+    BLE_Group_t g;
+    const char *p;
+
+    if (gid >= BLE_GROUP_MAX || spec == NULL || spec[0] == '\0') {
+        return -1;
+    }
+
+    memset(&g, 0, sizeof(g));
+
+    if (strcmp(spec, "NONE") == 0) {
+        g.type = GROUP_TYPE_NONE;
+    } else if (strcmp(spec, "ALL") == 0) {
+        g.type = GROUP_TYPE_ALL;
+    } else if (strncmp(spec, "NAME:", 5) == 0) {
+        if (spec[5] == '\0' || strlen(&spec[5]) >= BLE_GROUP_NAME_PREFIX_LEN) {
+            return -1;
+        }
+        g.type = GROUP_TYPE_NAME;
+        strncpy(g.name_prefix, &spec[5], BLE_GROUP_NAME_PREFIX_LEN - 1);
+    } else if (strncmp(spec, "RSSI:", 5) == 0) {
+        long rssi = strtol(&spec[5], NULL, 10);
+        if (rssi < -127 || rssi > 20) {
+            return -1;
+        }
+        g.type = GROUP_TYPE_RSSI;
+        g.rssi_min = (int8_t)rssi;
+    } else {
+        /* Device index list: "1;2;5" */
+        g.type = GROUP_TYPE_LIST;
+        p = spec;
+        while (*p != '\0') {
+            char *end;
+            unsigned long idx = strtoul(p, &end, 10);
+            if (end == p || idx >= MAX_BLE_DEVICES) {
+                return -1;
+            }
+            g.members |= (1UL << idx);
+            p = end;
+            if (*p == ';') {
+                p++;
+            } else if (*p != '\0') {
+                return -1;
+            }
+        }
+    }
+
+    groups[gid] = g;
+    DEBUG_INFO("Group %d defined: %s", gid, spec);
+    return 0;
+}
+
+uint32_t BLE_Group_Resolve(uint8_t gid)
+{
+    const BLE_Group_t *g;
+    BLE_Device_t *dev;
+    uint32_t mask = 0;
+    uint8_t i, count;
+
+    if (gid >= BLE_GROUP_MAX) {
+        return 0;
+    }
+    g = &groups[gid];
+
+    count = BLE_DeviceManager_GetCount();
+    for (i = 0; i < count; i++) {
+        dev = BLE_DeviceManager_GetDevice(i);
+        if (dev != NULL && dev->is_connected && Group_Matches(g, i, dev)) {
+            mask |= (1UL << i);
+        }
+    }
+    return mask;
+}
+
+uint8_t BLE_Group_IsBusy(void)
+{
+    return group_op.busy;
+}
+
+int BLE_Group_Run(uint8_t gid, BLE_GattQueueOpType_t type, uint8_t by_uuid,
+                  uint16_t target, uint8_t arg, const uint8_t *data, uint16_t len)
+{
+    BLE_GattQueueOp_t op;
+    BLE_Device_t *dev;
+    uint32_t mask;
+    uint8_t i, queued = 0;
+
+    if (group_op.busy || len > BLE_GROUP_MAX_DATA) {
+        return -1;
+    }
+
+    mask = BLE_Group_Resolve(gid);
+    if (mask == 0) {
+        return -1;
+    }
+
+    group_op.tag++;
+    group_op.type = (uint8_t)type;
+    group_op.completed = 0;
+    group_op.ok = 0;
+    group_op.total = 0;
+    if (data != NULL && len > 0) {
+        memcpy(group_op.data, data, len);
+    }
+
+    memset(&op, 0, sizeof(op));
+    op.type = (uint8_t)type;
+    op.arg = arg;
+    op.by_uuid = by_uuid;
+    op.target = target;
+    op.data = group_op.data;
+    op.len = len;
+    op.tag = group_op.tag;
+    op.cb = Group_OnOpComplete;
+
+    /* Busy is set first: a queued op cannot complete before this returns */
+    group_op.busy = 1;
+
+    for (i = 0; i < MAX_BLE_DEVICES; i++) {
+        if ((mask & (1UL << i)) == 0) {
+            continue;
+        }
+        dev = BLE_DeviceManager_GetDevice(i);
+        if (dev == NULL) {
+            continue;
+        }
+        group_op.total++;
+        if (BLE_GattQueue_Push(dev->conn_handle, &op) == 0) {
+            queued++;
+        } else {
+            /* Counts as completed-with-error */
+            group_op.completed++;
+            AT_Response_Send("+GFAIL:%d,0x%02X\r\n", i, GATTQ_ERR_CMD_FAILED);
+        }
+    }
+
+    if (queued == 0) {
+        group_op.busy = 0;
+        return -1;
+    }
+
+    DEBUG_INFO("Group %d %s queued on %d links", gid, group_op_names[type], queued);
+    return queued;
+}
+
+void BLE_Group_Report(void)
+{
+    uint8_t gid, i;
+    const BLE_Group_t *g;
+    const char *sep;
+
+    for (gid = 0; gid < BLE_GROUP_MAX; gid++) {
+        g = &groups[gid];
+        switch (g->type) {
+            case GROUP_TYPE_ALL:
+                AT_Response_Send("+GROUP:%d,ALL\r\n", gid);
+                break;
+            case GROUP_TYPE_NAME:
+                AT_Response_Send("+GROUP:%d,NAME:%s\r\n", gid, g->name_prefix);
+                break;
+            case GROUP_TYPE_RSSI:
+                AT_Response_Send("+GROUP:%d,RSSI:%d\r\n", gid, (int)g->rssi_min);
+                break;
+            case GROUP_TYPE_LIST:
+                AT_Response_Send("+GROUP:%d,", gid);
+                sep = "";
+                for (i = 0; i < MAX_BLE_DEVICES; i++) {
+                    if (g->members & (1UL << i)) {
+                        AT_Response_Send("%s%d", sep, i);
+                        sep = ";";
+                    }
+                }
+                AT_Response_Send("\r\n");
+                break;
+            default:
+                break;
+        }
+    }
+}
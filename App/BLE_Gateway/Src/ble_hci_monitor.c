@@ -0,0 +1,247 @@
+/**
+  ******************************************************************************
+  * @file    ble_hci_monitor.c
+  * @brief   HCI event queue and event pool telemetry implementation
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#define DEBUG_MODULE DEBUG_MOD_BLE
+
+#include "ble_hci_monitor.h"
+#include "ble_connection.h"
+#include "ble_device_manager.h"
+#include "at_command.h"
+#include "debug_trace.h"
+#include "app_common.h"
+#include "app_entry.h"
+#include "hci_tl.h"
+#include "ble_hal_aci.h"
+#include "main.h"
+#include <string.h>
+
+/*============================================================================
+ * State
+ *============================================================================*/
+typedef struct {
+    uint32_t events;
+    uint16_t max_depth;
+    uint32_t pool_max;                  /* Bytes */
+    uint64_t wait_cycles;               /* Queued -> taken for processing */
+    uint32_t wait_max;
+    uint32_t timed;
+    uint32_t throttles;
+} HciMonStats_t;
+
+/* Updated from the IPCC RX interrupt and the HCI event task */
+static volatile uint16_t mon_depth = 0;
+static volatile uint32_t mon_pool_used = 0;
+
+/* Arrival times of the oldest queued events (FIFO with the queue). Events
+   queued while it is full, and all after them until they drain, are not
+   timed, so each time stays paired with its event */
+static uint32_t mon_ts[BLE_HCIMON_TS_DEPTH];
+static uint8_t mon_ts_head = 0;
+static uint8_t mon_ts_count = 0;
+static uint16_t mon_untimed = 0;
+
+static HciMonStats_t mon_stats;
+
+static uint8_t mon_scan_active = 0;
+static uint8_t mon_throttled = 0;
+static uint32_t mon_calm_since = 0;     /* 0: usage above the resume level */
+
+/*============================================================================
+ * Static Helper Functions
+ *============================================================================*/
+
+/**
+ * @brief Pool bytes taken by an event (4-byte aligned allocation)
+ */
+static uint32_t HciMon_EvtSize(const TL_EvtPacket_t *pevt)
+{
+    return DIVC(sizeof(TL_PacketHeader_t) + TL_EVT_HDR_SIZE + pevt->evtserial.evt.plen, 4U) * 4U;
+}
+
+static uint32_t HciMon_UsagePct(uint32_t bytes)
+{
+    return (APPE_EvtPoolSize > 0U) ? ((bytes * 100U) / APPE_EvtPoolSize) : 0U;
+}
+
+static uint32_t HciMon_CyclesToUs(uint64_t cycles)
+{
+    uint32_t per_us = SystemCoreClock / 1000000U;
+
+    return (uint32_t)(cycles / ((per_us > 0U) ? per_us : 1U));
+}
+
+/**
+ * @brief Slow down or restore scanning from the pool usage (HCI event task)
+ */
+static void HciMon_Adapt(uint32_t pct)
+{
+    uint32_t now = HAL_GetTick();
+
+    if (!mon_scan_active) {
+        return;
+    }
+
+    if (!mon_throttled) {
+        if (pct >= BLE_HCIMON_THROTTLE_PCT &&
+            BLE_Connection_ThrottleScan(1) == 0) {
+            mon_throttled = 1;
+            mon_calm_since = 0;
+            mon_stats.throttles++;
+            DEBUG_WARN("Event pool %lu%% used, scan throttled", pct);
+        }
+        return;
+    }
+
+    if (pct >= BLE_HCIMON_RESUME_PCT) {
+        mon_calm_since = 0;
+        return;
+    }
+    if (mon_calm_since == 0) {
+        mon_calm_since = (now != 0U) ? now : 1U;
+        return;
+    }
+    if ((now - mon_calm_since) >= BLE_HCIMON_RESUME_MS &&
+        BLE_Connection_ThrottleScan(0) == 0) {
+        mon_throttled = 0;
+        DEBUG_INFO("Event pool calm, scan at full duty");
+    }
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+void BLE_HciMon_Init(void)
+{
+    memset(&mon_stats, 0, sizeof(mon_stats));
+    mon_scan_active = 0;
+    mon_throttled = 0;
+    mon_calm_since = 0;
+
+    DEBUG_INFO("HCI monitor initialized: event pool %lu bytes", APPE_EvtPoolSize);
+}
+
+void BLE_HciMon_OnScan(uint8_t active)
+{
+    mon_scan_active = active;
+    mon_throttled = 0;
+    mon_calm_since = 0;
+}
+
+void BLE_HciMon_Report(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    HciMonStats_t s;
+    uint16_t depth;
+    uint32_t used;
+    uint8_t tx = 0, rx = 0, mblocks = 0;
+
+    __disable_irq();
+    s = mon_stats;
+    depth = mon_depth;
+    used = mon_pool_used;
+    __set_PRIMASK(primask);
+
+    AT_Response_Send("+HCIEVT:%u,%u,%lu,%lu,%lu,%lu,%lu,%lu,%u,%lu\r\n",
+                     depth, s.max_depth, used, s.pool_max, APPE_EvtPoolSize, s.events,
+                     HciMon_CyclesToUs((s.timed > 0U) ? (s.wait_cycles / s.timed) : 0U),
+                     HciMon_CyclesToUs(s.wait_max), mon_throttled, s.throttles);
+
+    if (aci_hal_get_pm_debug_info(&tx, &rx, &mblocks) == BLE_STATUS_SUCCESS) {
+        AT_Response_Send("+HCIMEM:%u,%u,%u\r\n", tx, rx, mblocks);
+    }
+}
+
+void BLE_HciMon_Reset(void)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    memset(&mon_stats, 0, sizeof(mon_stats));
+    mon_stats.max_depth = mon_depth;
+    mon_stats.pool_max = mon_pool_used;
+    __set_PRIMASK(primask);
+}
+
+/*============================================================================
+ * hci_tl.c Hooks
+ *============================================================================*/
+
+/* Overrides the weak hook: IPCC RX interrupt for HCI_TL_EvtQueued */
+void hci_notify_evt_stage(HCI_TL_EvtStage_t stage, TL_EvtPacket_t *pevt)
+{
+    uint32_t primask = __get_PRIMASK();
+    uint32_t now = DWT->CYCCNT;
+    uint32_t wait, pct = 0;
+    uint8_t adapt = 0;
+
+    __disable_irq();
+    switch (stage) {
+    case HCI_TL_EvtQueued:
+        mon_stats.events++;
+        mon_depth++;
+        if (mon_depth > mon_stats.max_depth) {
+            mon_stats.max_depth = mon_depth;
+        }
+        mon_pool_used += HciMon_EvtSize(pevt);
+        if (mon_pool_used > mon_stats.pool_max) {
+            mon_stats.pool_max = mon_pool_used;
+        }
+        if (mon_untimed == 0 && mon_ts_count < BLE_HCIMON_TS_DEPTH) {
+            mon_ts[(mon_ts_head + mon_ts_count) % BLE_HCIMON_TS_DEPTH] = now;
+            mon_ts_count++;
+        } else {
+            mon_untimed++;
+        }
+        break;
+
+    case HCI_TL_EvtDequeued:
+        if (mon_depth > 0) {
+            mon_depth--;
+        }
+        if (mon_ts_count > 0) {
+            wait = now - mon_ts[mon_ts_head];
+            mon_ts_head = (uint8_t)((mon_ts_head + 1U) % BLE_HCIMON_TS_DEPTH);
+            mon_ts_count--;
+            mon_stats.timed++;
+            mon_stats.wait_cycles += wait;
+            if (wait > mon_stats.wait_max) {
+                mon_stats.wait_max = wait;
+            }
+        } else if (mon_untimed > 0) {
+            mon_untimed--;
+        }
+        /* Held bytes include this event and everything queued behind it */
+        pct = HciMon_UsagePct(mon_pool_used);
+        adapt = 1;
+        break;
+
+    case HCI_TL_EvtRequeued:
+        /* Back at the head: timed again from now */
+        mon_depth++;
+        if (mon_untimed == 0 && mon_ts_count < BLE_HCIMON_TS_DEPTH) {
+            mon_ts_head = (uint8_t)((mon_ts_head + BLE_HCIMON_TS_DEPTH - 1U) % BLE_HCIMON_TS_DEPTH);
+            mon_ts[mon_ts_head] = now;
+            mon_ts_count++;
+        }
+        break;
+
+    case HCI_TL_EvtReleased:
+        wait = HciMon_EvtSize(pevt);
+        mon_pool_used = (mon_pool_used > wait) ? (mon_pool_used - wait) : 0U;
+        break;
+
+    default:
+        break;
+    }
+    __set_PRIMASK(primask);
+
+    /* Task context: may queue HCI commands */
+    if (adapt) {
+        HciMon_Adapt(pct);
+    }
+}
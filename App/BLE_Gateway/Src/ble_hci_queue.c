@@ -0,0 +1,227 @@
+/**
+  ******************************************************************************
+  * @file    ble_hci_queue.c
+  * @brief   Asynchronous ACI/HCI command queue implementation
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#define DEBUG_MODULE DEBUG_MOD_BLE
+
+#include "ble_hci_queue.h"
+#include "at_command.h"
+#include "debug_trace.h"
+#include "app_conf.h"
+#include "main.h"
+#include "hci_tl.h"
+#include "stm32_seq.h"
+#include <string.h>
+
+/*============================================================================
+ * State
+ *============================================================================*/
+typedef struct {
+    uint16_t opcode;
+    uint8_t plen;
+    uint8_t param[BLE_HCIQ_PARAM_MAX];
+    BLE_HciQueueCb_t cb;
+    uint32_t tag;
+    uint32_t queued_at;                 /* CYCCNT */
+} HciQueueCmd_t;
+
+typedef struct {
+    uint32_t sent;
+    uint32_t errors;                    /* Non-zero status */
+    uint32_t full;                      /* Rejected: queue full */
+    uint8_t max_depth;
+    uint64_t wait_cycles;               /* Queued -> sent */
+    uint32_t wait_max;
+    uint64_t rsp_cycles;                /* Sent -> response */
+    uint32_t rsp_max;
+    uint32_t completed;
+} HciQueueStats_t;
+
+static HciQueueCmd_t hciq_cmds[BLE_HCIQ_DEPTH];
+static uint8_t hciq_head = 0;
+static uint8_t hciq_count = 0;
+
+/* Command in flight: callback and timing kept once it left the queue */
+static volatile uint8_t hciq_in_flight = 0;
+static BLE_HciQueueCb_t hciq_cb = 0;
+static uint32_t hciq_tag = 0;
+static uint32_t hciq_sent_at = 0;
+
+static HciQueueStats_t hciq_stats;
+
+/*============================================================================
+ * Static Helper Functions
+ *============================================================================*/
+
+static void HciQueue_Schedule(void)
+{
+    UTIL_SEQ_SetTask(1U << CFG_TASK_HCI_CMDQ_ID, CFG_SCH_PRIO_CTRL);
+}
+
+static uint32_t HciQueue_CyclesToUs(uint64_t cycles)
+{
+    uint32_t per_us = SystemCoreClock / 1000000U;
+
+    return (uint32_t)(cycles / ((per_us > 0U) ? per_us : 1U));
+}
+
+/**
+ * @brief hci_tl.c completion: the transport is free again
+ */
+static void HciQueue_OnDone(uint16_t opcode, const uint8_t *rparam, uint8_t rlen)
+{
+    uint32_t rsp = DWT->CYCCNT - hciq_sent_at;
+    uint8_t status = (rlen > 0U) ? rparam[0] : HCIQ_ERR_NO_STATUS;
+    BLE_HciQueueCb_t cb = hciq_cb;
+
+    hciq_in_flight = 0;
+    hciq_stats.completed++;
+    hciq_stats.rsp_cycles += rsp;
+    if (rsp > hciq_stats.rsp_max) {
+        hciq_stats.rsp_max = rsp;
+    }
+    if (status != 0) {
+        hciq_stats.errors++;
+        DEBUG_WARN("HCI cmd 0x%04X status 0x%02X", opcode, status);
+    }
+
+    /* May queue more: HciQueue_Task sends the next one right after */
+    if (cb != 0) {
+        cb(opcode, status, rparam, rlen, hciq_tag);
+    }
+}
+
+/**
+ * @brief Send the head command if the transport is free
+ */
+static void HciQueue_Issue(void)
+{
+    HciQueueCmd_t *cmd;
+    uint32_t wait;
+
+    if (hciq_in_flight || hciq_count == 0) {
+        return;
+    }
+
+    cmd = &hciq_cmds[hciq_head];
+    hciq_in_flight = 1;
+    hciq_cb = cmd->cb;
+    hciq_tag = cmd->tag;
+    hciq_sent_at = DWT->CYCCNT;
+
+    /* A blocking ACI call owns the buffer: retried when it ends */
+    if (hci_send_cmd_async(cmd->opcode, cmd->plen, cmd->param, HciQueue_OnDone) != 0) {
+        hciq_in_flight = 0;
+        return;
+    }
+
+    wait = hciq_sent_at - cmd->queued_at;
+    hciq_stats.sent++;
+    hciq_stats.wait_cycles += wait;
+    if (wait > hciq_stats.wait_max) {
+        hciq_stats.wait_max = wait;
+    }
+
+    hciq_head = (uint8_t)((hciq_head + 1U) % BLE_HCIQ_DEPTH);
+    hciq_count--;
+}
+
+/* Sequencer task: report the response, then send the next command back to
+   back. Called inside a blocking hci_send_req(), the callback runs from
+   there and the next command waits for its end (hci_notify_cmd_async()) */
+static void HciQueue_Task(void)
+{
+    hci_cmd_async_proc();
+    HciQueue_Issue();
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+void BLE_HciQueue_Init(void)
+{
+    hciq_head = 0;
+    hciq_count = 0;
+    hciq_in_flight = 0;
+    memset(&hciq_stats, 0, sizeof(hciq_stats));
+
+    UTIL_SEQ_RegTask(1U << CFG_TASK_HCI_CMDQ_ID, UTIL_SEQ_RFU, HciQueue_Task);
+
+    DEBUG_INFO("HCI command queue initialized");
+}
+
+int BLE_HciQueue_Send(uint16_t opcode, const void *param, uint8_t plen,
+                      BLE_HciQueueCb_t cb, uint32_t tag)
+{
+    HciQueueCmd_t *cmd;
+    uint8_t depth;
+
+    if (plen > BLE_HCIQ_PARAM_MAX) {
+        return -1;
+    }
+    if (hciq_count >= BLE_HCIQ_DEPTH) {
+        hciq_stats.full++;
+        DEBUG_WARN("HCI queue full, cmd 0x%04X rejected", opcode);
+        return -1;
+    }
+
+    cmd = &hciq_cmds[(hciq_head + hciq_count) % BLE_HCIQ_DEPTH];
+    cmd->opcode = opcode;
+    cmd->plen = plen;
+    if (plen > 0U) {
+        memcpy(cmd->param, param, plen);
+    }
+    cmd->cb = cb;
+    cmd->tag = tag;
+    cmd->queued_at = DWT->CYCCNT;
+    hciq_count++;
+
+    depth = (uint8_t)(hciq_count + hciq_in_flight);
+    if (depth > hciq_stats.max_depth) {
+        hciq_stats.max_depth = depth;
+    }
+
+    HciQueue_Schedule();
+    return 0;
+}
+
+uint8_t BLE_HciQueue_Pending(void)
+{
+    return (uint8_t)(hciq_count + hciq_in_flight);
+}
+
+void BLE_HciQueue_Report(void)
+{
+    uint32_t sent = hciq_stats.sent;
+    uint32_t done = hciq_stats.completed;
+
+    AT_Response_Send("+HCIQ:%u,%u,%lu,%lu,%lu,%lu,%lu,%lu,%lu\r\n",
+                     BLE_HciQueue_Pending(), hciq_stats.max_depth,
+                     sent, hciq_stats.errors, hciq_stats.full,
+                     HciQueue_CyclesToUs((sent > 0U) ? (hciq_stats.wait_cycles / sent) : 0U),
+                     HciQueue_CyclesToUs(hciq_stats.wait_max),
+                     HciQueue_CyclesToUs((done > 0U) ? (hciq_stats.rsp_cycles / done) : 0U),
+                     HciQueue_CyclesToUs(hciq_stats.rsp_max));
+}
+
+void BLE_HciQueue_Reset(void)
+{
+    memset(&hciq_stats, 0, sizeof(hciq_stats));
+    hciq_stats.max_depth = BLE_HciQueue_Pending();
+}
+
+/*============================================================================
+ * hci_tl.c Hooks
+ *============================================================================*/
+
+/* Overrides the weak hook: IPCC RX interrupt or end of a blocking command */
+void hci_notify_cmd_async(void)
+{
+    if (hciq_in_flight || hciq_count > 0) {
+        HciQueue_Schedule();
+    }
+}
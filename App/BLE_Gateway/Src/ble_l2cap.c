@@ -0,0 +1,525 @@
+/**
+  ******************************************************************************
+  * @file    ble_l2cap.c
+  * @brief   LE credit-based L2CAP channel implementation
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#define DEBUG_MODULE DEBUG_MOD_BLE
+
+#include "ble_l2cap.h"
+#include "ble_device_manager.h"
+#include "module_mode.h"
+#include "ble_tput.h"
+#include "at_command.h"
+#include "debug_trace.h"
+#include "ble_l2cap_aci.h"
+#include "main.h"
+#include <string.h>
+
+#define L2CAP_RESULT_SPSM_NOT_SUPPORTED  0x0002U
+#define L2CAP_UNBOUND                    0xFFU
+
+/*============================================================================
+ * State
+ *============================================================================*/
+typedef enum {
+    COC_STATE_FREE = 0,
+    COC_STATE_CONNECTING,
+    COC_STATE_OPEN
+} CocState_t;
+
+typedef struct {
+    uint8_t state;                  /* CocState_t */
+    uint8_t index;                  /* Stack channel index */
+    uint8_t dev_idx;
+    uint8_t credit_stall;           /* Stall already counted */
+    uint16_t conn_handle;
+    uint16_t spsm;
+    uint16_t peer_mtu;
+    uint16_t peer_mps;
+    uint16_t tx_credits;            /* K-frames we may send */
+    uint16_t rx_credits;            /* K-frames the peer may still send */
+    uint16_t rx_sdu_left;           /* Bytes left of the SDU being received */
+    uint16_t tx_len;                /* Queued SDU incl. 2-byte length, 0 = idle */
+    uint16_t tx_off;
+    uint8_t tx_sdu[BLE_L2CAP_SDU_MAX + 2];
+    /* Statistics */
+    uint32_t tx_bytes;
+    uint32_t tx_sdus;
+    uint32_t rx_bytes;
+    uint32_t rx_sdus;
+    uint32_t credit_stalls;
+    uint32_t pool_waits;
+    uint32_t errors;
+    uint32_t tx_first_tick;
+    uint32_t tx_last_tick;
+    uint32_t rx_first_tick;
+    uint32_t rx_last_tick;
+} CocChannel_t;
+
+static CocChannel_t channels[BLE_L2CAP_MAX_CHANNELS];
+static uint8_t uart_ch = L2CAP_UNBOUND;
+static uint8_t pool_wait = 0;
+
+/*============================================================================
+ * Static Helper Functions
+ *============================================================================*/
+
+static CocChannel_t* L2cap_FindIndex(uint8_t index)
+{
+    uint8_t i;
+
+    for (i = 0; i < BLE_L2CAP_MAX_CHANNELS; i++) {
+        if (channels[i].state == COC_STATE_OPEN && channels[i].index == index) {
+            return &channels[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Tell the writers that a channel can take the next SDU
+ */
+static void L2cap_NotifyReady(uint16_t conn_handle)
+{
+    Module_Mode_OnTxPoolAvailable(conn_handle);
+    BLE_Tput_OnTxPoolAvailable(conn_handle);
+}
+
+static uint32_t L2cap_Kbps(uint32_t bytes, uint32_t first, uint32_t last)
+{
+    uint32_t ms = last - first;
+
+    return (ms > 0) ? ((bytes * 8U) / ms) : 0U;
+}
+
+/**
+ * @brief Send K-frames of the queued SDU while credits and TX buffers last
+ * @return 0 if the SDU is complete, 1 if waiting for credits/buffers, -1 if error
+ */
+static int L2cap_Pump(CocChannel_t *c)
+{
+    uint16_t frame;
+    tBleStatus status;
+
+    while (c->tx_off < c->tx_len) {
+        if (c->tx_credits == 0) {
+            /* Resumes on ACI_L2CAP_COC_FLOW_CONTROL */
+            if (!c->credit_stall) {
+                c->credit_stall = 1;
+                c->credit_stalls++;
+            }
+            return 1;
+        }
+        if (pool_wait) {
+            return 1;
+        }
+
+        frame = (uint16_t)(c->tx_len - c->tx_off);
+        if (frame > c->peer_mps) {
+            frame = c->peer_mps;
+        }
+        if (frame > BLE_L2CAP_FRAME_MAX) {
+            frame = BLE_L2CAP_FRAME_MAX;
+        }
+
+        status = aci_l2cap_coc_tx_data(c->index, frame, &c->tx_sdu[c->tx_off]);
+        if (status == BLE_STATUS_INSUFFICIENT_RESOURCES) {
+            /* Resumes on ACI_L2CAP_COC_TX_POOL_AVAILABLE */
+            pool_wait = 1;
+            c->pool_waits++;
+            return 1;
+        }
+        if (status != BLE_STATUS_SUCCESS) {
+            DEBUG_ERROR("CoC %d TX failed: 0x%02X", (int)(c - channels), status);
+            c->errors++;
+            c->tx_len = 0;
+            c->tx_off = 0;
+            return -1;
+        }
+
+        c->tx_credits--;
+        c->credit_stall = 0;
+        c->tx_off = (uint16_t)(c->tx_off + frame);
+    }
+
+    if (c->tx_len > 0) {
+        if (c->tx_sdus == 0) {
+            c->tx_first_tick = HAL_GetTick();
+        }
+        c->tx_sdus++;
+        c->tx_bytes += (uint32_t)(c->tx_len - 2U);
+        c->tx_last_tick = HAL_GetTick();
+        c->tx_len = 0;
+        c->tx_off = 0;
+        /* Ready for the next SDU */
+        L2cap_NotifyReady(c->conn_handle);
+    }
+    return 0;
+}
+
+/**
+ * @brief Top up the peer's RX credits
+ * @note  A UART-bound channel gets no more credits than the UART TX ring can hold
+ *        in full-size K-frames, so nothing the peer sends is ever dropped
+ * @return 1 if credits are withheld, 0 otherwise
+ */
+static uint8_t L2cap_GrantCredits(uint8_t ch)
+{
+    CocChannel_t *c = &channels[ch];
+    uint16_t window = BLE_L2CAP_RX_CREDITS;
+    uint16_t grant;
+
+    if (c->state != COC_STATE_OPEN) {
+        return 0;
+    }
+
+    if (ch == uart_ch) {
+        uint16_t room = (uint16_t)(Module_Mode_UartTxFree() / BLE_L2CAP_MPS);
+        if (room < window) {
+            window = room;
+        }
+    }
+
+    if (window <= c->rx_credits) {
+        return (c->rx_credits < BLE_L2CAP_RX_CREDITS) ? 1U : 0U;
+    }
+    grant = (uint16_t)(window - c->rx_credits);
+
+    /* Batch updates: top up at half window, or at once if the peer is stalled */
+    if (c->rx_credits > 0 && grant < (BLE_L2CAP_RX_CREDITS / 2U)) {
+        return 1;
+    }
+
+    if (aci_l2cap_coc_flow_control(c->index, grant) != BLE_STATUS_SUCCESS) {
+        return 1;
+    }
+    c->rx_credits = (uint16_t)(c->rx_credits + grant);
+
+    return (c->rx_credits < BLE_L2CAP_RX_CREDITS) ? 1U : 0U;
+}
+
+static void L2cap_Release(uint8_t ch)
+{
+    if (uart_ch == ch) {
+        uart_ch = L2CAP_UNBOUND;
+    }
+    channels[ch].state = COC_STATE_FREE;
+    channels[ch].tx_len = 0;
+    channels[ch].tx_off = 0;
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+void BLE_L2cap_Init(void)
+{
+    memset(channels, 0, sizeof(channels));
+    uart_ch = L2CAP_UNBOUND;
+    pool_wait = 0;
+    DEBUG_INFO("L2CAP CoC initialized");
+}
+
+int BLE_L2cap_Connect(uint8_t dev_idx, uint16_t spsm, uint16_t mtu)
+{
+    BLE_Device_t *dev = BLE_DeviceManager_GetDevice(dev_idx);
+    tBleStatus status;
+    int slot = -1;
+    uint8_t i;
+
+    if (dev == NULL || !dev->is_connected || spsm == 0 || spsm > 0xFFU) {
+        return -1;
+    }
+    if (mtu == 0) {
+        mtu = BLE_L2CAP_SDU_MAX;
+    }
+    if (mtu < 23U) {
+        return -1;
+    }
+
+    for (i = 0; i < BLE_L2CAP_MAX_CHANNELS; i++) {
+        /* The confirm event only carries the connection handle */
+        if (channels[i].state == COC_STATE_CONNECTING &&
+            channels[i].conn_handle == dev->conn_handle) {
+            return -1;
+        }
+        if (slot < 0 && channels[i].state == COC_STATE_FREE) {
+            slot = i;
+        }
+    }
+    if (slot < 0) {
+        return -1;
+    }
+
+    /* Channel_Number 0: one LE credit-based channel (not enhanced) */
+    status = aci_l2cap_coc_connect(dev->conn_handle, spsm, mtu, BLE_L2CAP_MPS,
+                                   BLE_L2CAP_RX_CREDITS, 0);
+    if (status != BLE_STATUS_SUCCESS) {
+        DEBUG_ERROR("CoC connect failed: 0x%02X", status);
+        return -1;
+    }
+
+    memset(&channels[slot], 0, sizeof(channels[slot]));
+    channels[slot].state = COC_STATE_CONNECTING;
+    channels[slot].dev_idx = dev_idx;
+    channels[slot].conn_handle = dev->conn_handle;
+    channels[slot].spsm = spsm;
+
+    DEBUG_INFO("CoC %d: connecting dev=%d spsm=0x%02X mtu=%d", slot, dev_idx, spsm, mtu);
+    return slot;
+}
+
+int BLE_L2cap_Disconnect(uint8_t ch)
+{
+    if (ch >= BLE_L2CAP_MAX_CHANNELS || channels[ch].state != COC_STATE_OPEN) {
+        return -1;
+    }
+
+    return (aci_l2cap_coc_disconnect(channels[ch].index) == BLE_STATUS_SUCCESS) ? 0 : -1;
+}
+
+uint8_t BLE_L2cap_IsOpen(uint8_t ch)
+{
+    return (ch < BLE_L2CAP_MAX_CHANNELS && channels[ch].state == COC_STATE_OPEN) ? 1U : 0U;
+}
+
+uint16_t BLE_L2cap_GetConnHandle(uint8_t ch)
+{
+    return BLE_L2cap_IsOpen(ch) ? channels[ch].conn_handle : 0xFFFFU;
+}
+
+uint16_t BLE_L2cap_GetSduMax(uint8_t ch)
+{
+    if (!BLE_L2cap_IsOpen(ch)) {
+        return 0;
+    }
+    return (channels[ch].peer_mtu < BLE_L2CAP_SDU_MAX) ? channels[ch].peer_mtu
+                                                        : BLE_L2CAP_SDU_MAX;
+}
+
+int BLE_L2cap_Send(uint8_t ch, const uint8_t *data, uint16_t len)
+{
+    CocChannel_t *c;
+
+    if (!BLE_L2cap_IsOpen(ch) || len == 0 || len > BLE_L2cap_GetSduMax(ch)) {
+        return -1;
+    }
+    c = &channels[ch];
+
+    if (c->tx_len > 0) {
+        /* Previous SDU still waiting for credits or buffers */
+        return 1;
+    }
+
+    c->tx_sdu[0] = (uint8_t)(len & 0xFFU);
+    c->tx_sdu[1] = (uint8_t)(len >> 8);
+    memcpy(&c->tx_sdu[2], data, len);
+    c->tx_len = (uint16_t)(len + 2U);
+    c->tx_off = 0;
+
+    return (L2cap_Pump(c) < 0) ? -1 : 0;
+}
+
+void BLE_L2cap_BindUart(uint8_t ch)
+{
+    uint8_t prev = uart_ch;
+
+    uart_ch = (ch < BLE_L2CAP_MAX_CHANNELS) ? ch : L2CAP_UNBOUND;
+
+    /* Credits withheld for the UART are no longer limited */
+    if (prev != L2CAP_UNBOUND && prev != uart_ch) {
+        L2cap_GrantCredits(prev);
+    }
+}
+
+uint8_t BLE_L2cap_Service(void)
+{
+    if (uart_ch == L2CAP_UNBOUND) {
+        return 0;
+    }
+    return L2cap_GrantCredits(uart_ch);
+}
+
+void BLE_L2cap_Report(void)
+{
+    uint8_t i;
+    const CocChannel_t *c;
+
+    for (i = 0; i < BLE_L2CAP_MAX_CHANNELS; i++) {
+        c = &channels[i];
+        if (c->state == COC_STATE_FREE) {
+            continue;
+        }
+        AT_Response_Send("+COCS:%d,%d,0x%02X,%s,%d,%d,%d,%d,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu\r\n",
+                         i, c->dev_idx, c->spsm,
+                         (c->state == COC_STATE_OPEN) ? "OPEN" : "CONNECTING",
+                         c->peer_mtu, c->peer_mps, c->tx_credits, c->rx_credits,
+                         c->tx_bytes, c->tx_sdus,
+                         L2cap_Kbps(c->tx_bytes, c->tx_first_tick, c->tx_last_tick),
+                         c->rx_bytes, c->rx_sdus,
+                         L2cap_Kbps(c->rx_bytes, c->rx_first_tick, c->rx_last_tick),
+                         c->credit_stalls, c->pool_waits, c->errors);
+    }
+}
+
+/*============================================================================
+ * Stack Events
+ *============================================================================*/
+void BLE_L2cap_OnConnectRequest(uint16_t conn_handle, uint16_t spsm)
+{
+    uint8_t n = 0;
+    uint8_t list[5];
+
+    /* Central only: the gateway does not register any SPSM */
+    DEBUG_INFO("CoC request conn=0x%04X spsm=0x%02X refused", conn_handle, spsm);
+    aci_l2cap_coc_connect_confirm(conn_handle, BLE_L2CAP_SDU_MAX, BLE_L2CAP_MPS, 0,
+                                  L2CAP_RESULT_SPSM_NOT_SUPPORTED, &n, list);
+}
+
+void BLE_L2cap_OnConnectConfirm(uint16_t conn_handle, uint16_t mtu, uint16_t mps,
+                                uint16_t credits, uint16_t result, uint8_t index)
+{
+    CocChannel_t *c = NULL;
+    uint8_t i;
+
+    for (i = 0; i < BLE_L2CAP_MAX_CHANNELS; i++) {
+        if (channels[i].state == COC_STATE_CONNECTING &&
+            channels[i].conn_handle == conn_handle) {
+            c = &channels[i];
+            break;
+        }
+    }
+    if (c == NULL) {
+        return;
+    }
+
+    if (result != 0) {
+        DEBUG_ERROR("CoC %d refused: 0x%04X", i, result);
+        L2cap_Release(i);
+        AT_Response_Send("+COC:%d,FAIL,0x%04X\r\n", i, result);
+        return;
+    }
+
+    c->state = COC_STATE_OPEN;
+    c->index = index;
+    c->peer_mtu = mtu;
+    c->peer_mps = mps;
+    c->tx_credits = credits;
+    c->rx_credits = BLE_L2CAP_RX_CREDITS;
+
+    DEBUG_INFO("CoC %d open: index=%d mtu=%d mps=%d credits=%d", i, index, mtu, mps, credits);
+    AT_Response_Send("+COC:%d,OPEN,%d,%d,%d\r\n", i, mtu, mps, credits);
+}
+
+void BLE_L2cap_OnDisconnect(uint8_t index)
+{
+    CocChannel_t *c = L2cap_FindIndex(index);
+    uint8_t ch;
+
+    if (c == NULL) {
+        return;
+    }
+    ch = (uint8_t)(c - channels);
+
+    L2cap_Release(ch);
+    AT_Response_Send("+COC:%d,CLOSED\r\n", ch);
+    /* Wake a data mode writer so it sees the channel is gone */
+    L2cap_NotifyReady(c->conn_handle);
+}
+
+void BLE_L2cap_OnFlowControl(uint8_t index, uint16_t credits)
+{
+    CocChannel_t *c = L2cap_FindIndex(index);
+
+    if (c == NULL) {
+        return;
+    }
+
+    c->tx_credits = ((uint32_t)c->tx_credits + credits > 0xFFFFU) ? 0xFFFFU
+                    : (uint16_t)(c->tx_credits + credits);
+    if (c->tx_len > 0) {
+        L2cap_Pump(c);
+    }
+}
+
+void BLE_L2cap_OnRxData(uint8_t index, const uint8_t *data, uint16_t len)
+{
+    CocChannel_t *c = L2cap_FindIndex(index);
+    uint8_t ch;
+    uint16_t i;
+
+    if (c == NULL) {
+        return;
+    }
+    ch = (uint8_t)(c - channels);
+
+    if (c->rx_credits > 0) {
+        c->rx_credits--;
+    }
+
+    /* First K-frame of an SDU: strip the SDU length */
+    if (c->rx_sdu_left == 0) {
+        if (len < 2U) {
+            c->errors++;
+            L2cap_GrantCredits(ch);
+            return;
+        }
+        c->rx_sdu_left = (uint16_t)(data[0] | (data[1] << 8));
+        data += 2;
+        len = (uint16_t)(len - 2U);
+        if (c->rx_sdus == 0) {
+            c->rx_first_tick = HAL_GetTick();
+        }
+        c->rx_sdus++;
+    }
+    if (len > c->rx_sdu_left) {
+        c->errors++;
+        len = c->rx_sdu_left;
+    }
+    c->rx_sdu_left = (uint16_t)(c->rx_sdu_left - len);
+    c->rx_bytes += len;
+    c->rx_last_tick = HAL_GetTick();
+
+    if (BLE_Tput_OnCocRx(ch, len)) {
+        /* Benchmark sink: counted only */
+    } else if (ch == uart_ch) {
+        /* Credits guarantee room for every K-frame the peer may send */
+        if (Module_Mode_UartWrite(data, len) < len) {
+            c->errors++;
+        }
+    } else if (len > 0) {
+        AT_Response_Send("+COCDATA:%d,", ch);
+        for (i = 0; i < len; i++) {
+            AT_Response_Send("%02X", data[i]);
+        }
+        AT_Response_Send("\r\n");
+    }
+
+    L2cap_GrantCredits(ch);
+}
+
+void BLE_L2cap_OnTxPoolAvailable(void)
+{
+    uint8_t i;
+
+    pool_wait = 0;
+    for (i = 0; i < BLE_L2CAP_MAX_CHANNELS; i++) {
+        if (channels[i].state == COC_STATE_OPEN && channels[i].tx_len > 0) {
+            L2cap_Pump(&channels[i]);
+        }
+    }
+}
+
+void BLE_L2cap_OnLinkDown(uint16_t conn_handle)
+{
+    uint8_t i;
+
+    for (i = 0; i < BLE_L2CAP_MAX_CHANNELS; i++) {
+        if (channels[i].state != COC_STATE_FREE && channels[i].conn_handle == conn_handle) {
+            L2cap_Release(i);
+            AT_Response_Send("+COC:%d,CLOSED\r\n", i);
+        }
+    }
+}
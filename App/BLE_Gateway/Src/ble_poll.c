@@ -0,0 +1,332 @@
+/**
+  ******************************************************************************
+  * @file    ble_poll.c
+  * @brief   Periodic read scheduler implementation
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#define DEBUG_MODULE DEBUG_MOD_GATT
+
+#include "ble_poll.h"
+#include "ble_gatt_queue.h"
+#include "ble_device_manager.h"
+#include "ble_profile_decoder.h"
+#include "ble_rules.h"
+#include "at_command.h"
+#include "debug_trace.h"
+#include "main.h"
+#include "hw_if.h"
+#include "app_conf.h"
+#include "stm32_seq.h"
+#include <stdio.h>
+#include <string.h>
+
+/*============================================================================
+ * Constants
+ *============================================================================*/
+#define POLL_TICK_TS            ((BLE_POLL_TICK_MS * 1000U) / CFG_TS_TICK_VAL)
+#define POLL_FNV_OFFSET         2166136261UL
+#define POLL_FNV_PRIME          16777619UL
+
+typedef struct {
+    uint8_t active;
+    uint8_t dev_idx;
+    uint8_t by_uuid;
+    uint8_t pending;                /* Read queued or in flight */
+    uint8_t has_value;
+    uint16_t target;                /* Handle or UUID as configured */
+    uint16_t handle;                /* Resolved value handle (0 = unresolved) */
+    uint16_t last_len;
+    uint32_t last_hash;             /* Change detection */
+    uint32_t period_ms;
+    uint32_t next_due;
+    uint32_t reads;
+    uint32_t forwarded;
+    uint32_t overruns;              /* Due while previous read still pending */
+} PollEntry_t;
+
+static PollEntry_t polls[BLE_POLL_MAX_ENTRIES];
+static uint8_t poll_timer_id;
+static uint8_t poll_timer_running = 0;
+static uint8_t poll_rr = 0;         /* Round-robin start index */
+
+/*============================================================================
+ * Static Helper Functions
+ *============================================================================*/
+
+static void Poll_TimerCallback(void)
+{
+    /* Timer server ISR context: defer to task */
+    UTIL_SEQ_SetTask(1U << CFG_TASK_POLL_ID, CFG_SCH_PRIO_CTRL);
+}
+
+static uint32_t Poll_Hash(const uint8_t *data, uint16_t len)
+{
+    uint32_t h = POLL_FNV_OFFSET;
+    uint16_t i;
+
+    for (i = 0; i < len; i++) {
+        h ^= data[i];
+        h *= POLL_FNV_PRIME;
+    }
+    return h;
+}
+
+static uint8_t Poll_AnyActive(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < BLE_POLL_MAX_ENTRIES; i++) {
+        if (polls[i].active) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void Poll_UpdateTimer(void)
+{
+    uint8_t any = Poll_AnyActive();
+
+    if (any && !poll_timer_running) {
+        HW_TS_Start(poll_timer_id, POLL_TICK_TS);
+        poll_timer_running = 1;
+    } else if (!any && poll_timer_running) {
+        HW_TS_Stop(poll_timer_id);
+        poll_timer_running = 0;
+    }
+}
+
+/**
+ * @brief Forward a changed value: typed record if a decoder is bound, hex otherwise
+ */
+static void Poll_Forward(PollEntry_t *e, uint16_t conn_handle, uint16_t handle,
+                         const uint8_t *data, uint16_t len)
+{
+    char line[AT_CMD_MAX_LEN];
+    uint16_t i;
+    int n;
+
+    e->forwarded++;
+
+    if (BLE_Decoder_Process(conn_handle, handle, data, len) == 0) {
+        return;
+    }
+
+    n = snprintf(line, sizeof(line), "+POLL:%d,0x%04X,", e->dev_idx, handle);
+    for (i = 0; i < len && n < (int)sizeof(line) - 3; i++) {
+        n += snprintf(&line[n], sizeof(line) - (size_t)n, "%02X", data[i]);
+    }
+    AT_Response_Send("%s\r\n", line);
+}
+
+/**
+ * @brief Read completion from the GATT queue (task context)
+ */
+static void Poll_OnReadComplete(uint16_t conn_handle, uint16_t handle, uint8_t status, uint8_t tag)
+{
+    PollEntry_t *e;
+
+    (void)conn_handle;
+
+    if (tag >= BLE_POLL_MAX_ENTRIES) {
+        return;
+    }
+    e = &polls[tag];
+    e->pending = 0;
+
+    /* Keep resolved handle: later rounds skip UUID discovery */
+    if (status == 0 && handle != 0) {
+        e->handle = handle;
+    } else if (status != 0) {
+        DEBUG_WARN("Poll %d read failed: 0x%02X", tag, status);
+    }
+}
+
+/*============================================================================
+ * Sequencer Task
+ *============================================================================*/
+static void Poll_Task(void)
+{
+    uint32_t now = HAL_GetTick();
+    uint8_t issued = 0;
+    uint8_t n, i;
+    PollEntry_t *e;
+    BLE_Device_t *dev;
+    BLE_GattQueueOp_t op;
+
+    for (n = 0; n < BLE_POLL_MAX_ENTRIES && issued < BLE_POLL_MAX_PER_TICK; n++) {
+        i = (uint8_t)((poll_rr + n) % BLE_POLL_MAX_ENTRIES);
+        e = &polls[i];
+
+        if (!e->active || (int32_t)(now - e->next_due) < 0) {
+            continue;
+        }
+
+        dev = BLE_DeviceManager_GetDevice(e->dev_idx);
+        if (dev == NULL || !dev->is_connected) {
+            /* Resume on reconnect */
+            e->next_due = now + e->period_ms;
+            continue;
+        }
+
+        if (e->pending) {
+            e->overruns++;
+            e->next_due = now + e->period_ms;
+            continue;
+        }
+
+        memset(&op, 0, sizeof(op));
+        op.type = GATTQ_OP_READ;
+        op.by_uuid = (e->handle == 0) ? e->by_uuid : 0;
+        op.target = (e->handle != 0) ? e->handle : e->target;
+        op.tag = i;
+        op.cb = Poll_OnReadComplete;
+
+        if (BLE_GattQueue_Push(dev->conn_handle, &op) == 0) {
+            e->pending = 1;
+            e->reads++;
+            issued++;
+        }
+
+        /* Keep phase: avoid drift accumulating into bursts */
+        e->next_due += e->period_ms;
+        if ((int32_t)(now - e->next_due) >= 0) {
+            e->next_due = now + e->period_ms;
+        }
+        poll_rr = (uint8_t)((i + 1U) % BLE_POLL_MAX_ENTRIES);
+    }
+
+    Poll_UpdateTimer();
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+void BLE_Poll_Init(void)
+{
+    memset(polls, 0, sizeof(polls));
+    poll_timer_running = 0;
+    poll_rr = 0;
+
+    UTIL_SEQ_RegTask(1U << CFG_TASK_POLL_ID, UTIL_SEQ_RFU, Poll_Task);
+    HW_TS_Create(CFG_TIM_PROC_ID_ISR, &poll_timer_id, hw_ts_Repeated, Poll_TimerCallback);
+
+    DEBUG_INFO("Poll scheduler initialized");
+}
+
+int BLE_Poll_Set(uint8_t dev_idx, uint8_t by_uuid, uint16_t target, uint32_t period_ms)
+{
+    uint8_t i, active = 0;
+    int slot = -1;
+    PollEntry_t *e;
+
+    if (BLE_DeviceManager_GetDevice(dev_idx) == NULL || target == 0) {
+        return -1;
+    }
+
+    for (i = 0; i < BLE_POLL_MAX_ENTRIES; i++) {
+        if (polls[i].active) {
+            active++;
+            if (polls[i].dev_idx == dev_idx && polls[i].by_uuid == by_uuid &&
+                polls[i].target == target) {
+                slot = i;
+            }
+        } else if (slot < 0 && period_ms > 0) {
+            slot = i;
+        }
+    }
+
+    if (slot < 0) {
+        return -1;
+    }
+    e = &polls[slot];
+
+    if (period_ms == 0) {
+        if (!e->active) {
+            return -1;
+        }
+        e->active = 0;
+        Poll_UpdateTimer();
+        DEBUG_INFO("Poll %d removed", slot);
+        return slot;
+    }
+
+    if (period_ms < BLE_POLL_MIN_PERIOD_MS) {
+        period_ms = BLE_POLL_MIN_PERIOD_MS;
+    }
+
+    if (!e->active) {
+        memset(e, 0, sizeof(*e));
+        e->dev_idx = dev_idx;
+        e->by_uuid = by_uuid;
+        e->target = target;
+        e->handle = by_uuid ? 0 : target;
+    }
+    e->period_ms = period_ms;
+
+    /* Stagger first read by entry count so equal periods don't align */
+    e->next_due = HAL_GetTick() + ((uint32_t)active * BLE_POLL_TICK_MS) % period_ms;
+    e->active = 1;
+
+    Poll_UpdateTimer();
+    DEBUG_INFO("Poll %d: dev=%d target=%s0x%04X period=%lu", slot, dev_idx,
+               by_uuid ? "U" : "", target, period_ms);
+    return slot;
+}
+
+void BLE_Poll_Clear(void)
+{
+    memset(polls, 0, sizeof(polls));
+    Poll_UpdateTimer();
+}
+
+void BLE_Poll_Report(void)
+{
+    uint8_t i;
+    PollEntry_t *e;
+
+    for (i = 0; i < BLE_POLL_MAX_ENTRIES; i++) {
+        e = &polls[i];
+        if (e->active) {
+            AT_Response_Send("+POLLS:%d,%d,%s0x%04X,%lu,%lu,%lu,%lu\r\n", i, e->dev_idx,
+                             e->by_uuid ? "U" : "", e->target, e->period_ms,
+                             e->reads, e->forwarded, e->overruns);
+        }
+    }
+}
+
+uint8_t BLE_Poll_OnReadResponse(uint16_t conn_handle, uint16_t handle,
+                                const uint8_t *data, uint16_t len)
+{
+    const BLE_GattQueueOp_t *op;
+    uint16_t op_handle = 0;
+    uint32_t hash;
+    PollEntry_t *e;
+
+    /* Only the response to our own queued read: an AT+READ on the same link
+       is not a poll result, even while a poll read is pending */
+    op = BLE_GattQueue_InFlight(conn_handle, &op_handle);
+    if (op == NULL || op->cb != Poll_OnReadComplete || op->type != GATTQ_OP_READ ||
+        op->tag >= BLE_POLL_MAX_ENTRIES || op_handle != handle) {
+        return 0;
+    }
+    e = &polls[op->tag];
+    if (!e->active || !e->pending) {
+        /* Removed while the read was in flight */
+        return 1;
+    }
+
+    /* Change detection: forward only new values, then rule filtering */
+    hash = Poll_Hash(data, len);
+    if (!e->has_value || hash != e->last_hash || len != e->last_len) {
+        e->has_value = 1;
+        e->last_hash = hash;
+        e->last_len = len;
+        if (BLE_Rules_Evaluate(conn_handle, handle, data, len)) {
+            Poll_Forward(e, conn_handle, handle, data, len);
+        }
+    }
+    return 1;
+}
@@ -0,0 +1,479 @@
+/**
+  ******************************************************************************
+  * @file    ble_profile_decoder.c
+  * @brief   Client-side SIG characteristic decoders implementation
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#define DEBUG_MODULE DEBUG_MOD_GATT
+
+#include "ble_profile_decoder.h"
+#include "at_command.h"
+#include "debug_trace.h"
+#include <stdio.h>
+#include <string.h>
+
+/*============================================================================
+ * Constants
+ *============================================================================*/
+#define DECODER_RECORD_MAX_LEN  AT_CMD_MAX_LEN
+
+/* IEEE-11073 FLOAT special values (mantissa) */
+#define FLOAT_NAN               0x007FFFFF
+#define FLOAT_NRES              0x00800000
+#define FLOAT_POS_INF           0x007FFFFE
+#define FLOAT_NEG_INF           0x00800002
+#define FLOAT_RESERVED          0x00800001
+
+/*============================================================================
+ * Bindings
+ *============================================================================*/
+typedef struct {
+    uint16_t conn_handle;
+    uint16_t value_handle;
+    uint8_t type;
+    uint8_t has_wheel;              /* CSC: previous wheel sample valid */
+    uint8_t has_crank;              /* CSC: previous crank sample valid */
+    uint16_t prev_wheel_time;
+    uint16_t prev_crank_revs;
+    uint16_t prev_crank_time;
+    uint32_t prev_wheel_revs;
+} DecoderBinding_t;
+
+static DecoderBinding_t bindings[BLE_DECODER_MAX_BINDINGS];
+
+static const char * const decoder_names[DECODER_COUNT] = {
+    "NONE", "HRM", "BATT", "TEMP", "CSC", "RSC"
+};
+
+/*============================================================================
+ * Static Helper Functions
+ *============================================================================*/
+
+static uint16_t Get16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t Get32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static DecoderBinding_t* Decoder_Find(uint16_t conn_handle, uint16_t value_handle)
+{
+    uint8_t i;
+
+    for (i = 0; i < BLE_DECODER_MAX_BINDINGS; i++) {
+        if (bindings[i].type != DECODER_NONE &&
+            bindings[i].conn_handle == conn_handle &&
+            bindings[i].value_handle == value_handle) {
+            return &bindings[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Format hundredths as signed fixed-point "x.yy"
+ */
+static int FormatCenti(char *buf, uint16_t size, int32_t centi)
+{
+    uint32_t mag = (centi < 0) ? (uint32_t)(-centi) : (uint32_t)centi;
+
+    return snprintf(buf, size, "%s%lu.%02lu", (centi < 0) ? "-" : "",
+                    (unsigned long)(mag / 100U), (unsigned long)(mag % 100U));
+}
+
+/*============================================================================
+ * Decoders
+ *============================================================================*/
+
+/**
+ * @brief Heart Rate Measurement
+ * Record: +HRM:<conn>,<bpm>,<contact>,<energy_kJ>,<rr_ms;...>
+ * contact: '-' not supported, 0 not detected, 1 detected; empty = absent
+ */
+static int Decode_HRM(DecoderBinding_t *b, const uint8_t *data, uint16_t len)
+{
+    char rec[DECODER_RECORD_MAX_LEN];
+    uint8_t flags;
+    uint16_t idx = 1;
+    uint16_t bpm;
+    int n;
+
+    if (len < 2) {
+        return -1;
+    }
+    flags = data[0];
+
+    if (flags & 0x01) {
+        if (len < 3) {
+            return -1;
+        }
+        bpm = Get16(&data[1]);
+        idx = 3;
+    } else {
+        bpm = data[1];
+        idx = 2;
+    }
+
+    n = snprintf(rec, sizeof(rec), "+HRM:0x%04X,%u,%s,", b->conn_handle, bpm,
+                 ((flags & 0x04) == 0) ? "-" : ((flags & 0x02) ? "1" : "0"));
+
+    if (flags & 0x08) {
+        if ((uint16_t)(idx + 2) > len) {
+            return -1;
+        }
+        n += snprintf(&rec[n], sizeof(rec) - (size_t)n, "%u", Get16(&data[idx]));
+        idx += 2;
+    }
+    n += snprintf(&rec[n], sizeof(rec) - (size_t)n, ",");
+
+    if (flags & 0x10) {
+        uint8_t first = 1;
+        /* RR-Interval in 1/1024 s */
+        while ((uint16_t)(idx + 2) <= len && n < (int)sizeof(rec) - 8) {
+            uint32_t rr_ms = ((uint32_t)Get16(&data[idx]) * 1000U) / 1024U;
+            n += snprintf(&rec[n], sizeof(rec) - (size_t)n, "%s%lu",
+                          first ? "" : ";", (unsigned long)rr_ms);
+            first = 0;
+            idx += 2;
+        }
+    }
+
+    AT_Response_Send("%s\r\n", rec);
+    return 0;
+}
+
+/**
+ * @brief Battery Level
+ * Record: +BATT:<conn>,<percent>
+ */
+static int Decode_Battery(DecoderBinding_t *b, const uint8_t *data, uint16_t len)
+{
+    if (len < 1 || data[0] > 100) {
+        return -1;
+    }
+
+    AT_Response_Send("+BATT:0x%04X,%u\r\n", b->conn_handle, data[0]);
+    return 0;
+}
+
+/**
+ * @brief Temperature Measurement
+ * Record: +TEMP:<conn>,<value>,<C|F>[,<type>]
+ */
+static int Decode_Temp(DecoderBinding_t *b, const uint8_t *data, uint16_t len)
+{
+    char val[16];
+    uint8_t flags;
+    uint16_t idx = 5;
+    int32_t centi;
+
+    if (len < 5) {
+        return -1;
+    }
+    flags = data[0];
+
+    if (BLE_Decoder_Float11073ToCenti(Get32(&data[1]), &centi) != 0) {
+        snprintf(val, sizeof(val), "NaN");
+    } else {
+        FormatCenti(val, sizeof(val), centi);
+    }
+
+    if (flags & 0x02) {
+        idx += 7;   /* Skip Time Stamp */
+    }
+
+    if ((flags & 0x04) && idx < len) {
+        AT_Response_Send("+TEMP:0x%04X,%s,%c,%u\r\n", b->conn_handle, val,
+                         (flags & 0x01) ? 'F' : 'C', data[idx]);
+    } else {
+        AT_Response_Send("+TEMP:0x%04X,%s,%c\r\n", b->conn_handle, val,
+                         (flags & 0x01) ? 'F' : 'C');
+    }
+    return 0;
+}
+
+/**
+ * @brief CSC Measurement
+ * Record: +CSC:<conn>,<wheel_revs>,<wheel_rpm>,<crank_revs>,<cadence_rpm>
+ * Rates are derived from the previous sample; empty fields = absent
+ */
+static int Decode_CSC(DecoderBinding_t *b, const uint8_t *data, uint16_t len)
+{
+    char rec[DECODER_RECORD_MAX_LEN];
+    uint8_t flags;
+    uint16_t idx = 1;
+    uint16_t need = 1;
+    int n;
+
+    if (len < 1) {
+        return -1;
+    }
+    flags = data[0];
+
+    /* Reject a truncated sample before any rate state is touched */
+    if (flags & 0x01) {
+        need += 6;
+    }
+    if (flags & 0x02) {
+        need += 4;
+    }
+    if (len < need) {
+        return -1;
+    }
+
+    n = snprintf(rec, sizeof(rec), "+CSC:0x%04X,", b->conn_handle);
+
+    if (flags & 0x01) {
+        uint32_t revs;
+        uint16_t time;
+        revs = Get32(&data[idx]);
+        time = Get16(&data[idx + 4]);
+        idx += 6;
+
+        n += snprintf(&rec[n], sizeof(rec) - (size_t)n, "%lu,", (unsigned long)revs);
+        if (b->has_wheel && time != b->prev_wheel_time) {
+            /* Event time in 1/1024 s, wraps at 64 s */
+            uint16_t dt = (uint16_t)(time - b->prev_wheel_time);
+            uint32_t rpm = ((revs - b->prev_wheel_revs) * 60U * 1024U) / dt;
+            n += snprintf(&rec[n], sizeof(rec) - (size_t)n, "%lu", (unsigned long)rpm);
+        }
+        b->prev_wheel_revs = revs;
+        b->prev_wheel_time = time;
+        b->has_wheel = 1;
+    } else {
+        n += snprintf(&rec[n], sizeof(rec) - (size_t)n, ",");
+    }
+    n += snprintf(&rec[n], sizeof(rec) - (size_t)n, ",");
+
+    if (flags & 0x02) {
+        uint16_t revs, time;
+        revs = Get16(&data[idx]);
+        time = Get16(&data[idx + 2]);
+
+        n += snprintf(&rec[n], sizeof(rec) - (size_t)n, "%u,", revs);
+        if (b->has_crank && time != b->prev_crank_time) {
+            uint16_t dt = (uint16_t)(time - b->prev_crank_time);
+            uint32_t rpm = ((uint32_t)(uint16_t)(revs - b->prev_crank_revs) * 60U * 1024U) / dt;
+            n += snprintf(&rec[n], sizeof(rec) - (size_t)n, "%lu", (unsigned long)rpm);
+        }
+        b->prev_crank_revs = revs;
+        b->prev_crank_time = time;
+        b->has_crank = 1;
+    } else {
+        snprintf(&rec[n], sizeof(rec) - (size_t)n, ",");
+    }
+
+    AT_Response_Send("%s\r\n", rec);
+    return 0;
+}
+
+/**
+ * @brief RSC Measurement
+ * Record: +RSC:<conn>,<speed_cm_s>,<cadence>,<stride_cm>,<distance_dm>,<R|W>
+ */
+static int Decode_RSC(DecoderBinding_t *b, const uint8_t *data, uint16_t len)
+{
+    char stride[8] = "";
+    char dist[12] = "";
+    uint8_t flags;
+    uint16_t idx = 4;
+    uint32_t speed_cm_s;
+
+    if (len < 4) {
+        return -1;
+    }
+    flags = data[0];
+
+    /* Instantaneous speed in 1/256 m/s */
+    speed_cm_s = ((uint32_t)Get16(&data[1]) * 100U) / 256U;
+
+    if (flags & 0x01) {
+        if ((uint16_t)(idx + 2) > len) {
+            return -1;
+        }
+        snprintf(stride, sizeof(stride), "%u", Get16(&data[idx]));
+        idx += 2;
+    }
+    if (flags & 0x02) {
+        if ((uint16_t)(idx + 4) > len) {
+            return -1;
+        }
+        snprintf(dist, sizeof(dist), "%lu", (unsigned long)Get32(&data[idx]));
+    }
+
+    AT_Response_Send("+RSC:0x%04X,%lu,%u,%s,%s,%c\r\n", b->conn_handle,
+                     (unsigned long)speed_cm_s, data[3], stride, dist,
+                     (flags & 0x04) ? 'R' : 'W');
+    return 0;
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+void BLE_Decoder_Init(void)
+{
+    memset(bindings, 0, sizeof(bindings));
+    DEBUG_INFO("Profile decoders initialized");
+}
+
+int BLE_Decoder_Bind(uint16_t conn_handle, uint16_t value_handle, BLE_DecoderType_t type)
+{
+    DecoderBinding_t *b = Decoder_Find(conn_handle, value_handle);
+    uint8_t i;
+
+    if (type >= DECODER_COUNT) {
+        return -1;
+    }
+
+    if (b == NULL) {
+        if (type == DECODER_NONE) {
+            return 0;
+        }
+        for (i = 0; i < BLE_DECODER_MAX_BINDINGS; i++) {
+            if (bindings[i].type == DECODER_NONE) {
+                b = &bindings[i];
+                break;
+            }
+        }
+        if (b == NULL) {
+            DEBUG_ERROR("Decoder table full");
+            return -1;
+        }
+    }
+
+    memset(b, 0, sizeof(*b));
+    b->conn_handle = conn_handle;
+    b->value_handle = value_handle;
+    b->type = (uint8_t)type;
+
+    DEBUG_INFO("Decoder %s bound: conn=0x%04X, handle=0x%04X",
+               decoder_names[type], conn_handle, value_handle);
+    return 0;
+}
+
+void BLE_Decoder_UnbindConn(uint16_t conn_handle)
+{
+    uint8_t i;
+
+    for (i = 0; i < BLE_DECODER_MAX_BINDINGS; i++) {
+        if (bindings[i].conn_handle == conn_handle) {
+            bindings[i].type = DECODER_NONE;
+        }
+    }
+}
+
+int BLE_Decoder_Process(uint16_t conn_handle, uint16_t value_handle,
+                        const uint8_t *data, uint16_t len)
+{
+    DecoderBinding_t *b = Decoder_Find(conn_handle, value_handle);
+
+    if (b == NULL || data == NULL) {
+        return -1;
+    }
+
+    switch (b->type) {
+        case DECODER_HRM:     return Decode_HRM(b, data, len);
+        case DECODER_BATTERY: return Decode_Battery(b, data, len);
+        case DECODER_TEMP:    return Decode_Temp(b, data, len);
+        case DECODER_CSC:     return Decode_CSC(b, data, len);
+        case DECODER_RSC:     return Decode_RSC(b, data, len);
+        default:              return -1;
+    }
+}
+
+BLE_DecoderType_t BLE_Decoder_FromUUID(uint16_t uuid)
+{
+    switch (uuid) {
+        case 0x2A37: return DECODER_HRM;
+        case 0x2A19: return DECODER_BATTERY;
+        case 0x2A1C: return DECODER_TEMP;
+        case 0x2A5B: return DECODER_CSC;
+        case 0x2A53: return DECODER_RSC;
+        default:     return DECODER_NONE;
+    }
+}
+
+BLE_DecoderType_t BLE_Decoder_FromName(const char *name)
+{
+    uint8_t i;
+
+    if (name == NULL) {
+        return DECODER_COUNT;
+    }
+
+    for (i = 0; i < DECODER_COUNT; i++) {
+        if (strcmp(name, decoder_names[i]) == 0) {
+            return (BLE_DecoderType_t)i;
+        }
+    }
+    return DECODER_COUNT;
+}
+
+const char* BLE_Decoder_GetName(BLE_DecoderType_t type)
+{
+    return (type < DECODER_COUNT) ? decoder_names[type] : "?";
+}
+
+void BLE_Decoder_ReportBindings(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < BLE_DECODER_MAX_BINDINGS; i++) {
+        if (bindings[i].type != DECODER_NONE) {
+            AT_Response_Send("+DECODE:0x%04X,0x%04X,%s\r\n", bindings[i].conn_handle,
+                             bindings[i].value_handle, decoder_names[bindings[i].type]);
+        }
+    }
+}
+
+int BLE_Decoder_Float11073ToCenti(uint32_t raw, int32_t *out_centi)
+{
+    int32_t mantissa = (int32_t)(raw & 0x00FFFFFFU);
+    int8_t exponent = (int8_t)(raw >> 24);
+    int32_t shift;
+    int32_t value;
+
+    if (mantissa == FLOAT_NAN || mantissa == FLOAT_NRES || mantissa == FLOAT_POS_INF ||
+        mantissa == FLOAT_NEG_INF || mantissa == FLOAT_RESERVED) {
+        return -1;
+    }
+
+    /* Sign-extend 24-bit mantissa */
+    if (mantissa & 0x00800000) {
+        mantissa -= 0x01000000;
+    }
+
+    /* value * 100 = mantissa * 10^(exponent + 2) */
+    shift = (int32_t)exponent + 2;
+    value = mantissa;
+
+    if (shift >= 0) {
+        while (shift-- > 0) {
+            if (value > 214748364 || value < -214748364) {
+                return -1;
+            }
+            value *= 10;
+        }
+    } else {
+        int32_t div = 1;
+        while (shift++ < 0) {
+            if (div > 100000000) {
+                value = 0;
+                div = 1;
+                break;
+            }
+            div *= 10;
+        }
+        /* Round half away from zero */
+        value = (value >= 0) ? ((value + div / 2) / div) : ((value - div / 2) / div);
+    }
+
+    *out_centi = value;
+    return 0;
+}
@@ -0,0 +1,420 @@
+/**
+  ******************************************************************************
+  * @file    ble_rules.c
+  * @brief   Notification filter and trigger rules implementation
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#define DEBUG_MODULE DEBUG_MOD_DATA
+
+#include "ble_rules.h"
+#include "ble_gatt_queue.h"
+#include "ble_device_manager.h"
+#include "ble_profile_decoder.h"
+#include "at_command.h"
+#include "debug_trace.h"
+#include "main.h"
+#include <string.h>
+
+/*============================================================================
+ * State
+ *============================================================================*/
+#define RULE_SLOT_EMPTY         0xFFU
+#define RULE_TX_SLOTS           8       /* Trigger writes queued at once */
+
+typedef struct {
+    BLE_RuleDef_t def;
+    uint8_t active;
+    uint8_t has_value;
+    uint8_t prev_above;             /* Threshold side of previous value */
+    uint8_t has_match;
+    int32_t last;                   /* Last forwarded value (DELTA) */
+    uint32_t last_match_tick;
+    uint32_t matched;
+    uint32_t dropped;
+    uint32_t triggers;
+} Rule_t;
+
+static Rule_t rules[BLE_RULES_MAX];
+
+/* Trigger payloads, owned until the write completes: the rule itself may be
+   changed or deleted while its write is queued */
+typedef struct {
+    uint8_t busy;
+    uint8_t data[BLE_RULES_MAX_DATA];
+} RuleTx_t;
+
+static RuleTx_t rule_tx[RULE_TX_SLOTS];
+
+/* Open-addressed (dev_idx, handle) -> rule index */
+static uint8_t rule_index[BLE_RULES_HASH_SIZE];
+
+static const char * const field_names[RULE_FIELD_COUNT] = {
+    "U8", "S8", "U16", "S16", "U32", "S32", "HR", "FLT"
+};
+
+static const char * const cond_names[RULE_COND_COUNT] = {
+    "ANY", "GT", "LT", "CROSS", "DELTA"
+};
+
+/*============================================================================
+ * Static Helper Functions
+ *============================================================================*/
+
+static uint8_t Rules_Hash(uint8_t dev_idx, uint16_t handle)
+{
+    return (uint8_t)((handle * 31U + dev_idx) & (BLE_RULES_HASH_SIZE - 1U));
+}
+
+static int Rules_Lookup(uint8_t dev_idx, uint16_t handle)
+{
+    uint8_t h = Rules_Hash(dev_idx, handle);
+    uint8_t n, slot;
+
+    for (n = 0; n < BLE_RULES_HASH_SIZE; n++) {
+        slot = rule_index[(h + n) & (BLE_RULES_HASH_SIZE - 1U)];
+        if (slot == RULE_SLOT_EMPTY) {
+            return -1;
+        }
+        if (rules[slot].def.dev_idx == dev_idx && rules[slot].def.handle == handle) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Rebuild index after add/delete (no tombstones needed)
+ */
+static void Rules_Reindex(void)
+{
+    uint8_t i, h;
+
+    memset(rule_index, RULE_SLOT_EMPTY, sizeof(rule_index));
+
+    for (i = 0; i < BLE_RULES_MAX; i++) {
+        if (!rules[i].active) {
+            continue;
+        }
+        h = Rules_Hash(rules[i].def.dev_idx, rules[i].def.handle);
+        while (rule_index[h] != RULE_SLOT_EMPTY) {
+            h = (uint8_t)((h + 1U) & (BLE_RULES_HASH_SIZE - 1U));
+        }
+        rule_index[h] = i;
+    }
+}
+
+/**
+ * @brief Apply condition (state is committed by the caller)
+ * @param above Threshold side of v
+ * @return 1 if condition matches
+ */
+static uint8_t Rules_Match(const Rule_t *r, int32_t v, uint8_t *above)
+{
+    uint8_t match = 0;
+    int64_t diff;
+
+    *above = r->prev_above;
+
+    switch (r->def.cond) {
+        case RULE_COND_ANY:
+            match = 1;
+            break;
+
+        case RULE_COND_GT:
+            *above = (v > r->def.threshold) ? 1U : 0U;
+            match = (*above && (!r->has_value || !r->prev_above)) ? 1U : 0U;
+            break;
+
+        case RULE_COND_LT:
+            *above = (v >= r->def.threshold) ? 1U : 0U;
+            match = (!*above && (!r->has_value || r->prev_above)) ? 1U : 0U;
+            break;
+
+        case RULE_COND_CROSS:
+            *above = (v > r->def.threshold) ? 1U : 0U;
+            match = (!r->has_value || *above != r->prev_above) ? 1U : 0U;
+            break;
+
+        case RULE_COND_DELTA:
+            /* 64-bit: the difference of two int32_t values may not fit */
+            diff = (int64_t)v - r->last;
+            if (diff < 0) {
+                diff = -diff;
+            }
+            match = (!r->has_value || diff > r->def.threshold) ? 1U : 0U;
+            break;
+
+        default:
+            break;
+    }
+
+    return match;
+}
+
+static void Rules_OnTriggerDone(uint16_t conn_handle, uint16_t handle, uint8_t status, uint8_t tag)
+{
+    (void)conn_handle;
+    (void)handle;
+    (void)status;
+
+    if (tag < RULE_TX_SLOTS) {
+        rule_tx[tag].busy = 0;
+    }
+}
+
+static void Rules_Trigger(Rule_t *r)
+{
+    BLE_GattQueueOp_t op;
+    BLE_Device_t *dst = BLE_DeviceManager_GetDevice(r->def.dst_idx);
+    uint8_t i;
+
+    if (dst == NULL || !dst->is_connected) {
+        return;
+    }
+
+    for (i = 0; i < RULE_TX_SLOTS; i++) {
+        if (!rule_tx[i].busy) {
+            break;
+        }
+    }
+    if (i == RULE_TX_SLOTS) {
+        return;
+    }
+    memcpy(rule_tx[i].data, r->def.dst_data, r->def.dst_len);
+
+    memset(&op, 0, sizeof(op));
+    op.type = GATTQ_OP_WRITE;
+    op.target = r->def.dst_handle;
+    op.data = rule_tx[i].data;
+    op.len = r->def.dst_len;
+    op.tag = i;
+    op.cb = Rules_OnTriggerDone;
+
+    /* Busy is set first: a queued op cannot complete before this returns */
+    rule_tx[i].busy = 1;
+    if (BLE_GattQueue_Push(dst->conn_handle, &op) == 0) {
+        r->triggers++;
+    } else {
+        rule_tx[i].busy = 0;
+    }
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+void BLE_Rules_Init(void)
+{
+    memset(rules, 0, sizeof(rules));
+    memset(rule_tx, 0, sizeof(rule_tx));
+    Rules_Reindex();
+    DEBUG_INFO("Rules initialized");
+}
+
+int BLE_Rules_Set(const BLE_RuleDef_t *def)
+{
+    int slot;
+    uint8_t i;
+
+    if (def == NULL || def->field >= RULE_FIELD_COUNT || def->cond >= RULE_COND_COUNT ||
+        def->handle == 0 || def->dst_len > BLE_RULES_MAX_DATA ||
+        (def->dst_idx != 0xFFU && (def->dst_handle == 0 || def->dst_len == 0))) {
+        return -1;
+    }
+
+    slot = Rules_Lookup(def->dev_idx, def->handle);
+    if (slot < 0) {
+        for (i = 0; i < BLE_RULES_MAX; i++) {
+            if (!rules[i].active) {
+                slot = i;
+                break;
+            }
+        }
+    }
+    if (slot < 0) {
+        return -1;
+    }
+
+    memset(&rules[slot], 0, sizeof(rules[slot]));
+    rules[slot].def = *def;
+    rules[slot].active = 1;
+    Rules_Reindex();
+
+    DEBUG_INFO("Rule %d: dev=%d handle=0x%04X %s %ld", slot, def->dev_idx, def->handle,
+               cond_names[def->cond], (long)def->threshold);
+    return 0;
+}
+
+int BLE_Rules_Delete(uint8_t dev_idx, uint16_t handle)
+{
+    int slot = Rules_Lookup(dev_idx, handle);
+
+    if (slot < 0) {
+        return -1;
+    }
+
+    rules[slot].active = 0;
+    Rules_Reindex();
+    return 0;
+}
+
+uint8_t BLE_Rules_Evaluate(uint16_t conn_handle, uint16_t handle,
+                           const uint8_t *data, uint16_t len)
+{
+    int dev_idx;
+    int slot;
+    int32_t v;
+    uint32_t now;
+    uint8_t match, above;
+    Rule_t *r;
+
+    dev_idx = BLE_DeviceManager_FindConnHandle(conn_handle);
+    if (dev_idx < 0) {
+        return 1;
+    }
+
+    slot = Rules_Lookup((uint8_t)dev_idx, handle);
+    if (slot < 0) {
+        return 1;
+    }
+    r = &rules[slot];
+
+    /* Malformed values are forwarded untouched */
+    if (BLE_Rules_ExtractField(r->def.field, r->def.offset, data, len, &v) != 0) {
+        return 1;
+    }
+
+    match = Rules_Match(r, v, &above);
+
+    /* A rate-limited match keeps the previous side, so the edge still
+       fires on the first value after the interval */
+    now = HAL_GetTick();
+    if (match && r->def.interval_ms > 0 && r->has_match &&
+        (now - r->last_match_tick) < r->def.interval_ms) {
+        r->dropped++;
+        return 0;
+    }
+
+    r->prev_above = above;
+    r->has_value = 1;
+    if (!match) {
+        r->dropped++;
+        return 0;
+    }
+
+    r->has_match = 1;
+    r->last_match_tick = now;
+    r->last = v;
+    r->matched++;
+
+    if (r->def.dst_idx != 0xFFU) {
+        Rules_Trigger(r);
+    }
+    return 1;
+}
+
+void BLE_Rules_Report(void)
+{
+    uint8_t i;
+    const Rule_t *r;
+
+    for (i = 0; i < BLE_RULES_MAX; i++) {
+        r = &rules[i];
+        if (!r->active) {
+            continue;
+        }
+        AT_Response_Send("+RULE:%d,0x%04X,%d:%s,%s:%ld,%u,%lu,%lu,%lu\r\n",
+                         r->def.dev_idx, r->def.handle, r->def.offset,
+                         field_names[r->def.field], cond_names[r->def.cond],
+                         (long)r->def.threshold, r->def.interval_ms,
+                         r->matched, r->dropped, r->triggers);
+    }
+}
+
+int BLE_Rules_ExtractField(uint8_t field, uint8_t offset, const uint8_t *data, uint16_t len,
+                           int32_t *out)
+{
+    const uint8_t *p = &data[offset];
+    uint16_t avail = (len > offset) ? (uint16_t)(len - offset) : 0U;
+
+    switch (field) {
+        case RULE_FIELD_U8:
+        case RULE_FIELD_S8:
+            if (avail < 1U) {
+                return -1;
+            }
+            *out = (field == RULE_FIELD_S8) ? (int32_t)(int8_t)p[0] : (int32_t)p[0];
+            return 0;
+
+        case RULE_FIELD_U16:
+        case RULE_FIELD_S16:
+            if (avail < 2U) {
+                return -1;
+            }
+            *out = (int32_t)(uint16_t)(p[0] | (p[1] << 8));
+            if (field == RULE_FIELD_S16) {
+                *out = (int32_t)(int16_t)*out;
+            }
+            return 0;
+
+        case RULE_FIELD_U32:
+        case RULE_FIELD_S32:
+            if (avail < 4U) {
+                return -1;
+            }
+            /* U32 above INT32_MAX wraps: thresholds compare as signed */
+            *out = (int32_t)((uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+                             ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+            return 0;
+
+        case RULE_FIELD_HR:
+            if (len < 2U) {
+                return -1;
+            }
+            if (data[0] & 0x01U) {
+                if (len < 3U) {
+                    return -1;
+                }
+                *out = (int32_t)(uint16_t)(data[1] | (data[2] << 8));
+            } else {
+                *out = (int32_t)data[1];
+            }
+            return 0;
+
+        case RULE_FIELD_FLT:
+            if (avail < 4U) {
+                return -1;
+            }
+            return BLE_Decoder_Float11073ToCenti((uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+                                                 ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24),
+                                                 out);
+
+        default:
+            return -1;
+    }
+}
+
+BLE_RuleField_t BLE_Rules_FieldFromName(const char *name, uint8_t len)
+{
+    uint8_t i;
+
+    for (i = 0; i < RULE_FIELD_COUNT; i++) {
+        if (strlen(field_names[i]) == len && strncmp(name, field_names[i], len) == 0) {
+            return (BLE_RuleField_t)i;
+        }
+    }
+    return RULE_FIELD_COUNT;
+}
+
+BLE_RuleCond_t BLE_Rules_CondFromName(const char *name, uint8_t len)
+{
+    uint8_t i;
+
+    for (i = 0; i < RULE_COND_COUNT; i++) {
+        if (strlen(cond_names[i]) == len && strncmp(name, cond_names[i], len) == 0) {
+            return (BLE_RuleCond_t)i;
+        }
+    }
+    return RULE_COND_COUNT;
+}
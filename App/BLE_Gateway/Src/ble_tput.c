@@ -0,0 +1,463 @@
+/**
+  ******************************************************************************
+  * @file    ble_tput.c
+  * @brief   Link throughput benchmark implementation
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#define DEBUG_MODULE DEBUG_MOD_BLE
+
+#include "ble_tput.h"
+#include "ble_device_manager.h"
+#include "ble_gatt_client.h"
+#include "ble_l2cap.h"
+#include "module_mode.h"
+#include "at_command.h"
+#include "debug_trace.h"
+#include "main.h"
+#include "hw_if.h"
+#include "app_conf.h"
+#include "stm32_seq.h"
+#include <string.h>
+
+#define TPUT_BURST              16      /* Packets per task run before yielding */
+#define TPUT_TICK_MS            1000    /* End-of-test check period */
+#define TPUT_MS_TO_TS(ms)       (((uint32_t)(ms) * 1000U) / CFG_TS_TICK_VAL)
+
+/*============================================================================
+ * State
+ *============================================================================*/
+typedef struct {
+    uint32_t bytes;
+    uint32_t packets;
+    uint32_t last_tick;
+    uint16_t hist[BLE_TPUT_HIST_BINS];      /* TX: ack RTT or stall time, RX: inter-arrival */
+} TputDirStats_t;
+
+typedef struct {
+    uint8_t active;
+    uint8_t dev_idx;
+    uint8_t dir;                    /* BLE_TputDir_t */
+    uint8_t mode;                   /* Data_TxMode_t */
+    uint8_t in_flight;              /* Write Request awaiting response */
+    uint8_t blocked;                /* Waiting for TX pool / CoC channel */
+    uint16_t conn_handle;
+    uint16_t target;
+    uint16_t packet_len;
+    uint16_t interval;              /* Connection interval, 1.25 ms units */
+    uint32_t start_tick;
+    uint32_t duration_ms;
+    uint32_t elapsed_ms;
+    uint32_t wait_tick;             /* Write sent / stall began */
+    uint32_t seq;
+    uint32_t rx_seq;
+    uint32_t rx_seq_gaps;
+    uint32_t pool_waits;
+    uint32_t slow_acks;
+    uint32_t errors;
+    TputDirStats_t tx;
+    TputDirStats_t rx;
+} TputState_t;
+
+static TputState_t tput;
+static uint8_t tput_timer_id;
+static uint8_t tput_packet[BLE_TPUT_MAX_PACKET];
+
+static void Tput_Task(void);
+
+/*============================================================================
+ * Static Helper Functions
+ *============================================================================*/
+
+static void Tput_TimerCallback(void)
+{
+    UTIL_SEQ_SetTask(1U << CFG_TASK_TPUT_ID, CFG_SCH_PRIO_BG);
+}
+
+static void Tput_HistAdd(uint16_t *hist, uint32_t ms)
+{
+    uint32_t bin = (ms < (BLE_TPUT_HIST_BINS - 1U)) ? ms : (BLE_TPUT_HIST_BINS - 1U);
+
+    if (hist[bin] < 0xFFFFU) {
+        hist[bin]++;
+    }
+}
+
+/**
+ * @brief Smallest bin holding at least pct percent of the samples
+ */
+static uint32_t Tput_Percentile(const uint16_t *hist, uint32_t pct)
+{
+    uint32_t total = 0, need, sum = 0;
+    uint16_t i;
+
+    for (i = 0; i < BLE_TPUT_HIST_BINS; i++) {
+        total += hist[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    need = (total * pct + 99U) / 100U;
+    for (i = 0; i < BLE_TPUT_HIST_BINS; i++) {
+        sum += hist[i];
+        if (sum >= need) {
+            break;
+        }
+    }
+    return (i < BLE_TPUT_HIST_BINS) ? i : (BLE_TPUT_HIST_BINS - 1U);
+}
+
+/**
+ * @brief Packets per connection event, in hundredths
+ */
+static uint32_t Tput_PerEventCenti(uint32_t packets)
+{
+    uint64_t events_x100;
+
+    if (tput.interval == 0 || tput.elapsed_ms == 0) {
+        return 0;
+    }
+    /* events = elapsed_ms / (interval * 1.25 ms) */
+    events_x100 = ((uint64_t)tput.elapsed_ms * 10000U) / ((uint64_t)tput.interval * 125U);
+    if (events_x100 == 0) {
+        return 0;
+    }
+    return (uint32_t)(((uint64_t)packets * 10000U) / events_x100);
+}
+
+static uint32_t Tput_Kbps(uint32_t bytes)
+{
+    return (tput.elapsed_ms > 0) ? (uint32_t)(((uint64_t)bytes * 8U) / tput.elapsed_ms) : 0U;
+}
+
+/**
+ * @brief Common head of a +TPUT:TX/RX line: bytes, packets, kbps, packets per event
+ */
+static void Tput_ReportHead(const char *name, const TputDirStats_t *s)
+{
+    uint32_t ppce = Tput_PerEventCenti(s->packets);
+
+    AT_Response_Send("+TPUT:%s,%lu,%lu,%lu,%lu.%02lu,", name, s->bytes, s->packets,
+                     Tput_Kbps(s->bytes), ppce / 100U, ppce % 100U);
+}
+
+/**
+ * @brief Common tail of a +TPUT:TX/RX line: p50, p90, p99, max (ms)
+ */
+static void Tput_ReportTail(const uint16_t *hist)
+{
+    AT_Response_Send("%lu,%lu,%lu,%lu\r\n", Tput_Percentile(hist, 50),
+                     Tput_Percentile(hist, 90), Tput_Percentile(hist, 99),
+                     Tput_Percentile(hist, 100));
+}
+
+static void Tput_Finish(void)
+{
+    tput.active = 0;
+    tput.elapsed_ms = HAL_GetTick() - tput.start_tick;
+    HW_TS_Stop(tput_timer_id);
+
+    DEBUG_INFO("Tput done: %lu ms", tput.elapsed_ms);
+    BLE_Tput_Report();
+}
+
+/**
+ * @brief Build the next pattern packet: [seq(4, LE)][(i & 0xFF)...]
+ */
+static void Tput_FillPacket(void)
+{
+    tput_packet[0] = (uint8_t)(tput.seq & 0xFFU);
+    tput_packet[1] = (uint8_t)((tput.seq >> 8) & 0xFFU);
+    tput_packet[2] = (uint8_t)((tput.seq >> 16) & 0xFFU);
+    tput_packet[3] = (uint8_t)((tput.seq >> 24) & 0xFFU);
+}
+
+/**
+ * @brief Benchmark task: generate packets as fast as the link accepts them
+ */
+static void Tput_Task(void)
+{
+    uint8_t n;
+    int ret;
+
+    if (!tput.active) {
+        return;
+    }
+
+    if ((HAL_GetTick() - tput.start_tick) >= tput.duration_ms) {
+        Tput_Finish();
+        return;
+    }
+
+    if (!(tput.dir & TPUT_DIR_TX) || tput.in_flight || tput.blocked) {
+        /* RX only, or the completion/credit event reschedules us */
+        return;
+    }
+
+    for (n = 0; n < TPUT_BURST; n++) {
+        Tput_FillPacket();
+
+        if (tput.mode == DATA_TX_COC) {
+            ret = BLE_L2cap_Send((uint8_t)tput.target, tput_packet, tput.packet_len);
+        } else if (tput.mode == DATA_TX_ACKED) {
+            ret = BLE_GATT_WriteCharacteristic(tput.conn_handle, tput.target, tput_packet,
+                                               tput.packet_len);
+        } else {
+            ret = BLE_GATT_TryWriteNoResp(tput.conn_handle, tput.target, tput_packet,
+                                          tput.packet_len);
+        }
+
+        if (ret == 1) {
+            /* Controller buffers full: the stall length goes to the histogram */
+            tput.blocked = 1;
+            tput.pool_waits++;
+            tput.wait_tick = HAL_GetTick();
+            return;
+        }
+        if (ret != 0) {
+            tput.errors++;
+            Tput_Finish();
+            return;
+        }
+
+        tput.seq++;
+        tput.tx.packets++;
+        tput.tx.bytes += tput.packet_len;
+
+        if (tput.mode == DATA_TX_ACKED) {
+            tput.in_flight = 1;
+            tput.wait_tick = HAL_GetTick();
+            return;
+        }
+    }
+
+    UTIL_SEQ_SetTask(1U << CFG_TASK_TPUT_ID, CFG_SCH_PRIO_BG);
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+void BLE_Tput_Init(void)
+{
+    uint16_t i;
+
+    memset(&tput, 0, sizeof(tput));
+    for (i = 0; i < BLE_TPUT_MAX_PACKET; i++) {
+        tput_packet[i] = (uint8_t)i;
+    }
+
+    UTIL_SEQ_RegTask(1U << CFG_TASK_TPUT_ID, UTIL_SEQ_RFU, Tput_Task);
+    HW_TS_Create(CFG_TIM_PROC_ID_ISR, &tput_timer_id, hw_ts_Repeated, Tput_TimerCallback);
+
+    DEBUG_INFO("Throughput benchmark initialized");
+}
+
+int BLE_Tput_Start(uint8_t dev_idx, BLE_TputDir_t dir, uint16_t seconds, uint8_t mode,
+                   uint16_t target)
+{
+    BLE_Device_t *dev = BLE_DeviceManager_GetDevice(dev_idx);
+    uint16_t len;
+
+    if (tput.active || dev == NULL || !dev->is_connected || dir == TPUT_DIR_INVALID ||
+        dir > TPUT_DIR_BOTH || seconds == 0 || seconds > BLE_TPUT_MAX_SECONDS ||
+        mode > DATA_TX_COC) {
+        return -1;
+    }
+
+    if (mode == DATA_TX_COC) {
+        if (BLE_L2cap_GetConnHandle((uint8_t)target) != dev->conn_handle) {
+            return -1;
+        }
+        len = BLE_L2cap_GetSduMax((uint8_t)target);
+    } else {
+        if ((dir & TPUT_DIR_TX) && target == 0) {
+            return -1;
+        }
+        len = (uint16_t)(dev->att_mtu - 3U);
+    }
+    if (len > BLE_TPUT_MAX_PACKET) {
+        len = BLE_TPUT_MAX_PACKET;
+    }
+    if (len < 4U) {
+        return -1;
+    }
+
+    memset(&tput, 0, sizeof(tput));
+    tput.dev_idx = dev_idx;
+    tput.dir = (uint8_t)dir;
+    tput.mode = mode;
+    tput.conn_handle = dev->conn_handle;
+    tput.target = target;
+    tput.packet_len = len;
+    tput.interval = dev->conn_interval;
+    tput.duration_ms = (uint32_t)seconds * 1000U;
+    tput.start_tick = HAL_GetTick();
+    tput.active = 1;
+
+    DEBUG_INFO("Tput start: dev=%d dir=%d %us mode=%d target=0x%04X len=%d", dev_idx, dir,
+               seconds, mode, target, len);
+
+    HW_TS_Stop(tput_timer_id);
+    HW_TS_Start(tput_timer_id, TPUT_MS_TO_TS(TPUT_TICK_MS));
+    UTIL_SEQ_SetTask(1U << CFG_TASK_TPUT_ID, CFG_SCH_PRIO_BG);
+    return 0;
+}
+
+int BLE_Tput_Stop(void)
+{
+    if (!tput.active) {
+        return -1;
+    }
+
+    Tput_Finish();
+    return 0;
+}
+
+uint8_t BLE_Tput_IsActive(void)
+{
+    return tput.active;
+}
+
+void BLE_Tput_Report(void)
+{
+    static const char *mode_names[] = {"NORESP", "ACK", "COC"};
+
+    if (tput.active) {
+        tput.elapsed_ms = HAL_GetTick() - tput.start_tick;
+    }
+    if (tput.dir == TPUT_DIR_INVALID) {
+        return;
+    }
+
+    AT_Response_Send("+TPUT:%s,%d,%s,%lu,%d,%d\r\n", tput.active ? "RUN" : "DONE",
+                     tput.dev_idx, mode_names[tput.mode], tput.elapsed_ms,
+                     tput.packet_len, tput.interval);
+    if (tput.dir & TPUT_DIR_TX) {
+        Tput_ReportHead("TX", &tput.tx);
+        AT_Response_Send("%lu,%lu,%lu,", tput.pool_waits, tput.slow_acks, tput.errors);
+        Tput_ReportTail(tput.tx.hist);
+    }
+    if (tput.dir & TPUT_DIR_RX) {
+        Tput_ReportHead("RX", &tput.rx);
+        AT_Response_Send("%lu,", tput.rx_seq_gaps);
+        Tput_ReportTail(tput.rx.hist);
+    }
+}
+
+BLE_TputDir_t BLE_Tput_DirFromName(const char *name, uint8_t len)
+{
+    static const char *dir_names[] = {"", "TX", "RX", "BOTH"};
+    uint8_t i, j;
+
+    for (i = TPUT_DIR_TX; i <= TPUT_DIR_BOTH; i++) {
+        if (strlen(dir_names[i]) != len) {
+            continue;
+        }
+        for (j = 0; j < len; j++) {
+            /* ASCII letters: clear the lowercase bit */
+            if ((uint8_t)(name[j] & 0xDFU) != (uint8_t)dir_names[i][j]) {
+                break;
+            }
+        }
+        if (j == len) {
+            return (BLE_TputDir_t)i;
+        }
+    }
+    return TPUT_DIR_INVALID;
+}
+
+/*============================================================================
+ * Stack Events
+ *============================================================================*/
+static void Tput_RxCount(uint16_t len)
+{
+    uint32_t now = HAL_GetTick();
+
+    if (tput.rx.packets > 0) {
+        Tput_HistAdd(tput.rx.hist, now - tput.rx.last_tick);
+    }
+    tput.rx.last_tick = now;
+    tput.rx.packets++;
+    tput.rx.bytes += len;
+}
+
+uint8_t BLE_Tput_OnNotification(uint16_t conn_handle, const uint8_t *data, uint16_t len)
+{
+    uint32_t seq;
+
+    if (!tput.active || !(tput.dir & TPUT_DIR_RX) || tput.mode == DATA_TX_COC ||
+        conn_handle != tput.conn_handle) {
+        return 0;
+    }
+
+    /* Peers that send the gateway pattern expose lost packets as sequence gaps */
+    if (len >= 4U) {
+        seq = (uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+              ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+        if (tput.rx.packets > 0 && seq != (uint32_t)(tput.rx_seq + 1U)) {
+            tput.rx_seq_gaps++;
+        }
+        tput.rx_seq = seq;
+    }
+
+    Tput_RxCount(len);
+    return 1;
+}
+
+uint8_t BLE_Tput_OnCocRx(uint8_t ch, uint16_t len)
+{
+    if (!tput.active || !(tput.dir & TPUT_DIR_RX) || tput.mode != DATA_TX_COC ||
+        ch != tput.target) {
+        return 0;
+    }
+
+    Tput_RxCount(len);
+    return 1;
+}
+
+uint8_t BLE_Tput_OnProcComplete(uint16_t conn_handle, uint8_t error_code)
+{
+    uint32_t rtt;
+    uint32_t slow_ms;
+
+    if (!tput.active || !tput.in_flight || conn_handle != tput.conn_handle) {
+        return 0;
+    }
+
+    tput.in_flight = 0;
+    rtt = HAL_GetTick() - tput.wait_tick;
+    Tput_HistAdd(tput.tx.hist, rtt);
+
+    /* A response later than two connection events points to LL retransmissions */
+    slow_ms = ((uint32_t)tput.interval * 5U * 2U) / 4U;
+    if (tput.interval > 0 && rtt > slow_ms + 1U) {
+        tput.slow_acks++;
+    }
+    if (error_code != 0) {
+        tput.errors++;
+    }
+
+    UTIL_SEQ_SetTask(1U << CFG_TASK_TPUT_ID, CFG_SCH_PRIO_BG);
+    return 1;
+}
+
+void BLE_Tput_OnTxPoolAvailable(uint16_t conn_handle)
+{
+    if (!tput.active || !tput.blocked || conn_handle != tput.conn_handle) {
+        return;
+    }
+
+    tput.blocked = 0;
+    Tput_HistAdd(tput.tx.hist, HAL_GetTick() - tput.wait_tick);
+    UTIL_SEQ_SetTask(1U << CFG_TASK_TPUT_ID, CFG_SCH_PRIO_BG);
+}
+
+void BLE_Tput_OnDisconnected(uint16_t conn_handle)
+{
+    if (tput.active && conn_handle == tput.conn_handle) {
+        tput.errors++;
+        Tput_Finish();
+    }
+}
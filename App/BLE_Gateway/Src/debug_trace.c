@@ -6,38 +6,482 @@
   ******************************************************************************
   */
 
+#define DEBUG_MODULE DEBUG_MOD_SYS
+
 #include "debug_trace.h"
+#include "at_command.h"
+#include "main.h"
+#include "app_conf.h"
+#include "stm32_seq.h"
+#include "usbd_cdc_if.h"
+#include <stdarg.h>
+#include <string.h>
+
+extern USBD_HandleTypeDef hUsbDeviceFS;
+
+/*============================================================================
+ * State
+ *============================================================================*/
+#define DEBUG_SPEC_MAX          12
+#define DEBUG_STR_BUDGET        (4 * DEBUG_STR_MAX)     /* All strings of one record */
+
+/* Ring record: header, nargs 32-bit arguments, then the copied strings */
+typedef struct {
+    const Debug_Site_t *site;
+    uint32_t tick;
+    uint16_t size;                  /* Whole record, bytes */
+    uint16_t suppressed;            /* Rate limited at this site before it */
+    uint8_t nargs;
+    uint8_t reserved[3];
+} Debug_Record_t;
+
+#define DEBUG_RECORD_MAX        (sizeof(Debug_Record_t) + 4 * DEBUG_MAX_ARGS + DEBUG_STR_BUDGET)
+
+static uint8_t debug_ring[DEBUG_RING_SIZE];
+static uint16_t debug_head = 0;     /* Next byte written */
+static uint16_t debug_tail = 0;     /* Oldest record */
+static uint16_t debug_used = 0;
+
+static uint32_t debug_rec[(DEBUG_RECORD_MAX + 3) / 4];
+static char debug_line[DEBUG_LINE_MAX];
+static uint16_t debug_line_len = 0; /* Rendered, not yet accepted by the endpoint */
+static volatile uint8_t debug_tx_busy = 0;
+static uint8_t debug_ready = 0;
+#if DEBUG_TOKENIZED
+static uint32_t debug_last_tick = 0;
+#endif
+
+/* Statistics */
+static uint32_t debug_stat_logged = 0;
+static uint32_t debug_stat_dropped = 0;
+static uint32_t debug_stat_suppressed = 0;
+static uint16_t debug_stat_peak = 0;
+
+#if !DEBUG_TOKENIZED
+static const char * const debug_prefix[] = {
+    "", "[ERROR] ", "[WARN] ", "[INFO] ", "[DEBUG] "
+};
+#endif
+
+/*============================================================================
+ * Static Helper Functions
+ *============================================================================*/
+
+#if !DEBUG_TOKENIZED
+/**
+ * @brief Parse one conversion (p points after '%')
+ * @param spec Receives it without length modifiers: arguments are 32-bit
+ * @return Pointer after the conversion character
+ */
+static const char* Debug_ParseSpec(const char *p, char *spec, uint8_t *stars, char *conv)
+{
+    uint8_t n = 0;
+
+    spec[n++] = '%';
+    *stars = 0;
+    while (*p != '\0' && strchr("-+ #0", *p) != 0 && n < DEBUG_SPEC_MAX - 2) {
+        spec[n++] = *p++;
+    }
+    while (((*p >= '0' && *p <= '9') || *p == '.' || *p == '*') && n < DEBUG_SPEC_MAX - 2) {
+        if (*p == '*') {
+            (*stars)++;
+        }
+        spec[n++] = *p++;
+    }
+    while (*p != '\0' && strchr("hlzjt", *p) != 0) {
+        p++;
+    }
+
+    *conv = *p;
+    if (*p != '\0') {
+        spec[n++] = (*p == 'p') ? 'X' : *p;
+        p++;
+    }
+    spec[n] = '\0';
+    return p;
+}
+#endif /* !DEBUG_TOKENIZED */
+
+static void Debug_RingWrite(const uint8_t *src, uint16_t len)
+{
+    uint16_t first = (uint16_t)(DEBUG_RING_SIZE - debug_head);
+
+    if (first > len) {
+        first = len;
+    }
+    memcpy(&debug_ring[debug_head], src, first);
+    memcpy(debug_ring, src + first, len - first);
+    debug_head = (uint16_t)((debug_head + len) % DEBUG_RING_SIZE);
+}
+
+static void Debug_RingRead(uint16_t pos, uint8_t *dst, uint16_t len)
+{
+    uint16_t first = (uint16_t)(DEBUG_RING_SIZE - pos);
+
+    if (first > len) {
+        first = len;
+    }
+    memcpy(dst, &debug_ring[pos], first);
+    memcpy(dst + first, debug_ring, len - first);
+}
+
+/**
+ * @brief Move the oldest record to debug_rec
+ * @return 1 if a record was taken, 0 if the ring is empty
+ */
+static uint8_t Debug_Pop(void)
+{
+    Debug_Record_t hdr;
+    uint32_t primask;
+
+    if (debug_used == 0) {
+        return 0;
+    }
+
+    /* Producers only append: the tail record is stable until freed */
+    Debug_RingRead(debug_tail, (uint8_t*)&hdr, sizeof(hdr));
+    Debug_RingRead(debug_tail, (uint8_t*)debug_rec, hdr.size);
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    debug_tail = (uint16_t)((debug_tail + hdr.size) % DEBUG_RING_SIZE);
+    debug_used = (uint16_t)(debug_used - hdr.size);
+    __set_PRIMASK(primask);
+    return 1;
+}
+
+#if !DEBUG_TOKENIZED
+static uint16_t Debug_Append(uint16_t pos, int n, uint16_t room)
+{
+    if (n < 0) {
+        return pos;
+    }
+    if ((uint32_t)pos + (uint32_t)n >= room) {
+        return (uint16_t)(room - 1U);
+    }
+    return (uint16_t)(pos + n);
+}
+
+/**
+ * @brief Format the record in debug_rec
+ * @return Line length, "\r\n" included
+ */
+static uint16_t Debug_Render(char *out, uint16_t size)
+{
+    const Debug_Record_t *hdr = (const Debug_Record_t*)debug_rec;
+    const uint32_t *args = (const uint32_t*)(hdr + 1);
+    const char *strings = (const char*)(args + hdr->nargs);
+    const char *p = hdr->site->fmt;
+    uint16_t room = (uint16_t)(size - 2U);      /* Keep "\r\n" */
+    uint16_t pos = 0;
+    uint8_t a = 0, stars;
+    char spec[DEBUG_SPEC_MAX];
+    char conv;
+    int n;
+
+    n = snprintf(out, room, "%s", debug_prefix[hdr->site->level]);
+    pos = Debug_Append(pos, n, room);
+
+    while (*p != '\0' && pos < room - 1U) {
+        if (*p != '%') {
+            out[pos++] = *p++;
+            continue;
+        }
+        p++;
+        if (*p == '%') {
+            out[pos++] = *p++;
+            continue;
+        }
+
+        p = Debug_ParseSpec(p, spec, &stars, &conv);
+        if (conv == '\0') {
+            break;
+        }
+        if (a + stars >= hdr->nargs ||
+            (conv == 's') != ((hdr->site->strmask >> (a + stars)) & 1U)) {
+            /* Format and arguments disagree */
+            out[pos++] = '?';
+            a = (uint8_t)(a + stars + 1U);
+            continue;
+        }
+
+        if (conv == 's') {
+            if (stars == 0) {
+                n = snprintf(&out[pos], room - pos, spec, &strings[args[a]]);
+            } else {
+                n = snprintf(&out[pos], room - pos, spec, (int)args[a], &strings[args[a + 1U]]);
+            }
+        } else if (stars == 0) {
+            n = snprintf(&out[pos], room - pos, spec, args[a]);
+        } else if (stars == 1) {
+            n = snprintf(&out[pos], room - pos, spec, (int)args[a], args[a + 1U]);
+        } else {
+            n = snprintf(&out[pos], room - pos, spec, (int)args[a], (int)args[a + 1U], args[a + 2U]);
+        }
+        a = (uint8_t)(a + stars + 1U);
+        pos = Debug_Append(pos, n, room);
+    }
+
+    if (hdr->suppressed > 0) {
+        n = snprintf(&out[pos], room - pos, " (+%u suppressed)", hdr->suppressed);
+        pos = Debug_Append(pos, n, room);
+    }
+
+    out[pos++] = '\r';
+    out[pos++] = '\n';
+    return pos;
+}
+#else
+#define DEBUG_VARINT_MAX        5U      /* LEB128 of a 32-bit value */
+#define DEBUG_FRAME_MAX         (2U + 255U)
+/* Sync, length, token, level, time delta, suppressed count */
+#define DEBUG_FRAME_HDR_MAX     (2U + DEBUG_VARINT_MAX + 1U + DEBUG_VARINT_MAX + 3U)
+
+_Static_assert(DEBUG_LINE_MAX >= DEBUG_FRAME_HDR_MAX, "debug line too short for a frame header");
+
+static uint16_t Debug_PutVarint(uint8_t *out, uint16_t pos, uint32_t v)
+{
+    while (v >= 0x80U) {
+        out[pos++] = (uint8_t)(v | 0x80U);
+        v >>= 7;
+    }
+    out[pos++] = (uint8_t)v;
+    return pos;
+}
+
+/**
+ * @brief Encode the record in debug_rec as a token frame
+ * @return Frame length
+ * @note  Arguments that do not fit are cut: the last string is truncated and
+ *        the decoder shows "?" for missing arguments
+ */
+static uint16_t Debug_Encode(uint8_t *out, uint16_t size)
+{
+    const Debug_Record_t *hdr = (const Debug_Record_t*)debug_rec;
+    const uint32_t *args = (const uint32_t*)(hdr + 1);
+    const char *strings = (const char*)(args + hdr->nargs);
+    uint16_t room = (size < DEBUG_FRAME_MAX) ? size : (uint16_t)DEBUG_FRAME_MAX;
+    uint16_t pos = 2;
+    uint8_t i, len;
+
+    /* The format address is the token: the string itself is not on target */
+    pos = Debug_PutVarint(out, pos, (uint32_t)(uintptr_t)hdr->site->fmt);
+    out[pos++] = (uint8_t)(hdr->site->level | ((hdr->suppressed > 0) ? DEBUG_TOKEN_SUPPRESSED : 0U));
+    pos = Debug_PutVarint(out, pos, hdr->tick - debug_last_tick);
+    debug_last_tick = hdr->tick;
+    if (hdr->suppressed > 0) {
+        pos = Debug_PutVarint(out, pos, hdr->suppressed);
+    }
+
+    for (i = 0; i < hdr->nargs; i++) {
+        if ((hdr->site->strmask >> i) & 1U) {
+            if (pos + 1U >= room) {
+                break;
+            }
+            len = (uint8_t)strlen(&strings[args[i]]);
+            if (len > room - pos - 1U) {
+                len = (uint8_t)(room - pos - 1U);
+            }
+            out[pos++] = len;
+            memcpy(&out[pos], &strings[args[i]], len);
+            pos = (uint16_t)(pos + len);
+        } else {
+            if (pos + DEBUG_VARINT_MAX > room) {
+                break;
+            }
+            pos = Debug_PutVarint(out, pos, args[i]);
+        }
+    }
+
+    out[0] = DEBUG_TOKEN_SYNC;
+    out[1] = (uint8_t)(pos - 2U);
+    return pos;
+}
+#endif /* !DEBUG_TOKENIZED */
+
+/**
+ * @brief Sequencer task: one line per USB IN transfer
+ */
+static void Debug_Task(void)
+{
+    /* Keep records until the host has enumerated the port */
+    if (hUsbDeviceFS.dev_state != USBD_STATE_CONFIGURED) {
+        debug_tx_busy = 0;
+        return;
+    }
+    if (debug_tx_busy) {
+        return;
+    }
+
+    if (debug_line_len == 0) {
+        if (!Debug_Pop()) {
+            return;
+        }
+#if DEBUG_TOKENIZED
+        debug_line_len = Debug_Encode((uint8_t*)debug_line, sizeof(debug_line));
+#else
+        debug_line_len = Debug_Render(debug_line, sizeof(debug_line));
+#endif
+    }
+
+    /* Set first: the completion interrupt may come before the call returns */
+    debug_tx_busy = 1;
+    if (CDC_Transmit_FS((uint8_t*)debug_line, debug_line_len) == USBD_OK) {
+        debug_line_len = 0;
+    } else {
+        /* Endpoint used by a printf: its completion retries this line */
+        debug_tx_busy = 0;
+    }
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+void DEBUG_Init(void)
+{
+    debug_line_len = 0;
+    debug_tx_busy = 0;
+
+    UTIL_SEQ_RegTask(1U << CFG_TASK_LOG_ID, UTIL_SEQ_RFU, Debug_Task);
+    debug_ready = 1;
+
+    if (debug_used > 0) {
+        UTIL_SEQ_SetTask(1U << CFG_TASK_LOG_ID, CFG_SCH_PRIO_BG);
+    }
+}
+
+void DEBUG_Log(Debug_Site_t *site, ...)
+{
+    uint32_t rec[(DEBUG_RECORD_MAX + 3) / 4];
+    Debug_Record_t *hdr = (Debug_Record_t*)rec;
+    uint32_t *args = (uint32_t*)(hdr + 1);
+    char strings[DEBUG_STR_BUDGET];
+    uint16_t str_len = 0, len, args_size;
+    uint32_t now = HAL_GetTick();
+    uint32_t primask;
+    const char *s;
+    uint8_t i;
+    va_list ap;
+
+    /* Rate limit before any formatting work */
+    primask = __get_PRIMASK();
+    __disable_irq();
+    if ((uint32_t)(now - site->window_start) >= DEBUG_RATE_WINDOW_MS) {
+        site->window_start = now;
+        site->count = 0;
+    }
+    if (site->count >= DEBUG_RATE_BURST) {
+        if (site->suppressed < 0xFFFFU) {
+            site->suppressed++;
+        }
+        debug_stat_suppressed++;
+        __set_PRIMASK(primask);
+        return;
+    }
+    site->count++;
+    __set_PRIMASK(primask);
+
+    /* Capture the arguments as 32-bit words; strings by copy */
+    hdr->site = site;
+    hdr->tick = now;
+    hdr->nargs = site->nargs;
+    va_start(ap, site);
+    for (i = 0; i < site->nargs; i++) {
+        if ((site->strmask >> i) & 1U) {
+            s = va_arg(ap, const char*);
+            if (s == 0) {
+                s = "(null)";
+            }
+            len = (uint16_t)strnlen(s, DEBUG_STR_MAX);
+            if (len > DEBUG_STR_BUDGET - 1U - str_len) {
+                len = (uint16_t)(DEBUG_STR_BUDGET - 1U - str_len);
+            }
+            args[i] = str_len;
+            memcpy(&strings[str_len], s, len);
+            str_len = (uint16_t)(str_len + len);
+            strings[str_len++] = '\0';
+        } else {
+            args[i] = va_arg(ap, uint32_t);
+        }
+    }
+    va_end(ap);
+
+    args_size = (uint16_t)(hdr->nargs * sizeof(uint32_t));
+    memcpy((uint8_t*)args + args_size, strings, str_len);
+    hdr->size = (uint16_t)((sizeof(Debug_Record_t) + args_size + str_len + 3U) & ~3U);
+
+    /* Commit, or drop if the output task is that far behind */
+    primask = __get_PRIMASK();
+    __disable_irq();
+    if (debug_used + hdr->size > DEBUG_RING_SIZE) {
+        debug_stat_dropped++;
+        __set_PRIMASK(primask);
+        return;
+    }
+    hdr->suppressed = site->suppressed;
+    site->suppressed = 0;
+    Debug_RingWrite((const uint8_t*)rec, hdr->size);
+    debug_used = (uint16_t)(debug_used + hdr->size);
+    if (debug_used > debug_stat_peak) {
+        debug_stat_peak = debug_used;
+    }
+    debug_stat_logged++;
+    __set_PRIMASK(primask);
+
+    if (debug_ready) {
+        UTIL_SEQ_SetTask(1U << CFG_TASK_LOG_ID, CFG_SCH_PRIO_BG);
+    }
+}
+
+void DEBUG_OnTxComplete(void)
+{
+    debug_tx_busy = 0;
+    if (debug_ready && (debug_line_len > 0 || debug_used > 0)) {
+        UTIL_SEQ_SetTask(1U << CFG_TASK_LOG_ID, CFG_SCH_PRIO_BG);
+    }
+}
+
+void DEBUG_Report(void)
+{
+    AT_Response_Send("+LOG:%d,0x%04X,%lu,%lu,%lu,%d,%d,%d\r\n", DEBUG_LEVEL, DEBUG_MODULES,
+                     debug_stat_logged, debug_stat_dropped, debug_stat_suppressed,
+                     debug_used, debug_stat_peak, DEBUG_TOKENIZED);
+}
 
 void DEBUG_PrintMAC(const uint8_t *mac)
 {
     if (!mac) {
-        printf("MAC: (NULL)\r\n");
+        DEBUG_PRINT("MAC: (NULL)");
         return;
     }
-    printf("MAC: %02X:%02X:%02X:%02X:%02X:%02X\r\n",
-           mac[5], mac[4], mac[3], mac[2], mac[1], mac[0]);
+    DEBUG_PRINT("MAC: %02X:%02X:%02X:%02X:%02X:%02X",
+                mac[5], mac[4], mac[3], mac[2], mac[1], mac[0]);
 }
 
 void DEBUG_PrintHEX(const uint8_t *data, uint16_t len)
 {
+    char hex[DEBUG_STR_MAX + 1];
+    uint16_t i;
+
     if (!data || len == 0) {
-        printf("HEX: (empty)\r\n");
+        DEBUG_PRINT("HEX: (empty)");
         return;
     }
-    
-    printf("HEX[%d]: ", len);
-    for (uint16_t i = 0; i < len; i++) {
-        printf("%02X ", data[i]);
+
+    /* One string argument: the first DEBUG_STR_MAX / 2 bytes */
+    for (i = 0; i < len && i < DEBUG_STR_MAX / 2; i++) {
+        snprintf(&hex[i * 2U], 3, "%02X", data[i]);
     }
-    printf("\r\n");
+    hex[i * 2U] = '\0';
+    DEBUG_PRINT("HEX[%d]: %s%s", len, hex, (i < len) ? ".." : "");
 }
 
 void DEBUG_PrintConnectionInfo(uint16_t conn_handle)
 {
-    printf("=== Connection Handle: 0x%04X ===\r\n", conn_handle);
+    DEBUG_PRINT("=== Connection Handle: 0x%04X ===", conn_handle);
 }
 
 void DEBUG_PrintDeviceList(void)
 {
-    printf("=== Device List ===\r\n");
+    DEBUG_PRINT("=== Device List ===");
 }
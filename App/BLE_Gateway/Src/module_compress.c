@@ -0,0 +1,406 @@
+/**
+  ******************************************************************************
+  * @file    module_compress.c
+  * @brief   Streaming LZ compression of UART data mode traffic
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#define DEBUG_MODULE DEBUG_MOD_DATA
+
+#include "module_compress.h"
+#include "ble_device_manager.h"
+#include "at_command.h"
+#include "debug_trace.h"
+#include "main.h"
+#include <string.h>
+
+/*============================================================================
+ * State
+ *============================================================================*/
+#define COMPRESS_WINDOW_MASK    (COMPRESS_WINDOW - 1U)
+#define COMPRESS_HASH_SIZE      256U    /* Power of 2 */
+#define COMPRESS_CHAIN_MAX      8       /* Candidates tried per position */
+#define COMPRESS_FREE           0xFFU
+
+typedef struct {
+    uint8_t link;                   /* COMPRESS_FREE if unused */
+    uint16_t pos;                   /* Bytes through the window, mod 2^16 */
+    uint16_t filled;                /* Valid history, up to COMPRESS_WINDOW */
+    uint32_t raw_bytes;
+    uint32_t packed_bytes;
+    uint32_t errors;                /* Decoder: bad references */
+    uint64_t cycles;
+    uint8_t window[COMPRESS_WINDOW];
+} CompStream_t;
+
+typedef struct {
+    CompStream_t s;
+    uint16_t head[COMPRESS_HASH_SIZE];  /* Newest position per 3-byte hash */
+    uint16_t prev[COMPRESS_WINDOW];     /* Older position with the same hash */
+} CompEncoder_t;
+
+typedef struct {
+    CompStream_t s;
+    uint8_t flags;
+    uint8_t bits;                   /* Tokens left in the group, 0 = next is flags */
+    uint8_t hi;                     /* First byte of a split reference */
+    uint8_t have_hi;
+} CompDecoder_t;
+
+static CompEncoder_t encoders[COMPRESS_MAX_STREAMS];
+static CompDecoder_t decoders[COMPRESS_MAX_STREAMS];
+
+/*============================================================================
+ * Static Helper Functions
+ *============================================================================*/
+
+static CompEncoder_t* Comp_FindEncoder(uint8_t link)
+{
+    uint8_t i;
+
+    for (i = 0; i < COMPRESS_MAX_STREAMS; i++) {
+        if (encoders[i].s.link == link) {
+            return &encoders[i];
+        }
+    }
+    return NULL;
+}
+
+static CompDecoder_t* Comp_FindDecoder(uint8_t link)
+{
+    uint8_t i;
+
+    for (i = 0; i < COMPRESS_MAX_STREAMS; i++) {
+        if (decoders[i].s.link == link) {
+            return &decoders[i];
+        }
+    }
+    return NULL;
+}
+
+static void Comp_ResetStream(CompStream_t *s)
+{
+    s->pos = 0;
+    s->filled = 0;
+    s->raw_bytes = 0;
+    s->packed_bytes = 0;
+    s->errors = 0;
+    s->cycles = 0;
+}
+
+static void Comp_ResetEncoder(CompEncoder_t *e)
+{
+    Comp_ResetStream(&e->s);
+    memset(e->head, 0, sizeof(e->head));
+}
+
+static void Comp_ResetDecoder(CompDecoder_t *d)
+{
+    Comp_ResetStream(&d->s);
+    d->flags = 0;
+    d->bits = 0;
+    d->have_hi = 0;
+}
+
+static uint16_t Comp_Hash(const uint8_t *p)
+{
+    uint32_t v = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+
+    return (uint16_t)((v * 2654435761U) >> 24);
+}
+
+/**
+ * @brief Longest match for in[i..] in the window (and its own overlap)
+ * @return Match length, 0 if shorter than COMPRESS_MIN_MATCH
+ */
+static uint16_t Comp_Match(const CompEncoder_t *e, const uint8_t *in, uint16_t i,
+                           uint16_t len, uint16_t *offset)
+{
+    const CompStream_t *s = &e->s;
+    uint16_t max = (uint16_t)(len - i);
+    uint16_t cand, d, last_d = 0, k, best = 0;
+    uint8_t depth, src;
+
+    if (max < COMPRESS_MIN_MATCH) {
+        return 0;
+    }
+    if (max > COMPRESS_MAX_MATCH) {
+        max = COMPRESS_MAX_MATCH;
+    }
+
+    cand = e->head[Comp_Hash(&in[i])];
+    for (depth = 0; depth < COMPRESS_CHAIN_MAX; depth++) {
+        /* Chains only go back in time; anything else is a recycled slot */
+        d = (uint16_t)(s->pos - cand);
+        if (d <= last_d || d > s->filled || d >= COMPRESS_WINDOW) {
+            break;
+        }
+
+        for (k = 0; k < max; k++) {
+            src = (k < d) ? s->window[(uint16_t)(s->pos - d + k) & COMPRESS_WINDOW_MASK]
+                          : in[i + k - d];
+            if (src != in[i + k]) {
+                break;
+            }
+        }
+        if (k > best) {
+            best = k;
+            *offset = d;
+            if (k == max) {
+                break;
+            }
+        }
+
+        last_d = d;
+        cand = e->prev[cand & COMPRESS_WINDOW_MASK];
+    }
+
+    return (best >= COMPRESS_MIN_MATCH) ? best : 0U;
+}
+
+/**
+ * @brief Move encoded bytes into the window, indexing positions with 3 bytes known
+ */
+static void Comp_Append(CompEncoder_t *e, const uint8_t *in, uint16_t i, uint16_t n,
+                        uint16_t len)
+{
+    CompStream_t *s = &e->s;
+    uint16_t h;
+
+    for (; n > 0; n--, i++) {
+        if (i + 2U < len) {
+            h = Comp_Hash(&in[i]);
+            e->prev[s->pos & COMPRESS_WINDOW_MASK] = e->head[h];
+            e->head[h] = s->pos;
+        }
+        s->window[s->pos & COMPRESS_WINDOW_MASK] = in[i];
+        s->pos++;
+        if (s->filled < COMPRESS_WINDOW) {
+            s->filled++;
+        }
+    }
+}
+
+static void Comp_Emit(CompDecoder_t *d, uint8_t byte, uint8_t *out, uint16_t out_max,
+                      uint16_t *n)
+{
+    CompStream_t *s = &d->s;
+
+    s->window[s->pos & COMPRESS_WINDOW_MASK] = byte;
+    s->pos++;
+    if (s->filled < COMPRESS_WINDOW) {
+        s->filled++;
+    }
+
+    if (*n < out_max) {
+        out[*n] = byte;
+    }
+    (*n)++;
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+void Module_Compress_Init(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < COMPRESS_MAX_STREAMS; i++) {
+        encoders[i].s.link = COMPRESS_FREE;
+        decoders[i].s.link = COMPRESS_FREE;
+    }
+}
+
+int Module_Compress_Set(uint8_t link, uint8_t up, uint8_t down)
+{
+    CompEncoder_t *e;
+    CompDecoder_t *d;
+
+    if (link >= MAX_BLE_DEVICES || up > 1U || down > 1U) {
+        return -1;
+    }
+
+    e = Comp_FindEncoder(link);
+    d = Comp_FindDecoder(link);
+
+    /* All or nothing: check both pools before changing either */
+    if ((down && e == NULL && Comp_FindEncoder(COMPRESS_FREE) == NULL) ||
+        (up && d == NULL && Comp_FindDecoder(COMPRESS_FREE) == NULL)) {
+        return -1;
+    }
+
+    if (!down && e != NULL) {
+        e->s.link = COMPRESS_FREE;
+    } else if (down && e == NULL) {
+        e = Comp_FindEncoder(COMPRESS_FREE);
+        Comp_ResetEncoder(e);
+        e->s.link = link;
+    }
+
+    if (!up && d != NULL) {
+        d->s.link = COMPRESS_FREE;
+    } else if (up && d == NULL) {
+        d = Comp_FindDecoder(COMPRESS_FREE);
+        Comp_ResetDecoder(d);
+        d->s.link = link;
+    }
+
+    DEBUG_INFO("Compression link %d: up=%d down=%d", link, up, down);
+    return 0;
+}
+
+uint8_t Module_Compress_IsEnabled(uint8_t link, Compress_Dir_t dir)
+{
+    if (dir == COMPRESS_DOWN) {
+        return (Comp_FindEncoder(link) != NULL) ? 1U : 0U;
+    }
+    return (Comp_FindDecoder(link) != NULL) ? 1U : 0U;
+}
+
+void Module_Compress_Reset(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < COMPRESS_MAX_STREAMS; i++) {
+        Comp_ResetEncoder(&encoders[i]);
+        Comp_ResetDecoder(&decoders[i]);
+    }
+}
+
+uint16_t Module_Compress_Encode(uint8_t link, const uint8_t *in, uint16_t len, uint8_t *out)
+{
+    CompEncoder_t *e = Comp_FindEncoder(link);
+    uint16_t i = 0, o = 0, flags_pos = 0, n, offset = 0;
+    uint8_t tokens = 8;
+    uint32_t t0;
+
+    if (e == NULL || len == 0 || len > COMPRESS_BLOCK_MAX) {
+        return 0;
+    }
+
+    t0 = DWT->CYCCNT;
+
+    while (i < len) {
+        if (tokens == 8U) {
+            flags_pos = o;
+            out[o++] = 0;
+            tokens = 0;
+        }
+
+        n = Comp_Match(e, in, i, len, &offset);
+        if (n > 0) {
+            out[o++] = (uint8_t)(offset >> 4);
+            out[o++] = (uint8_t)((offset << 4) | (n - COMPRESS_MIN_MATCH));
+        } else {
+            n = 1;
+            out[flags_pos] |= (uint8_t)(1U << tokens);
+            out[o++] = in[i];
+        }
+        tokens++;
+
+        Comp_Append(e, in, i, n, len);
+        i = (uint16_t)(i + n);
+    }
+
+    /* Sync marker ends a partial group so the host can decode this block now */
+    if (tokens < 8U) {
+        out[o++] = 0;
+        out[o++] = 0;
+    }
+
+    e->s.cycles += DWT->CYCCNT - t0;
+    e->s.raw_bytes += len;
+    e->s.packed_bytes += o;
+    return o;
+}
+
+uint16_t Module_Compress_Decode(uint8_t link, const uint8_t *in, uint16_t len,
+                                uint8_t *out, uint16_t out_max)
+{
+    CompDecoder_t *d = Comp_FindDecoder(link);
+    CompStream_t *s;
+    uint16_t i, n = 0, offset, k;
+    uint8_t b, mlen;
+    uint32_t t0;
+
+    if (d == NULL) {
+        return 0;
+    }
+    s = &d->s;
+
+    t0 = DWT->CYCCNT;
+
+    for (i = 0; i < len; i++) {
+        b = in[i];
+
+        if (d->bits == 0) {
+            d->flags = b;
+            d->bits = 8;
+            continue;
+        }
+
+        if (d->flags & 0x01U) {
+            Comp_Emit(d, b, out, out_max, &n);
+        } else if (!d->have_hi) {
+            d->hi = b;
+            d->have_hi = 1;
+            continue;
+        } else {
+            d->have_hi = 0;
+            offset = (uint16_t)(((uint16_t)d->hi << 4) | (b >> 4));
+            if (offset == 0) {
+                d->bits = 0;
+                continue;
+            }
+
+            mlen = (uint8_t)((b & 0x0FU) + COMPRESS_MIN_MATCH);
+            if (offset > s->filled || offset >= COMPRESS_WINDOW) {
+                /* Host encoder out of step: skip the token, keep the framing */
+                s->errors++;
+            } else {
+                for (k = 0; k < mlen; k++) {
+                    Comp_Emit(d, s->window[(uint16_t)(s->pos - offset) & COMPRESS_WINDOW_MASK],
+                              out, out_max, &n);
+                }
+            }
+        }
+
+        d->flags >>= 1;
+        d->bits--;
+    }
+
+    s->cycles += DWT->CYCCNT - t0;
+    s->raw_bytes += n;
+    s->packed_bytes += len;
+    return n;
+}
+
+void Module_Compress_Report(void)
+{
+    const CompStream_t *list[2 * COMPRESS_MAX_STREAMS];
+    const CompStream_t *s;
+    uint32_t ratio, cpb;
+    uint8_t i;
+
+    for (i = 0; i < COMPRESS_MAX_STREAMS; i++) {
+        list[2U * i] = &decoders[i].s;
+        list[2U * i + 1U] = &encoders[i].s;
+    }
+
+    for (i = 0; i < 2U * COMPRESS_MAX_STREAMS; i++) {
+        s = list[i];
+        if (s->link == COMPRESS_FREE) {
+            continue;
+        }
+
+        /* Ratio = raw / packed in hundredths; cost in cycles per raw byte */
+        ratio = (s->packed_bytes > 0U) ?
+                (uint32_t)(((uint64_t)s->raw_bytes * 100U) / s->packed_bytes) : 0U;
+        cpb = (s->raw_bytes > 0U) ? (uint32_t)(s->cycles / s->raw_bytes) : 0U;
+
+        AT_Response_Send("+COMPS:%d,%s,%lu,%lu,%lu.%02lu,%lu,%lu\r\n", s->link,
+                         (i & 1U) ? "DOWN" : "UP", s->raw_bytes, s->packed_bytes,
+                         ratio / 100U, ratio % 100U, cpb, s->errors);
+    }
+}
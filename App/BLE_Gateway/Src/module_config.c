@@ -6,7 +6,11 @@
   ******************************************************************************
   */
 
+#define DEBUG_MODULE DEBUG_MOD_STORE
+
 #include "module_config.h"
+#include "module_kv.h"
+#include "module_crc.h"
 #include "debug_trace.h"
 #include "main.h"
 #include "stm32wbxx_hal.h"
@@ -15,11 +19,6 @@
 #include <string.h>
 #include <stdio.h>
 
-/* Flash configuration - STM32WB55 Flash layout */
-/* Use last page of Flash for config storage */
-#define FLASH_CONFIG_PAGE_ADDR    0x080FF000  /* Last 4KB page */
-#define FLASH_PAGE_SIZE           4096
-
 /* Runtime configuration */
 static Module_Config_t current_config;
 static uint8_t config_loaded = 0;
@@ -48,41 +47,18 @@ static const Module_Config_t default_config = {
 /* External UART handle */
 extern UART_HandleTypeDef hlpuart1;
 
-/*============================================================================
- * CRC32 Calculation
- *============================================================================*/
-static uint32_t Calculate_CRC32(const uint8_t *data, uint32_t len)
-{
-    uint32_t crc = 0xFFFFFFFF;
-    uint32_t i, j;
-    
-    for (i = 0; i < len; i++) {
-        crc ^= data[i];
-        for (j = 0; j < 8; j++) {
-            if (crc & 1) {
-                crc = (crc >> 1) ^ 0xEDB88320;
-            } else {
-                crc = crc >> 1;
-            }
-        }
-    }
-    
-    return ~crc;
-}
-
 /*============================================================================
  * Initialization
  *============================================================================*/
 void Module_Config_Init(void)
 {
-    // __HAL_FLASH_PREFETCH_BUFFER_ENABLE();
-    /* Try to load from Flash */
-    // if (Module_Config_Load() != 0) {
+    /* Try to load from the KV store (Module_KV_Init runs first) */
+    if (Module_Config_Load() != 0) {
         /* Load failed, use defaults */
         DEBUG_WARN("Config load failed, using defaults");
         memcpy(&current_config, &default_config, sizeof(Module_Config_t));
         config_loaded = 1;
-    // }
+    }
     
     DEBUG_INFO("Config module initialized: %s", current_config.device_name);
 }
@@ -185,75 +161,48 @@ int Module_Config_GetRF(RF_Config_t *rf_config)
  *============================================================================*/
 int Module_Config_Save(void)
 {
-    HAL_StatusTypeDef status;
-    uint32_t page_error;
-    FLASH_EraseInitTypeDef erase_init;
-    uint64_t *src_ptr = (uint64_t*)&current_config;
-    uint32_t flash_addr = FLASH_CONFIG_PAGE_ADDR;
-    uint32_t len = sizeof(Module_Config_t);
-    uint32_t i;
-    
     /* Calculate CRC */
-    current_config.crc = Calculate_CRC32((uint8_t*)&current_config, 
+    current_config.crc = Module_Crc32((uint8_t*)&current_config, 
                                          sizeof(Module_Config_t) - sizeof(uint32_t));
     
-    /* Unlock Flash */
-    HAL_FLASH_Unlock();
-    
-    /* Erase page */
-    erase_init.TypeErase = FLASH_TYPEERASE_PAGES;
-    erase_init.Page = (FLASH_CONFIG_PAGE_ADDR - FLASH_BASE) / FLASH_PAGE_SIZE;
-    erase_init.NbPages = 1;
-    
-    status = HAL_FLASHEx_Erase(&erase_init, &page_error);
-    if (status != HAL_OK) {
-        DEBUG_ERROR("Flash erase failed: %d", status);
-        HAL_FLASH_Lock();
+    /* Appended to the KV log: no page erase unless the log wraps */
+    if (Module_KV_Set(KV_KEY_CONFIG, &current_config, sizeof(Module_Config_t)) != 0) {
+        DEBUG_ERROR("Config save failed");
         return -1;
     }
     
-    /* Write config data (64-bit aligned) */
-    for (i = 0; i < (len + 7) / 8; i++) {
-        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, 
-                                    flash_addr, 
-                                    src_ptr[i]);
-        if (status != HAL_OK) {
-            DEBUG_ERROR("Flash write failed: %d", status);
-            HAL_FLASH_Lock();
-            return -1;
-        }
-        flash_addr += 8;
-    }
-    
-    /* Lock Flash */
-    HAL_FLASH_Lock();
-    
     DEBUG_INFO("Config saved to Flash");
     return 0;
 }
 
 int Module_Config_Load(void)
 {
-    Module_Config_t *flash_config = (Module_Config_t*)FLASH_CONFIG_PAGE_ADDR;
+    Module_Config_t flash_config;
     uint32_t calculated_crc;
     
+    if (Module_KV_Get(KV_KEY_CONFIG, &flash_config, sizeof(Module_Config_t)) !=
+        (int)sizeof(Module_Config_t)) {
+        DEBUG_WARN("No saved config");
+        return -1;
+    }
+    
     /* Check magic number */
-    if (flash_config->magic != CONFIG_FLASH_MAGIC) {
-        DEBUG_WARN("Invalid config magic: 0x%08lX", flash_config->magic);
+    if (flash_config.magic != CONFIG_FLASH_MAGIC) {
+        DEBUG_WARN("Invalid config magic: 0x%08lX", flash_config.magic);
         return -1;
     }
     
     /* Verify CRC */
-    calculated_crc = Calculate_CRC32((uint8_t*)flash_config, 
+    calculated_crc = Module_Crc32((uint8_t*)&flash_config, 
                                      sizeof(Module_Config_t) - sizeof(uint32_t));
-    if (calculated_crc != flash_config->crc) {
+    if (calculated_crc != flash_config.crc) {
         DEBUG_ERROR("Config CRC mismatch: calc=0x%08lX, stored=0x%08lX", 
-                    calculated_crc, flash_config->crc);
+                    calculated_crc, flash_config.crc);
         return -1;
     }
     
     /* Copy to RAM */
-    memcpy(&current_config, flash_config, sizeof(Module_Config_t));
+    memcpy(&current_config, &flash_config, sizeof(Module_Config_t));
     config_loaded = 1;
     
     DEBUG_INFO("Config loaded from Flash");
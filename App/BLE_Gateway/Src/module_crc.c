@@ -0,0 +1,269 @@
+/**
+  ******************************************************************************
+  * @file    module_crc.c
+  * @brief   CRC-32 service implementation
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#define DEBUG_MODULE DEBUG_MOD_STORE
+
+#include "module_crc.h"
+#include "at_command.h"
+#include "debug_trace.h"
+#include "main.h"
+#if CRC_USE_HARDWARE
+#include "stm32wbxx_ll_bus.h"
+#include "stm32wbxx_ll_crc.h"
+#include "stm32wbxx_ll_dma.h"
+#include "stm32wbxx_ll_dmamux.h"
+#endif
+#include <string.h>
+
+/*============================================================================
+ * State
+ *============================================================================*/
+#define CRC_POLY_REFLECTED      0xEDB88320U
+
+#if CRC_USE_HARDWARE
+#define CRC_DMA                 DMA2
+#define CRC_DMA_CHANNEL         LL_DMA_CHANNEL_1
+#endif
+
+/* crc_table[i] = CRC of byte i, reflected polynomial */
+static const uint32_t crc_table[256] = {
+    0x00000000U, 0x77073096U, 0xEE0E612CU, 0x990951BAU, 0x076DC419U, 0x706AF48FU,
+    0xE963A535U, 0x9E6495A3U, 0x0EDB8832U, 0x79DCB8A4U, 0xE0D5E91EU, 0x97D2D988U,
+    0x09B64C2BU, 0x7EB17CBDU, 0xE7B82D07U, 0x90BF1D91U, 0x1DB71064U, 0x6AB020F2U,
+    0xF3B97148U, 0x84BE41DEU, 0x1ADAD47DU, 0x6DDDE4EBU, 0xF4D4B551U, 0x83D385C7U,
+    0x136C9856U, 0x646BA8C0U, 0xFD62F97AU, 0x8A65C9ECU, 0x14015C4FU, 0x63066CD9U,
+    0xFA0F3D63U, 0x8D080DF5U, 0x3B6E20C8U, 0x4C69105EU, 0xD56041E4U, 0xA2677172U,
+    0x3C03E4D1U, 0x4B04D447U, 0xD20D85FDU, 0xA50AB56BU, 0x35B5A8FAU, 0x42B2986CU,
+    0xDBBBC9D6U, 0xACBCF940U, 0x32D86CE3U, 0x45DF5C75U, 0xDCD60DCFU, 0xABD13D59U,
+    0x26D930ACU, 0x51DE003AU, 0xC8D75180U, 0xBFD06116U, 0x21B4F4B5U, 0x56B3C423U,
+    0xCFBA9599U, 0xB8BDA50FU, 0x2802B89EU, 0x5F058808U, 0xC60CD9B2U, 0xB10BE924U,
+    0x2F6F7C87U, 0x58684C11U, 0xC1611DABU, 0xB6662D3DU, 0x76DC4190U, 0x01DB7106U,
+    0x98D220BCU, 0xEFD5102AU, 0x71B18589U, 0x06B6B51FU, 0x9FBFE4A5U, 0xE8B8D433U,
+    0x7807C9A2U, 0x0F00F934U, 0x9609A88EU, 0xE10E9818U, 0x7F6A0DBBU, 0x086D3D2DU,
+    0x91646C97U, 0xE6635C01U, 0x6B6B51F4U, 0x1C6C6162U, 0x856530D8U, 0xF262004EU,
+    0x6C0695EDU, 0x1B01A57BU, 0x8208F4C1U, 0xF50FC457U, 0x65B0D9C6U, 0x12B7E950U,
+    0x8BBEB8EAU, 0xFCB9887CU, 0x62DD1DDFU, 0x15DA2D49U, 0x8CD37CF3U, 0xFBD44C65U,
+    0x4DB26158U, 0x3AB551CEU, 0xA3BC0074U, 0xD4BB30E2U, 0x4ADFA541U, 0x3DD895D7U,
+    0xA4D1C46DU, 0xD3D6F4FBU, 0x4369E96AU, 0x346ED9FCU, 0xAD678846U, 0xDA60B8D0U,
+    0x44042D73U, 0x33031DE5U, 0xAA0A4C5FU, 0xDD0D7CC9U, 0x5005713CU, 0x270241AAU,
+    0xBE0B1010U, 0xC90C2086U, 0x5768B525U, 0x206F85B3U, 0xB966D409U, 0xCE61E49FU,
+    0x5EDEF90EU, 0x29D9C998U, 0xB0D09822U, 0xC7D7A8B4U, 0x59B33D17U, 0x2EB40D81U,
+    0xB7BD5C3BU, 0xC0BA6CADU, 0xEDB88320U, 0x9ABFB3B6U, 0x03B6E20CU, 0x74B1D29AU,
+    0xEAD54739U, 0x9DD277AFU, 0x04DB2615U, 0x73DC1683U, 0xE3630B12U, 0x94643B84U,
+    0x0D6D6A3EU, 0x7A6A5AA8U, 0xE40ECF0BU, 0x9309FF9DU, 0x0A00AE27U, 0x7D079EB1U,
+    0xF00F9344U, 0x8708A3D2U, 0x1E01F268U, 0x6906C2FEU, 0xF762575DU, 0x806567CBU,
+    0x196C3671U, 0x6E6B06E7U, 0xFED41B76U, 0x89D32BE0U, 0x10DA7A5AU, 0x67DD4ACCU,
+    0xF9B9DF6FU, 0x8EBEEFF9U, 0x17B7BE43U, 0x60B08ED5U, 0xD6D6A3E8U, 0xA1D1937EU,
+    0x38D8C2C4U, 0x4FDFF252U, 0xD1BB67F1U, 0xA6BC5767U, 0x3FB506DDU, 0x48B2364BU,
+    0xD80D2BDAU, 0xAF0A1B4CU, 0x36034AF6U, 0x41047A60U, 0xDF60EFC3U, 0xA867DF55U,
+    0x316E8EEFU, 0x4669BE79U, 0xCB61B38CU, 0xBC66831AU, 0x256FD2A0U, 0x5268E236U,
+    0xCC0C7795U, 0xBB0B4703U, 0x220216B9U, 0x5505262FU, 0xC5BA3BBEU, 0xB2BD0B28U,
+    0x2BB45A92U, 0x5CB36A04U, 0xC2D7FFA7U, 0xB5D0CF31U, 0x2CD99E8BU, 0x5BDEAE1DU,
+    0x9B64C2B0U, 0xEC63F226U, 0x756AA39CU, 0x026D930AU, 0x9C0906A9U, 0xEB0E363FU,
+    0x72076785U, 0x05005713U, 0x95BF4A82U, 0xE2B87A14U, 0x7BB12BAEU, 0x0CB61B38U,
+    0x92D28E9BU, 0xE5D5BE0DU, 0x7CDCEFB7U, 0x0BDBDF21U, 0x86D3D2D4U, 0xF1D4E242U,
+    0x68DDB3F8U, 0x1FDA836EU, 0x81BE16CDU, 0xF6B9265BU, 0x6FB077E1U, 0x18B74777U,
+    0x88085AE6U, 0xFF0F6A70U, 0x66063BCAU, 0x11010B5CU, 0x8F659EFFU, 0xF862AE69U,
+    0x616BFFD3U, 0x166CCF45U, 0xA00AE278U, 0xD70DD2EEU, 0x4E048354U, 0x3903B3C2U,
+    0xA7672661U, 0xD06016F7U, 0x4969474DU, 0x3E6E77DBU, 0xAED16A4AU, 0xD9D65ADCU,
+    0x40DF0B66U, 0x37D83BF0U, 0xA9BCAE53U, 0xDEBB9EC5U, 0x47B2CF7FU, 0x30B5FFE9U,
+    0xBDBDF21CU, 0xCABAC28AU, 0x53B39330U, 0x24B4A3A6U, 0xBAD03605U, 0xCDD70693U,
+    0x54DE5729U, 0x23D967BFU, 0xB3667A2EU, 0xC4614AB8U, 0x5D681B02U, 0x2A6F2B94U,
+    0xB40BBE37U, 0xC30C8EA1U, 0x5A05DF1BU, 0x2D02EF8DU
+};
+
+static uint8_t crc_ready = 0;
+
+/*============================================================================
+ * Static Helper Functions
+ *============================================================================*/
+
+/**
+ * @brief Reference implementation: one shift per bit (benchmark only)
+ */
+static uint32_t Crc_Bitwise(uint32_t crc, const uint8_t *p, uint32_t len)
+{
+    uint32_t j;
+
+    while (len--) {
+        crc ^= *p++;
+        for (j = 0; j < 8; j++) {
+            crc = (crc & 1U) ? ((crc >> 1) ^ CRC_POLY_REFLECTED) : (crc >> 1);
+        }
+    }
+    return crc;
+}
+
+static uint32_t Crc_Table(uint32_t crc, const uint8_t *p, uint32_t len)
+{
+    while (len--) {
+        crc = crc_table[(crc ^ *p++) & 0xFFU] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if CRC_USE_HARDWARE
+/**
+ * @brief Feed whole words to CRC->DR by memory-to-memory DMA
+ * @note  Source must be word aligned; the CPU polls, the bus moves the data
+ */
+static void Crc_DmaFeed(const uint32_t *words, uint32_t count)
+{
+    LL_DMA_ConfigAddresses(CRC_DMA, CRC_DMA_CHANNEL, (uint32_t)words,
+                           (uint32_t)&CRC->DR, LL_DMA_DIRECTION_MEMORY_TO_MEMORY);
+    LL_DMA_SetDataLength(CRC_DMA, CRC_DMA_CHANNEL, count);
+    LL_DMA_ClearFlag_GI1(CRC_DMA);
+    LL_DMA_EnableChannel(CRC_DMA, CRC_DMA_CHANNEL);
+
+    while (!LL_DMA_IsActiveFlag_TC1(CRC_DMA) && !LL_DMA_IsActiveFlag_TE1(CRC_DMA));
+
+    LL_DMA_DisableChannel(CRC_DMA, CRC_DMA_CHANNEL);
+    LL_DMA_ClearFlag_GI1(CRC_DMA);
+}
+
+/**
+ * @brief Run the CRC unit over a buffer, continuing from crc
+ * @param dma_min Word-aligned runs of at least this many bytes go by DMA
+ */
+static uint32_t Crc_Hardware(uint32_t crc, const uint8_t *p, uint32_t len, uint32_t dma_min)
+{
+    uint32_t words;
+    uint32_t w;
+
+    /* INIT is in the unit's bit order; the output is read bit-reversed */
+    LL_CRC_SetInitialData(CRC, __RBIT(crc));
+    LL_CRC_ResetCRCCalculationUnit(CRC);
+
+    /* Byte writes, LSB first, up to word alignment */
+    LL_CRC_SetInputDataReverseMode(CRC, LL_CRC_INDATA_REVERSE_BYTE);
+    while (len > 0 && ((uint32_t)p & 3U) != 0) {
+        LL_CRC_FeedData8(CRC, *p++);
+        len--;
+    }
+
+    /* Word writes: little-endian bytes, so reverse the whole word */
+    words = len / 4U;
+    if (words > 0) {
+        LL_CRC_SetInputDataReverseMode(CRC, LL_CRC_INDATA_REVERSE_WORD);
+        if (len >= dma_min) {
+            Crc_DmaFeed((const uint32_t*)p, words);
+        } else {
+            for (w = 0; w < words; w++) {
+                LL_CRC_FeedData32(CRC, ((const uint32_t*)p)[w]);
+            }
+        }
+        p += words * 4U;
+        len -= words * 4U;
+    }
+
+    LL_CRC_SetInputDataReverseMode(CRC, LL_CRC_INDATA_REVERSE_BYTE);
+    while (len > 0) {
+        LL_CRC_FeedData8(CRC, *p++);
+        len--;
+    }
+
+    return LL_CRC_ReadData32(CRC);
+}
+#endif
+
+/**
+ * @brief Report one benchmark run
+ */
+static void Crc_BenchReport(const char *name, uint16_t len, uint32_t cycles, uint32_t crc)
+{
+    uint32_t cpb = (cycles * 100U) / len;
+
+    AT_Response_Send("+CRCB:%s,%d,%lu,%lu.%02lu,%08lX\r\n", name, len, cycles,
+                     cpb / 100U, cpb % 100U, ~crc);
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+void Module_Crc_Init(void)
+{
+#if CRC_USE_HARDWARE
+    LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_CRC | LL_AHB1_GRP1_PERIPH_DMA2 |
+                             LL_AHB1_GRP1_PERIPH_DMAMUX1);
+
+    /* Default polynomial 0x04C11DB7, 32-bit; reflected output */
+    LL_CRC_SetPolynomialCoef(CRC, LL_CRC_DEFAULT_CRC32_POLY);
+    LL_CRC_SetPolynomialSize(CRC, LL_CRC_POLYLENGTH_32B);
+    LL_CRC_SetOutputDataReverseMode(CRC, LL_CRC_OUTDATA_REVERSE_BIT);
+
+    LL_DMA_ConfigTransfer(CRC_DMA, CRC_DMA_CHANNEL,
+                          LL_DMA_DIRECTION_MEMORY_TO_MEMORY | LL_DMA_MODE_NORMAL |
+                          LL_DMA_PERIPH_INCREMENT | LL_DMA_MEMORY_NOINCREMENT |
+                          LL_DMA_PDATAALIGN_WORD | LL_DMA_MDATAALIGN_WORD |
+                          LL_DMA_PRIORITY_LOW);
+    LL_DMA_SetPeriphRequest(CRC_DMA, CRC_DMA_CHANNEL, LL_DMAMUX_REQ_MEM2MEM);
+#endif
+
+    crc_ready = 1;
+}
+
+uint32_t Module_Crc32_Update(uint32_t crc, const void *data, uint32_t len)
+{
+    if (len == 0) {
+        return crc;
+    }
+
+#if CRC_USE_HARDWARE
+    /* Modules may check records before Module_Crc_Init has run */
+    if (crc_ready) {
+        return Crc_Hardware(crc, (const uint8_t*)data, len, CRC_DMA_THRESHOLD);
+    }
+#endif
+    return Crc_Table(crc, (const uint8_t*)data, len);
+}
+
+uint32_t Module_Crc32(const void *data, uint32_t len)
+{
+    return ~Module_Crc32_Update(CRC32_INIT, data, len);
+}
+
+int Module_Crc_Benchmark(uint16_t len)
+{
+    const uint8_t *data = (const uint8_t*)FLASH_BASE;
+    uint32_t t0, cycles, ref, crc;
+    int result = 0;
+
+    if (len == 0 || len > CRC_BENCH_MAX) {
+        return -1;
+    }
+
+    t0 = DWT->CYCCNT;
+    ref = Crc_Bitwise(CRC32_INIT, data, len);
+    cycles = DWT->CYCCNT - t0;
+    Crc_BenchReport("BIT", len, cycles, ref);
+
+    t0 = DWT->CYCCNT;
+    crc = Crc_Table(CRC32_INIT, data, len);
+    cycles = DWT->CYCCNT - t0;
+    Crc_BenchReport("TABLE", len, cycles, crc);
+    result |= (crc != ref) ? -1 : 0;
+
+#if CRC_USE_HARDWARE
+    t0 = DWT->CYCCNT;
+    crc = Crc_Hardware(CRC32_INIT, data, len, 0xFFFFFFFFU);
+    cycles = DWT->CYCCNT - t0;
+    Crc_BenchReport("HW", len, cycles, crc);
+    result |= (crc != ref) ? -1 : 0;
+
+    t0 = DWT->CYCCNT;
+    crc = Crc_Hardware(CRC32_INIT, data, len, 0);
+    cycles = DWT->CYCCNT - t0;
+    Crc_BenchReport("DMA", len, cycles, crc);
+    result |= (crc != ref) ? -1 : 0;
+#endif
+
+    if (result != 0) {
+        DEBUG_ERROR("CRC implementations disagree over %d bytes", len);
+    }
+    return result;
+}
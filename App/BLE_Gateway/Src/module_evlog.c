@@ -0,0 +1,514 @@
+/**
+  ******************************************************************************
+  * @file    module_evlog.c
+  * @brief   Store-and-forward event log implementation
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#define DEBUG_MODULE DEBUG_MOD_STORE
+
+#include "module_evlog.h"
+#include "module_flash.h"
+#include "module_kv.h"
+#include "module_crc.h"
+#include "at_command.h"
+#include "debug_trace.h"
+#include "main.h"
+#include "app_conf.h"
+#include "stm32_seq.h"
+#include <string.h>
+
+/*============================================================================
+ * State
+ *============================================================================*/
+#define EVLOG_PAGE_SIZE         FLASH_PAGE_SIZE
+#define EVLOG_PAGE_ADDR(p)      (EVLOG_FLASH_BASE + (uint32_t)(p) * EVLOG_PAGE_SIZE)
+#define EVLOG_REC_HDR_SIZE      16U
+#define EVLOG_REC_SIZE(len)     (EVLOG_REC_HDR_SIZE + (((uint32_t)(len) + 7U) & ~7U))
+#define EVLOG_CRC_OFFSET        12U     /* CRC covers the header up to crc, then the payload */
+#define EVLOG_HEX_CHUNK         48U     /* Payload bytes per AT response */
+
+#define EVLOG_TYPE_NOTIFICATION 0x01U   /* [conn_handle:2][handle:2][value] */
+#define EVLOG_TYPE_SCAN         0x02U   /* [mac:6][rssi:1][name] */
+#define EVLOG_TYPE_LINE         0x03U   /* [response line without CR LF] */
+
+/* Record: [header][payload padded to 8 bytes], programmed in one writer job */
+typedef struct {
+    uint32_t seq;                   /* From 1, increases across reboots */
+    uint32_t time_ms;               /* HAL_GetTick() when stored */
+    uint16_t boot;                  /* Boot number the time belongs to */
+    uint8_t type;
+    uint8_t len;
+    uint32_t crc;
+} EvLogRec_t;
+
+typedef struct {
+    uint32_t first_seq;             /* 0 = empty */
+    uint16_t used;
+    uint16_t count;
+} EvLogPage_t;
+
+/* Persisted in the key-value store */
+typedef struct {
+    uint8_t mode;
+    uint8_t reserved;
+    uint16_t timeout_s;
+    uint32_t delivered;             /* Last sequence number replayed */
+} EvLogSettings_t;
+
+static EvLogPage_t evlog_pages[EVLOG_PAGE_COUNT];
+static EvLogSettings_t evlog_cfg;
+static uint8_t evlog_head = 0;
+static uint32_t evlog_next_seq = 1;
+static uint16_t evlog_boot = 0;
+static uint32_t evlog_host_tick = 0;
+
+/* Replay cursor */
+static uint8_t rp_active = 0;
+static uint8_t rp_page = 0;
+static uint8_t rp_pages_left = 0;
+static uint16_t rp_off = 0;
+static uint32_t rp_from = 0;
+static uint32_t rp_end = 0;
+static uint32_t rp_last = 0;
+static uint32_t rp_count = 0;
+
+/* Response lines captured while a notification is consumed */
+static uint8_t cap_armed = 0;
+static uint8_t cap_buf[EVLOG_MAX_PAYLOAD];
+static uint8_t cap_len = 0;
+
+/* Statistics */
+static uint32_t evlog_stored = 0;
+static uint32_t evlog_dropped = 0;
+static uint32_t evlog_overwritten = 0;
+
+static uint8_t evlog_rec[EVLOG_REC_SIZE(EVLOG_MAX_PAYLOAD)];
+
+/*============================================================================
+ * Static Helper Functions
+ *============================================================================*/
+
+static uint32_t EvLog_RecordCrc(const EvLogRec_t *hdr, const uint8_t *payload)
+{
+    return ~Module_Crc32_Update(Module_Crc32_Update(CRC32_INIT, hdr, EVLOG_CRC_OFFSET),
+                                payload, hdr->len);
+}
+
+/**
+ * @brief Read and check the record at a page offset
+ * @return 1 if valid (header in hdr, payload in evlog_rec), 0 if blank or corrupt
+ */
+static uint8_t EvLog_ReadRecord(uint8_t page, uint16_t off, EvLogRec_t *hdr)
+{
+    uint32_t addr = EVLOG_PAGE_ADDR(page) + off;
+
+    if (off + EVLOG_REC_HDR_SIZE > EVLOG_PAGE_SIZE) {
+        return 0;
+    }
+
+    Module_Flash_Read(addr, hdr, sizeof(EvLogRec_t));
+    if (hdr->seq == 0xFFFFFFFFU || hdr->seq == 0 || hdr->len > EVLOG_MAX_PAYLOAD ||
+        off + EVLOG_REC_SIZE(hdr->len) > EVLOG_PAGE_SIZE) {
+        return 0;
+    }
+
+    Module_Flash_Read(addr + EVLOG_REC_HDR_SIZE, evlog_rec, hdr->len);
+    return (EvLog_RecordCrc(hdr, evlog_rec) == hdr->crc) ? 1U : 0U;
+}
+
+static void EvLog_SaveSettings(void)
+{
+    Module_KV_Set(KV_KEY_EVLOG, &evlog_cfg, sizeof(evlog_cfg));
+}
+
+/**
+ * @brief Append a record at the head, moving to (and erasing) the next page if needed
+ * @return 1 if queued to Flash, 0 if the writer is full
+ */
+static uint8_t EvLog_Append(uint8_t type, const uint8_t *payload, uint8_t len)
+{
+    EvLogRec_t hdr;
+    EvLogPage_t *pg = &evlog_pages[evlog_head];
+    uint32_t size = EVLOG_REC_SIZE(len);
+    uint8_t next;
+
+    if (pg->used + size > EVLOG_PAGE_SIZE) {
+        next = (uint8_t)((evlog_head + 1U) % EVLOG_PAGE_COUNT);
+        if (Module_Flash_Erase(EVLOG_PAGE_ADDR(next), NULL) != 0) {
+            evlog_dropped++;
+            return 0;
+        }
+        /* The ring is full: the oldest page goes */
+        evlog_overwritten += evlog_pages[next].count;
+        memset(&evlog_pages[next], 0, sizeof(EvLogPage_t));
+        evlog_head = next;
+        pg = &evlog_pages[next];
+    }
+
+    hdr.seq = evlog_next_seq;
+    hdr.time_ms = HAL_GetTick();
+    hdr.boot = evlog_boot;
+    hdr.type = type;
+    hdr.len = len;
+    hdr.crc = EvLog_RecordCrc(&hdr, payload);
+
+    memcpy(evlog_rec, &hdr, EVLOG_REC_HDR_SIZE);
+    memcpy(&evlog_rec[EVLOG_REC_HDR_SIZE], payload, len);
+
+    if (Module_Flash_Program(EVLOG_PAGE_ADDR(evlog_head) + pg->used, evlog_rec,
+                             (uint16_t)(EVLOG_REC_HDR_SIZE + len), NULL) != 0) {
+        evlog_dropped++;
+        return 0;
+    }
+
+    if (pg->first_seq == 0) {
+        pg->first_seq = hdr.seq;
+    }
+    pg->used = (uint16_t)(pg->used + size);
+    pg->count++;
+    evlog_next_seq++;
+    evlog_stored++;
+    return 1;
+}
+
+static uint32_t EvLog_OldestSeq(void)
+{
+    uint32_t oldest = 0;
+    uint8_t p;
+
+    for (p = 0; p < EVLOG_PAGE_COUNT; p++) {
+        if (evlog_pages[p].first_seq != 0 &&
+            (oldest == 0 || evlog_pages[p].first_seq < oldest)) {
+            oldest = evlog_pages[p].first_seq;
+        }
+    }
+    return oldest;
+}
+
+/**
+ * @brief Print one stored event as its live response line, prefixed with +EVT
+ */
+static void EvLog_Emit(const EvLogRec_t *hdr, const uint8_t *payload)
+{
+    char hex[EVLOG_HEX_CHUNK * 2U + 1U];
+    uint16_t i, n, start = 0;
+    uint16_t conn_handle, handle;
+
+    AT_Response_Send("+EVT:%lu,%d,%lu,", hdr->seq, hdr->boot, hdr->time_ms);
+
+    if (hdr->type == EVLOG_TYPE_NOTIFICATION && hdr->len >= 4U) {
+        memcpy(&conn_handle, &payload[0], 2);
+        memcpy(&handle, &payload[2], 2);
+        AT_Response_Send("+NOTIFICATION:0x%04X,0x%04X,", conn_handle, handle);
+        start = 4;
+    } else if (hdr->type == EVLOG_TYPE_SCAN && hdr->len >= 7U) {
+        AT_Response_Send("+SCAN:%02X:%02X:%02X:%02X:%02X:%02X,%d,%.*s\r\n",
+                         payload[5], payload[4], payload[3], payload[2], payload[1], payload[0],
+                         (int)(int8_t)payload[6],
+                         (hdr->len > 7U) ? (int)(hdr->len - 7U) : 7,
+                         (hdr->len > 7U) ? (const char*)&payload[7] : "Unknown");
+        return;
+    } else if (hdr->type == EVLOG_TYPE_LINE) {
+        AT_Response_Send("%.*s\r\n", (int)hdr->len, (const char*)payload);
+        return;
+    } else {
+        AT_Response_Send("+UNKNOWN:%d,", hdr->type);
+    }
+
+    /* Hex value in chunks that fit one AT response */
+    while (start < hdr->len) {
+        n = (uint16_t)(hdr->len - start);
+        if (n > EVLOG_HEX_CHUNK) {
+            n = EVLOG_HEX_CHUNK;
+        }
+        for (i = 0; i < n; i++) {
+            hex[i * 2U] = "0123456789ABCDEF"[payload[start + i] >> 4];
+            hex[i * 2U + 1U] = "0123456789ABCDEF"[payload[start + i] & 0x0FU];
+        }
+        hex[n * 2U] = '\0';
+        AT_Response_Send("%s", hex);
+        start = (uint16_t)(start + n);
+    }
+    AT_Response_Send("\r\n");
+}
+
+static void EvLog_ReplayDone(void)
+{
+    rp_active = 0;
+    AT_Response_Send("+REPLAYEND:%lu,%lu\r\n", rp_count, rp_last);
+
+    if (rp_last > evlog_cfg.delivered) {
+        evlog_cfg.delivered = rp_last;
+        EvLog_SaveSettings();
+    }
+}
+
+/**
+ * @brief Replay task: a burst of records per run, so BLE events interleave
+ */
+static void EvLog_ReplayTask(void)
+{
+    EvLogRec_t hdr;
+    uint8_t burst = 0;
+
+    if (!rp_active) {
+        return;
+    }
+
+    if (rp_from > rp_end) {
+        EvLog_ReplayDone();
+        return;
+    }
+
+    while (burst < EVLOG_REPLAY_BURST) {
+        if (rp_off >= evlog_pages[rp_page].used || !EvLog_ReadRecord(rp_page, rp_off, &hdr)) {
+            /* End of page: continue with the next newer one */
+            if (rp_pages_left == 0) {
+                EvLog_ReplayDone();
+                return;
+            }
+            rp_pages_left--;
+            rp_page = (uint8_t)((rp_page + 1U) % EVLOG_PAGE_COUNT);
+            rp_off = 0;
+            continue;
+        }
+
+        rp_off = (uint16_t)(rp_off + EVLOG_REC_SIZE(hdr.len));
+
+        /* A page overwritten during the replay holds newer records: stop there */
+        if (hdr.seq > rp_end || (rp_last != 0 && hdr.seq <= rp_last)) {
+            EvLog_ReplayDone();
+            return;
+        }
+        if (hdr.seq < rp_from) {
+            continue;
+        }
+
+        EvLog_Emit(&hdr, evlog_rec);
+        rp_last = hdr.seq;
+        rp_count++;
+        burst++;
+    }
+
+    UTIL_SEQ_SetTask(1U << CFG_TASK_EVLOG_ID, CFG_SCH_PRIO_BG);
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+void Module_EvLog_Init(void)
+{
+    EvLogRec_t hdr;
+    uint8_t p;
+    uint16_t off;
+    uint32_t probe;
+    uint32_t last_seq = 0;
+    uint16_t last_boot = 0;
+    uint8_t found = 0;
+
+    if (Module_KV_Get(KV_KEY_EVLOG, &evlog_cfg, sizeof(evlog_cfg)) != (int)sizeof(evlog_cfg) ||
+        evlog_cfg.mode > EVLOG_HOLD) {
+        evlog_cfg.mode = EVLOG_OFF;
+        evlog_cfg.reserved = 0;
+        evlog_cfg.timeout_s = EVLOG_DEFAULT_TIMEOUT_S;
+        evlog_cfg.delivered = 0;
+    }
+
+    /* Each page holds records back to back until the first blank or torn one */
+    for (p = 0; p < EVLOG_PAGE_COUNT; p++) {
+        memset(&evlog_pages[p], 0, sizeof(EvLogPage_t));
+        off = 0;
+        while (EvLog_ReadRecord(p, off, &hdr)) {
+            if (evlog_pages[p].first_seq == 0) {
+                evlog_pages[p].first_seq = hdr.seq;
+            }
+            evlog_pages[p].count++;
+            if (hdr.seq >= last_seq) {
+                last_seq = hdr.seq;
+                last_boot = hdr.boot;
+                evlog_head = p;
+                found = 1;
+            }
+            off = (uint16_t)(off + EVLOG_REC_SIZE(hdr.len));
+        }
+        /* Empty pages are erased when the head reaches them; a torn tail is never appended to */
+        evlog_pages[p].used = (evlog_pages[p].count == 0) ? EVLOG_PAGE_SIZE : off;
+        if (off < EVLOG_PAGE_SIZE && evlog_pages[p].count > 0) {
+            Module_Flash_Read(EVLOG_PAGE_ADDR(p) + off, &probe, sizeof(probe));
+            if (probe != 0xFFFFFFFFU) {
+                evlog_pages[p].used = EVLOG_PAGE_SIZE;
+            }
+        }
+    }
+
+    if (found) {
+        evlog_next_seq = last_seq + 1U;
+        evlog_boot = (uint16_t)(last_boot + 1U);
+    } else {
+        /* Empty ring: the first record erases page 0 and starts there */
+        evlog_head = EVLOG_PAGE_COUNT - 1U;
+        evlog_next_seq = (evlog_cfg.delivered != 0) ? evlog_cfg.delivered + 1U : 1U;
+        evlog_boot = 0;
+    }
+
+    evlog_host_tick = HAL_GetTick();
+    rp_active = 0;
+
+    UTIL_SEQ_RegTask(1U << CFG_TASK_EVLOG_ID, UTIL_SEQ_RFU, EvLog_ReplayTask);
+
+    DEBUG_INFO("Event log: mode %d, seq %lu, boot %d", evlog_cfg.mode, evlog_next_seq, evlog_boot);
+}
+
+int Module_EvLog_Config(EvLog_Mode_t mode, uint16_t timeout_s)
+{
+    if (mode > EVLOG_HOLD || timeout_s == 0 || timeout_s > 3600U) {
+        return -1;
+    }
+
+    evlog_cfg.mode = (uint8_t)mode;
+    evlog_cfg.timeout_s = timeout_s;
+    EvLog_SaveSettings();
+
+    evlog_host_tick = HAL_GetTick();
+    return 0;
+}
+
+void Module_EvLog_OnHostActivity(void)
+{
+    evlog_host_tick = HAL_GetTick();
+}
+
+uint8_t Module_EvLog_IsStoring(void)
+{
+    switch (evlog_cfg.mode) {
+        case EVLOG_HOLD:
+            return 1;
+        case EVLOG_AUTO:
+            return ((HAL_GetTick() - evlog_host_tick) >= (uint32_t)evlog_cfg.timeout_s * 1000U) ?
+                   1U : 0U;
+        default:
+            return 0;
+    }
+}
+
+uint8_t Module_EvLog_Notification(uint16_t conn_handle, uint16_t handle,
+                                  const uint8_t *data, uint16_t len)
+{
+    uint8_t payload[EVLOG_MAX_PAYLOAD];
+
+    if (!Module_EvLog_IsStoring()) {
+        return 0;
+    }
+
+    if (len > EVLOG_MAX_PAYLOAD - 4U) {
+        len = EVLOG_MAX_PAYLOAD - 4U;
+    }
+    memcpy(&payload[0], &conn_handle, 2);
+    memcpy(&payload[2], &handle, 2);
+    memcpy(&payload[4], data, len);
+
+    return EvLog_Append(EVLOG_TYPE_NOTIFICATION, payload, (uint8_t)(len + 4U));
+}
+
+void Module_EvLog_BeginCapture(void)
+{
+    cap_len = 0;
+    cap_armed = Module_EvLog_IsStoring();
+}
+
+void Module_EvLog_EndCapture(void)
+{
+    /* A line the consumer left unterminated is still an event */
+    if (cap_armed && cap_len > 0) {
+        (void)EvLog_Append(EVLOG_TYPE_LINE, cap_buf, cap_len);
+    }
+    cap_armed = 0;
+    cap_len = 0;
+}
+
+uint8_t Module_EvLog_Capture(const char *text, uint16_t len)
+{
+    uint16_t i;
+
+    if (!cap_armed) {
+        return 0;
+    }
+
+    /* One record per line; a line longer than a record is truncated */
+    for (i = 0; i < len; i++) {
+        if (text[i] == '\n') {
+            if (cap_len > 0) {
+                (void)EvLog_Append(EVLOG_TYPE_LINE, cap_buf, cap_len);
+            }
+            cap_len = 0;
+        } else if (text[i] != '\r' && cap_len < EVLOG_MAX_PAYLOAD) {
+            cap_buf[cap_len++] = (uint8_t)text[i];
+        }
+    }
+    return 1;
+}
+
+uint8_t Module_EvLog_Scan(const uint8_t *mac, int8_t rssi, const char *name)
+{
+    uint8_t payload[7U + 31U];
+    uint8_t name_len = 0;
+
+    if (!Module_EvLog_IsStoring()) {
+        return 0;
+    }
+
+    memcpy(payload, mac, 6);
+    payload[6] = (uint8_t)rssi;
+    if (name != NULL) {
+        while (name_len < 31U && name[name_len] != '\0') {
+            payload[7U + name_len] = (uint8_t)name[name_len];
+            name_len++;
+        }
+    }
+
+    return EvLog_Append(EVLOG_TYPE_SCAN, payload, (uint8_t)(7U + name_len));
+}
+
+int Module_EvLog_Replay(uint32_t from_seq)
+{
+    uint32_t oldest = EvLog_OldestSeq();
+
+    if (rp_active) {
+        return -1;
+    }
+
+    rp_from = (from_seq != 0) ? from_seq : evlog_cfg.delivered + 1U;
+    rp_end = (oldest != 0) ? evlog_next_seq - 1U : 0U;
+    rp_last = 0;
+    rp_count = 0;
+    if (rp_from < oldest) {
+        rp_from = oldest;
+    }
+
+    /* Walk the ring from the page after the head (oldest) back to the head */
+    rp_page = (uint8_t)((evlog_head + 1U) % EVLOG_PAGE_COUNT);
+    rp_pages_left = EVLOG_PAGE_COUNT - 1U;
+    rp_off = 0;
+    rp_active = 1;
+    UTIL_SEQ_SetTask(1U << CFG_TASK_EVLOG_ID, CFG_SCH_PRIO_BG);
+
+    return (rp_from > rp_end) ? 0 : (int)(rp_end - rp_from + 1U);
+}
+
+void Module_EvLog_Report(void)
+{
+    uint32_t events = 0;
+    uint8_t p;
+
+    for (p = 0; p < EVLOG_PAGE_COUNT; p++) {
+        events += evlog_pages[p].count;
+    }
+
+    AT_Response_Send("+EVLOG:%d,%d,%d,%lu,%lu,%lu,%lu\r\n", evlog_cfg.mode, evlog_cfg.timeout_s,
+                     Module_EvLog_IsStoring(), events, EvLog_OldestSeq(), evlog_next_seq - 1U,
+                     evlog_cfg.delivered);
+    AT_Response_Send("+EVLOGS:%lu,%lu,%lu,%d\r\n", evlog_stored, evlog_dropped,
+                     evlog_overwritten, evlog_boot);
+}
@@ -6,15 +6,34 @@
   ******************************************************************************
   */
 
+#define DEBUG_MODULE DEBUG_MOD_SYS
+
 #include "module_execute.h"
 #include "at_command.h"
 #include "ble_device_manager.h"
 #include "ble_connection.h"
 #include "ble_gatt_client.h"
 #include "ble_event_handler.h"
+#include "ble_gatt_flow.h"
+#include "ble_profile_decoder.h"
+#include "ble_gatt_queue.h"
+#include "ble_group.h"
+#include "ble_poll.h"
+#include "ble_rules.h"
+#include "ble_aggregate.h"
+#include "ble_anomaly.h"
+#include "ble_l2cap.h"
+#include "ble_tput.h"
+#include "ble_hci_queue.h"
+#include "ble_hci_monitor.h"
 #include "module_system.h"
 #include "module_config.h"
+#include "module_crc.h"
+#include "module_flash.h"
+#include "module_kv.h"
+#include "module_evlog.h"
 #include "module_power.h"
+#include "module_prof.h"
 #include "module_mode.h"
 #include "debug_trace.h"
 #include "app_conf.h"
@@ -26,6 +45,36 @@ static void Module_AT_Task(void);
  * GATT Event Callbacks - Forward to AT Response
  *============================================================================*/
 
+/**
+ * @brief Pass a notification to the consumers that turn it into records
+ * @return 1 if consumed, 0 if it should be printed as is
+ */
+static uint8_t Module_ConsumeNotification(uint16_t conn_handle, uint16_t handle,
+                                          const uint8_t *data, uint16_t len)
+{
+    /* Aggregated streams emit window summaries only */
+    if (BLE_Agg_Process(conn_handle, handle, data, len)) {
+        return 1;
+    }
+    
+    /* Scored streams forward anomalous windows only */
+    if (BLE_Anomaly_Process(conn_handle, handle, data, len)) {
+        return 1;
+    }
+    
+    /* Edge filtering: nothing is formatted for values a rule drops */
+    if (!BLE_Rules_Evaluate(conn_handle, handle, data, len)) {
+        return 1;
+    }
+    
+    /* Typed record if a profile decoder is bound to this value */
+    if (BLE_Decoder_Process(conn_handle, handle, data, len) == 0) {
+        return 1;
+    }
+    
+    return 0;
+}
+
 /**
  * @brief Callback for GATT notification received
  */
@@ -33,6 +82,30 @@ static void Module_OnNotification(uint16_t conn_handle, uint16_t handle,
                                   const uint8_t *data, uint16_t len)
 {
     uint16_t i;
+    uint8_t consumed;
+    
+    /* A running benchmark sinks its link: counted, never formatted */
+    if (BLE_Tput_OnNotification(conn_handle, data, len)) {
+        return;
+    }
+    
+    /* Data mode RX characteristic goes to UART as raw bytes */
+    if (Module_Mode_ProcessGATTData(conn_handle, handle, data, len)) {
+        return;
+    }
+    
+    /* Host away: the records the consumers print are kept for AT+REPLAY */
+    Module_EvLog_BeginCapture();
+    consumed = Module_ConsumeNotification(conn_handle, handle, data, len);
+    Module_EvLog_EndCapture();
+    if (consumed) {
+        return;
+    }
+    
+    /* Host away: keep it for AT+REPLAY */
+    if (Module_EvLog_Notification(conn_handle, handle, data, len)) {
+        return;
+    }
     
     /* Send notification data as hex string via AT response */
     AT_Response_Send("+NOTIFICATION:0x%04X,0x%04X,", conn_handle, handle);
@@ -51,6 +124,16 @@ static void Module_OnReadResponse(uint16_t conn_handle, uint16_t handle,
 {
     uint16_t i;
     
+    /* Poll results go through change detection instead */
+    if (BLE_Poll_OnReadResponse(conn_handle, handle, data, len)) {
+        return;
+    }
+    
+    /* Typed record if a profile decoder is bound to this value */
+    if (BLE_Decoder_Process(conn_handle, handle, data, len) == 0) {
+        return;
+    }
+    
     /* Send read data as hex string via AT response */
     AT_Response_Send("+READ:0x%04X,0x%04X,", conn_handle, handle);
     
@@ -78,20 +161,39 @@ static void Module_OnWriteResponse(uint16_t conn_handle, uint8_t status)
 
 void module_ble_init(void)
 {
+    Module_Prof_Init();
+    DEBUG_Init();
+    
     DEBUG_INFO("=== BLE Gateway Initialization ===");
     
     /* Initialize system modules first */
     Module_System_Init();
+    Module_Crc_Init();
+    Module_Flash_Init();
+    Module_KV_Init();
     Module_Config_Init();
+    Module_EvLog_Init();
     Module_Power_Init();
     Module_Mode_Init();
     
     /* Initialize BLE modules */
     BLE_DeviceManager_Init();
     AT_Command_Init();
+    BLE_HciQueue_Init();
+    BLE_HciMon_Init();
     BLE_Connection_Init();
     BLE_GATT_Init();
     BLE_EventHandler_Init();
+    BLE_Flow_Init();
+    BLE_Decoder_Init();
+    BLE_GattQueue_Init();
+    BLE_Group_Init();
+    BLE_Poll_Init();
+    BLE_Rules_Init();
+    BLE_Agg_Init();
+    BLE_Anomaly_Init();
+    BLE_L2cap_Init();
+    BLE_Tput_Init();
 
     /* Apply saved configuration */
     // Module_Config_ApplyRF();
@@ -0,0 +1,402 @@
+/**
+  ******************************************************************************
+  * @file    module_flash.c
+  * @brief   Background Flash writer implementation
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#define DEBUG_MODULE DEBUG_MOD_STORE
+
+#include "module_flash.h"
+#include "at_command.h"
+#include "debug_trace.h"
+#include "main.h"
+#include "app_common.h"
+#include "hw_if.h"
+#include "shci.h"
+#include "stm32_seq.h"
+#include "stm32wbxx_ll_hsem.h"
+#include <string.h>
+
+/*============================================================================
+ * State
+ *============================================================================*/
+#define FLASH_JOB_ERASE         0U
+#define FLASH_JOB_PROGRAM       1U
+#define FLASH_MS_TO_TS(ms)      (((uint32_t)(ms) * 1000U) / CFG_TS_TICK_VAL)
+
+typedef struct {
+    uint32_t addr;
+    uint16_t len;                   /* Program: bytes, multiple of 8 */
+    uint16_t done;                  /* Program: bytes written */
+    uint16_t data;                  /* Program: offset in pool */
+    uint16_t alloc;                 /* Pool bytes held, including wrap padding */
+    uint8_t type;
+    uint8_t erase_on;               /* EraseActivity ON sent to CPU2 */
+    uint8_t erased;                 /* Erase: page erased, OFF still due */
+    int status;
+    Module_Flash_Cb_t cb;
+} FlashJob_t;
+
+static FlashJob_t jobs[FLASH_WRITER_MAX_JOBS];
+static uint8_t job_head = 0;        /* Next free slot */
+static uint8_t job_tail = 0;        /* Running job */
+static uint8_t job_count = 0;
+
+static uint8_t pool[FLASH_WRITER_POOL_SIZE];
+static uint16_t pool_head = 0;
+static uint16_t pool_used = 0;
+
+static uint8_t flash_cpu2_ready = 0;
+static uint8_t flash_in_step = 0;
+static uint8_t flash_in_cmd = 0;    /* Waiting for a CPU2 EraseActivity response */
+static Module_Flash_DoneCb_t flash_flush_done = 0;  /* Flush deferred past that wait */
+static uint8_t flash_timer_id;
+
+/* Statistics */
+static uint32_t flash_stat_words = 0;
+static uint32_t flash_stat_pages = 0;
+static uint32_t flash_stat_radio_waits = 0;
+static uint32_t flash_stat_flushes = 0;
+static uint32_t flash_stat_errors = 0;
+static uint8_t flash_stat_max_jobs = 0;
+
+/*============================================================================
+ * Static Helper Functions
+ *============================================================================*/
+
+static void Flash_Task(void);
+
+static void Flash_TimerCallback(void)
+{
+    /* Timer server ISR context: defer to task */
+    UTIL_SEQ_SetTask(1U << CFG_TASK_FLASH_ID, CFG_SCH_PRIO_BG);
+}
+
+/**
+ * @brief Take the Flash for one slice
+ * @return 1 if taken, 0 if CPU2 is in a radio event
+ */
+static uint8_t Flash_Acquire(void)
+{
+    /* 1StepLock returns 0 when the lock is obtained */
+    if (LL_HSEM_1StepLock(HSEM, CFG_HW_BLOCK_FLASH_REQ_BY_CPU2_SEMID)) {
+        return 0;
+    }
+    while (LL_HSEM_1StepLock(HSEM, CFG_HW_FLASH_SEMID));
+    HAL_FLASH_Unlock();
+    return 1;
+}
+
+/**
+ * @brief Release the Flash; CPU2 may take semaphore 7 before the next slice
+ */
+static void Flash_Release(void)
+{
+    uint32_t i;
+
+    HAL_FLASH_Lock();
+    LL_HSEM_ReleaseLock(HSEM, CFG_HW_FLASH_SEMID, 0);
+    LL_HSEM_ReleaseLock(HSEM, CFG_HW_BLOCK_FLASH_REQ_BY_CPU2_SEMID, 0);
+
+    /* Leave CPU2 at least 1us to take semaphore 7 before it is taken again */
+    for (i = 0; i < (SystemCoreClock / 1000000U); i++) {
+        __NOP();
+    }
+}
+
+static void Flash_Complete(FlashJob_t *j)
+{
+    Module_Flash_Cb_t cb = j->cb;
+    uint32_t addr = j->addr;
+    int status = j->status;
+
+    pool_used = (uint16_t)(pool_used - j->alloc);
+    if (pool_used == 0) {
+        pool_head = 0;
+    }
+    job_tail = (uint8_t)((job_tail + 1U) % FLASH_WRITER_MAX_JOBS);
+    job_count--;
+
+    if (status != 0) {
+        flash_stat_errors++;
+    }
+    /* shci.h redefines NULL as 0U: test the callback directly */
+    if (cb) {
+        cb(addr, status);
+    }
+}
+
+/**
+ * @brief Open or close the CPU2 erase window
+ * @note  Blocks in shci_cmd_resp_wait(), where the sequencer runs other tasks:
+ *        no slice starts meanwhile and a nested flush is deferred
+ */
+static void Flash_EraseActivity(SHCI_EraseActivity_t activity)
+{
+    flash_in_cmd = 1;
+    SHCI_C2_FLASH_EraseActivity(activity);
+    flash_in_cmd = 0;
+}
+
+/**
+ * @brief Run one slice of the oldest job
+ * @return 1 if progress was made, 0 if blocked by CPU2 (or nothing to do)
+ */
+static uint8_t Flash_Step(void)
+{
+    FlashJob_t *j;
+    FLASH_EraseInitTypeDef erase_init;
+    uint32_t page_error;
+    uint64_t dw;
+
+    if (job_count == 0 || flash_in_step || flash_in_cmd) {
+        return 0;
+    }
+    j = &jobs[job_tail];
+
+    /* CPU2 guards its radio timing until the erase window is closed. The
+       SHCI commands are slices of their own, outside the slice guard */
+    if (j->type == FLASH_JOB_ERASE) {
+        if (j->erased) {
+            if (j->erase_on) {
+                Flash_EraseActivity(ERASE_ACTIVITY_OFF);
+            }
+            Flash_Complete(j);
+            return 1;
+        }
+        if (!j->erase_on && flash_cpu2_ready) {
+            j->erase_on = 1;
+            Flash_EraseActivity(ERASE_ACTIVITY_ON);
+            return 1;
+        }
+    }
+
+    flash_in_step = 1;
+    if (!Flash_Acquire()) {
+        flash_stat_radio_waits++;
+        flash_in_step = 0;
+        return 0;
+    }
+
+    if (j->type == FLASH_JOB_ERASE) {
+        erase_init.TypeErase = FLASH_TYPEERASE_PAGES;
+        erase_init.Page = (j->addr - FLASH_BASE) / FLASH_PAGE_SIZE;
+        erase_init.NbPages = 1;
+        if (HAL_FLASHEx_Erase(&erase_init, &page_error) != HAL_OK) {
+            j->status = -1;
+        }
+        Flash_Release();
+        flash_stat_pages++;
+        j->erased = 1;
+    } else {
+        memcpy(&dw, &pool[j->data + j->done], sizeof(dw));
+        if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, j->addr + j->done, dw) != HAL_OK) {
+            j->status = -1;
+        }
+        Flash_Release();
+        flash_stat_words++;
+
+        j->done = (uint16_t)(j->done + 8U);
+        if (j->done >= j->len) {
+            Flash_Complete(j);
+        }
+    }
+
+    flash_in_step = 0;
+    return 1;
+}
+
+/**
+ * @brief Fill the next free job slot (caller checks job_count)
+ */
+static FlashJob_t* Flash_NewJob(uint8_t type, uint32_t addr, Module_Flash_Cb_t cb)
+{
+    FlashJob_t *j = &jobs[job_head];
+
+    memset(j, 0, sizeof(FlashJob_t));
+    j->type = type;
+    j->addr = addr;
+    j->cb = cb;
+    return j;
+}
+
+static void Flash_Commit(void)
+{
+    job_head = (uint8_t)((job_head + 1U) % FLASH_WRITER_MAX_JOBS);
+    job_count++;
+    if (job_count > flash_stat_max_jobs) {
+        flash_stat_max_jobs = job_count;
+    }
+    UTIL_SEQ_SetTask(1U << CFG_TASK_FLASH_ID, CFG_SCH_PRIO_BG);
+}
+
+/**
+ * @brief Sequencer task: one slice per run, so radio and BLE events interleave
+ */
+static void Flash_Task(void)
+{
+    Module_Flash_DoneCb_t done = flash_flush_done;
+
+    /* A flush requested during our CPU2 command runs now */
+    if (done != 0) {
+        flash_flush_done = 0;
+        Module_Flash_FlushThen(done);
+        return;
+    }
+
+    if (Flash_Step()) {
+        if (job_count > 0 || flash_flush_done != 0) {
+            UTIL_SEQ_SetTask(1U << CFG_TASK_FLASH_ID, CFG_SCH_PRIO_BG);
+        }
+    } else if (job_count > 0 && !flash_in_step && !flash_in_cmd) {
+        HW_TS_Stop(flash_timer_id);
+        HW_TS_Start(flash_timer_id, FLASH_MS_TO_TS(FLASH_WRITER_RETRY_MS));
+    }
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+void Module_Flash_Init(void)
+{
+    job_head = 0;
+    job_tail = 0;
+    job_count = 0;
+    pool_head = 0;
+    pool_used = 0;
+    flash_in_step = 0;
+    flash_in_cmd = 0;
+    flash_flush_done = 0;
+
+    UTIL_SEQ_RegTask(1U << CFG_TASK_FLASH_ID, UTIL_SEQ_RFU, Flash_Task);
+    HW_TS_Create(CFG_TIM_PROC_ID_ISR, &flash_timer_id, hw_ts_SingleShot, Flash_TimerCallback);
+}
+
+void Module_Flash_OnCpu2Ready(void)
+{
+    /* CPU2 takes semaphore 7 around radio events instead of setting PES */
+    SHCI_C2_SetFlashActivityControl(FLASH_ACTIVITY_CONTROL_SEM7);
+    flash_cpu2_ready = 1;
+}
+
+int Module_Flash_Erase(uint32_t addr, Module_Flash_Cb_t cb)
+{
+    if ((addr & (FLASH_PAGE_SIZE - 1U)) != 0 || job_count >= FLASH_WRITER_MAX_JOBS) {
+        return -1;
+    }
+
+    Flash_NewJob(FLASH_JOB_ERASE, addr, cb);
+    Flash_Commit();
+    return 0;
+}
+
+int Module_Flash_Program(uint32_t addr, const void *data, uint16_t len, Module_Flash_Cb_t cb)
+{
+    FlashJob_t *j;
+    uint16_t size = (uint16_t)((len + 7U) & ~7U);
+    uint16_t pad = 0;
+
+    if ((addr & 7U) != 0 || len == 0 || size > FLASH_WRITER_POOL_SIZE ||
+        job_count >= FLASH_WRITER_MAX_JOBS) {
+        return -1;
+    }
+
+    /* Data is contiguous: skip the pool tail if it would wrap */
+    if (pool_head + size > FLASH_WRITER_POOL_SIZE) {
+        pad = (uint16_t)(FLASH_WRITER_POOL_SIZE - pool_head);
+    }
+    if ((uint32_t)pool_used + pad + size > FLASH_WRITER_POOL_SIZE) {
+        return -1;
+    }
+
+    j = Flash_NewJob(FLASH_JOB_PROGRAM, addr, cb);
+    if (pad > 0) {
+        pool_head = 0;
+    }
+    j->data = pool_head;
+    j->len = size;
+    j->alloc = (uint16_t)(pad + size);
+    memcpy(&pool[pool_head], data, len);
+    memset(&pool[pool_head + len], 0xFF, size - len);
+
+    pool_head = (uint16_t)((pool_head + size) % FLASH_WRITER_POOL_SIZE);
+    pool_used = (uint16_t)(pool_used + j->alloc);
+
+    Flash_Commit();
+    return 0;
+}
+
+void Module_Flash_Read(uint32_t addr, void *buffer, uint16_t len)
+{
+    uint8_t *dst = (uint8_t*)buffer;
+    const FlashJob_t *j;
+    uint32_t start, end, from, to;
+    uint8_t i, idx;
+
+    memcpy(dst, (const void*)addr, len);
+
+    /* Apply queued jobs oldest first */
+    for (i = 0, idx = job_tail; i < job_count;
+         i++, idx = (uint8_t)((idx + 1U) % FLASH_WRITER_MAX_JOBS)) {
+        j = &jobs[idx];
+        start = j->addr;
+        end = start + ((j->type == FLASH_JOB_ERASE) ? FLASH_PAGE_SIZE : j->len);
+        from = (start > addr) ? start : addr;
+        to = (end < addr + len) ? end : (addr + len);
+        if (from >= to) {
+            continue;
+        }
+
+        if (j->type == FLASH_JOB_ERASE) {
+            memset(&dst[from - addr], 0xFF, to - from);
+        } else {
+            memcpy(&dst[from - addr], &pool[j->data + (from - start)], to - from);
+        }
+    }
+}
+
+int Module_Flash_Flush(void)
+{
+    /* Called from a task run while the writer waits for CPU2: the wait
+       cannot end until we return, so spinning here would never finish */
+    if (flash_in_step || flash_in_cmd) {
+        return -1;
+    }
+    if (job_count == 0) {
+        return 0;
+    }
+
+    flash_stat_flushes++;
+    while (job_count > 0) {
+        /* Blocked slices are retried as soon as CPU2 releases semaphore 7 */
+        Flash_Step();
+    }
+    return 0;
+}
+
+void Module_Flash_FlushThen(Module_Flash_DoneCb_t done)
+{
+    if (Module_Flash_Flush() != 0) {
+        /* Flash_Task picks it up once the CPU2 command has returned */
+        flash_flush_done = done;
+        UTIL_SEQ_SetTask(1U << CFG_TASK_FLASH_ID, CFG_SCH_PRIO_BG);
+        return;
+    }
+    if (done != 0) {
+        done();
+    }
+}
+
+uint8_t Module_Flash_IsIdle(void)
+{
+    return (job_count == 0) ? 1U : 0U;
+}
+
+void Module_Flash_Report(void)
+{
+    AT_Response_Send("+FLASHQ:%d,%d,%d,%lu,%lu,%lu,%lu,%lu\r\n", job_count, pool_used,
+                     flash_stat_max_jobs, flash_stat_words, flash_stat_pages,
+                     flash_stat_radio_waits, flash_stat_flushes, flash_stat_errors);
+}
@@ -0,0 +1,595 @@
+/**
+  ******************************************************************************
+  * @file    module_kv.c
+  * @brief   Log-structured key-value store implementation
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#define DEBUG_MODULE DEBUG_MOD_STORE
+
+#include "module_kv.h"
+#include "module_flash.h"
+#include "module_crc.h"
+#include "at_command.h"
+#include "debug_trace.h"
+#include "main.h"
+#include "stm32wbxx_hal.h"
+#include <string.h>
+
+/*============================================================================
+ * State
+ *============================================================================*/
+#define KV_PAGE_SIZE            FLASH_PAGE_SIZE
+#define KV_PAGE_ADDR(p)         (KV_FLASH_BASE + (uint32_t)(p) * KV_PAGE_SIZE)
+#define KV_PAGE_MAGIC           0x4B565032U     /* "KVP2" */
+#define KV_PAGE_READY           0x5245414459524459ULL
+#define KV_PAGE_READY_OFF       (8U + 4U * KV_PAGE_COUNT)
+#define KV_PAGE_HDR_SIZE        (KV_PAGE_READY_OFF + 8U)
+#define KV_REC_HDR_SIZE         8U
+#define KV_REC_SIZE(len)        (KV_REC_HDR_SIZE + (((uint32_t)(len) + 7U) & ~7U))
+#define KV_CAPACITY             ((KV_PAGE_COUNT - 2U) * (KV_PAGE_SIZE - KV_PAGE_HDR_SIZE))
+#define KV_ERASED_KEY           0xFFFFU
+#define KV_NO_PAGE              0xFFU
+
+#define KV_INDEX_SIZE           256U    /* Power of 2, > KV_MAX_KEYS */
+#define KV_INDEX_EMPTY          0xFFFFU
+
+#if (KV_PAGE_COUNT % 2) != 0
+#error "KV page header must stay a multiple of 8 bytes"
+#endif
+
+/*
+ * Page: [header][record][record]...[erased]
+ * The header's ready word is programmed last; a page without it was being
+ * filled by an interrupted swap and is erased at boot. Every header carries
+ * the erase counts of all pages, as a blank page has no header to keep its
+ * own: at boot the highest count seen for each page wins.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;                   /* Log order, increases with every new page */
+    uint32_t erases[KV_PAGE_COUNT]; /* Wear counters when the page was opened */
+    uint64_t ready;
+} KvPageHdr_t;
+
+/* Record: [header][value padded to 8 bytes]; len 0 deletes the key */
+typedef struct {
+    uint16_t key;
+    uint16_t len;
+    uint32_t crc;                   /* CRC32 of key, len and value */
+} KvRecHdr_t;
+
+typedef struct {
+    uint16_t key;
+    uint16_t loc;                   /* (record address - KV_FLASH_BASE) / 8 */
+} KvIndex_t;
+
+typedef struct {
+    uint32_t seq;                   /* 0 = blank */
+    uint32_t erases;
+    uint16_t used;                  /* End of the last record */
+} KvPage_t;
+
+static KvPage_t kv_pages[KV_PAGE_COUNT];
+static KvIndex_t kv_index[KV_INDEX_SIZE];
+static uint8_t kv_active = KV_NO_PAGE;
+static uint32_t kv_seq = 0;
+static uint32_t kv_live_bytes = 0;
+static uint16_t kv_keys = 0;
+static uint32_t kv_swaps = 0;
+static uint32_t kv_errors = 0;
+static uint8_t kv_ready = 0;
+static uint8_t kv_buf[KV_MAX_VALUE];    /* Value read back from Flash */
+
+/*============================================================================
+ * Static Helper Functions
+ *============================================================================*/
+
+static uint32_t Kv_RecordCrc(uint16_t key, uint16_t len, const void *data)
+{
+    uint16_t hdr[2];
+
+    hdr[0] = key;
+    hdr[1] = len;
+    return ~Module_Crc32_Update(Module_Crc32_Update(CRC32_INIT, hdr, sizeof(hdr)), data, len);
+}
+
+static uint32_t Kv_RecordAddr(uint16_t loc)
+{
+    return KV_FLASH_BASE + (uint32_t)loc * 8U;
+}
+
+/**
+ * @brief Read a record header, including one still queued in the Flash writer
+ */
+static void Kv_ReadHeader(uint16_t loc, KvRecHdr_t *hdr)
+{
+    Module_Flash_Read(Kv_RecordAddr(loc), hdr, sizeof(KvRecHdr_t));
+}
+
+static uint8_t Kv_IsBlank(uint32_t addr, uint32_t len)
+{
+    const uint32_t *p = (const uint32_t*)addr;
+
+    for (len /= 4U; len > 0; len--, p++) {
+        if (*p != 0xFFFFFFFFU) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void Kv_OnFlashDone(uint32_t addr, int status)
+{
+    if (status != 0) {
+        DEBUG_ERROR("KV Flash job failed at 0x%08lX", addr);
+        kv_errors++;
+    }
+}
+
+/**
+ * @brief Queue a page erase; the writer runs it between radio events
+ */
+static int Kv_FlashErase(uint8_t page)
+{
+    kv_pages[page].seq = 0;
+    kv_pages[page].used = 0;
+    kv_pages[page].erases++;
+
+    if (Module_Flash_Erase(KV_PAGE_ADDR(page), Kv_OnFlashDone) != 0) {
+        /* Queue full: drain it and try once more (not inside a writer wait) */
+        if (Module_Flash_Flush() != 0 ||
+            Module_Flash_Erase(KV_PAGE_ADDR(page), Kv_OnFlashDone) != 0) {
+            kv_errors++;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Queue whole double words; a short tail is padded with 0xFF
+ */
+static int Kv_FlashWrite(uint32_t addr, const void *data, uint32_t len)
+{
+    if (Module_Flash_Program(addr, data, (uint16_t)len, Kv_OnFlashDone) != 0) {
+        if (Module_Flash_Flush() != 0 ||
+            Module_Flash_Program(addr, data, (uint16_t)len, Kv_OnFlashDone) != 0) {
+            kv_errors++;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static uint16_t Kv_Hash(uint16_t key)
+{
+    return (uint16_t)(((uint32_t)key * 2654435761U) >> 24);
+}
+
+/**
+ * @brief Index slot holding key, or the empty slot where it would go
+ */
+static KvIndex_t* Kv_Slot(uint16_t key)
+{
+    uint16_t i = Kv_Hash(key);
+    uint16_t n;
+
+    for (n = 0; n < KV_INDEX_SIZE; n++) {
+        if (kv_index[i].loc == KV_INDEX_EMPTY || kv_index[i].key == key) {
+            return &kv_index[i];
+        }
+        i = (uint16_t)((i + 1U) & (KV_INDEX_SIZE - 1U));
+    }
+    return NULL;
+}
+
+static KvIndex_t* Kv_Find(uint16_t key)
+{
+    KvIndex_t *e = Kv_Slot(key);
+
+    return (e != NULL && e->loc != KV_INDEX_EMPTY) ? e : NULL;
+}
+
+/**
+ * @brief Remove an entry, shifting later entries of its probe run back
+ */
+static void Kv_Remove(KvIndex_t *e)
+{
+    uint16_t i = (uint16_t)(e - kv_index);
+    uint16_t j = i;
+    uint16_t k;
+
+    for (;;) {
+        j = (uint16_t)((j + 1U) & (KV_INDEX_SIZE - 1U));
+        if (kv_index[j].loc == KV_INDEX_EMPTY) {
+            break;
+        }
+        /* Entry j may fill the hole only if its home slot is not in (i, j] */
+        k = Kv_Hash(kv_index[j].key);
+        if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j)) {
+            continue;
+        }
+        kv_index[i] = kv_index[j];
+        i = j;
+    }
+    kv_index[i].loc = KV_INDEX_EMPTY;
+}
+
+/**
+ * @brief Point key at a committed record (len 0 = deleted)
+ */
+static void Kv_IndexPut(uint16_t key, uint16_t len, uint32_t addr)
+{
+    KvIndex_t *e = Kv_Slot(key);
+    KvRecHdr_t old;
+
+    if (e == NULL) {
+        kv_errors++;
+        return;
+    }
+
+    if (e->loc != KV_INDEX_EMPTY) {
+        Kv_ReadHeader(e->loc, &old);
+        kv_live_bytes -= KV_REC_SIZE(old.len);
+        if (len == 0) {
+            Kv_Remove(e);
+            kv_keys--;
+            return;
+        }
+    } else {
+        if (len == 0) {
+            return;
+        }
+        e->key = key;
+        kv_keys++;
+    }
+
+    e->loc = (uint16_t)((addr - KV_FLASH_BASE) / 8U);
+    kv_live_bytes += KV_REC_SIZE(len);
+}
+
+/**
+ * @brief Replay one page's records into the index
+ * @return Offset of the first free byte, KV_PAGE_SIZE if the page is unusable
+ */
+static uint16_t Kv_ScanPage(uint8_t page)
+{
+    uint32_t base = KV_PAGE_ADDR(page);
+    uint32_t off = KV_PAGE_HDR_SIZE;
+    const KvRecHdr_t *h;
+
+    while (off + KV_REC_HDR_SIZE <= KV_PAGE_SIZE) {
+        h = (const KvRecHdr_t*)(base + off);
+        if (h->key == KV_ERASED_KEY && h->len == 0xFFFFU && h->crc == 0xFFFFFFFFU) {
+            break;
+        }
+        if (h->len > KV_MAX_VALUE || off + KV_REC_SIZE(h->len) > KV_PAGE_SIZE) {
+            kv_errors++;
+            return KV_PAGE_SIZE;
+        }
+
+        if (Kv_RecordCrc(h->key, h->len, h + 1) == h->crc) {
+            Kv_IndexPut(h->key, h->len, base + off);
+        } else {
+            kv_errors++;
+        }
+        off += KV_REC_SIZE(h->len);
+    }
+
+    return (uint16_t)off;
+}
+
+/**
+ * @brief Commit one record at the end of the active page
+ * @note  Value first, header last: the header is the commit point
+ */
+static int Kv_Append(uint16_t key, uint16_t len, uint32_t crc, const void *data)
+{
+    KvRecHdr_t hdr;
+    uint32_t addr = KV_PAGE_ADDR(kv_active) + kv_pages[kv_active].used;
+
+    hdr.key = key;
+    hdr.len = len;
+    hdr.crc = crc;
+
+    /* Whatever happens, this space is no longer blank */
+    kv_pages[kv_active].used = (uint16_t)(kv_pages[kv_active].used + KV_REC_SIZE(len));
+
+    if ((len > 0 && Kv_FlashWrite(addr + KV_REC_HDR_SIZE, data, len) != 0) ||
+        Kv_FlashWrite(addr, &hdr, sizeof(hdr)) != 0) {
+        return -1;
+    }
+
+    Kv_IndexPut(key, len, addr);
+    return 0;
+}
+
+/**
+ * @brief Start a page: header without the ready word
+ * @param erasing Page the swap erases next (counted ahead), KV_NO_PAGE if none
+ */
+static int Kv_OpenPage(uint8_t page, uint8_t erasing)
+{
+    KvPageHdr_t hdr;
+    uint8_t p;
+
+    hdr.magic = KV_PAGE_MAGIC;
+    hdr.seq = ++kv_seq;
+    for (p = 0; p < KV_PAGE_COUNT; p++) {
+        hdr.erases[p] = kv_pages[p].erases + ((p == erasing) ? 1U : 0U);
+    }
+
+    kv_pages[page].seq = hdr.seq;
+    kv_pages[page].used = KV_PAGE_HDR_SIZE;
+    kv_active = page;
+
+    return Kv_FlashWrite(KV_PAGE_ADDR(page), &hdr, KV_PAGE_READY_OFF);
+}
+
+static int Kv_ReadyPage(uint8_t page)
+{
+    uint64_t ready = KV_PAGE_READY;
+
+    return Kv_FlashWrite(KV_PAGE_ADDR(page) + KV_PAGE_READY_OFF, &ready, sizeof(ready));
+}
+
+/**
+ * @brief Move the log to a blank page; with only the spare left, swap out the oldest
+ */
+static int Kv_NextPage(void)
+{
+    uint8_t p, dst = KV_NO_PAGE, src = KV_NO_PAGE, blanks = 0;
+    uint8_t swap;
+    uint16_t i;
+    KvRecHdr_t h;
+
+    for (p = 0; p < KV_PAGE_COUNT; p++) {
+        if (kv_pages[p].seq == 0) {
+            blanks++;
+            /* Wear leveling: least erased blank page first */
+            if (dst == KV_NO_PAGE || kv_pages[p].erases < kv_pages[dst].erases) {
+                dst = p;
+            }
+        } else if (src == KV_NO_PAGE || kv_pages[p].seq < kv_pages[src].seq) {
+            src = p;
+        }
+    }
+
+    if (dst == KV_NO_PAGE) {
+        return -1;
+    }
+
+    /* The swap's erase of src is recorded in the new header already: once
+       dst is ready, src is erased by the swap or, if interrupted, at boot */
+    swap = (blanks < 2U && src != KV_NO_PAGE) ? 1U : 0U;
+    if (Kv_OpenPage(dst, swap ? src : KV_NO_PAGE) != 0) {
+        return -1;
+    }
+
+    if (swap) {
+        /* Page swap: live records of the oldest page move to the new one */
+        for (i = 0; i < KV_INDEX_SIZE; i++) {
+            if (kv_index[i].loc == KV_INDEX_EMPTY ||
+                (((uint32_t)kv_index[i].loc * 8U) / KV_PAGE_SIZE) != src) {
+                continue;
+            }
+            Kv_ReadHeader(kv_index[i].loc, &h);
+            Module_Flash_Read(Kv_RecordAddr(kv_index[i].loc) + KV_REC_HDR_SIZE, kv_buf, h.len);
+            if (Kv_Append(h.key, h.len, h.crc, kv_buf) != 0) {
+                return -1;
+            }
+        }
+
+        if (Kv_ReadyPage(dst) != 0) {
+            return -1;
+        }
+        kv_swaps++;
+        return Kv_FlashErase(src);
+    }
+
+    return Kv_ReadyPage(dst);
+}
+
+/**
+ * @brief Make room for a record in the active page
+ */
+static int Kv_Reserve(uint32_t size)
+{
+    uint8_t tries;
+
+    for (tries = 0; tries < KV_PAGE_COUNT; tries++) {
+        if (kv_active != KV_NO_PAGE && kv_pages[kv_active].used + size <= KV_PAGE_SIZE) {
+            return 0;
+        }
+        if (Kv_NextPage() != 0) {
+            return -1;
+        }
+    }
+    return -1;
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+void Module_KV_Init(void)
+{
+    const KvPageHdr_t *h;
+    uint8_t p, q, next, blanks = 0, oldest = KV_NO_PAGE;
+    uint32_t last = 0;
+
+    memset(kv_index, 0xFF, sizeof(kv_index));
+    kv_active = KV_NO_PAGE;
+    kv_seq = 0;
+    kv_live_bytes = 0;
+    kv_keys = 0;
+    kv_swaps = 0;
+    kv_errors = 0;
+
+    /* Wear counters: highest value in any page header, blank pages included */
+    for (p = 0; p < KV_PAGE_COUNT; p++) {
+        kv_pages[p].erases = 0;
+    }
+    for (p = 0; p < KV_PAGE_COUNT; p++) {
+        h = (const KvPageHdr_t*)KV_PAGE_ADDR(p);
+        if (h->magic != KV_PAGE_MAGIC) {
+            continue;
+        }
+        for (q = 0; q < KV_PAGE_COUNT; q++) {
+            if (h->erases[q] != 0xFFFFFFFFU && h->erases[q] > kv_pages[q].erases) {
+                kv_pages[q].erases = h->erases[q];
+            }
+        }
+    }
+
+    /* Classify pages: ready, blank, or left over from an interrupted swap */
+    for (p = 0; p < KV_PAGE_COUNT; p++) {
+        h = (const KvPageHdr_t*)KV_PAGE_ADDR(p);
+        kv_pages[p].seq = 0;
+        kv_pages[p].used = 0;
+
+        if (h->magic == KV_PAGE_MAGIC && h->ready == KV_PAGE_READY && h->seq != 0) {
+            kv_pages[p].seq = h->seq;
+            if (h->seq > kv_seq) {
+                kv_seq = h->seq;
+            }
+            if (oldest == KV_NO_PAGE || h->seq < kv_pages[oldest].seq) {
+                oldest = p;
+            }
+        } else if (Kv_IsBlank(KV_PAGE_ADDR(p), KV_PAGE_SIZE)) {
+            blanks++;
+        } else {
+            /* Unfinished copy or erase: the data is still in another page */
+            Kv_FlashErase(p);
+            blanks++;
+        }
+    }
+
+    /* No spare: a swap copied the oldest page but did not get to erase it */
+    if (blanks == 0 && oldest != KV_NO_PAGE) {
+        /* The new page's header already counted this erase */
+        if (kv_pages[oldest].erases > 0) {
+            kv_pages[oldest].erases--;
+        }
+        Kv_FlashErase(oldest);
+    }
+
+    /* Recovery erases must land before the pages are scanned in place */
+    Module_Flash_Flush();
+
+    /* Replay oldest first so later records win */
+    for (;;) {
+        next = KV_NO_PAGE;
+        for (p = 0; p < KV_PAGE_COUNT; p++) {
+            if (kv_pages[p].seq > last &&
+                (next == KV_NO_PAGE || kv_pages[p].seq < kv_pages[next].seq)) {
+                next = p;
+            }
+        }
+        if (next == KV_NO_PAGE) {
+            break;
+        }
+        kv_pages[next].used = Kv_ScanPage(next);
+        kv_active = next;
+        last = kv_pages[next].seq;
+    }
+
+    /* A value written without its header leaves the tail dirty: append elsewhere */
+    if (kv_active != KV_NO_PAGE &&
+        !Kv_IsBlank(KV_PAGE_ADDR(kv_active) + kv_pages[kv_active].used,
+                    KV_PAGE_SIZE - kv_pages[kv_active].used)) {
+        kv_pages[kv_active].used = KV_PAGE_SIZE;
+    }
+
+    kv_ready = 1;
+    DEBUG_INFO("KV store: %d keys, %lu bytes live, page %d", kv_keys, kv_live_bytes, kv_active);
+}
+
+int Module_KV_Get(uint16_t key, void *buffer, uint16_t max_len)
+{
+    const KvIndex_t *e;
+    KvRecHdr_t h;
+
+    if (!kv_ready || key == KV_ERASED_KEY) {
+        return -1;
+    }
+
+    e = Kv_Find(key);
+    if (e == NULL) {
+        return -1;
+    }
+
+    Kv_ReadHeader(e->loc, &h);
+    if (buffer != NULL) {
+        Module_Flash_Read(Kv_RecordAddr(e->loc) + KV_REC_HDR_SIZE, buffer,
+                          (h.len < max_len) ? h.len : max_len);
+    }
+    return h.len;
+}
+
+int Module_KV_Set(uint16_t key, const void *data, uint16_t len)
+{
+    const KvIndex_t *e;
+    KvRecHdr_t h;
+    uint32_t old_size = 0;
+    uint32_t size = KV_REC_SIZE(len);
+
+    if (!kv_ready || key == KV_ERASED_KEY || data == NULL || len == 0 || len > KV_MAX_VALUE) {
+        return -1;
+    }
+
+    e = Kv_Find(key);
+    if (e != NULL) {
+        Kv_ReadHeader(e->loc, &h);
+        old_size = KV_REC_SIZE(h.len);
+        /* Unchanged value: no Flash wear */
+        if (h.len == len) {
+            Module_Flash_Read(Kv_RecordAddr(e->loc) + KV_REC_HDR_SIZE, kv_buf, len);
+            if (memcmp(kv_buf, data, len) == 0) {
+                return 0;
+            }
+        }
+    }
+
+    /* Live data must fit in all pages but the spare and the one being filled */
+    if (kv_live_bytes + size - old_size > KV_CAPACITY ||
+        (e == NULL && kv_keys >= KV_MAX_KEYS)) {
+        DEBUG_WARN("KV store full: key 0x%04X", key);
+        return -1;
+    }
+
+    if (Kv_Reserve(size) != 0) {
+        return -1;
+    }
+    return Kv_Append(key, len, Kv_RecordCrc(key, len, data), data);
+}
+
+int Module_KV_Delete(uint16_t key)
+{
+    if (!kv_ready || key == KV_ERASED_KEY) {
+        return -1;
+    }
+
+    if (Kv_Find(key) == NULL) {
+        return 0;
+    }
+
+    if (Kv_Reserve(KV_REC_HDR_SIZE) != 0) {
+        return -1;
+    }
+    return Kv_Append(key, 0, Kv_RecordCrc(key, 0, NULL), NULL);
+}
+
+void Module_KV_Report(void)
+{
+    uint8_t p;
+
+    AT_Response_Send("+KV:%d,%lu,%lu,%lu,%lu\r\n", kv_keys, kv_live_bytes,
+                     (uint32_t)KV_CAPACITY, kv_swaps, kv_errors);
+
+    for (p = 0; p < KV_PAGE_COUNT; p++) {
+        AT_Response_Send("+KVPAGE:%d,%lu,%d,%lu%s\r\n", p, kv_pages[p].seq, kv_pages[p].used,
+                         kv_pages[p].erases, (p == kv_active) ? ",ACTIVE" : "");
+    }
+}
@@ -6,32 +6,212 @@
   ******************************************************************************
   */
 
+#define DEBUG_MODULE DEBUG_MOD_DATA
+
 #include "module_mode.h"
+#include "module_mux.h"
+#include "module_compress.h"
 #include "debug_trace.h"
 #include "main.h"
 #include "ble_device_manager.h"
 #include "ble_gatt_client.h"
+#include "ble_l2cap.h"
 #include "at_command.h"
+#include "hw_if.h"
+#include "app_conf.h"
+#include "stm32_seq.h"
 #include <string.h>
 
 /* Current mode state */
 static Operation_Mode_t current_mode = MODE_COMMAND;
 static uint8_t target_dev_idx = 0xFF;
 static uint16_t target_char_handle = 0;
+static uint16_t target_rx_handle = 0;     /* Notified/indicated by the peer */
+static uint8_t target_coc_ch = 0xFF;      /* L2CAP channel (DATA_TX_COC) */
 
-/* Data mode TX buffer */
+/* Data mode TX buffer: [data_tx_sent, data_tx_len) not yet written */
 #define DATA_TX_BUFFER_SIZE  512
 static uint8_t data_tx_buffer[DATA_TX_BUFFER_SIZE];
 static uint16_t data_tx_len = 0;
+static uint16_t data_tx_sent = 0;
+static Data_TxMode_t data_tx_mode = DATA_TX_NORESP;
+
+/* Compressed link directions, latched at data mode entry (GATT targets only) */
+static uint8_t data_comp_up = 0;
+static uint8_t data_comp_down = 0;
+
+/* UART RX ring: filled by the LPUART ISR, drained by the data mode task */
+#define DATA_RX_RING_SIZE    1024U      /* Power of 2 */
+#define DATA_RX_RING_MASK    (DATA_RX_RING_SIZE - 1U)
+static uint8_t data_rx_ring[DATA_RX_RING_SIZE];
+static volatile uint16_t data_rx_head = 0;     /* Written by ISR only */
+static volatile uint16_t data_rx_tail = 0;     /* Written by task only */
+static volatile uint32_t data_rx_overflow = 0;
+/* Per ring slot: byte arrived after at least the escape guard time of silence.
+   Timed in the ISR, as the task may dequeue long after arrival */
+static uint8_t data_rx_gap[DATA_RX_RING_SIZE / 8U];
+
+/* UART TX ring: peer data written by tasks, sent by LPUART TX DMA */
+#define UART_TX_RING_SIZE    2048U      /* Power of 2 */
+#define UART_TX_RING_MASK    (UART_TX_RING_SIZE - 1U)
+static uint8_t uart_tx_ring[UART_TX_RING_SIZE];
+static volatile uint16_t uart_tx_head = 0;     /* Written by task only */
+static volatile uint16_t uart_tx_tail = 0;     /* Written by DMA completion only */
+static volatile uint16_t uart_tx_dma_len = 0;  /* Bytes of current DMA transfer */
+static volatile uint8_t uart_tx_busy = 0;
+static volatile uint8_t uart_tx_notify = 0;    /* Wake data task when space frees */
+static volatile uint8_t uart_tx_retry = 0;     /* DMA start refused: retry from task */
+static uint8_t uart_tx_timer_id;
+
+/* Flow control: one acked write in flight, or waiting for TX pool credits */
+static uint8_t data_write_in_flight = 0;
+static uint8_t data_pool_wait = 0;
+static uint16_t data_write_conn = 0xFFFF;
 
-/* Escape sequence detection */
+/* Throughput statistics (last data mode session) */
+static uint32_t data_stat_bytes = 0;
+static uint32_t data_stat_packets = 0;
+static uint32_t data_stat_pool_waits = 0;
+static uint32_t data_stat_errors = 0;
+static uint32_t data_stat_first_tick = 0;
+static uint32_t data_stat_last_tick = 0;
+static uint32_t data_stat_down_bytes = 0;
+static uint32_t data_stat_down_drops = 0;
+
+/* Flush policy and its deadline timer */
+#define DATA_COC_CREDIT_POLL_MS  5   /* Retry withheld CoC RX credits as the UART drains */
+#define UART_TX_RETRY_MS     1       /* Retry a DMA start refused during a blocking transfer */
+#define MODE_MS_TO_TS(ms)    (((uint32_t)(ms) * 1000U) / CFG_TS_TICK_VAL)
+static Data_FlushPolicy_t flush_policy = {
+    DATA_FLUSH_DEFAULT_MAX_BYTES, DATA_FLUSH_DEFAULT_LATENCY_MS,
+    DATA_FLUSH_DEFAULT_IDLE_MS, DATA_FLUSH_DEFAULT_NAGLE
+};
+static uint8_t data_timer_id;
+static volatile uint32_t data_rx_last_tick = 0;    /* Arrival of last UART byte (ISR) */
+static uint32_t data_tx_first_tick = 0;             /* Oldest unsent byte buffered */
+
+/* Escape sequence detection: guard times run on a one-shot timer */
 static uint8_t escape_count = 0;
-static uint32_t last_char_time = 0;
-static uint32_t escape_start_time = 0;
 static uint8_t escape_detected = 0;
+static uint8_t escape_timer_id;
+static volatile uint8_t escape_timer_fired = 0;
+
+static void Module_Mode_DataTask(void);
+static void Module_Mode_MuxTask(void);
+static int Module_Mode_SendPackets(uint8_t partial);
+static void Module_Mode_UartTxKick(void);
+static void Module_Mode_ResetData(void);
+static void Module_Mode_BufferByte(uint8_t byte);
+
+static void Module_Mode_TimerCallback(void)
+{
+    /* Timer server ISR context: defer to task */
+    UTIL_SEQ_SetTask(1U << CFG_TASK_DATA_MODE_ID, CFG_SCH_PRIO_RT);
+}
 
-/* External handles */
-extern UART_HandleTypeDef hlpuart1;
+static void Module_Mode_UartTxTimerCallback(void)
+{
+    /* Timer server ISR context: the task restarts DMA, never racing a task kick */
+    UTIL_SEQ_SetTask(1U << CFG_TASK_DATA_MODE_ID, CFG_SCH_PRIO_RT);
+}
+
+static void Module_Mode_EscapeTimerCallback(void)
+{
+    /* Guard time elapsed with no byte after the held '+' */
+    escape_timer_fired = 1;
+    UTIL_SEQ_SetTask(1U << CFG_TASK_DATA_MODE_ID, CFG_SCH_PRIO_RT);
+}
+
+/**
+ * @brief Time the trailing guard from the arrival of the last byte received
+ * @note  If bytes followed the held '+', they are still queued and cancel it
+ */
+static void Module_Mode_EscapeArm(void)
+{
+    uint32_t elapsed = HAL_GetTick() - data_rx_last_tick;
+    uint32_t wait = (elapsed < ESCAPE_GUARD_TIME_MS) ? (ESCAPE_GUARD_TIME_MS - elapsed) : 1U;
+    
+    HW_TS_Stop(escape_timer_id);
+    escape_timer_fired = 0;
+    HW_TS_Start(escape_timer_id, MODE_MS_TO_TS(wait));
+}
+
+static void Module_Mode_EscapeCancel(void)
+{
+    HW_TS_Stop(escape_timer_id);
+    escape_timer_fired = 0;
+    escape_count = 0;
+    escape_detected = 0;
+}
+
+/**
+ * @brief Release held '+' characters as data
+ */
+static void Module_Mode_EscapeRelease(void)
+{
+    uint8_t i;
+    
+    if (escape_count > 0 && data_tx_len == data_tx_sent) {
+        data_tx_first_tick = HAL_GetTick();
+    }
+    for (i = 0; i < escape_count; i++) {
+        Module_Mode_BufferByte(ESCAPE_SEQ_CHAR);
+    }
+    Module_Mode_EscapeCancel();
+}
+
+/**
+ * @brief LPUART TX DMA complete (ISR context): release bytes, chain next segment
+ */
+static void Module_Mode_UartTxDone(void)
+{
+    uart_tx_tail = (uint16_t)(uart_tx_tail + uart_tx_dma_len);
+    uart_tx_dma_len = 0;
+    uart_tx_busy = 0;
+    Module_Mode_UartTxKick();
+    
+    if (uart_tx_notify) {
+        uart_tx_notify = 0;
+        UTIL_SEQ_SetTask(1U << CFG_TASK_DATA_MODE_ID, CFG_SCH_PRIO_RT);
+    }
+}
+
+/**
+ * @brief Start DMA on the contiguous pending part of the UART TX ring
+ * @note  Safe from task and DMA ISR: while busy, only the ISR starts transfers
+ */
+static void Module_Mode_UartTxKick(void)
+{
+    uint16_t tail, pending, contiguous;
+    
+    if (uart_tx_busy) {
+        return;
+    }
+    
+    tail = uart_tx_tail;
+    pending = (uint16_t)(uart_tx_head - tail);
+    if (pending == 0) {
+        return;
+    }
+    
+    contiguous = (uint16_t)(UART_TX_RING_SIZE - (tail & UART_TX_RING_MASK));
+    if (pending > contiguous) {
+        pending = contiguous;
+    }
+    
+    uart_tx_busy = 1;
+    uart_tx_dma_len = pending;
+    if (HW_UART_Transmit_DMA(hw_lpuart1, &uart_tx_ring[tail & UART_TX_RING_MASK], pending,
+                             Module_Mode_UartTxDone) != hw_uart_ok) {
+        /* UART busy with a blocking transfer: retried from the data mode task,
+           in any mode, as no further write may come */
+        uart_tx_dma_len = 0;
+        uart_tx_busy = 0;
+        uart_tx_retry = 1;
+        HW_TS_Stop(uart_tx_timer_id);
+        HW_TS_Start(uart_tx_timer_id, MODE_MS_TO_TS(UART_TX_RETRY_MS));
+    }
+}
 
 /*============================================================================
  * Initialization
@@ -41,9 +221,31 @@ void Module_Mode_Init(void)
     current_mode = MODE_COMMAND;
     target_dev_idx = 0xFF;
     target_char_handle = 0;
+    target_rx_handle = 0;
+    target_coc_ch = 0xFF;
     data_tx_len = 0;
     escape_count = 0;
     escape_detected = 0;
+    data_rx_head = 0;
+    data_rx_tail = 0;
+    uart_tx_head = 0;
+    uart_tx_tail = 0;
+    uart_tx_busy = 0;
+    data_write_in_flight = 0;
+    
+    Module_Mux_Init();
+    Module_Compress_Init();
+    
+    UTIL_SEQ_RegTask(1U << CFG_TASK_DATA_MODE_ID, UTIL_SEQ_RFU, Module_Mode_DataTask);
+    /* Timer slots are sized in hw_conf.h (CFG_HW_TS_MAX_NBR_CONCURRENT_TIMER) */
+    if (HW_TS_Create(CFG_TIM_PROC_ID_ISR, &data_timer_id, hw_ts_SingleShot,
+                     Module_Mode_TimerCallback) != hw_ts_Successful ||
+        HW_TS_Create(CFG_TIM_PROC_ID_ISR, &escape_timer_id, hw_ts_SingleShot,
+                     Module_Mode_EscapeTimerCallback) != hw_ts_Successful ||
+        HW_TS_Create(CFG_TIM_PROC_ID_ISR, &uart_tx_timer_id, hw_ts_SingleShot,
+                     Module_Mode_UartTxTimerCallback) != hw_ts_Successful) {
+        DEBUG_ERROR("Mode control: no free timer");
+    }
     
     DEBUG_INFO("Mode control initialized");
 }
@@ -60,14 +262,24 @@ int Module_Mode_EnterCommand(void)
     DEBUG_INFO("Entering command mode");
     
     /* Flush any pending data */
-    Module_Mode_FlushTxBuffer();
+    if (current_mode == MODE_MUX) {
+        Module_Mux_Stop();
+    } else {
+        Module_Mode_FlushTxBuffer();
+    }
     
-    /* Switch to command mode */
+    /* Switch to command mode; bytes still in the ring belong to data mode */
     current_mode = MODE_COMMAND;
     target_dev_idx = 0xFF;
     target_char_handle = 0;
-    escape_count = 0;
-    escape_detected = 0;
+    target_rx_handle = 0;
+    if (target_coc_ch != 0xFF) {
+        BLE_L2cap_BindUart(0xFF);
+        target_coc_ch = 0xFF;
+    }
+    Module_Mode_EscapeCancel();
+    data_rx_tail = data_rx_head;
+    HW_TS_Stop(data_timer_id);
     
     /* Send confirmation */
     AT_Response_Send("+CMDMODE\r\n");
@@ -75,7 +287,8 @@ int Module_Mode_EnterCommand(void)
     return 0;
 }
 
-int Module_Mode_EnterData(uint8_t dev_idx, uint16_t char_handle)
+int Module_Mode_EnterData(uint8_t dev_idx, uint16_t char_handle, uint16_t rx_handle,
+                          Data_TxMode_t tx_mode)
 {
     BLE_Device_t *dev;
     
@@ -86,16 +299,18 @@ int Module_Mode_EnterData(uint8_t dev_idx, uint16_t char_handle)
         return -1;
     }
     
-    DEBUG_INFO("Entering data mode: dev=%d, handle=0x%04X", dev_idx, char_handle);
+    DEBUG_INFO("Entering data mode: dev=%d, tx=0x%04X, rx=0x%04X, mode=%d",
+               dev_idx, char_handle, rx_handle, tx_mode);
     
     /* Switch to data mode */
     current_mode = MODE_DATA;
     target_dev_idx = dev_idx;
     target_char_handle = char_handle;
-    data_tx_len = 0;
-    escape_count = 0;
-    escape_detected = 0;
-    last_char_time = HAL_GetTick();
+    target_rx_handle = (rx_handle != 0) ? rx_handle : char_handle;
+    data_tx_mode = tx_mode;
+    Module_Mode_ResetData();
+    data_comp_up = Module_Compress_IsEnabled(dev_idx, COMPRESS_UP);
+    data_comp_down = Module_Compress_IsEnabled(dev_idx, COMPRESS_DOWN);
     
     /* Send confirmation */
     AT_Response_Send("+DATAMODE\r\n");
@@ -103,6 +318,74 @@ int Module_Mode_EnterData(uint8_t dev_idx, uint16_t char_handle)
     return 0;
 }
 
+int Module_Mode_EnterCoc(uint8_t ch)
+{
+    if (current_mode != MODE_COMMAND || !BLE_L2cap_IsOpen(ch)) {
+        DEBUG_ERROR("Cannot enter CoC data mode: channel not open");
+        return -1;
+    }
+    
+    DEBUG_INFO("Entering CoC data mode: ch=%d", ch);
+    
+    /* Same pipeline as GATT data mode; SDUs replace ATT writes */
+    current_mode = MODE_DATA;
+    target_dev_idx = 0xFF;
+    target_char_handle = 0;
+    target_rx_handle = 0;
+    target_coc_ch = ch;
+    data_tx_mode = DATA_TX_COC;
+    Module_Mode_ResetData();
+    BLE_L2cap_BindUart(ch);
+    
+    AT_Response_Send("+COCMODE\r\n");
+    
+    return 0;
+}
+
+/**
+ * @brief Reset buffers and statistics for a new data mode session
+ */
+static void Module_Mode_ResetData(void)
+{
+    data_tx_len = 0;
+    data_tx_sent = 0;
+    Module_Mode_EscapeCancel();
+    data_write_in_flight = 0;
+    data_pool_wait = 0;
+    data_rx_tail = data_rx_head;
+    data_rx_overflow = 0;
+    data_stat_bytes = 0;
+    data_stat_packets = 0;
+    data_stat_pool_waits = 0;
+    data_stat_errors = 0;
+    data_stat_down_bytes = 0;
+    data_stat_down_drops = 0;
+    data_comp_up = 0;
+    data_comp_down = 0;
+    Module_Compress_Reset();
+    /* The leading guard time of an escape runs from data mode entry */
+    data_rx_last_tick = HAL_GetTick();
+}
+
+int Module_Mode_EnterMux(void)
+{
+    if (current_mode != MODE_COMMAND || Module_Mux_Start() != 0) {
+        DEBUG_ERROR("Cannot enter mux mode: no link bound");
+        return -1;
+    }
+    
+    DEBUG_INFO("Entering mux mode");
+    
+    current_mode = MODE_MUX;
+    data_rx_tail = data_rx_head;
+    data_rx_overflow = 0;
+    
+    /* Last plain-text line before framed traffic */
+    AT_Response_Send("+MUXMODE\r\n");
+    
+    return 0;
+}
+
 Operation_Mode_t Module_Mode_GetCurrent(void)
 {
     return current_mode;
@@ -111,100 +394,435 @@ Operation_Mode_t Module_Mode_GetCurrent(void)
 /*============================================================================
  * Data Mode Processing
  *============================================================================*/
-void Module_Mode_ProcessDataByte(uint8_t byte)
+void Module_Mode_ReceiveByteISR(uint8_t byte)
+{
+    uint16_t head = data_rx_head;
+    uint16_t slot = head & DATA_RX_RING_MASK;
+    uint32_t now = HAL_GetTick();
+    
+    /* ISR: append only. Everything else runs in the data mode task. */
+    if ((uint16_t)(head - data_rx_tail) >= DATA_RX_RING_SIZE) {
+        data_rx_overflow++;
+    } else {
+        data_rx_ring[slot] = byte;
+        if ((now - data_rx_last_tick) >= ESCAPE_GUARD_TIME_MS) {
+            data_rx_gap[slot >> 3] |= (uint8_t)(1U << (slot & 7U));
+        } else {
+            data_rx_gap[slot >> 3] &= (uint8_t)~(1U << (slot & 7U));
+        }
+        data_rx_head = (uint16_t)(head + 1U);
+    }
+    data_rx_last_tick = now;
+    
+    UTIL_SEQ_SetTask(1U << CFG_TASK_DATA_MODE_ID, CFG_SCH_PRIO_RT);
+}
+
+void Module_Mode_ProcessDataByte(uint8_t byte, uint8_t after_guard)
 {
     uint32_t current_time = HAL_GetTick();
-    uint32_t time_since_last = current_time - last_char_time;
-    BLE_Device_t *dev;
     
     /* Check for escape sequence: +++ with guard time */
     if (byte == ESCAPE_SEQ_CHAR) {
         if (escape_count == 0) {
             /* First + */
-            if (time_since_last >= ESCAPE_GUARD_TIME_MS) {
-                escape_start_time = current_time;
+            if (after_guard) {
                 escape_count = 1;
+                Module_Mode_EscapeArm();
+                return;
             }
         } else if (escape_count < ESCAPE_SEQ_LENGTH) {
             /* Subsequent + */
             escape_count++;
             
             if (escape_count == ESCAPE_SEQ_LENGTH) {
-                /* Complete escape sequence - check trailing guard time later */
+                /* Complete escape sequence - the timer checks trailing guard time */
                 escape_detected = 1;
-                /* Don't add to buffer */
-                last_char_time = current_time;
-                return;
             }
+            /* Don't add to buffer; guard time restarts at every held + */
+            Module_Mode_EscapeArm();
+            return;
         }
-    } else {
-        /* Non-+ character resets escape detection if incomplete */
-        if (escape_count > 0 && escape_count < ESCAPE_SEQ_LENGTH) {
-            /* Add the buffered + characters */
-            for (uint8_t i = 0; i < escape_count && data_tx_len < DATA_TX_BUFFER_SIZE; i++) {
-                data_tx_buffer[data_tx_len++] = ESCAPE_SEQ_CHAR;
-            }
-        }
-        escape_count = 0;
     }
     
-    /* Add byte to TX buffer */
-    if (data_tx_len < DATA_TX_BUFFER_SIZE) {
-        data_tx_buffer[data_tx_len++] = byte;
-    } else {
-        /* Buffer full - flush it */
-        Module_Mode_FlushTxBuffer();
+    /* Anything after a complete or partial escape cancels it: release held + */
+    if (escape_count > 0) {
+        Module_Mode_EscapeRelease();
+    }
+    
+    if (data_tx_len == data_tx_sent) {
+        data_tx_first_tick = current_time;
+    }
+    
+    /* Add byte to TX buffer (task drains only while there is room) */
+    Module_Mode_BufferByte(byte);
+}
+
+/**
+ * @brief Append one host byte to the TX buffer, decompressing on a compressed link
+ */
+static void Module_Mode_BufferByte(uint8_t byte)
+{
+    uint16_t room = (uint16_t)(DATA_TX_BUFFER_SIZE - data_tx_len);
+    uint16_t n;
+    
+    if (data_comp_up) {
+        n = Module_Compress_Decode(target_dev_idx, &byte, 1, &data_tx_buffer[data_tx_len], room);
+        data_tx_len = (uint16_t)(data_tx_len + ((n < room) ? n : room));
+        return;
+    }
+    
+    if (room > 0) {
         data_tx_buffer[data_tx_len++] = byte;
     }
+}
+
+/**
+ * @brief Buffer fill level at which the task stops draining the RX ring
+ * @note  Held escape characters released by the next byte must still fit; a
+ *        decompressed byte may complete a reference of COMPRESS_MAX_MATCH bytes
+ */
+static uint16_t Module_Mode_BufferLimit(void)
+{
+    if (data_comp_up) {
+        return (uint16_t)(DATA_TX_BUFFER_SIZE - (ESCAPE_SEQ_LENGTH + 1U) * COMPRESS_MAX_MATCH);
+    }
+    return (uint16_t)(DATA_TX_BUFFER_SIZE - ESCAPE_SEQ_LENGTH);
+}
+
+/**
+ * @brief Compress a notification to the UART, whole or not at all
+ * @note  A partial block would desynchronize the host decoder
+ */
+static void Module_Mode_UartWriteCompressed(const uint8_t *data, uint16_t len)
+{
+    uint8_t packed[COMPRESS_BOUND(COMPRESS_BLOCK_MAX)];
+    uint16_t blocks = (uint16_t)((len + COMPRESS_BLOCK_MAX - 1U) / COMPRESS_BLOCK_MAX);
+    uint16_t n;
     
-    last_char_time = current_time;
+    if (Module_Mode_UartTxFree() < (uint32_t)blocks * COMPRESS_BOUND(COMPRESS_BLOCK_MAX)) {
+        data_stat_down_drops += len;
+        return;
+    }
     
-    /* Auto-flush if buffer reaches threshold or timeout */
-    if (data_tx_len >= (DATA_TX_BUFFER_SIZE - 20) || time_since_last > 10) {
-        Module_Mode_FlushTxBuffer();
+    while (len > 0) {
+        n = (len > COMPRESS_BLOCK_MAX) ? COMPRESS_BLOCK_MAX : len;
+        Module_Mode_UartWrite(packed, Module_Compress_Encode(target_dev_idx, data, n, packed));
+        data_stat_down_bytes += n;
+        data += n;
+        len = (uint16_t)(len - n);
     }
 }
 
-void Module_Mode_ProcessGATTData(uint16_t conn_handle, uint16_t handle, 
-                                 const uint8_t *data, uint16_t len)
+/**
+ * @brief Smallest packet sent without a latency trigger
+ */
+static uint16_t Module_Mode_FlushThreshold(void)
 {
-    BLE_Device_t *dev;
+    uint16_t chunk = Module_Mode_GetChunkSize();
+    
+    if (flush_policy.max_bytes == 0 || flush_policy.max_bytes > chunk) {
+        return chunk;
+    }
+    return flush_policy.max_bytes;
+}
+
+/**
+ * @brief Milliseconds left until a deadline, 0 if passed
+ */
+static uint32_t Module_Mode_Remaining(uint32_t elapsed, uint32_t limit)
+{
+    return (elapsed >= limit) ? 0U : (limit - elapsed);
+}
+
+/**
+ * @brief Mux mode: decode frames into link buffers, then write each link
+ * @note  Frames are message boundaries, so no idle timer is needed
+ */
+static void Module_Mode_MuxTask(void)
+{
+    uint16_t budget = DATA_RX_RING_SIZE;
+    
+    while (data_rx_tail != data_rx_head && budget-- > 0) {
+        uint8_t byte = data_rx_ring[data_rx_tail & DATA_RX_RING_MASK];
+        data_rx_tail = (uint16_t)(data_rx_tail + 1U);
+        if (Module_Mux_RxByte(byte)) {
+            Module_Mode_EnterCommand();
+            return;
+        }
+    }
+    
+    Module_Mux_Service();
+    
+    if (data_rx_tail != data_rx_head) {
+        UTIL_SEQ_SetTask(1U << CFG_TASK_DATA_MODE_ID, CFG_SCH_PRIO_RT);
+    }
+}
+
+/**
+ * @brief Data mode task: drain RX ring, detect escape, flush to GATT
+ */
+static void Module_Mode_DataTask(void)
+{
+    uint32_t now, idle, age, quiet, wait;
+    uint16_t pending, limit, slot;
+    uint8_t partial;
+    
+    if (uart_tx_retry) {
+        uart_tx_retry = 0;
+        Module_Mode_UartTxKick();
+    }
+    
+    if (current_mode == MODE_MUX) {
+        Module_Mode_MuxTask();
+        return;
+    }
     
-    /* Only forward if in data mode and target matches */
     if (current_mode != MODE_DATA) {
+        data_rx_tail = data_rx_head;
         return;
     }
     
-    dev = BLE_DeviceManager_GetDevice(target_dev_idx);
-    if (dev == NULL || dev->conn_handle != conn_handle) {
+    /* Compact: move unsent bytes to the front */
+    if (data_tx_sent > 0) {
+        memmove(data_tx_buffer, &data_tx_buffer[data_tx_sent], data_tx_len - data_tx_sent);
+        data_tx_len = (uint16_t)(data_tx_len - data_tx_sent);
+        data_tx_sent = 0;
+    }
+    
+    /* Leave room for held escape characters released by the next byte */
+    limit = Module_Mode_BufferLimit();
+    while (data_rx_tail != data_rx_head && data_tx_len < limit) {
+        slot = data_rx_tail & DATA_RX_RING_MASK;
+        Module_Mode_ProcessDataByte(data_rx_ring[slot], (data_rx_gap[slot >> 3] >> (slot & 7U)) & 1U);
+        data_rx_tail = (uint16_t)(data_rx_tail + 1U);
+    }
+    
+    /* Guard time elapsed after the last held + with no byte in between. Bytes
+       still queued behind it (buffer full) cancel it once processed */
+    if (escape_timer_fired && data_rx_tail == data_rx_head) {
+        escape_timer_fired = 0;
+        if (escape_detected) {
+            Module_Mode_EscapeCancel();
+            Module_Mode_EnterCommand();
+            return;
+        }
+        /* Partial escape followed by silence was data after all */
+        Module_Mode_EscapeRelease();
+    }
+    
+    /* CoC: RX credits held back until the UART ring has room for the K-frames */
+    if (data_tx_mode == DATA_TX_COC && BLE_L2cap_Service()) {
+        HW_TS_Stop(data_timer_id);
+        HW_TS_Start(data_timer_id, MODE_MS_TO_TS(DATA_COC_CREDIT_POLL_MS));
+    }
+    
+    if (data_write_in_flight || data_pool_wait) {
+        /* Blocked on an acked write or TX pool credits: the event reschedules us */
         return;
     }
     
-    if (handle != target_char_handle) {
+    /* Full packets go at once; a partial packet waits for a policy trigger */
+    now = HAL_GetTick();
+    idle = now - data_rx_last_tick;
+    age = now - data_tx_first_tick;
+    quiet = now - data_stat_last_tick;
+    pending = (uint16_t)(data_tx_len - data_tx_sent);
+    
+    if (pending > 0) {
+        partial = (age >= flush_policy.latency_ms) ||
+                  (flush_policy.idle_ms > 0 && idle >= flush_policy.idle_ms) ||
+                  (flush_policy.nagle && (data_stat_packets == 0 || quiet >= flush_policy.latency_ms)) ||
+                  (data_tx_len + (20U - ESCAPE_SEQ_LENGTH) >= limit);
+        Module_Mode_SendPackets(partial);
+    }
+    
+    if (current_mode != MODE_DATA || data_write_in_flight || data_pool_wait) {
         return;
     }
     
-    /* Forward data to UART */
-    HAL_UART_Transmit(&hlpuart1, (uint8_t*)data, len, 100);
+    if (data_rx_tail != data_rx_head || data_tx_sent > 0) {
+        UTIL_SEQ_SetTask(1U << CFG_TASK_DATA_MODE_ID, CFG_SCH_PRIO_RT);
+    } else if (data_tx_len > 0) {
+        /* Sleep until the earliest partial-packet deadline */
+        wait = Module_Mode_Remaining(age, flush_policy.latency_ms);
+        if (flush_policy.idle_ms > 0 && Module_Mode_Remaining(idle, flush_policy.idle_ms) < wait) {
+            wait = Module_Mode_Remaining(idle, flush_policy.idle_ms);
+        }
+        if (flush_policy.nagle && Module_Mode_Remaining(quiet, flush_policy.latency_ms) < wait) {
+            wait = Module_Mode_Remaining(quiet, flush_policy.latency_ms);
+        }
+        HW_TS_Stop(data_timer_id);
+        HW_TS_Start(data_timer_id, MODE_MS_TO_TS((wait > 0U) ? wait : 1U));
+    }
 }
 
-uint8_t Module_Mode_IsEscapeDetected(void)
+uint8_t Module_Mode_OnProcComplete(uint16_t conn_handle, uint8_t error_code)
 {
-    uint32_t current_time = HAL_GetTick();
+    if (current_mode == MODE_MUX) {
+        return Module_Mux_OnProcComplete(conn_handle, error_code);
+    }
     
-    if (escape_detected) {
-        /* Check trailing guard time */
-        if ((current_time - last_char_time) >= ESCAPE_GUARD_TIME_MS) {
-            /* Valid escape sequence with trailing guard time */
-            escape_detected = 0;
-            escape_count = 0;
-            return 1;
-        }
+    if (!data_write_in_flight || conn_handle != data_write_conn) {
+        return 0;
+    }
+    
+    data_write_in_flight = 0;
+    if (error_code != 0) {
+        data_stat_errors++;
+        DEBUG_ERROR("Data TX error: 0x%02X", error_code);
+    }
+    
+    UTIL_SEQ_SetTask(1U << CFG_TASK_DATA_MODE_ID, CFG_SCH_PRIO_RT);
+    return 1;
+}
+
+void Module_Mode_OnTxPoolAvailable(uint16_t conn_handle)
+{
+    if (current_mode == MODE_MUX) {
+        Module_Mux_OnTxPoolAvailable(conn_handle);
+        return;
+    }
+    
+    if (data_pool_wait && conn_handle == data_write_conn) {
+        data_pool_wait = 0;
+        UTIL_SEQ_SetTask(1U << CFG_TASK_DATA_MODE_ID, CFG_SCH_PRIO_RT);
+    }
+}
+
+void Module_Mode_OnConnected(uint8_t dev_idx, uint16_t conn_handle)
+{
+    Module_Mux_OnConnected(dev_idx, conn_handle);
+}
+
+void Module_Mode_OnDisconnected(uint16_t conn_handle)
+{
+    if (current_mode == MODE_MUX) {
+        Module_Mux_OnDisconnected(conn_handle);
+        return;
+    }
+    
+    if (current_mode == MODE_DATA && conn_handle == data_write_conn) {
+        /* No completion or credits will come: let the task exit data mode */
+        data_write_in_flight = 0;
+        data_pool_wait = 0;
+        UTIL_SEQ_SetTask(1U << CFG_TASK_DATA_MODE_ID, CFG_SCH_PRIO_RT);
+    }
+}
+
+uint16_t Module_Mode_GetChunkSize(void)
+{
+    BLE_Device_t *dev;
+    uint16_t mtu;
+    
+    if (data_tx_mode == DATA_TX_COC) {
+        /* One SDU per chunk; the channel segments it into K-frames */
+        mtu = BLE_L2cap_GetSduMax(target_coc_ch);
+        return (mtu > 0U && mtu < DATA_TX_BUFFER_SIZE) ? mtu : DATA_TX_BUFFER_SIZE;
+    }
+    
+    dev = BLE_DeviceManager_GetDevice(target_dev_idx);
+    mtu = (dev != NULL) ? dev->att_mtu : BLE_ATT_DEFAULT_MTU;
+    
+    /* ATT Write Command/Request header: opcode + handle */
+    return (uint16_t)(mtu - 3U);
+}
+
+int Module_Mode_SetFlushPolicy(const Data_FlushPolicy_t *policy)
+{
+    if (policy == NULL || policy->latency_ms == 0 || policy->nagle > 1U) {
+        return -1;
     }
     
+    flush_policy = *policy;
+    DEBUG_INFO("Flush policy: max=%u latency=%u idle=%u nagle=%u", policy->max_bytes,
+               policy->latency_ms, policy->idle_ms, policy->nagle);
     return 0;
 }
 
+const Data_FlushPolicy_t* Module_Mode_GetFlushPolicy(void)
+{
+    return &flush_policy;
+}
+
+void Module_Mode_ReportStats(void)
+{
+    uint32_t ms = data_stat_last_tick - data_stat_first_tick;
+    uint32_t kbps = (ms > 0) ? ((data_stat_bytes * 8U) / ms) : 0U;
+    
+    AT_Response_Send("+DATASTAT:%s,%lu,%lu,%lu,%lu,%lu,%lu,%u,%lu,%lu\r\n",
+                     (data_tx_mode == DATA_TX_ACKED) ? "ACK" :
+                     (data_tx_mode == DATA_TX_COC) ? "COC" : "NORESP",
+                     data_stat_bytes, data_stat_packets, kbps, data_stat_pool_waits,
+                     data_stat_errors, data_rx_overflow, Module_Mode_GetChunkSize(),
+                     data_stat_down_bytes, data_stat_down_drops);
+}
+
+uint8_t Module_Mode_ProcessGATTData(uint16_t conn_handle, uint16_t handle, 
+                                    const uint8_t *data, uint16_t len)
+{
+    BLE_Device_t *dev;
+    uint16_t written;
+    
+    if (current_mode == MODE_MUX) {
+        return Module_Mux_OnNotification(conn_handle, handle, data, len);
+    }
+    
+    /* Only forward if in data mode and target matches */
+    if (current_mode != MODE_DATA || handle != target_rx_handle) {
+        return 0;
+    }
+    
+    dev = BLE_DeviceManager_GetDevice(target_dev_idx);
+    if (dev == NULL || dev->conn_handle != conn_handle) {
+        return 0;
+    }
+    
+    if (data_comp_down) {
+        Module_Mode_UartWriteCompressed(data, len);
+        return 1;
+    }
+    
+    /* Raw bytes, no framing: the peer cannot be paced, so overflow is dropped */
+    written = Module_Mode_UartWrite(data, len);
+    data_stat_down_bytes += written;
+    data_stat_down_drops += (uint32_t)(len - written);
+    return 1;
+}
+
+uint16_t Module_Mode_UartWrite(const uint8_t *data, uint16_t len)
+{
+    uint16_t head = uart_tx_head;
+    uint16_t space = (uint16_t)(UART_TX_RING_SIZE - (uint16_t)(head - uart_tx_tail));
+    uint16_t i;
+    
+    if (len > space) {
+        len = space;
+    }
+    
+    for (i = 0; i < len; i++) {
+        uart_tx_ring[(head + i) & UART_TX_RING_MASK] = data[i];
+    }
+    uart_tx_head = (uint16_t)(head + len);
+    
+    Module_Mode_UartTxKick();
+    return len;
+}
+
+uint16_t Module_Mode_UartTxFree(void)
+{
+    return (uint16_t)(UART_TX_RING_SIZE - (uint16_t)(uart_tx_head - uart_tx_tail));
+}
+
+void Module_Mode_UartTxNotify(void)
+{
+    uart_tx_notify = 1;
+}
+
+uint8_t Module_Mode_UartTxPending(void)
+{
+    return (uart_tx_busy || uart_tx_head != uart_tx_tail) ? 1U : 0U;
+}
+
 uint8_t Module_Mode_GetTargetDevice(void)
 {
     return target_dev_idx;
@@ -216,40 +834,101 @@ uint16_t Module_Mode_GetTargetHandle(void)
 }
 
 int Module_Mode_FlushTxBuffer(void)
+{
+    return Module_Mode_SendPackets(1);
+}
+
+/**
+ * @brief Write buffered bytes in ATT_MTU-3 packets (or CoC SDUs)
+ * @param partial 0 = stop before a packet smaller than the flush threshold
+ */
+static int Module_Mode_SendPackets(uint8_t partial)
 {
     BLE_Device_t *dev;
+    uint16_t chunk_max, chunk, threshold;
+    uint16_t start = data_tx_sent;
     int ret;
     
-    if (data_tx_len == 0) {
+    if (data_tx_sent >= data_tx_len || data_write_in_flight || data_pool_wait) {
         return 0;
     }
     
     if (current_mode != MODE_DATA) {
         data_tx_len = 0;
+        data_tx_sent = 0;
         return 0;
     }
     
-    /* Get target device */
+    /* Get target device (or channel) */
     dev = BLE_DeviceManager_GetDevice(target_dev_idx);
-    if (dev == NULL || !dev->is_connected) {
+    if ((data_tx_mode == DATA_TX_COC) ? !BLE_L2cap_IsOpen(target_coc_ch)
+                                      : (dev == NULL || !dev->is_connected)) {
         DEBUG_ERROR("Data mode target disconnected");
         data_tx_len = 0;
+        data_tx_sent = 0;
         /* Auto-exit data mode on disconnect */
         Module_Mode_EnterCommand();
         return -1;
     }
     
-    /* Write to GATT characteristic */
-    ret = BLE_GATT_WriteCharacteristic(dev->conn_handle, target_char_handle, 
-                                       data_tx_buffer, data_tx_len);
+    data_write_conn = (data_tx_mode == DATA_TX_COC) ? BLE_L2cap_GetConnHandle(target_coc_ch)
+                                                    : dev->conn_handle;
+    chunk_max = Module_Mode_GetChunkSize();
+    threshold = Module_Mode_FlushThreshold();
     
-    if (ret == 0) {
-        DEBUG_PRINT("Data TX: %d bytes", data_tx_len);
-        data_tx_len = 0;
-        return data_tx_len;
-    } else {
-        DEBUG_ERROR("Data TX failed");
+    /* Split into ATT_MTU-3 packets: one acked write, or as many commands as credits allow */
+    while (data_tx_sent < data_tx_len) {
+        chunk = (uint16_t)(data_tx_len - data_tx_sent);
+        if (chunk > chunk_max) {
+            chunk = chunk_max;
+        }
+        if (chunk < threshold && !partial) {
+            break;
+        }
+        
+        if (data_tx_mode == DATA_TX_COC) {
+            /* 1 = previous SDU still waiting for credits: same wait as the TX pool */
+            ret = BLE_L2cap_Send(target_coc_ch, &data_tx_buffer[data_tx_sent], chunk);
+        } else if (data_tx_mode == DATA_TX_ACKED) {
+            ret = BLE_GATT_WriteCharacteristic(dev->conn_handle, target_char_handle,
+                                               &data_tx_buffer[data_tx_sent], chunk);
+        } else {
+            ret = BLE_GATT_TryWriteNoResp(dev->conn_handle, target_char_handle,
+                                          &data_tx_buffer[data_tx_sent], chunk);
+        }
+        
+        if (ret == 1) {
+            /* TX pool full: resume on ACI_GATT_TX_POOL_AVAILABLE (or SDU sent) */
+            data_pool_wait = 1;
+            data_stat_pool_waits++;
+            break;
+        }
+        if (ret != 0) {
+            DEBUG_ERROR("Data TX failed");
+            data_stat_errors++;
+            data_tx_len = 0;
+            data_tx_sent = 0;
+            return -1;
+        }
+        
+        if (data_stat_packets == 0) {
+            data_stat_first_tick = HAL_GetTick();
+        }
+        data_stat_packets++;
+        data_stat_bytes += chunk;
+        data_stat_last_tick = HAL_GetTick();
+        data_tx_sent = (uint16_t)(data_tx_sent + chunk);
+        
+        if (data_tx_mode == DATA_TX_ACKED) {
+            data_write_in_flight = 1;
+            break;
+        }
+    }
+    
+    ret = (int)(data_tx_sent - start);
+    if (data_tx_sent >= data_tx_len) {
         data_tx_len = 0;
-        return -1;
+        data_tx_sent = 0;
     }
+    return ret;
 }
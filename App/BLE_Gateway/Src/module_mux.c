@@ -0,0 +1,622 @@
+/**
+  ******************************************************************************
+  * @file    module_mux.c
+  * @brief   Multiplexed data mode implementation
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#define DEBUG_MODULE DEBUG_MOD_DATA
+
+#include "module_mux.h"
+#include "module_mode.h"
+#include "module_compress.h"
+#include "module_crc.h"
+#include "ble_device_manager.h"
+#include "ble_gatt_client.h"
+#include "at_command.h"
+#include "debug_trace.h"
+#include "app_conf.h"
+#include "stm32_seq.h"
+#include <string.h>
+
+/*============================================================================
+ * State
+ *============================================================================*/
+#define MUX_CRC_SIZE            4U
+#define MUX_FRAME_MAX           (2U + MUX_MAX_PAYLOAD + MUX_CRC_SIZE)
+#define MUX_ENCODED_MAX         (MUX_FRAME_MAX + 2U)    /* Code byte + delimiter */
+#define MUX_HIGH_WATER          (MUX_LINK_BUFFER_SIZE - 2U * MUX_MAX_PAYLOAD)
+#define MUX_LOW_WATER           (MUX_LINK_BUFFER_SIZE / 4U)
+
+#if COMPRESS_BOUND(COMPRESS_BLOCK_MAX) > MUX_MAX_PAYLOAD
+#error "A compressed block must fit one mux frame"
+#endif
+
+typedef struct {
+    uint8_t bound;
+    uint8_t tx_mode;                /* Data_TxMode_t */
+    uint8_t in_flight;              /* Acked write outstanding */
+    uint8_t pool_wait;              /* Waiting for TX pool credits */
+    uint8_t xoff;                   /* Host told to pause (XOFF queued to UART) */
+    uint8_t down_pending;           /* DOWN not yet queued to UART */
+    uint16_t tx_handle;
+    uint16_t rx_handle;
+    uint16_t conn_handle;
+    uint16_t len;                   /* [sent, len) not yet written */
+    uint16_t sent;
+    uint32_t up_bytes;
+    uint32_t down_bytes;
+    uint32_t up_drops;
+    uint32_t down_drops;
+    uint32_t pool_waits;
+    uint32_t errors;
+    uint8_t buf[MUX_LINK_BUFFER_SIZE];
+} MuxLink_t;
+
+static MuxLink_t links[MUX_MAX_LINKS];
+static uint8_t mux_active = 0;
+static uint32_t mux_bad_frames = 0;
+
+/* Streaming COBS decoder */
+static uint8_t rx_frame[MUX_FRAME_MAX];
+static uint16_t rx_len = 0;
+static uint8_t rx_code = 0;
+static uint8_t rx_left = 0;
+static uint8_t rx_error = 0;
+
+/*============================================================================
+ * Static Helper Functions
+ *============================================================================*/
+
+static uint16_t Mux_CobsEncode(const uint8_t *in, uint16_t len, uint8_t *out)
+{
+    uint16_t code_pos = 0;
+    uint16_t o = 1;
+    uint16_t i;
+    uint8_t code = 1;
+
+    for (i = 0; i < len; i++) {
+        if (in[i] == 0) {
+            out[code_pos] = code;
+            code_pos = o++;
+            code = 1;
+        } else {
+            out[o++] = in[i];
+            code++;
+            if (code == 0xFFU) {
+                out[code_pos] = code;
+                code_pos = o++;
+                code = 1;
+            }
+        }
+    }
+    out[code_pos] = code;
+    out[o++] = 0x00;
+    return o;
+}
+
+/**
+ * @brief Encode and queue a frame to UART, whole or not at all
+ * @return 0 if queued, -1 if the UART TX ring is full
+ */
+static int Mux_SendFrame(uint8_t link, const uint8_t *payload, uint8_t len)
+{
+    uint8_t frame[MUX_FRAME_MAX];
+    uint8_t encoded[MUX_ENCODED_MAX];
+    uint16_t n;
+
+    uint32_t crc;
+
+    frame[0] = link;
+    frame[1] = len;
+    memcpy(&frame[2], payload, len);
+    crc = Module_Crc32(frame, len + 2U);
+    memcpy(&frame[2U + len], &crc, MUX_CRC_SIZE);
+    n = Mux_CobsEncode(frame, (uint16_t)(len + 2U + MUX_CRC_SIZE), encoded);
+
+    /* A partial frame would desynchronize the host decoder */
+    if (Module_Mode_UartTxFree() < n) {
+        return -1;
+    }
+    Module_Mode_UartWrite(encoded, n);
+    return 0;
+}
+
+static int Mux_SendState(uint8_t link, Mux_LinkState_t state)
+{
+    uint8_t ctrl[2];
+
+    ctrl[0] = link;
+    ctrl[1] = (uint8_t)state;
+    return Mux_SendFrame(MUX_LINK_CTRL, ctrl, sizeof(ctrl));
+}
+
+/**
+ * @brief Tell the host the link state it has not been told yet
+ * @note  State changes only once its frame is queued; a frame that did not
+ *        fit the UART TX ring is retried by Module_Mux_Service
+ */
+static void Mux_UpdateFlow(uint8_t link, MuxLink_t *l)
+{
+    uint16_t left = (uint16_t)(l->len - l->sent);
+
+    if (l->down_pending) {
+        if (Mux_SendState(link, MUX_STATE_DOWN) != 0) {
+            Module_Mode_UartTxNotify();
+            return;
+        }
+        l->down_pending = 0;
+    }
+
+    if (!l->xoff && left >= MUX_HIGH_WATER) {
+        if (Mux_SendState(link, MUX_STATE_XOFF) == 0) {
+            l->xoff = 1;
+        } else {
+            Module_Mode_UartTxNotify();
+        }
+    } else if (l->xoff && left <= MUX_LOW_WATER) {
+        if (Mux_SendState(link, MUX_STATE_XON) == 0) {
+            l->xoff = 0;
+        } else {
+            Module_Mode_UartTxNotify();
+        }
+    }
+}
+
+/**
+ * @brief Compress a notification into frames, whole or not at all
+ * @note  A dropped block would desynchronize the host decoder
+ */
+static void Mux_SendCompressed(uint8_t link, MuxLink_t *l, const uint8_t *data, uint16_t len)
+{
+    uint8_t packed[COMPRESS_BOUND(COMPRESS_BLOCK_MAX)];
+    uint16_t blocks = (uint16_t)((len + COMPRESS_BLOCK_MAX - 1U) / COMPRESS_BLOCK_MAX);
+    uint16_t n;
+
+    if (Module_Mode_UartTxFree() < (uint32_t)blocks * MUX_ENCODED_MAX) {
+        l->down_drops += len;
+        return;
+    }
+
+    while (len > 0) {
+        n = (len > COMPRESS_BLOCK_MAX) ? COMPRESS_BLOCK_MAX : len;
+        Mux_SendFrame(link, packed, (uint8_t)Module_Compress_Encode(link, data, n, packed));
+        l->down_bytes += n;
+        data += n;
+        len = (uint16_t)(len - n);
+    }
+}
+
+static void Mux_ResetLink(MuxLink_t *l)
+{
+    l->in_flight = 0;
+    l->pool_wait = 0;
+    l->xoff = 0;
+    l->down_pending = 0;
+    l->len = 0;
+    l->sent = 0;
+}
+
+/**
+ * @brief Append a host frame payload to its link buffer
+ */
+static void Mux_Enqueue(uint8_t link, const uint8_t *data, uint8_t len)
+{
+    MuxLink_t *l;
+    BLE_Device_t *dev;
+    uint16_t room, n;
+
+    if (link >= MUX_MAX_LINKS || !links[link].bound) {
+        mux_bad_frames++;
+        return;
+    }
+    l = &links[link];
+
+    dev = BLE_DeviceManager_GetDevice(link);
+    if (dev == NULL || !dev->is_connected) {
+        l->up_drops += len;
+        return;
+    }
+
+    if (l->sent > 0) {
+        memmove(l->buf, &l->buf[l->sent], l->len - l->sent);
+        l->len = (uint16_t)(l->len - l->sent);
+        l->sent = 0;
+    }
+
+    if (Module_Compress_IsEnabled(link, COMPRESS_UP)) {
+        /* Overflow is dropped after decoding so the window stays in step */
+        room = (uint16_t)(MUX_LINK_BUFFER_SIZE - l->len);
+        n = Module_Compress_Decode(link, data, len, &l->buf[l->len], room);
+        if (n > room) {
+            l->up_drops += (uint32_t)(n - room);
+            n = room;
+        }
+        l->len = (uint16_t)(l->len + n);
+    } else {
+        if ((uint32_t)l->len + len > MUX_LINK_BUFFER_SIZE) {
+            l->up_drops += len;
+            return;
+        }
+        memcpy(&l->buf[l->len], data, len);
+        l->len = (uint16_t)(l->len + len);
+    }
+
+    Mux_UpdateFlow(link, l);
+}
+
+/**
+ * @brief Handle one decoded frame
+ * @return 1 if exit requested
+ */
+static uint8_t Mux_OnFrame(const uint8_t *frame, uint16_t len)
+{
+    uint32_t crc;
+
+    if (len < 2U + MUX_CRC_SIZE || frame[1] != (uint8_t)(len - 2U - MUX_CRC_SIZE)) {
+        mux_bad_frames++;
+        return 0;
+    }
+
+    memcpy(&crc, &frame[len - MUX_CRC_SIZE], MUX_CRC_SIZE);
+    if (Module_Crc32(frame, len - MUX_CRC_SIZE) != crc) {
+        mux_bad_frames++;
+        return 0;
+    }
+
+    if (frame[0] == MUX_LINK_CTRL) {
+        if (frame[1] == 1U && frame[2] == MUX_CTRL_EXIT) {
+            return 1;
+        }
+        mux_bad_frames++;
+        return 0;
+    }
+
+    if (frame[1] > 0U) {
+        Mux_Enqueue(frame[0], &frame[2], frame[1]);
+    }
+    return 0;
+}
+
+/**
+ * @brief Write one link's buffer in ATT_MTU-3 packets
+ */
+static void Mux_Flush(uint8_t link)
+{
+    MuxLink_t *l = &links[link];
+    BLE_Device_t *dev;
+    uint16_t chunk_max, chunk;
+    int ret;
+
+    dev = BLE_DeviceManager_GetDevice(link);
+    if (dev == NULL || !dev->is_connected) {
+        l->up_drops += (uint32_t)(l->len - l->sent);
+        Mux_ResetLink(l);
+        return;
+    }
+
+    l->conn_handle = dev->conn_handle;
+    chunk_max = (uint16_t)(dev->att_mtu - 3U);
+
+    while (l->sent < l->len) {
+        chunk = (uint16_t)(l->len - l->sent);
+        if (chunk > chunk_max) {
+            chunk = chunk_max;
+        }
+
+        if (l->tx_mode == DATA_TX_ACKED) {
+            ret = BLE_GATT_WriteCharacteristic(dev->conn_handle, l->tx_handle,
+                                               &l->buf[l->sent], chunk);
+        } else {
+            ret = BLE_GATT_TryWriteNoResp(dev->conn_handle, l->tx_handle,
+                                          &l->buf[l->sent], chunk);
+        }
+
+        if (ret == 1) {
+            l->pool_wait = 1;
+            l->pool_waits++;
+            break;
+        }
+        if (ret != 0) {
+            l->errors++;
+            l->up_drops += (uint32_t)(l->len - l->sent);
+            l->len = 0;
+            l->sent = 0;
+            break;
+        }
+
+        l->up_bytes += chunk;
+        l->sent = (uint16_t)(l->sent + chunk);
+
+        if (l->tx_mode == DATA_TX_ACKED) {
+            l->in_flight = 1;
+            break;
+        }
+    }
+
+    if (l->sent >= l->len) {
+        l->len = 0;
+        l->sent = 0;
+    }
+
+    Mux_UpdateFlow(link, l);
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+void Module_Mux_Init(void)
+{
+    memset(links, 0, sizeof(links));
+    mux_active = 0;
+    DEBUG_INFO("Mux initialized");
+}
+
+int Module_Mux_Bind(uint8_t link, uint16_t tx_handle, uint16_t rx_handle, Data_TxMode_t tx_mode)
+{
+    MuxLink_t *l;
+
+    if (link >= MUX_MAX_LINKS || tx_mode > DATA_TX_ACKED) {
+        return -1;
+    }
+    l = &links[link];
+
+    if (tx_handle == 0) {
+        l->bound = 0;
+        Mux_ResetLink(l);
+        return 0;
+    }
+
+    l->tx_handle = tx_handle;
+    l->rx_handle = (rx_handle != 0) ? rx_handle : tx_handle;
+    l->tx_mode = (uint8_t)tx_mode;
+    l->bound = 1;
+
+    DEBUG_INFO("Mux link %d: tx=0x%04X rx=0x%04X mode=%d", link, tx_handle, l->rx_handle, tx_mode);
+    return 0;
+}
+
+int Module_Mux_Start(void)
+{
+    uint8_t i, any = 0;
+    MuxLink_t *l;
+    BLE_Device_t *dev;
+
+    for (i = 0; i < MUX_MAX_LINKS; i++) {
+        l = &links[i];
+        dev = BLE_DeviceManager_GetDevice(i);
+        Mux_ResetLink(l);
+        l->conn_handle = (dev != NULL && dev->is_connected) ? dev->conn_handle : 0xFFFFU;
+        l->up_bytes = 0;
+        l->down_bytes = 0;
+        l->up_drops = 0;
+        l->down_drops = 0;
+        l->pool_waits = 0;
+        l->errors = 0;
+        any |= l->bound;
+    }
+
+    if (!any) {
+        return -1;
+    }
+
+    rx_len = 0;
+    rx_left = 0;
+    rx_code = 0;
+    rx_error = 0;
+    mux_bad_frames = 0;
+    Module_Compress_Reset();
+    mux_active = 1;
+    return 0;
+}
+
+void Module_Mux_Stop(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < MUX_MAX_LINKS; i++) {
+        Mux_ResetLink(&links[i]);
+    }
+    mux_active = 0;
+}
+
+uint8_t Module_Mux_RxByte(uint8_t byte)
+{
+    uint8_t exit_req = 0;
+
+    if (byte == 0x00U) {
+        /* Delimiter: a complete frame ends exactly at a block boundary */
+        if (rx_len > 0 && !rx_error && rx_left == 0) {
+            exit_req = Mux_OnFrame(rx_frame, rx_len);
+        } else if (rx_len > 0 || rx_error) {
+            mux_bad_frames++;
+        }
+        rx_len = 0;
+        rx_code = 0;
+        rx_left = 0;
+        rx_error = 0;
+        return exit_req;
+    }
+
+    if (rx_error) {
+        return 0;
+    }
+
+    if (rx_left == 0) {
+        /* Code byte: the previous block ended with an implicit zero unless it was full */
+        if (rx_code != 0 && rx_code != 0xFFU) {
+            if (rx_len >= MUX_FRAME_MAX) {
+                rx_error = 1;
+                return 0;
+            }
+            rx_frame[rx_len++] = 0x00;
+        }
+        rx_code = byte;
+        rx_left = (uint8_t)(byte - 1U);
+        return 0;
+    }
+
+    if (rx_len >= MUX_FRAME_MAX) {
+        rx_error = 1;
+        return 0;
+    }
+    rx_frame[rx_len++] = byte;
+    rx_left--;
+    return 0;
+}
+
+void Module_Mux_Service(void)
+{
+    uint8_t i;
+    MuxLink_t *l;
+
+    if (!mux_active) {
+        return;
+    }
+
+    for (i = 0; i < MUX_MAX_LINKS; i++) {
+        l = &links[i];
+        if (!l->bound) {
+            continue;
+        }
+        if (l->sent < l->len && !l->in_flight && !l->pool_wait) {
+            Mux_Flush(i);
+        } else {
+            /* Control frames that did not fit the UART TX ring last time */
+            Mux_UpdateFlow(i, l);
+        }
+    }
+}
+
+uint8_t Module_Mux_OnNotification(uint16_t conn_handle, uint16_t handle,
+                                  const uint8_t *data, uint16_t len)
+{
+    uint8_t i;
+    uint8_t n;
+    MuxLink_t *l;
+    BLE_Device_t *dev;
+
+    if (!mux_active) {
+        return 0;
+    }
+
+    for (i = 0; i < MUX_MAX_LINKS; i++) {
+        l = &links[i];
+        if (!l->bound || l->rx_handle != handle) {
+            continue;
+        }
+        dev = BLE_DeviceManager_GetDevice(i);
+        if (dev == NULL || dev->conn_handle != conn_handle) {
+            continue;
+        }
+
+        l->conn_handle = conn_handle;
+
+        if (Module_Compress_IsEnabled(i, COMPRESS_DOWN)) {
+            Mux_SendCompressed(i, l, data, len);
+            return 1;
+        }
+
+        while (len > 0) {
+            n = (len > MUX_MAX_PAYLOAD) ? MUX_MAX_PAYLOAD : (uint8_t)len;
+            if (Mux_SendFrame(i, data, n) == 0) {
+                l->down_bytes += n;
+            } else {
+                l->down_drops += n;
+            }
+            data += n;
+            len = (uint16_t)(len - n);
+        }
+        return 1;
+    }
+
+    return 0;
+}
+
+uint8_t Module_Mux_OnProcComplete(uint16_t conn_handle, uint8_t error_code)
+{
+    uint8_t i;
+    MuxLink_t *l;
+
+    for (i = 0; i < MUX_MAX_LINKS; i++) {
+        l = &links[i];
+        if (l->in_flight && l->conn_handle == conn_handle) {
+            l->in_flight = 0;
+            if (error_code != 0) {
+                l->errors++;
+            }
+            UTIL_SEQ_SetTask(1U << CFG_TASK_DATA_MODE_ID, CFG_SCH_PRIO_RT);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void Module_Mux_OnTxPoolAvailable(uint16_t conn_handle)
+{
+    uint8_t i;
+    uint8_t wake = 0;
+
+    (void)conn_handle;
+
+    /* The TX pool is shared by all links: any credit may unblock each of them */
+    for (i = 0; i < MUX_MAX_LINKS; i++) {
+        if (links[i].pool_wait) {
+            links[i].pool_wait = 0;
+            wake = 1;
+        }
+    }
+
+    if (wake) {
+        UTIL_SEQ_SetTask(1U << CFG_TASK_DATA_MODE_ID, CFG_SCH_PRIO_RT);
+    }
+}
+
+void Module_Mux_OnConnected(uint8_t link, uint16_t conn_handle)
+{
+    /* Disconnects are matched on it: a link may connect after the session
+       started and only ever carry notifications */
+    if (link < MUX_MAX_LINKS) {
+        links[link].conn_handle = conn_handle;
+    }
+}
+
+void Module_Mux_OnDisconnected(uint16_t conn_handle)
+{
+    uint8_t i;
+    MuxLink_t *l;
+
+    if (!mux_active) {
+        return;
+    }
+
+    for (i = 0; i < MUX_MAX_LINKS; i++) {
+        l = &links[i];
+        if (l->bound && l->conn_handle == conn_handle) {
+            l->up_drops += (uint32_t)(l->len - l->sent);
+            Mux_ResetLink(l);
+            l->conn_handle = 0xFFFFU;
+            l->down_pending = 1;
+            Mux_UpdateFlow(i, l);
+        }
+    }
+}
+
+void Module_Mux_Report(void)
+{
+    uint8_t i;
+    const MuxLink_t *l;
+
+    AT_Response_Send("+MUX:%d,%lu\r\n", mux_active, mux_bad_frames);
+
+    for (i = 0; i < MUX_MAX_LINKS; i++) {
+        l = &links[i];
+        if (l->bound) {
+            AT_Response_Send("+MUXS:%d,0x%04X,0x%04X,%d,%lu,%lu,%lu,%lu,%lu,%lu\r\n", i,
+                             l->tx_handle, l->rx_handle, l->tx_mode, l->up_bytes,
+                             l->down_bytes, l->up_drops, l->down_drops, l->pool_waits,
+                             l->errors);
+        }
+    }
+}
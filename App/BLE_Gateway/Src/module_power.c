@@ -6,6 +6,8 @@
   ******************************************************************************
   */
 
+#define DEBUG_MODULE DEBUG_MOD_SYS
+
 #include "module_power.h"
 #include "debug_trace.h"
 #include "main.h"
@@ -0,0 +1,367 @@
+/**
+  ******************************************************************************
+  * @file    module_prof.c
+  * @brief   Sequencer task and ISR profiler implementation
+  * @author  BLE Gateway
+  ******************************************************************************
+  */
+
+#include "module_prof.h"
+#include "at_command.h"
+#include "main.h"
+#include <string.h>
+
+/*============================================================================
+ * State
+ *============================================================================*/
+typedef struct {
+    uint32_t runs;
+    uint64_t cycles;                /* Self time */
+    uint32_t max_cycles;
+    uint32_t max_latency;
+    uint32_t set_at;                /* CYCCNT of the first SetTask while not pending */
+    uint8_t pending;
+    uint8_t prio;                   /* Highest class requested while pending */
+} Prof_Task_t;
+
+typedef struct {
+    uint32_t runs;
+    uint32_t max_latency;
+    uint32_t buckets[PROF_LAT_BUCKETS];
+} Prof_Class_t;
+
+typedef struct {
+    uint32_t count;
+    uint64_t cycles;
+    uint32_t max_cycles;
+} Prof_IsrStat_t;
+
+typedef struct {
+    uint32_t idx;
+    uint32_t start;
+    uint32_t nested;
+} Prof_Frame_t;
+
+static Prof_Task_t prof_tasks[PROF_TASK_NBR];
+static Prof_IsrStat_t prof_isrs[PROF_ISR_NBR];
+static Prof_Class_t prof_classes[CFG_SCH_PRIO_NBR];
+
+/* Running task runs, innermost last (UTIL_SEQ_WaitEvt runs tasks inside a task) */
+static Prof_Frame_t prof_stack[PROF_DEPTH];
+static uint8_t prof_depth = 0;
+static uint8_t prof_overflow = 0;   /* Frames beyond PROF_DEPTH, not measured */
+
+/* Self time of every finished task run and ISR: what an enclosing run excludes */
+static uint32_t prof_nested = 0;
+
+/* 64-bit extension of CYCCNT, advanced at every sequencer pass */
+static uint64_t prof_clock = 0;
+static uint32_t prof_clock_last = 0;
+static uint64_t prof_window_start = 0;
+static uint64_t prof_busy = 0;
+
+static const char * const prof_task_names[PROF_TASK_NBR] = {
+    [CFG_TASK_START_SCAN_ID] = "SCAN",
+    [CFG_TASK_CONN_DEV_1_ID] = "CONN",
+    [CFG_TASK_SEARCH_SERVICE_ID] = "SEARCH",
+    [CFG_TASK_CONN_UPDATE_ID] = "CONN_UPDATE",
+    [CFG_TASK_HCI_ASYNCH_EVT_ID] = "HCI_EVT",
+    [CFG_TASK_AT_CMD_PROC_ID] = "AT",
+    [CFG_TASK_GATT_FLOW_ID] = "GATT_FLOW",
+    [CFG_TASK_GATT_QUEUE_ID] = "GATT_QUEUE",
+    [CFG_TASK_DATA_MODE_ID] = "DATA_MODE",
+    [CFG_TASK_TPUT_ID] = "TPUT",
+    [CFG_TASK_HCI_CMDQ_ID] = "HCI_CMDQ",
+    [CFG_TASK_SYSTEM_HCI_ASYNCH_EVT_ID] = "SHCI_EVT",
+    [CFG_TASK_POLL_ID] = "POLL",
+    [CFG_TASK_FLASH_ID] = "FLASH",
+    [CFG_TASK_EVLOG_ID] = "EVLOG",
+    [CFG_TASK_LOG_ID] = "LOG",
+    [CFG_TASK_SCAN_REPORT_ID] = "SCAN_REPORT",
+};
+
+static const char * const prof_class_names[CFG_SCH_PRIO_NBR] = {
+    [CFG_SCH_PRIO_RT] = "RT",
+    [CFG_SCH_PRIO_CTRL] = "CTRL",
+    [CFG_SCH_PRIO_BG] = "BG",
+};
+
+static const char * const prof_isr_names[PROF_ISR_NBR] = {
+    "LPUART1", "IPCC_RX", "IPCC_TX", "RTC_WKUP"
+};
+
+/*============================================================================
+ * Static Helper Functions
+ *============================================================================*/
+
+/**
+ * @brief Advance the 64-bit clock (interrupts disabled)
+ */
+static uint64_t Prof_Clock(void)
+{
+    uint32_t now = DWT->CYCCNT;
+
+    prof_clock += (uint32_t)(now - prof_clock_last);
+    prof_clock_last = now;
+    return prof_clock;
+}
+
+static uint32_t Prof_CyclesToUs(uint64_t cycles)
+{
+    uint32_t per_us = SystemCoreClock / 1000000U;
+
+    return (uint32_t)(cycles / ((per_us > 0U) ? per_us : 1U));
+}
+
+/**
+ * @brief Latency below which pct % of the class runs started (bucket bound)
+ */
+static uint32_t Prof_ClassPercentile(const Prof_Class_t *c, uint32_t pct)
+{
+    uint32_t target = (uint32_t)(((uint64_t)c->runs * pct + 99U) / 100U);
+    uint32_t seen = 0;
+    uint32_t b;
+
+    for (b = 0; b < PROF_LAT_BUCKETS - 1U; b++) {
+        seen += c->buckets[b];
+        if (seen >= target) {
+            break;
+        }
+    }
+    /* The last bucket is open: the maximum bounds it */
+    if (b == PROF_LAT_BUCKETS - 1U || (1UL << b) > c->max_latency) {
+        return c->max_latency;
+    }
+    return 1UL << b;
+}
+
+static uint32_t Prof_CyclesToMs(uint64_t cycles)
+{
+    uint32_t per_ms = SystemCoreClock / 1000U;
+
+    return (uint32_t)(cycles / ((per_ms > 0U) ? per_ms : 1U));
+}
+
+/*============================================================================
+ * Public API
+ *============================================================================*/
+void Module_Prof_Init(void)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    /* Started here only, for every module that times work. Keep it
+       running: frames opened before Init stay consistent */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    __disable_irq();
+    prof_clock_last = DWT->CYCCNT;
+    __set_PRIMASK(primask);
+
+    Module_Prof_Reset();
+}
+
+void Module_Prof_TaskSet(uint32_t task_bm, uint32_t prio)
+{
+    uint32_t now = DWT->CYCCNT;
+    uint32_t idx;
+
+    /* Latency runs from the first request; the sequencer runs a task at the
+       highest class it was set with */
+    while (task_bm != 0U) {
+        idx = (uint32_t)__builtin_ctz(task_bm);
+        task_bm &= task_bm - 1U;
+        if (!prof_tasks[idx].pending) {
+            prof_tasks[idx].pending = 1;
+            prof_tasks[idx].set_at = now;
+            prof_tasks[idx].prio = (uint8_t)prio;
+        } else if (prio < prof_tasks[idx].prio) {
+            prof_tasks[idx].prio = (uint8_t)prio;
+        }
+    }
+}
+
+void Module_Prof_TaskStart(uint32_t task_idx)
+{
+    uint32_t primask = __get_PRIMASK();
+    uint32_t now, latency, b;
+    Prof_Task_t *t = &prof_tasks[task_idx];
+    Prof_Class_t *c;
+    Prof_Frame_t *f;
+
+    __disable_irq();
+    now = DWT->CYCCNT;
+    if (t->pending) {
+        t->pending = 0;
+        latency = now - t->set_at;
+        if (latency > t->max_latency) {
+            t->max_latency = latency;
+        }
+
+        if (t->prio < CFG_SCH_PRIO_NBR) {
+            c = &prof_classes[t->prio];
+            b = (latency == 0U) ? 0U : (32U - (uint32_t)__builtin_clz(latency));
+            c->buckets[(b < PROF_LAT_BUCKETS) ? b : (PROF_LAT_BUCKETS - 1U)]++;
+            c->runs++;
+            if (latency > c->max_latency) {
+                c->max_latency = latency;
+            }
+        }
+    }
+
+    if (prof_depth < PROF_DEPTH) {
+        f = &prof_stack[prof_depth++];
+        f->idx = task_idx;
+        f->nested = prof_nested;
+        f->start = DWT->CYCCNT;
+    } else {
+        prof_overflow++;
+    }
+    __set_PRIMASK(primask);
+}
+
+void Module_Prof_TaskEnd(uint32_t task_idx)
+{
+    uint32_t primask = __get_PRIMASK();
+    uint32_t self;
+    Prof_Task_t *t;
+    Prof_Frame_t *f;
+
+    /* The frame stack knows the task: CurrentTaskIdx may have changed */
+    (void)task_idx;
+
+    __disable_irq();
+    if (prof_overflow > 0) {
+        prof_overflow--;
+        __set_PRIMASK(primask);
+        return;
+    }
+    if (prof_depth == 0) {
+        __set_PRIMASK(primask);
+        return;
+    }
+
+    f = &prof_stack[--prof_depth];
+    self = (DWT->CYCCNT - f->start) - (prof_nested - f->nested);
+    prof_nested += self;
+    prof_busy += self;
+
+    t = &prof_tasks[f->idx];
+    t->runs++;
+    t->cycles += self;
+    if (self > t->max_cycles) {
+        t->max_cycles = self;
+    }
+    __set_PRIMASK(primask);
+}
+
+void Module_Prof_Idle(void)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    /* CYCCNT wraps in about a minute: extend it at every pass */
+    __disable_irq();
+    (void)Prof_Clock();
+    __set_PRIMASK(primask);
+}
+
+void Module_Prof_IsrEnter(Prof_IsrCtx_t *ctx)
+{
+    ctx->nested = prof_nested;
+    ctx->start = DWT->CYCCNT;
+}
+
+void Module_Prof_IsrExit(Prof_Isr_t isr, const Prof_IsrCtx_t *ctx)
+{
+    uint32_t primask = __get_PRIMASK();
+    Prof_IsrStat_t *s = &prof_isrs[isr];
+    uint32_t self;
+
+    /* Higher priority ISRs may nest: update with interrupts disabled */
+    __disable_irq();
+    self = (DWT->CYCCNT - ctx->start) - (prof_nested - ctx->nested);
+    prof_nested += self;
+    prof_busy += self;
+
+    s->count++;
+    s->cycles += self;
+    if (self > s->max_cycles) {
+        s->max_cycles = self;
+    }
+    __set_PRIMASK(primask);
+}
+
+void Module_Prof_Reset(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    uint32_t i;
+
+    __disable_irq();
+    for (i = 0; i < PROF_TASK_NBR; i++) {
+        /* A pending task keeps its request time */
+        prof_tasks[i].runs = 0;
+        prof_tasks[i].cycles = 0;
+        prof_tasks[i].max_cycles = 0;
+        prof_tasks[i].max_latency = 0;
+    }
+    memset(prof_isrs, 0, sizeof(prof_isrs));
+    memset(prof_classes, 0, sizeof(prof_classes));
+    prof_busy = 0;
+    prof_window_start = Prof_Clock();
+    __set_PRIMASK(primask);
+}
+
+void Module_Prof_Report(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    uint64_t window, busy;
+    uint32_t load, i;
+    const Prof_Task_t *t;
+    const Prof_IsrStat_t *s;
+    Prof_Class_t c;
+
+    __disable_irq();
+    window = Prof_Clock() - prof_window_start;
+    busy = prof_busy;
+    __set_PRIMASK(primask);
+
+    /* Load in 0.1 %; idle is the rest of the window */
+    load = (window > 0U) ? (uint32_t)((busy * 1000U) / window) : 0U;
+    AT_Response_Send("+PROF:%lu,%lu,%lu.%lu\r\n", Prof_CyclesToMs(window),
+                     Prof_CyclesToMs(busy), load / 10U, load % 10U);
+
+    for (i = 0; i < PROF_TASK_NBR; i++) {
+        t = &prof_tasks[i];
+        if (t->runs == 0) {
+            continue;
+        }
+        AT_Response_Send("+PROFT:%lu,%s,%lu,%lu,%lu,%lu\r\n", i,
+                         (prof_task_names[i] != 0) ? prof_task_names[i] : "?", t->runs,
+                         Prof_CyclesToUs(t->cycles), Prof_CyclesToUs(t->max_cycles),
+                         Prof_CyclesToUs(t->max_latency));
+    }
+
+    for (i = 0; i < CFG_SCH_PRIO_NBR; i++) {
+        /* Snapshot: the histogram must add up while percentiles are read */
+        __disable_irq();
+        c = prof_classes[i];
+        __set_PRIMASK(primask);
+        if (c.runs == 0) {
+            continue;
+        }
+        AT_Response_Send("+PROFP:%lu,%s,%lu,%lu,%lu,%lu\r\n", i,
+                         (prof_class_names[i] != 0) ? prof_class_names[i] : "?", c.runs,
+                         Prof_CyclesToUs(Prof_ClassPercentile(&c, 50U)),
+                         Prof_CyclesToUs(Prof_ClassPercentile(&c, 99U)),
+                         Prof_CyclesToUs(c.max_latency));
+    }
+
+    for (i = 0; i < PROF_ISR_NBR; i++) {
+        s = &prof_isrs[i];
+        if (s->count == 0) {
+            continue;
+        }
+        AT_Response_Send("+PROFI:%s,%lu,%lu,%lu\r\n", prof_isr_names[i], s->count,
+                         Prof_CyclesToUs(s->cycles), Prof_CyclesToUs(s->max_cycles));
+    }
+}
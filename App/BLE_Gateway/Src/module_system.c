@@ -6,8 +6,11 @@
   ******************************************************************************
   */
 
+#define DEBUG_MODULE DEBUG_MOD_SYS
+
 #include "module_system.h"
 #include "module_config.h"
+#include "module_flash.h"
 #include "debug_trace.h"
 #include "main.h"
 #include "ble_gap_aci.h"
@@ -82,10 +85,11 @@ int Module_System_GetBDAddr(uint8_t *addr_type, uint8_t addr[6])
 /*============================================================================
  * Reset Functions
  *============================================================================*/
-void Module_System_SoftwareReset(void)
+/**
+ * @brief Reset once the Flash writer queue is empty
+ */
+static void System_Reboot(void)
 {
-    DEBUG_WARN("Software reset requested");
-    
     /* Delay to allow UART transmission to complete */
     HAL_Delay(100);
     
@@ -96,6 +100,15 @@ void Module_System_SoftwareReset(void)
     while (1);
 }
 
+void Module_System_SoftwareReset(void)
+{
+    DEBUG_WARN("Software reset requested");
+    
+    /* Queued Flash writes (e.g. AT+SAVE) must land before the reset. Inside
+       the writer's CPU2 wait this returns and the writer task resets later */
+    Module_Flash_FlushThen(System_Reboot);
+}
+
 int Module_System_HardwareReset(void)
 {
     /* Hardware reset pin not used in this design */
@@ -116,14 +129,8 @@ void Module_System_FactoryReset(void)
     
     DEBUG_INFO("Factory reset complete, rebooting...");
     
-    /* Delay for UART transmission */
-    HAL_Delay(100);
-    
     /* Software reset to apply changes */
-    NVIC_SystemReset();
-    
-    /* Should never reach here */
-    while (1);
+    Module_Flash_FlushThen(System_Reboot);
 }
 
 /*============================================================================
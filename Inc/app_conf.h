@@ -618,6 +618,27 @@ typedef enum
 #define MAX_DBG_TRACE_MSG_SIZE   1024
 
 /* USER CODE BEGIN Defines */
+/**
+ * Sequencer task and ISR profiling on the DWT cycle counter (AT+PROF)
+ * Set to 0 to remove the hooks from UTIL_SEQ and the ISRs
+ */
+#define CFG_PROF_ENABLE    1
+
+/**
+ * Sequencer priority classes (CFG_SCH_PRIO_0 runs first). UTIL_SEQ_Run()
+ * always picks the highest class with a pending task and round-robins
+ * within a class, so a class only runs when all classes above are idle.
+ *  - RT:   HCI event intake (notifications are forwarded from it), system
+ *          HCI, UART data mode and AT command processing. Round-robin with
+ *          the HCI event task keeps the AT path alive during event floods.
+ *  - CTRL: Asynchronous HCI command queue, GATT procedures: discovery
+ *          flow, request queue, polling.
+ *  - BG:   Work that can wait or be dropped: scan report processing,
+ *          Flash writes, event log replay, debug output, throughput test.
+ */
+#define CFG_SCH_PRIO_RT     CFG_SCH_PRIO_0
+#define CFG_SCH_PRIO_CTRL   CFG_SCH_PRIO_1
+#define CFG_SCH_PRIO_BG     CFG_SCH_PRIO_2
 
 /* USER CODE END Defines */
 
@@ -642,6 +663,11 @@ typedef enum
   CFG_TASK_HCI_ASYNCH_EVT_ID,
   /* USER CODE BEGIN CFG_Task_Id_With_HCI_Cmd_t */
   CFG_TASK_AT_CMD_PROC_ID,
+  CFG_TASK_GATT_FLOW_ID,
+  CFG_TASK_GATT_QUEUE_ID,
+  CFG_TASK_DATA_MODE_ID,
+  CFG_TASK_TPUT_ID,
+  CFG_TASK_HCI_CMDQ_ID,
 
   /* USER CODE END CFG_Task_Id_With_HCI_Cmd_t */
   CFG_LAST_TASK_ID_WITH_HCICMD,                                               /**< Shall be LAST in the list */
@@ -653,6 +679,11 @@ typedef enum
   CFG_FIRST_TASK_ID_WITH_NO_HCICMD = CFG_LAST_TASK_ID_WITH_HCICMD - 1,        /**< Shall be FIRST in the list */
   CFG_TASK_SYSTEM_HCI_ASYNCH_EVT_ID,
   /* USER CODE BEGIN CFG_Task_Id_With_NO_HCI_Cmd_t */
+  CFG_TASK_POLL_ID,
+  CFG_TASK_FLASH_ID,
+  CFG_TASK_EVLOG_ID,
+  CFG_TASK_LOG_ID,
+  CFG_TASK_SCAN_REPORT_ID,
 
   /* USER CODE END CFG_Task_Id_With_NO_HCI_Cmd_t */
   CFG_LAST_TASK_ID_WITH_NO_HCICMD                                            /**< Shall be LAST in the list */
@@ -668,6 +699,8 @@ typedef enum
 {
   CFG_SCH_PRIO_0,
   /* USER CODE BEGIN CFG_SCH_Prio_Id_t */
+  CFG_SCH_PRIO_1,
+  CFG_SCH_PRIO_2,
 
   /* USER CODE END CFG_SCH_Prio_Id_t */
   CFG_SCH_PRIO_NBR
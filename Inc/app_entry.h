@@ -30,7 +30,7 @@ extern "C" {
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
-
+#include <stdint.h>
 /* USER CODE END Includes */
 
 /* Exported types ------------------------------------------------------------*/
@@ -45,6 +45,7 @@ extern "C" {
 
 /* Exported variables --------------------------------------------------------*/
 /* USER CODE BEGIN EV */
+extern const uint32_t APPE_EvtPoolSize;
 
 /* USER CODE END EV */
 
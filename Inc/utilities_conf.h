@@ -58,6 +58,18 @@ extern "C" {
 #define UTIL_SEQ_CONF_PRIO_NBR                  CFG_SCH_PRIO_NBR
 #define UTIL_SEQ_MEMSET8( dest, value, size )   UTILS_MEMSET8( dest, value, size )
 
+/* Profiler hooks (module_prof.c) */
+#if (CFG_PROF_ENABLE == 1)
+void Module_Prof_TaskSet(uint32_t task_bm, uint32_t prio);
+void Module_Prof_TaskStart(uint32_t task_idx);
+void Module_Prof_TaskEnd(uint32_t task_idx);
+void Module_Prof_Idle(void);
+#define UTIL_SEQ_CONF_PROF_TASK_SET( bm, prio ) Module_Prof_TaskSet( bm, prio )
+#define UTIL_SEQ_CONF_PROF_TASK_START( idx )    Module_Prof_TaskStart( idx )
+#define UTIL_SEQ_CONF_PROF_TASK_END( idx )      Module_Prof_TaskEnd( idx )
+#define UTIL_SEQ_CONF_PROF_IDLE( )              Module_Prof_Idle( )
+#endif
+
 #ifdef __cplusplus
 }
 #endif
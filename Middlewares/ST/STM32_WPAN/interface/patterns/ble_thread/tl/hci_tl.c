@@ -58,6 +58,14 @@ static tListNode HciCmdEventQueue;
 static void (* StatusNotCallBackFunction) (HCI_TL_CmdStatus_t status);
 static volatile HCI_TL_CmdRespStatus_t CmdRspStatusFlag;
 
+/**
+ * Asynchronous command in flight (hci_send_cmd_async()), 0 if none, and whether
+ * hci_send_req() owns the command buffer
+ */
+static volatile uint16_t AsyncCmdOpcode;
+static HCI_TL_CmdAsyncCb_t AsyncCmdDone;
+static volatile uint8_t SyncCmdPending;
+
 /* Private function prototypes -----------------------------------------------*/
 static void NotifyCmdStatus(HCI_TL_CmdStatus_t hcicmdstatus);
 static void SendCmd(uint16_t opcode, uint8_t plen, void *param);
@@ -100,6 +108,7 @@ void hci_user_evt_proc(void)
   if((LST_is_empty(&HciAsynchEventQueue) == FALSE) && (UserEventFlow != HCI_TL_UserEventFlow_Disable))
   {
     LST_remove_head ( &HciAsynchEventQueue, (tListNode **)&phcievtbuffer );
+    hci_notify_evt_stage(HCI_TL_EvtDequeued, phcievtbuffer);
 
     if (hciContext.UserEvtRx != NULL)
     {
@@ -115,6 +124,7 @@ void hci_user_evt_proc(void)
 
     if(UserEventFlow != HCI_TL_UserEventFlow_Disable)
     {
+      hci_notify_evt_stage(HCI_TL_EvtReleased, phcievtbuffer);
       TL_MM_EvtDone( phcievtbuffer );
     }
     else
@@ -123,6 +133,7 @@ void hci_user_evt_proc(void)
        * put back the event in the queue
        */
       LST_insert_head ( &HciAsynchEventQueue, (tListNode *)phcievtbuffer );
+      hci_notify_evt_stage(HCI_TL_EvtRequeued, phcievtbuffer);
     }
   }
 
@@ -161,6 +172,17 @@ int hci_send_req(struct hci_request *p_cmd, uint8_t async)
   NotifyCmdStatus(HCI_TL_CmdBusy);
   local_cmd_status = HCI_TL_CmdBusy;
   opcode = ((p_cmd->ocf) & 0x03ff) | ((p_cmd->ogf) << 10);
+
+  /**
+   * An asynchronous command owns the command buffer: let its response come back first
+   */
+  SyncCmdPending = 1;
+  hci_cmd_async_proc();
+  while(AsyncCmdOpcode != 0)
+  {
+    hci_cmd_resp_wait(HCI_TL_DEFAULT_TIMEOUT);
+    hci_cmd_async_proc();
+  }
   
   CmdRspStatusFlag = HCI_TL_CMD_RESP_WAIT;
   SendCmd(opcode, p_cmd->clen, p_cmd->cparam);
@@ -210,9 +232,90 @@ int hci_send_req(struct hci_request *p_cmd, uint8_t async)
 
   NotifyCmdStatus(HCI_TL_CmdAvailable);
 
+  /**
+   * Asynchronous commands queued meanwhile may be sent
+   */
+  SyncCmdPending = 0;
+  hci_notify_cmd_async();
+
   return 0;
 }
 
+int hci_send_cmd_async(uint16_t opcode, uint8_t plen, const void *param, HCI_TL_CmdAsyncCb_t done)
+{
+  if((AsyncCmdOpcode != 0) || (SyncCmdPending != 0))
+  {
+    return -1;
+  }
+
+  AsyncCmdOpcode = opcode;
+  AsyncCmdDone = done;
+  SendCmd(opcode, plen, (void *)param);
+
+  return 0;
+}
+
+void hci_cmd_async_proc(void)
+{
+  TL_CcEvt_t  *pcommand_complete_event;
+  TL_CsEvt_t    *pcommand_status_event;
+  TL_EvtPacket_t *pevtpacket;
+  HCI_TL_CmdAsyncCb_t done;
+  const uint8_t *rparam;
+  uint16_t opcode;
+  uint8_t rlen;
+
+  /**
+   * Same rules as hci_send_req(): the command is complete when the controller
+   * can take a new one. The return parameters stay in the command buffer until
+   * the next command is sent
+   */
+  while((AsyncCmdOpcode != 0) && (LST_is_empty(&HciCmdEventQueue) == FALSE))
+  {
+    LST_remove_head (&HciCmdEventQueue, (tListNode **)&pevtpacket);
+    opcode = AsyncCmdOpcode;
+    rparam = NULL;
+    rlen = 0;
+
+    if(pevtpacket->evtserial.evt.evtcode == TL_BLEEVT_CS_OPCODE)
+    {
+      pcommand_status_event = (TL_CsEvt_t*)pevtpacket->evtserial.evt.payload;
+      if(pcommand_status_event->numcmd == 0)
+      {
+        continue;
+      }
+      if(pcommand_status_event->cmdcode == opcode)
+      {
+        rparam = &pcommand_status_event->status;
+        rlen = 1;
+      }
+    }
+    else
+    {
+      pcommand_complete_event = (TL_CcEvt_t*)pevtpacket->evtserial.evt.payload;
+      if(pcommand_complete_event->numcmd == 0)
+      {
+        continue;
+      }
+      if(pcommand_complete_event->cmdcode == opcode)
+      {
+        rparam = pcommand_complete_event->payload;
+        rlen = pevtpacket->evtserial.evt.plen - TL_EVT_HDR_SIZE;
+      }
+    }
+
+    /* Free before the callback: it may send the next command */
+    done = AsyncCmdDone;
+    AsyncCmdOpcode = 0;
+    if(done != NULL)
+    {
+      done(opcode, rparam, rlen);
+    }
+  }
+
+  return;
+}
+
 /* Private functions ---------------------------------------------------------*/
 static void TlInit( TL_CmdPacket_t * p_cmdbuffer )
 {
@@ -227,6 +330,9 @@ static void TlInit( TL_CmdPacket_t * p_cmdbuffer )
 
   LST_init_head (&HciAsynchEventQueue);
 
+  AsyncCmdOpcode = 0;
+  SyncCmdPending = 0;
+
   UserEventFlow = HCI_TL_UserEventFlow_Enable;
 
   /* Initialize low level driver */
@@ -277,11 +383,19 @@ static void TlEvtReceived(TL_EvtPacket_t *hcievt)
   if ( ((hcievt->evtserial.evt.evtcode) == TL_BLEEVT_CS_OPCODE) || ((hcievt->evtserial.evt.evtcode) == TL_BLEEVT_CC_OPCODE ) )
   {
     LST_insert_tail(&HciCmdEventQueue, (tListNode *)hcievt);
-    hci_cmd_resp_release(0); /**< Notify the application a full Cmd Event has been received */
+    if((AsyncCmdOpcode != 0) && (SyncCmdPending == 0))
+    {
+      hci_notify_cmd_async(); /**< Response to an asynchronous command, nobody is waiting */
+    }
+    else
+    {
+      hci_cmd_resp_release(0); /**< Notify the application a full Cmd Event has been received */
+    }
   }
   else
   {
     LST_insert_tail(&HciAsynchEventQueue, (tListNode *)hcievt);
+    hci_notify_evt_stage(HCI_TL_EvtQueued, hcievt);
     hci_notify_asynch_evt((void*) &HciAsynchEventQueue); /**< Notify the application a full HCI event has been received */
   }
 
@@ -298,6 +412,19 @@ __WEAK void hci_cmd_resp_wait(uint32_t timeout)
   return;
 }
 
+__WEAK void hci_notify_cmd_async(void)
+{
+  return;
+}
+
+__WEAK void hci_notify_evt_stage(HCI_TL_EvtStage_t stage, TL_EvtPacket_t *pevt)
+{
+  (void)stage;
+  (void)pevt;
+
+  return;
+}
+
 __WEAK void hci_cmd_resp_release(uint32_t flag)
 {
   (void)flag;
@@ -41,6 +41,14 @@ typedef enum
   HCI_TL_CmdAvailable
 } HCI_TL_CmdStatus_t;
 
+typedef enum
+{
+  HCI_TL_EvtQueued,       /**< Added to the asynchronous event queue (IPCC RX interrupt context) */
+  HCI_TL_EvtDequeued,     /**< Removed from the queue to be reported */
+  HCI_TL_EvtRequeued,     /**< Put back at the head: user event flow disabled */
+  HCI_TL_EvtReleased,     /**< About to be returned to the memory manager */
+} HCI_TL_EvtStage_t;
+
 /**
  * @brief Structure used to manage the BUS IO operations.
  *        All the structure fields will point to functions defined at user level.
@@ -82,6 +90,13 @@ typedef struct
   void (* StatusNotCallBack) (HCI_TL_CmdStatus_t status);
 } HCI_TL_HciInitConf_t;
 
+/**
+ * @brief Completion of a command sent with hci_send_cmd_async()
+ *        rparam: return parameters (status first), valid during the call only
+ *        rlen:   0 when the response did not match the command opcode
+ */
+typedef void (* HCI_TL_CmdAsyncCb_t) (uint16_t opcode, const uint8_t *rparam, uint8_t rlen);
+
 /**
  * @brief  Register IO bus services.
  * @param  fops The HCI IO structure managing the IO BUS
@@ -137,6 +152,30 @@ void hci_cmd_resp_wait(uint32_t timeout);
  */
 void hci_cmd_resp_release(uint32_t flag);
 
+/**
+ * @brief  This function is called when the response to a command sent with hci_send_cmd_async() is received,
+ *         and when a blocking command ends while no asynchronous command is in flight.
+ *         It is called from IPCC RX interrupt context or from the hci_send_req() context.
+ *         It requests hci_cmd_async_proc() to be executed.
+ *         A weak empty implementation is available in hci_tl.c
+ *
+ * @param  None
+ * @retval None
+ */
+void hci_notify_cmd_async(void);
+
+/**
+ * @brief  This function is called at each stage of an asynchronous event in the HCI layer (see HCI_TL_EvtStage_t),
+ *         for queue and memory pool monitoring. It is called from IPCC RX interrupt context for
+ *         HCI_TL_EvtQueued and from hci_user_evt_proc() context otherwise.
+ *         A weak empty implementation is available in hci_tl.c
+ *
+ * @param  stage: Event stage
+ * @param  pevt:  Event packet
+ * @retval None
+ */
+void hci_notify_evt_stage(HCI_TL_EvtStage_t stage, TL_EvtPacket_t *pevt);
+
 
 
 /**
@@ -160,6 +199,16 @@ void hci_cmd_resp_release(uint32_t flag);
 
 void hci_user_evt_proc(void);
 
+/**
+ * @brief  This process shall be called by the scheduler each time it is requested with hci_notify_cmd_async()
+ *         It reports the response of the asynchronous command in flight to its callback, which may send the
+ *         next one.
+ *
+ * @param  None
+ * @retval None
+ */
+void hci_cmd_async_proc(void);
+
 /**
  * END OF SECTION - PROCESS TO BE CALLED BY THE SCHEDULER
  *********************************************************************************************************************
@@ -184,6 +233,19 @@ void hci_user_evt_proc(void);
  */
 void hci_init(void(* UserEvtRx)(void* pData), void* pConf);
 
+/**
+ * @brief  Send an ACI/HCI command without waiting for its response.
+ *         The response is reported to the callback from hci_cmd_async_proc(). Only one command, blocking or
+ *         not, may be in flight: a blocking hci_send_req() first waits for the asynchronous one to complete.
+ *
+ * @param  opcode: Command opcode (OGF << 10 | OCF)
+ * @param  plen:   Parameter length
+ * @param  param:  Parameters, copied before returning
+ * @param  done:   Completion callback (may be NULL)
+ * @retval 0 when sent, -1 when a command is already in flight
+ */
+int hci_send_cmd_async(uint16_t opcode, uint8_t plen, const void *param, HCI_TL_CmdAsyncCb_t done);
+
 /**
  * END OF SECTION - INTERFACES USED BY THE BLE DRIVER
  *********************************************************************************************************************
@@ -40,6 +40,7 @@
 /* USER CODE BEGIN Includes */
 #include "ble_connection.h"
 #include "ble_event_handler.h"
+#include "module_flash.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -252,7 +253,7 @@ void APP_BLE_Init(void)
   SHCI_CmdStatus_t status;
   tBleStatus ret = BLE_STATUS_INVALID_PARAMS;
   /* USER CODE BEGIN APP_BLE_Init_1 */
-
+  Module_Flash_OnCpu2Ready();
   /* USER CODE END APP_BLE_Init_1 */
   SHCI_C2_Ble_Init_Cmd_Packet_t ble_init_cmd_packet =
       {
@@ -537,7 +538,15 @@ SVCCTL_UserEvtFlowStatus_t SVCCTL_App_Notification(void *pckt)
     switch (meta_evt->subevent)
     {
       /* USER CODE BEGIN subevent */
+    case HCI_LE_CONNECTION_UPDATE_COMPLETE_SUBEVT_CODE:
+    {
+      hci_le_connection_update_complete_event_rp0 *upd = (hci_le_connection_update_complete_event_rp0 *)meta_evt->data;
 
+      if (upd->Status == 0) {
+        BLE_EventHandler_OnConnParams(upd->Connection_Handle, upd->Conn_Interval);
+      }
+    }
+    break; /* HCI_LE_CONNECTION_UPDATE_COMPLETE_SUBEVT_CODE */
       /* USER CODE END subevent */
 
     case HCI_LE_CONNECTION_COMPLETE_SUBEVT_CODE:
@@ -546,6 +555,9 @@ SVCCTL_UserEvtFlowStatus_t SVCCTL_App_Notification(void *pckt)
         /* Forward to BLE Gateway */
         hci_le_connection_complete_event_rp0 *conn_evt = (hci_le_connection_complete_event_rp0 *)meta_evt->data;
         BLE_Connection_OnConnected(conn_evt->Peer_Address, conn_evt->Connection_Handle, conn_evt->Status);
+        if (conn_evt->Status == 0) {
+          BLE_EventHandler_OnConnParams(conn_evt->Connection_Handle, conn_evt->Conn_Interval);
+        }
       }
       /* USER CODE END EVT_LE_CONN_COMPLETE */
       /**
@@ -561,21 +573,9 @@ SVCCTL_UserEvtFlowStatus_t SVCCTL_App_Notification(void *pckt)
       handleNotification.ConnectionHandle = BleApplicationContext.BleApplicationContext_legacy.connectionHandle;
       P2PC_APP_Notification(&handleNotification);
 
-      /* DISABLED: Auto GATT discovery blocks AT command processing
-       * User will manually trigger via AT+DISC command instead
+      /* GATT discovery is not started here: it is driven per link by the
+       * non-blocking flow engine (ble_gatt_flow.c, AT+FLOW) or manually via AT+DISC
        */
-      /*
-      result = aci_gatt_disc_all_primary_services(BleApplicationContext.BleApplicationContext_legacy.connectionHandle);
-      if (result == BLE_STATUS_SUCCESS)
-      {
-        APP_DBG_MSG("\r\n\r** GATT SERVICES & CHARACTERISTICS DISCOVERY  \n\r");
-        APP_DBG_MSG("* GATT :  Start Searching Primary Services \r\n\r");
-      }
-      else
-      {
-        APP_DBG_MSG("BLE_CTRL_App_Notification(), All services discovery Failed \r\n\r");
-      }
-      */
       break; /* HCI_LE_CONNECTION_COMPLETE_SUBEVT_CODE */
 
     case HCI_LE_ADVERTISING_REPORT_SUBEVT_CODE:
@@ -64,6 +64,8 @@ PLACE_IN_SECTION("MB_MEM2") ALIGN(4) static uint8_t SystemSpareEvtBuffer[sizeof(
 PLACE_IN_SECTION("MB_MEM2") ALIGN(4) static uint8_t BleSpareEvtBuffer[sizeof(TL_PacketHeader_t) + TL_EVT_HDR_SIZE + 255];
 
 /* USER CODE BEGIN PV */
+/* Asynchronous event pool size, for pool usage monitoring */
+const uint32_t APPE_EvtPoolSize = POOL_SIZE;
 
 /* USER CODE END PV */
 
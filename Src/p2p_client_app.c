@@ -33,6 +33,7 @@
 
 /* USER CODE BEGIN Includes */
 #include "ble_event_handler.h"
+#include "ble_gatt_client.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -405,6 +406,10 @@ static SVCCTL_EvtAckStatus_t Event_Handler(void *Event)
           uint8_t numDesc, idx, i;
           uint16_t uuid, handle;
 
+          /* Forward descriptors of all links to BLE Gateway first */
+          BLE_EventHandler_OnDescriptorDiscovered(pr->Connection_Handle, pr->Format,
+                                                  pr->Handle_UUID_Pair, pr->Event_Data_Length);
+
           /*
            * event data will be of the format
            * 2 bytes handle
@@ -488,6 +493,19 @@ static SVCCTL_EvtAckStatus_t Event_Handler(void *Event)
         }
         break;/* end ACI_GATT_NOTIFICATION_VSEVT_CODE */
 
+        case ACI_GATT_INDICATION_VSEVT_CODE:
+        {
+          aci_gatt_indication_event_rp0 *pr = (void*)blecore_evt->data;
+
+          /* Indications take the notification path; the peer waits for the confirmation */
+          BLE_EventHandler_OnNotification(pr->Connection_Handle,
+                                          pr->Attribute_Handle,
+                                          pr->Attribute_Value,
+                                          pr->Attribute_Value_Length);
+          aci_gatt_confirm_indication(pr->Connection_Handle);
+        }
+        break;/* end ACI_GATT_INDICATION_VSEVT_CODE */
+
         case ACI_GATT_PROC_COMPLETE_VSEVT_CODE:
         {
           aci_gatt_proc_complete_event_rp0 *pr = (void*)blecore_evt->data;
@@ -517,6 +535,99 @@ static SVCCTL_EvtAckStatus_t Event_Handler(void *Event)
           }
         }
         break; /*ACI_GATT_PROC_COMPLETE_VSEVT_CODE*/
+
+        case ACI_ATT_EXCHANGE_MTU_RESP_VSEVT_CODE:
+        {
+          aci_att_exchange_mtu_resp_event_rp0 *pr = (void*)blecore_evt->data;
+
+          BLE_EventHandler_OnMtuExchanged(pr->Connection_Handle, pr->Server_RX_MTU);
+        }
+        break; /*ACI_ATT_EXCHANGE_MTU_RESP_VSEVT_CODE*/
+
+        case ACI_GATT_TX_POOL_AVAILABLE_VSEVT_CODE:
+        {
+          aci_gatt_tx_pool_available_event_rp0 *pr = (void*)blecore_evt->data;
+
+          BLE_EventHandler_OnTxPoolAvailable(pr->Connection_Handle, pr->Available_Buffers);
+        }
+        break; /*ACI_GATT_TX_POOL_AVAILABLE_VSEVT_CODE*/
+
+        case ACI_L2CAP_COC_CONNECT_VSEVT_CODE:
+        {
+          aci_l2cap_coc_connect_event_rp0 *pr = (void*)blecore_evt->data;
+
+          BLE_EventHandler_OnCocConnectRequest(pr->Connection_Handle, pr->SPSM);
+        }
+        break; /*ACI_L2CAP_COC_CONNECT_VSEVT_CODE*/
+
+        case ACI_L2CAP_COC_CONNECT_CONFIRM_VSEVT_CODE:
+        {
+          aci_l2cap_coc_connect_confirm_event_rp0 *pr = (void*)blecore_evt->data;
+
+          BLE_EventHandler_OnCocConnectConfirm(pr->Connection_Handle, pr->MTU, pr->MPS,
+                                               pr->Initial_Credits, pr->Result,
+                                               pr->Channel_Number, pr->Channel_Index_List);
+        }
+        break; /*ACI_L2CAP_COC_CONNECT_CONFIRM_VSEVT_CODE*/
+
+        case ACI_L2CAP_COC_DISCONNECT_VSEVT_CODE:
+        {
+          aci_l2cap_coc_disconnect_event_rp0 *pr = (void*)blecore_evt->data;
+
+          BLE_EventHandler_OnCocDisconnect(pr->Channel_Index);
+        }
+        break; /*ACI_L2CAP_COC_DISCONNECT_VSEVT_CODE*/
+
+        case ACI_L2CAP_COC_FLOW_CONTROL_VSEVT_CODE:
+        {
+          aci_l2cap_coc_flow_control_event_rp0 *pr = (void*)blecore_evt->data;
+
+          BLE_EventHandler_OnCocFlowControl(pr->Channel_Index, pr->Credits);
+        }
+        break; /*ACI_L2CAP_COC_FLOW_CONTROL_VSEVT_CODE*/
+
+        case ACI_L2CAP_COC_RX_DATA_VSEVT_CODE:
+        {
+          aci_l2cap_coc_rx_data_event_rp0 *pr = (void*)blecore_evt->data;
+
+          BLE_EventHandler_OnCocRxData(pr->Channel_Index, pr->Data, pr->Length);
+        }
+        break; /*ACI_L2CAP_COC_RX_DATA_VSEVT_CODE*/
+
+        case ACI_L2CAP_COC_TX_POOL_AVAILABLE_VSEVT_CODE:
+          BLE_EventHandler_OnCocTxPoolAvailable();
+        break; /*ACI_L2CAP_COC_TX_POOL_AVAILABLE_VSEVT_CODE*/
+
+        case ACI_ATT_FIND_BY_TYPE_VALUE_RESP_VSEVT_CODE:
+        {
+          aci_att_find_by_type_value_resp_event_rp0 *pr = (void*)blecore_evt->data;
+
+          BLE_EventHandler_OnServiceFoundByUUID(pr->Connection_Handle,
+                                                (const uint8_t *)pr->Attribute_Group_Handle_Pair,
+                                                pr->Num_of_Handle_Pair);
+        }
+        break; /*ACI_ATT_FIND_BY_TYPE_VALUE_RESP_VSEVT_CODE*/
+
+        case ACI_GATT_DISC_READ_CHAR_BY_UUID_RESP_VSEVT_CODE:
+        {
+          aci_gatt_disc_read_char_by_uuid_resp_event_rp0 *pr = (void*)blecore_evt->data;
+
+          BLE_EventHandler_OnCharFoundByUUID(pr->Connection_Handle, pr->Attribute_Handle,
+                                             pr->Attribute_Value, pr->Attribute_Value_Length);
+        }
+        break; /*ACI_GATT_DISC_READ_CHAR_BY_UUID_RESP_VSEVT_CODE*/
+
+        case ACI_ATT_READ_RESP_VSEVT_CODE:
+        {
+          aci_att_read_resp_event_rp0 *pr = (void*)blecore_evt->data;
+
+          /* ATT Read Response carries no handle: use the one tracked at request time */
+          BLE_EventHandler_OnReadResponse(pr->Connection_Handle,
+                                          BLE_GATT_TakePendingReadHandle(pr->Connection_Handle),
+                                          pr->Attribute_Value, pr->Event_Data_Length);
+        }
+        break; /*ACI_ATT_READ_RESP_VSEVT_CODE*/
+
         default:
           break;
       }
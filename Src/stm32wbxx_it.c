@@ -23,6 +23,8 @@
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include "at_command.h"
+#include "module_prof.h"
+#include "hw_if.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -265,6 +267,8 @@ void USB_LP_IRQHandler(void)
 void LPUART1_IRQHandler(void)
 {
   /* USER CODE BEGIN LPUART1_IRQn 0 */
+    PROF_ISR_ENTER(prof);
+    
     // Check RXNE flag (Receive Not Empty)
     if (__HAL_UART_GET_FLAG(&hlpuart1, UART_FLAG_RXNE) && 
         __HAL_UART_GET_IT_SOURCE(&hlpuart1, UART_IT_RXNE)) {
@@ -290,6 +294,7 @@ void LPUART1_IRQHandler(void)
   /* USER CODE END LPUART1_IRQn 0 */
   HAL_UART_IRQHandler(&hlpuart1);
   /* USER CODE BEGIN LPUART1_IRQn 1 */
+  PROF_ISR_EXIT(PROF_ISR_LPUART1, prof);
 
   /* USER CODE END LPUART1_IRQn 1 */
 }
@@ -300,11 +305,11 @@ void LPUART1_IRQHandler(void)
 void IPCC_C1_RX_IRQHandler(void)
 {
   /* USER CODE BEGIN IPCC_C1_RX_IRQn 0 */
-
+  PROF_ISR_ENTER(prof);
   /* USER CODE END IPCC_C1_RX_IRQn 0 */
   HAL_IPCC_RX_IRQHandler(&hipcc);
   /* USER CODE BEGIN IPCC_C1_RX_IRQn 1 */
-
+  PROF_ISR_EXIT(PROF_ISR_IPCC_RX, prof);
   /* USER CODE END IPCC_C1_RX_IRQn 1 */
 }
 
@@ -314,11 +319,11 @@ void IPCC_C1_RX_IRQHandler(void)
 void IPCC_C1_TX_IRQHandler(void)
 {
   /* USER CODE BEGIN IPCC_C1_TX_IRQn 0 */
-
+  PROF_ISR_ENTER(prof);
   /* USER CODE END IPCC_C1_TX_IRQn 0 */
   HAL_IPCC_TX_IRQHandler(&hipcc);
   /* USER CODE BEGIN IPCC_C1_TX_IRQn 1 */
-
+  PROF_ISR_EXIT(PROF_ISR_IPCC_TX, prof);
   /* USER CODE END IPCC_C1_TX_IRQn 1 */
 }
 
@@ -338,4 +343,14 @@ void HSEM_IRQHandler(void)
 
 /* USER CODE BEGIN 1 */
 
+/**
+  * @brief This function handles RTC wake-up interrupt (timer server).
+  */
+void RTC_WKUP_IRQHandler(void)
+{
+  PROF_ISR_ENTER(prof);
+  HW_TS_RTC_Wakeup_Handler();
+  PROF_ISR_EXIT(PROF_ISR_RTC_WKUP, prof);
+}
+
 /* USER CODE END 1 */
@@ -23,6 +23,7 @@
 
 /* USER CODE BEGIN INCLUDE */
 #include <stdio.h>
+#include "debug_trace.h"
 /* USER CODE END INCLUDE */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -311,6 +312,7 @@ static int8_t CDC_TransmitCplt_FS(uint8_t *Buf, uint32_t *Len, uint8_t epnum)
   UNUSED(Buf);
   UNUSED(Len);
   UNUSED(epnum);
+  DEBUG_OnTxComplete();
   /* USER CODE END 13 */
   return result;
 }
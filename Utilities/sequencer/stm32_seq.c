@@ -108,6 +108,22 @@ typedef struct
 #define UTIL_SEQ_MEMSET8( dest, value, size )   UTILS_MEMSET8( dest, value, size )
 #endif
 
+/**
+ * @brief Profiling hooks, empty unless defined in utilities_conf.h
+ */
+#ifndef UTIL_SEQ_CONF_PROF_TASK_SET
+#define UTIL_SEQ_CONF_PROF_TASK_SET( bm, prio )
+#endif
+#ifndef UTIL_SEQ_CONF_PROF_TASK_START
+#define UTIL_SEQ_CONF_PROF_TASK_START( idx )
+#endif
+#ifndef UTIL_SEQ_CONF_PROF_TASK_END
+#define UTIL_SEQ_CONF_PROF_TASK_END( idx )
+#endif
+#ifndef UTIL_SEQ_CONF_PROF_IDLE
+#define UTIL_SEQ_CONF_PROF_IDLE( )
+#endif
+
 /**
  * @}
  */
@@ -287,7 +303,9 @@ void UTIL_SEQ_Run( UTIL_SEQ_bm_t Mask_bm )
     UTIL_SEQ_EXIT_CRITICAL_SECTION( );
 
     /* Execute the task */
+    UTIL_SEQ_CONF_PROF_TASK_START( CurrentTaskIdx );
     TaskCb[CurrentTaskIdx]( );
+    UTIL_SEQ_CONF_PROF_TASK_END( CurrentTaskIdx );
 
     local_taskset = TaskSet;
     local_evtset = EvtSet;
@@ -297,6 +315,7 @@ void UTIL_SEQ_Run( UTIL_SEQ_bm_t Mask_bm )
 
   /* the set of CurrentTaskIdx to no task running allows to call WaitEvt in the Pre/Post ilde context */
   CurrentTaskIdx = UTIL_SEQ_NOTASKRUNNING;
+  UTIL_SEQ_CONF_PROF_IDLE( );
   UTIL_SEQ_PreIdle( );
 
   UTIL_SEQ_ENTER_CRITICAL_SECTION_IDLE( );
@@ -336,6 +355,7 @@ void UTIL_SEQ_SetTask( UTIL_SEQ_bm_t TaskId_bm , uint32_t Task_Prio )
 {
   UTIL_SEQ_ENTER_CRITICAL_SECTION( );
 
+  UTIL_SEQ_CONF_PROF_TASK_SET( TaskId_bm, Task_Prio );
   TaskSet |= TaskId_bm;
   TaskPrio[Task_Prio].priority |= TaskId_bm;
 
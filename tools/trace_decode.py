@@ -0,0 +1,211 @@
+#!/usr/bin/env python3
+"""
+Decode the tokenized debug trace (firmware built with DEBUG_TOKENIZED=1).
+
+The format strings are read from the .trace_fmt section of the firmware ELF;
+frames from the USB CDC console are expanded back to text. Bytes outside
+frames (boot printf output) are passed through unchanged.
+
+Usage:
+    trace_decode.py <firmware.elf> [<capture file | serial port>]
+
+Without a capture argument the trace is read from stdin. A serial port
+(e.g. /dev/ttyACM0 or COM5) needs pyserial.
+"""
+
+import re
+import struct
+import sys
+
+SYNC = 0xA5
+SUPPRESSED = 0x08
+LEVELS = {1: "ERROR", 2: "WARN", 3: "INFO", 4: "DEBUG"}
+SPEC = re.compile(r"%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d*))?(?:hh|h|ll|l|z|j|t)?([diouxXcsp%])")
+
+
+def load_formats(path, section=".trace_fmt"):
+    """Map the address of each format string to the string"""
+    with open(path, "rb") as f:
+        elf = f.read()
+    if elf[:4] != b"\x7fELF":
+        raise ValueError("%s: not an ELF file" % path)
+
+    is64 = elf[4] == 2
+    end = "<" if elf[5] == 1 else ">"
+    if is64:
+        shoff, = struct.unpack_from(end + "Q", elf, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from(end + "HHH", elf, 0x3A)
+        shdr = end + "IIQQQQIIQQ"
+    else:
+        shoff, = struct.unpack_from(end + "I", elf, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from(end + "HHH", elf, 0x2E)
+        shdr = end + "IIIIIIIIII"
+
+    sections = [struct.unpack_from(shdr, elf, shoff + i * shentsize) for i in range(shnum)]
+    names = sections[shstrndx]
+    for sh in sections:
+        name_off = names[4] + sh[0]
+        name = elf[name_off:elf.index(b"\0", name_off)].decode()
+        if name != section:
+            continue
+        addr, offset, size = sh[3], sh[4], sh[5]
+        data = elf[offset:offset + size]
+        formats = {}
+        pos = 0
+        while pos < len(data):
+            nul = data.index(b"\0", pos)
+            formats[addr + pos] = data[pos:nul].decode("ascii", "replace")
+            pos = nul + 1
+        return formats
+
+    raise ValueError("%s: no %s section (not a DEBUG_TOKENIZED build?)" % (path, section))
+
+
+class Frame:
+    """Read numbers and strings from a frame payload"""
+
+    def __init__(self, payload):
+        self.data = payload
+        self.pos = 0
+
+    def varint(self):
+        value = shift = 0
+        while True:
+            if self.pos >= len(self.data):
+                raise IndexError
+            b = self.data[self.pos]
+            self.pos += 1
+            value |= (b & 0x7F) << shift
+            shift += 7
+            if not b & 0x80:
+                return value
+
+    def string(self):
+        n = self.data[self.pos]
+        s = self.data[self.pos + 1:self.pos + 1 + n]
+        if len(s) != n:
+            raise IndexError
+        self.pos += 1 + n
+        return s.decode("ascii", "replace")
+
+
+def signed(v):
+    return v - (1 << 32) if v & 0x80000000 else v
+
+
+def render(fmt, frame):
+    """Expand a format the way the firmware's printf would"""
+    out = []
+    last = 0
+    for m in SPEC.finditer(fmt):
+        out.append(fmt[last:m.start()])
+        last = m.end()
+        flags, width, prec, conv = m.groups()
+        if conv == "%":
+            out.append("%")
+            continue
+        try:
+            if width == "*":
+                width = str(signed(frame.varint()))
+            if prec == "*":
+                prec = str(signed(frame.varint()))
+            if conv == "s":
+                value = frame.string()
+            else:
+                value = frame.varint()
+        except IndexError:
+            out.append("?")
+            continue
+
+        spec = "%" + flags + (width or "") + ("." + prec if prec is not None else "")
+        if conv in "di":
+            out.append((spec + "d") % signed(value))
+        elif conv == "u":
+            out.append((spec + "d") % value)
+        elif conv == "c":
+            out.append((spec + "c") % chr(value & 0xFF))
+        elif conv == "p":
+            out.append((spec + "X") % value)
+        else:
+            out.append((spec + conv) % value)
+    out.append(fmt[last:])
+    return "".join(out)
+
+
+def decode(formats, read, write):
+    """Decode a byte stream (read() returns b"" at the end); returns the number of frames"""
+    buf = bytearray()
+    frames = 0
+    time_ms = 0
+
+    while True:
+        chunk = read()
+        if not chunk:
+            break
+        buf += chunk
+
+        while buf:
+            if buf[0] != SYNC:
+                text = buf.find(bytes([SYNC]))
+                text = len(buf) if text < 0 else text
+                write(buf[:text].decode("ascii", "replace"))
+                del buf[:text]
+                continue
+            if len(buf) < 2 or len(buf) < 2 + buf[1]:
+                break
+
+            frame = Frame(bytes(buf[2:2 + buf[1]]))
+            try:
+                fmt = formats[frame.varint()]
+                level = frame.data[frame.pos]
+                frame.pos += 1
+                time_ms += frame.varint()
+                suppressed = frame.varint() if level & SUPPRESSED else 0
+            except (KeyError, IndexError):
+                # Not a frame: the sync byte was data
+                write(chr(buf[0]))
+                del buf[:1]
+                continue
+
+            line = "[%6d.%03d] [%s] %s" % (time_ms // 1000, time_ms % 1000,
+                                          LEVELS.get(level & 0x07, "?"), render(fmt, frame))
+            if suppressed:
+                line += " (+%d suppressed)" % suppressed
+            write(line + "\r\n")
+            del buf[:2 + buf[1]]
+            frames += 1
+
+    return frames
+
+
+def open_input(path):
+    """Return a read function that blocks until some bytes are available"""
+    if path is not None and (path.startswith("/dev/") or path.upper().startswith("COM")):
+        import serial
+        port = serial.Serial(path, timeout=None)
+        return lambda: port.read(max(1, port.in_waiting))
+    stream = sys.stdin.buffer if path is None else open(path, "rb")
+    return lambda: stream.read1(256)
+
+
+def main(argv):
+    if len(argv) not in (2, 3):
+        sys.stderr.write(__doc__)
+        return 2
+
+    formats = load_formats(argv[1])
+    read = open_input(argv[2] if len(argv) == 3 else None)
+
+    def write(text):
+        sys.stdout.write(text)
+        sys.stdout.flush()
+
+    try:
+        decode(formats, read, write)
+    except KeyboardInterrupt:
+        pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))